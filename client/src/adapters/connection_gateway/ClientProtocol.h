@@ -49,6 +49,8 @@ enum ServiceId : quint32 {
   QuitGroupResponse = 1042,
   SendGroupTextRequest = 1043,
   SendGroupTextResponse = 1044,
+  GatewayRedirectRequest = 1045,
+  GatewayRedirectResponse = 1046,
 };
 
 enum ErrorCode : int {
@@ -83,6 +85,7 @@ enum ErrorCode : int {
   ResourceExhausted = 1027,
   DependencyUnavailable = 1028,
   IdempotencyConflict = 1029,
+  RequestCancelled = 1030,
 };
 
 constexpr quint32 ResponseFor(quint32 requestServiceId) {
@@ -16,6 +16,7 @@ namespace {
 constexpr int kHeartbeatIntervalMilliseconds = 20'000;
 constexpr int kReconnectBaseMilliseconds = 200;
 constexpr int kReconnectMaximumMilliseconds = 10'000;
+constexpr int kRedirectMaximumDelayMilliseconds = 60'000;
 constexpr int kServerRequestBudgetMilliseconds = 3'000;
 
 QString NewRequestId() {
@@ -33,12 +34,17 @@ ConnectionGatewayClient::ConnectionGatewayClient(QObject *parent)
   reconnect_timer_.setSingleShot(true);
 
   connect(&socket_, &QTcpSocket::connected, this, [this] {
-    reconnect_attempt_ = 0;
     SetState(State::Authenticating);
     wimi::protocol::Packet login;
     login.setUid(session_.uid);
     login.setAuthToken(session_.token);
+    // 断线重连时先尝试恢复会话；Gateway 找不到停放状态时按 auth_token
+    // 完整登录。
+    if (!resume_token_.isEmpty()) {
+      login.setResumeToken(resume_token_);
+    }
     login.setInit(session_.profileInitializationRequired);
+    login.setTransportFeatures(TcpFrameCodec::kTransportFeatureFragmentation);
     if (session_.profileInitializationRequired) {
       login.setName(session_.profileName);
       login.setAge(0);
@@ -108,6 +114,8 @@ void ConnectionGatewayClient::Open(const GateSession &session) {
       QDateTime::currentMSecsSinceEpoch() +
       std::max<qint64>(0, session.tokenExpiresInSeconds) * 1000;
   reconnect_attempt_ = 0;
+  redirect_delay_milliseconds_ = -1;
+  resume_token_.clear();
   reconnect_timer_.stop();
   heartbeat_timer_.stop();
   desired_open_ = true;
@@ -422,6 +430,10 @@ void ConnectionGatewayClient::HandleFrame(const TcpFrame &frame) {
     socket_.abort();
     return;
   }
+  if (frame.serviceId == protocol::GatewayRedirectRequest) {
+    HandleRedirect(packet);
+    return;
+  }
   if ((frame.serviceId & 1U) == 0U) {
     CompleteFront(frame.serviceId, frame.payload);
   } else {
@@ -440,6 +452,11 @@ void ConnectionGatewayClient::HandleLoginResponse(const QByteArray &payload) {
   const int errorCode =
       response.hasError() ? static_cast<int>(response.error()) : 0;
   if (errorCode != protocol::Success) {
+    // Gateway 登录准入队列已满或依赖暂不可用：保持打开，断开后按退避重连。
+    if (protocol::IsRetryableError(errorCode)) {
+      socket_.disconnectFromHost();
+      return;
+    }
     desired_open_ = false;
     if (errorCode == protocol::TokenInvalid ||
         errorCode == protocol::AuthenticationRequired) {
@@ -452,9 +469,34 @@ void ConnectionGatewayClient::HandleLoginResponse(const QByteArray &payload) {
   }
 
   session_.profileInitializationRequired = false;
+  resume_token_ = response.resumeToken();
+  reconnect_attempt_ = 0;
   SetState(State::Ready);
   heartbeat_timer_.start();
-  emit Authenticated();
+  emit Authenticated(response.resumed());
+}
+
+void ConnectionGatewayClient::HandleRedirect(
+    const wimi::protocol::Packet &redirect) {
+  // 缺少目标或凭证时忽略，连接关闭后按退避重连原 Gateway，再失败由
+  // 上层重新登录 Gate。
+  if (redirect.gatewayHost().isEmpty() || redirect.gatewayPort() <= 0 ||
+      redirect.gatewayPort() > 65535 || redirect.authToken().isEmpty()) {
+    return;
+  }
+  // Gateway 即将关闭连接：改用它预选的目标和新凭证，按指定延迟直连，
+  // 不再经过 Gate。
+  session_.gatewayHost = redirect.gatewayHost();
+  session_.gatewayPort = static_cast<quint16>(redirect.gatewayPort());
+  session_.gatewayId = redirect.gatewayId();
+  session_.token = redirect.authToken();
+  resume_token_.clear();
+  session_.tokenExpiresInSeconds = redirect.authTokenExpiresIn();
+  token_expires_at_milliseconds_ =
+      QDateTime::currentMSecsSinceEpoch() +
+      std::max<qint64>(0, session_.tokenExpiresInSeconds) * 1000;
+  redirect_delay_milliseconds_ = static_cast<int>(std::min<quint64>(
+      redirect.reconnectDelayMs(), kRedirectMaximumDelayMilliseconds));
 }
 
 void ConnectionGatewayClient::ScheduleReconnect() {
@@ -467,6 +509,12 @@ void ConnectionGatewayClient::ScheduleReconnect() {
   }
 
   SetState(State::Reconnecting);
+  if (redirect_delay_milliseconds_ >= 0) {
+    ++reconnect_attempt_;
+    reconnect_timer_.start(redirect_delay_milliseconds_);
+    redirect_delay_milliseconds_ = -1;
+    return;
+  }
   const int exponent = std::min(reconnect_attempt_, 6);
   const int base = std::min(kReconnectMaximumMilliseconds,
                             kReconnectBaseMilliseconds * (1 << exponent));
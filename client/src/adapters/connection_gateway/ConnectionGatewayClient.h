@@ -69,7 +69,8 @@ class ConnectionGatewayClient final : public QObject {
 
  signals:
   void StateChanged(wimi::client::ConnectionGatewayClient::State state);
-  void Authenticated();
+  // resumed 为 true 表示 Gateway 恢复了断线前的会话，未确认推送会重放。
+  void Authenticated(bool resumed);
   void CredentialsExpired();
   void ResponseReceived(const QString &requestId, quint32 serviceId,
                         const QByteArray &payload);
@@ -100,6 +101,7 @@ class ConnectionGatewayClient final : public QObject {
   void SendPacket(quint32 serviceId, const wimi::protocol::Packet &packet);
   void HandleFrame(const TcpFrame &frame);
   void HandleLoginResponse(const QByteArray &payload);
+  void HandleRedirect(const wimi::protocol::Packet &redirect);
   void ScheduleReconnect();
   void StartSocket();
   void SetState(State state);
@@ -116,6 +118,10 @@ class ConnectionGatewayClient final : public QObject {
   qint64 token_expires_at_milliseconds_{};
   std::int64_t next_legacy_sequence_{};
   int reconnect_attempt_{};
+  // Gateway 下线前指定的重连等待；-1 表示按退避重连。
+  int redirect_delay_milliseconds_{-1};
+  // 上次登录签发的会话恢复凭证，只对签发它的 Gateway 有效。
+  QString resume_token_;
   bool desired_open_{};
 };
 
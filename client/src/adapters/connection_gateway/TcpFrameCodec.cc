@@ -3,6 +3,8 @@
 #include <QDataStream>
 #include <QIODevice>
 
+#include <utility>
+
 namespace wimi::client {
 
 QByteArray TcpFrameCodec::Encode(quint32 serviceId, const QByteArray &payload) {
@@ -44,11 +46,42 @@ QVector<TcpFrame> TcpFrameCodec::Feed(const QByteArray &bytes) {
       break;
     }
 
-    frames.push_back(TcpFrame{
-        .serviceId = serviceId,
-        .payload = buffer_.mid(kHeaderSize, payloadSize),
-    });
+    if ((serviceId & kFragmentFlag) == 0) {
+      frames.push_back(TcpFrame{
+          .serviceId = serviceId,
+          .payload = buffer_.mid(kHeaderSize, payloadSize),
+      });
+      buffer_.remove(0, totalSize);
+      continue;
+    }
+
+    // Small frames may arrive between fragments; only one large frame is
+    // in flight at a time, so a single reassembly buffer is enough.
+    const quint32 originalId = serviceId & ~(kFragmentFlag | kFragmentEndFlag);
+    if (reassembling_ && originalId != fragmentServiceId_) {
+      error_ = QStringLiteral("interleaved TCP frame fragments");
+      buffer_.clear();
+      fragments_.clear();
+      return {};
+    }
+    if (static_cast<quint64>(fragments_.size()) + payloadSize >
+        kMaximumPayloadSize) {
+      error_ = QStringLiteral("TCP frame payload exceeds 10 MiB");
+      buffer_.clear();
+      fragments_.clear();
+      return {};
+    }
+    reassembling_ = true;
+    fragmentServiceId_ = originalId;
+    fragments_.append(buffer_.constData() + kHeaderSize, payloadSize);
     buffer_.remove(0, totalSize);
+    if ((serviceId & kFragmentEndFlag) != 0) {
+      frames.push_back(TcpFrame{
+          .serviceId = originalId,
+          .payload = std::exchange(fragments_, QByteArray{}),
+      });
+      reassembling_ = false;
+    }
   }
   return frames;
 }
@@ -63,6 +96,8 @@ QString TcpFrameCodec::ErrorString() const {
 
 void TcpFrameCodec::Reset() {
   buffer_.clear();
+  fragments_.clear();
+  reassembling_ = false;
   error_.clear();
 }
 
@@ -15,6 +15,13 @@ class TcpFrameCodec final {
  public:
   static constexpr quint32 kHeaderSize = 8;
   static constexpr quint32 kMaximumPayloadSize = 10 * 1024 * 1024;
+  // Gateway fragments large frames for clients that advertise
+  // kTransportFeatureFragmentation at login. The top bit of the service id
+  // marks a fragment and the next bit marks the last one; Feed reassembles
+  // them and hands out the original frame with the flags cleared.
+  static constexpr quint32 kFragmentFlag = 0x80000000U;
+  static constexpr quint32 kFragmentEndFlag = 0x40000000U;
+  static constexpr quint32 kTransportFeatureFragmentation = 0x1U;
 
   static QByteArray Encode(quint32 serviceId, const QByteArray &payload);
 
@@ -25,6 +32,9 @@ class TcpFrameCodec final {
 
  private:
   QByteArray buffer_;
+  QByteArray fragments_;
+  quint32 fragmentServiceId_{};
+  bool reassembling_{false};
   QString error_;
 };
 
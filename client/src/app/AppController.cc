@@ -810,15 +810,18 @@ void AppController::ConfigureNetwork(const QString &gateUrl) {
           });
 
   connect(&gateway_client_, &ConnectionGatewayClient::Authenticated, this,
-          [this] {
+          [this](bool resumed) {
             authentication_busy_ = false;
             authentication_error_.clear();
             authentication_completed_ = true;
             SetConnectionStatus(QStringLiteral("online"));
             emit authenticationStateChanged();
             emit authRequiredChanged();
-            gateway_client_.PullFriendList();
-            gateway_client_.PullFriendApplications();
+            // 恢复的会话沿用断线前的好友数据，只按游标补齐断线期间的消息。
+            if (!resumed) {
+              gateway_client_.PullFriendList();
+              gateway_client_.PullFriendApplications();
+            }
             SyncKnownConversations();
             ResumePendingOutgoing();
           });
@@ -136,6 +136,7 @@ class ClientModelsTest final : public QObject {
   void platformNotificationPortUpdatesControllerState();
   void tcpFrameCodecHandlesFragmentationAndCoalescing();
   void tcpFrameCodecRejectsOversizedPayload();
+  void tcpFrameCodecReassemblesGatewayFragments();
 };
 
 void ClientModelsTest::fakeRepositoryExposesEveryPlannedScenario() {
@@ -724,6 +725,48 @@ void ClientModelsTest::tcpFrameCodecRejectsOversizedPayload() {
   QVERIFY(codec.ErrorString().contains(QStringLiteral("10 MiB")));
 }
 
+void ClientModelsTest::tcpFrameCodecReassemblesGatewayFragments() {
+  const auto fragment = [](quint32 serviceId, const QByteArray &payload,
+                           bool last) {
+    QByteArray frame;
+    QDataStream stream(&frame, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::BigEndian);
+    stream << (serviceId | TcpFrameCodec::kFragmentFlag |
+               (last ? TcpFrameCodec::kFragmentEndFlag : 0U))
+           << quint32(payload.size());
+    frame.append(payload);
+    return frame;
+  };
+
+  // A live push and a pong overtake the bulk pull response between its
+  // fragments; the bulk frame is only handed out once complete.
+  const QByteArray stream =
+      fragment(1006, QByteArrayLiteral("history-"), false) +
+      TcpFrameCodec::Encode(1027, QByteArrayLiteral("push")) +
+      fragment(1006, QByteArrayLiteral("page-"), false) +
+      TcpFrameCodec::Encode(1012, QByteArrayLiteral("pong")) +
+      fragment(1006, QByteArrayLiteral("done"), true);
+
+  TcpFrameCodec codec;
+  QVector<TcpFrame> frames;
+  for (qsizetype offset = 0; offset < stream.size(); offset += 5) {
+    frames += codec.Feed(stream.mid(offset, 5));
+  }
+  QVERIFY(!codec.HasError());
+  QCOMPARE(frames.size(), 3);
+  QCOMPARE(frames[0].serviceId, 1027U);
+  QCOMPARE(frames[1].serviceId, 1012U);
+  QCOMPARE(frames[2].serviceId, 1006U);
+  QCOMPARE(frames[2].payload, QByteArrayLiteral("history-page-done"));
+
+  TcpFrameCodec interleaved;
+  QVERIFY(interleaved
+              .Feed(fragment(1006, QByteArrayLiteral("a"), false) +
+                    fragment(1008, QByteArrayLiteral("b"), true))
+              .isEmpty());
+  QVERIFY(interleaved.HasError());
+}
+
 }  // namespace wimi::client
 
 QTEST_GUILESS_MAIN(wimi::client::ClientModelsTest)
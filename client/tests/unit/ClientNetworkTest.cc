@@ -53,6 +53,9 @@ class ClientNetworkTest final : public QObject {
   void gateCoversAccountRequests();
   void gatewayCoversSupportedRequestAndReceiptContracts();
   void gatewayReconnectsAndAuthenticatesAgain();
+  void gatewayFollowsServerRedirect();
+  void gatewayRetriesBusyLogin();
+  void gatewayResumesAfterNetworkLoss();
 };
 
 void ClientNetworkTest::qtProtobufMatchesCanonicalWireFormat() {
@@ -416,6 +419,169 @@ void ClientNetworkTest::gatewayReconnectsAndAuthenticatesAgain() {
   gateway.Close();
 }
 
+void ClientNetworkTest::gatewayFollowsServerRedirect() {
+  QTcpServer draining;
+  QTcpServer target;
+  QVERIFY(draining.listen(QHostAddress::LocalHost, 0));
+  QVERIFY(target.listen(QHostAddress::LocalHost, 0));
+  QVector<wimi::protocol::Packet> targetLogins;
+
+  // 下线中的 Gateway 登录成功后立即推送重定向并断开。
+  connect(&draining, &QTcpServer::newConnection, this, [&] {
+    auto *socket = draining.nextPendingConnection();
+    auto codec = QSharedPointer<TcpFrameCodec>::create();
+    connect(socket, &QTcpSocket::readyRead, socket, [socket, codec, &target] {
+      for (const auto &frame : codec->Feed(socket->readAll())) {
+        if (frame.serviceId != protocol::LoginRequest) {
+          continue;
+        }
+        wimi::protocol::Packet response;
+        response.setError(protocol::Success);
+        socket->write(TcpFrameCodec::Encode(protocol::LoginResponse,
+                                            PacketPayload(response)));
+        wimi::protocol::Packet redirect;
+        redirect.setUid(66);
+        redirect.setGatewayId(QStringLiteral("gateway-b"));
+        redirect.setGatewayHost(QStringLiteral("127.0.0.1"));
+        redirect.setGatewayPort(target.serverPort());
+        redirect.setAuthToken(QStringLiteral("redirect-token"));
+        redirect.setAuthTokenExpiresIn(900);
+        redirect.setReconnectDelayMs(50);
+        socket->write(TcpFrameCodec::Encode(protocol::GatewayRedirectRequest,
+                                            PacketPayload(redirect)));
+        socket->disconnectFromHost();
+      }
+    });
+  });
+  connect(&target, &QTcpServer::newConnection, this, [&] {
+    auto *socket = target.nextPendingConnection();
+    auto codec = QSharedPointer<TcpFrameCodec>::create();
+    connect(socket, &QTcpSocket::readyRead, socket,
+            [socket, codec, &targetLogins] {
+              for (const auto &frame : codec->Feed(socket->readAll())) {
+                if (frame.serviceId != protocol::LoginRequest) {
+                  continue;
+                }
+                targetLogins.push_back(ParsePacket(frame.payload));
+                wimi::protocol::Packet response;
+                response.setError(protocol::Success);
+                socket->write(TcpFrameCodec::Encode(protocol::LoginResponse,
+                                                    PacketPayload(response)));
+              }
+            });
+  });
+
+  ConnectionGatewayClient gateway;
+  QSignalSpy authenticated(&gateway, &ConnectionGatewayClient::Authenticated);
+  QSignalSpy pushes(&gateway, &ConnectionGatewayClient::PushReceived);
+  gateway.Open(GateSession{
+      .uid = 66,
+      .gatewayHost = QStringLiteral("127.0.0.1"),
+      .gatewayPort = draining.serverPort(),
+      .gatewayId = QStringLiteral("gateway-a"),
+      .token = QStringLiteral("token-66"),
+      .tokenExpiresInSeconds = 900,
+  });
+  QTRY_COMPARE_WITH_TIMEOUT(authenticated.count(), 2, 3000);
+  QCOMPARE(targetLogins.size(), 1);
+  QCOMPARE(targetLogins[0].uid(), 66);
+  QCOMPARE(targetLogins[0].authToken(), QStringLiteral("redirect-token"));
+  QCOMPARE(pushes.count(), 0);
+  gateway.Close();
+}
+
+void ClientNetworkTest::gatewayRetriesBusyLogin() {
+  QTcpServer server;
+  QVERIFY(server.listen(QHostAddress::LocalHost, 0));
+  int loginAttempts = 0;
+
+  // 第一次登录遇到准入队列已满，第二次成功。
+  connect(&server, &QTcpServer::newConnection, this, [&] {
+    auto *socket = server.nextPendingConnection();
+    auto codec = QSharedPointer<TcpFrameCodec>::create();
+    connect(socket, &QTcpSocket::readyRead, socket,
+            [socket, codec, &loginAttempts] {
+              for (const auto &frame : codec->Feed(socket->readAll())) {
+                if (frame.serviceId != protocol::LoginRequest) {
+                  continue;
+                }
+                ++loginAttempts;
+                wimi::protocol::Packet response;
+                response.setError(loginAttempts == 1
+                                      ? protocol::ResourceExhausted
+                                      : protocol::Success);
+                socket->write(TcpFrameCodec::Encode(protocol::LoginResponse,
+                                                    PacketPayload(response)));
+              }
+            });
+  });
+
+  ConnectionGatewayClient gateway;
+  QSignalSpy authenticated(&gateway, &ConnectionGatewayClient::Authenticated);
+  QSignalSpy expired(&gateway, &ConnectionGatewayClient::CredentialsExpired);
+  QSignalSpy errors(&gateway, &ConnectionGatewayClient::ProtocolError);
+  gateway.Open(GateSession{
+      .uid = 77,
+      .gatewayHost = QStringLiteral("127.0.0.1"),
+      .gatewayPort = server.serverPort(),
+      .token = QStringLiteral("token-77"),
+      .tokenExpiresInSeconds = 900,
+  });
+  QTRY_COMPARE_WITH_TIMEOUT(authenticated.count(), 1, 3000);
+  QCOMPARE(loginAttempts, 2);
+  QCOMPARE(expired.count(), 0);
+  QCOMPARE(errors.count(), 0);
+  gateway.Close();
+}
+
+void ClientNetworkTest::gatewayResumesAfterNetworkLoss() {
+  QTcpServer server;
+  QVERIFY(server.listen(QHostAddress::LocalHost, 0));
+  QVector<wimi::protocol::Packet> logins;
+
+  // 首次登录签发恢复凭证后断开，模拟网络中断；重连时恢复会话。
+  connect(&server, &QTcpServer::newConnection, this, [&] {
+    auto *socket = server.nextPendingConnection();
+    auto codec = QSharedPointer<TcpFrameCodec>::create();
+    connect(socket, &QTcpSocket::readyRead, socket, [socket, codec, &logins] {
+      for (const auto &frame : codec->Feed(socket->readAll())) {
+        if (frame.serviceId != protocol::LoginRequest) {
+          continue;
+        }
+        logins.push_back(ParsePacket(frame.payload));
+        wimi::protocol::Packet response;
+        response.setError(protocol::Success);
+        response.setResumeToken(
+            QStringLiteral("resume-%1").arg(logins.size()));
+        response.setResumed(logins.size() > 1);
+        socket->write(TcpFrameCodec::Encode(protocol::LoginResponse,
+                                            PacketPayload(response)));
+        if (logins.size() == 1) {
+          socket->disconnectFromHost();
+        }
+      }
+    });
+  });
+
+  ConnectionGatewayClient gateway;
+  QSignalSpy authenticated(&gateway, &ConnectionGatewayClient::Authenticated);
+  gateway.Open(GateSession{
+      .uid = 88,
+      .gatewayHost = QStringLiteral("127.0.0.1"),
+      .gatewayPort = server.serverPort(),
+      .token = QStringLiteral("token-88"),
+      .tokenExpiresInSeconds = 900,
+  });
+  QTRY_COMPARE_WITH_TIMEOUT(authenticated.count(), 2, 5000);
+  QCOMPARE(authenticated[0][0].toBool(), false);
+  QCOMPARE(authenticated[1][0].toBool(), true);
+  QCOMPARE(logins.size(), 2);
+  QVERIFY(!logins[0].hasResumeToken() || logins[0].resumeToken().isEmpty());
+  QCOMPARE(logins[1].resumeToken(), QStringLiteral("resume-1"));
+  QCOMPARE(logins[1].authToken(), QStringLiteral("token-88"));
+  gateway.Close();
+}
+
 }  // namespace wimi::client
 
 QTEST_GUILESS_MAIN(wimi::client::ClientNetworkTest)
@@ -70,6 +70,7 @@ CREATE TABLE `conversations` (
   `type` SMALLINT NOT NULL COMMENT '1 direct, 2 group',
   `businessId` BIGINT UNSIGNED NOT NULL,
   `latestSeq` BIGINT UNSIGNED NOT NULL DEFAULT 0,
+  `seqEpoch` BIGINT UNSIGNED NOT NULL DEFAULT 0 COMMENT 'sequencer epoch of latestSeq',
   `createTime` VARCHAR(32) NOT NULL DEFAULT '',
   PRIMARY KEY (`conversationId`),
   UNIQUE KEY `uk_conversations_type_business` (`type`, `businessId`)
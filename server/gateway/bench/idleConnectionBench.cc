@@ -0,0 +1,245 @@
+#include "GatewayOptions.h"
+#include "GatewayServices.h"
+#include "GatewaySession.h"
+#include "LeaseRefresher.h"
+#include "Logger.h"
+#include "MessageLink.h"
+#include "SessionRegistry.h"
+
+#include <boost/asio.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 空闲连接内存压测：子进程向本机 Gateway 会话层打开 N 条 TCP 连接并完成
+// 登录，父进程按登录前后的 VmRSS 之差计算每连接常驻内存。登录走本地桩，
+// 不依赖 Redis/MySQL；会话、路由表、时间轮与生产路径一致。
+// 客户端 socket 在子进程里，不计入父进程 RSS；内核 socket 缓冲也不计入。
+// 百万连接需要足够的 fd 上限（ulimit -Hn）和 net.ipv4.ip_local_port_range，
+// 源地址按 127.0.0.x 轮换以避开单源地址的临时端口上限。
+// 用法：gatewayIdleConnectionBench [connections]
+
+namespace {
+
+namespace asio = boost::asio;
+using wimi::connection::GatewayServices;
+using wimi::connection::GatewaySession;
+using wimi::connection::LoginResult;
+using wimi::TcpPacket;
+
+constexpr std::size_t kConnectionsPerSourceAddress = 20000;
+
+long ReadRssKilobytes() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("VmRSS:", 0) == 0)
+      return std::strtol(line.c_str() + 6, nullptr, 10);
+  }
+  return 0;
+}
+
+void RaiseFileLimit(std::size_t connections) {
+  rlimit limit{};
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+    return;
+  limit.rlim_cur = limit.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &limit);
+  if (limit.rlim_cur < connections + 64)
+    std::cerr << "warning: RLIMIT_NOFILE " << limit.rlim_cur
+              << " is below the requested connection count\n";
+}
+
+std::string EncodeLogin(int64_t uid) {
+  TcpPacket login;
+  login.set_uid(uid);
+  login.set_auth_token("bench");
+  const std::string payload = wimi::SerializeTcpPacket(login);
+  std::string frame(PROTOCOL_HEADER_TOTAL, '\0');
+  const uint32_t wireId = htonl(ID_LOGIN_INIT_REQ);
+  const uint32_t wireSize = htonl(static_cast<uint32_t>(payload.size()));
+  std::memcpy(frame.data(), &wireId, sizeof(wireId));
+  std::memcpy(frame.data() + sizeof(wireId), &wireSize, sizeof(wireSize));
+  return frame + payload;
+}
+
+bool ReadExactly(int fd, char *data, std::size_t size) {
+  while (size > 0) {
+    const ssize_t count = read(fd, data, size);
+    if (count <= 0)
+      return false;
+    data += count;
+    size -= static_cast<std::size_t>(count);
+  }
+  return true;
+}
+
+// 子进程只用阻塞式 POSIX socket，不触碰父进程 fork 前建立的 asio 状态。
+// 先连接并发送全部登录包，再逐条读回登录响应，全部成功后通知父进程。
+[[noreturn]] void RunClients(unsigned short port, std::size_t connections,
+                             int readyFd) {
+  std::vector<int> sockets;
+  sockets.reserve(connections);
+  for (std::size_t i = 0; i < connections; ++i) {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in source{};
+    source.sin_family = AF_INET;
+    source.sin_addr.s_addr =
+        htonl(INADDR_LOOPBACK + 1 + i / kConnectionsPerSourceAddress);
+    sockaddr_in target{};
+    target.sin_family = AF_INET;
+    target.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    target.sin_port = htons(port);
+    if (fd < 0 ||
+        bind(fd, reinterpret_cast<sockaddr *>(&source), sizeof(source)) != 0 ||
+        connect(fd, reinterpret_cast<sockaddr *>(&target), sizeof(target)) !=
+            0) {
+      std::cerr << "client connect failed at " << i << ": "
+                << std::strerror(errno) << '\n';
+      _exit(EXIT_FAILURE);
+    }
+    const std::string login = EncodeLogin(static_cast<int64_t>(i) + 1);
+    if (write(fd, login.data(), login.size()) !=
+        static_cast<ssize_t>(login.size()))
+      _exit(EXIT_FAILURE);
+    sockets.push_back(fd);
+  }
+
+  std::string body;
+  for (const int fd : sockets) {
+    char header[PROTOCOL_HEADER_TOTAL];
+    if (!ReadExactly(fd, header, sizeof(header)))
+      _exit(EXIT_FAILURE);
+    uint32_t wireSize = 0;
+    std::memcpy(&wireSize, header + PROTOCOL_ID_LEN, sizeof(wireSize));
+    body.resize(ntohl(wireSize));
+    if (!ReadExactly(fd, body.data(), body.size()))
+      _exit(EXIT_FAILURE);
+  }
+  const char ready = 1;
+  if (write(readyFd, &ready, 1) != 1)
+    _exit(EXIT_FAILURE);
+  // 保持连接打开，直到父进程测量完毕后结束本进程。
+  for (;;)
+    pause();
+}
+
+asio::awaitable<void> Accept(asio::ip::tcp::acceptor &acceptor,
+                             GatewayServices &services,
+                             wimi::connection::TimingWheel &timers) {
+  while (acceptor.is_open()) {
+    boost::system::error_code ec;
+    auto socket = co_await acceptor.async_accept(
+        asio::redirect_error(asio::use_awaitable, ec));
+    if (ec)
+      co_return;
+    std::make_shared<GatewaySession>(std::move(socket), services, timers)
+        ->Start();
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const std::size_t connections =
+      argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+  wimi::setLoggerLevel(spdlog::level::warn);
+  RaiseFileLimit(connections);
+
+  // fork 之前不能启动任何线程：acceptor 先在父进程建好，子进程只需端口号。
+  asio::io_context ioContext(1);
+  asio::ip::tcp::acceptor acceptor(
+      ioContext, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+  acceptor.listen(SOMAXCONN);
+  const unsigned short port = acceptor.local_endpoint().port();
+  int readyPipe[2];
+  if (pipe(readyPipe) != 0)
+    return EXIT_FAILURE;
+  const pid_t child = fork();
+  if (child < 0)
+    return EXIT_FAILURE;
+  if (child == 0) {
+    close(readyPipe[0]);
+    RunClients(port, connections, readyPipe[1]);
+  }
+  close(readyPipe[1]);
+
+  wimi::connection::GatewayOptions options;
+  // 压测期间连接保持静默，不能被空闲读超时回收。
+  options.idleReadTimeoutSeconds = 0;
+  asio::thread_pool businessPool(1);
+  wimi::connection::SessionRegistry registry("bench-gateway", "bench", 60,
+                                             options.registryShards);
+  wimi::connection::MessageLinkManager messageLinks(ioContext, businessPool,
+                                                    "bench-gateway", "bench");
+  wimi::connection::LeaseRefresher leaseRefresher(
+      ioContext, businessPool, options.leaseTtlSeconds,
+      std::chrono::milliseconds(options.leaseRefreshFlushMilliseconds),
+      options.leaseRefreshBatchSize);
+  wimi::connection::TimingWheel timers(
+      ioContext, std::chrono::milliseconds(options.timerTickMilliseconds),
+      options.timerSlots);
+  GatewayServices services{
+      registry,
+      messageLinks,
+      businessPool,
+      leaseRefresher,
+      options,
+      [&registry](const TcpPacket &request,
+                  const std::shared_ptr<GatewaySession> &session) {
+        LoginResult result;
+        registry.Attach(request.uid(), session, 1);
+        result.error = ErrorCodes::Success;
+        result.generation = 1;
+        result.response.set_uid(request.uid());
+        result.response.set_error(ErrorCodes::Success);
+        return result;
+      }};
+
+  const long baselineKilobytes = ReadRssKilobytes();
+  const auto started = std::chrono::steady_clock::now();
+  asio::co_spawn(ioContext, Accept(acceptor, services, timers), asio::detached);
+  timers.Start();
+  std::thread io([&ioContext]() { ioContext.run(); });
+
+  char ready = 0;
+  const bool clientsReady = read(readyPipe[0], &ready, 1) == 1;
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - started)
+                             .count();
+  // 登录响应发出后 WriteLoop 才释放写队列，留一点时间让会话回到空闲态。
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  const long loadedKilobytes = ReadRssKilobytes();
+  const std::size_t sessions = registry.Size();
+
+  kill(child, SIGKILL);
+  waitpid(child, nullptr, 0);
+  if (!clientsReady || sessions == 0) {
+    std::cerr << "clients failed, sessions=" << sessions << '\n';
+    _exit(EXIT_FAILURE);
+  }
+  const long deltaKilobytes = loadedKilobytes - baselineKilobytes;
+  std::cout << "connections=" << sessions << " login_seconds=" << seconds
+            << " rss_baseline_kb=" << baselineKilobytes
+            << " rss_loaded_kb=" << loadedKilobytes << " bytes_per_connection="
+            << deltaKilobytes * 1024 / static_cast<long>(sessions) << '\n';
+  std::cout.flush();
+  // 逐个析构百万会话没有测量意义，直接退出。
+  _exit(EXIT_SUCCESS);
+}
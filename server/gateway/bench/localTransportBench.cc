@@ -0,0 +1,178 @@
+#include "gateway_message.grpc.pb.h"
+
+#include <grpcpp/create_channel.h>
+#include <grpcpp/security/credentials.h>
+#include <grpcpp/security/server_credentials.h>
+#include <grpcpp/server_builder.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Gateway-Message 流在 TCP 回环与 Unix 域套接字上的往返延迟对比。
+// 进程内起一个回显 StreamHeartbeat 的 GatewayMessageTransport 服务，同时
+// 监听两种地址；客户端在同一条双向流上逐个发心跳、等 ACK，统计分位数。
+// 帧格式与线上一致，差异只来自传输层。
+// 用法：gatewayLocalTransportBench [round trips] [payload bytes]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using wimi::gateway::GatewayToMessageFrame;
+using wimi::gateway::MessageToGatewayFrame;
+
+class EchoReactor final
+    : public grpc::ServerBidiReactor<GatewayToMessageFrame,
+                                     MessageToGatewayFrame> {
+ public:
+  EchoReactor() {
+    StartRead(&request);
+  }
+
+  void OnReadDone(bool ok) override {
+    if (!ok) {
+      Finish(grpc::Status::OK);
+      return;
+    }
+    // 命令帧回显负载，模拟一次命令往返；心跳直接应答。
+    response.Clear();
+    if (request.has_command()) {
+      auto *result = response.mutable_command_result();
+      result->set_request_seq(request.command().request_seq());
+      result->set_packet(
+          std::move(*request.mutable_command()->mutable_packet()));
+    } else {
+      auto *ack = response.mutable_heartbeat_ack();
+      ack->set_sent_at_unix_ms(request.heartbeat().sent_at_unix_ms());
+      ack->set_sequence(request.heartbeat().sequence());
+    }
+    StartWrite(&response);
+  }
+
+  void OnWriteDone(bool ok) override {
+    if (!ok) {
+      Finish(grpc::Status::OK);
+      return;
+    }
+    request.Clear();
+    StartRead(&request);
+  }
+
+  void OnDone() override {
+    delete this;
+  }
+
+ private:
+  GatewayToMessageFrame request;
+  MessageToGatewayFrame response;
+};
+
+class EchoService final
+    : public wimi::gateway::GatewayMessageTransport::CallbackService {
+ public:
+  grpc::ServerBidiReactor<GatewayToMessageFrame, MessageToGatewayFrame> *
+  Connect(grpc::CallbackServerContext *) override {
+    return new EchoReactor();
+  }
+};
+
+struct Result {
+  double p50{0};
+  double p99{0};
+  double mean{0};
+};
+
+Result Measure(const std::string &target, std::size_t roundTrips,
+               const std::string &payload) {
+  auto channel =
+      grpc::CreateChannel(target, grpc::InsecureChannelCredentials());
+  auto stub = wimi::gateway::GatewayMessageTransport::NewStub(channel);
+  grpc::ClientContext context;
+  auto stream = stub->Connect(&context);
+
+  GatewayToMessageFrame frame;
+  MessageToGatewayFrame reply;
+  std::vector<double> samples;
+  samples.reserve(roundTrips);
+  // 前 1000 次用于建连与预热，不计入统计。
+  const std::size_t warmup = 1000;
+  for (std::size_t i = 0; i < roundTrips + warmup; ++i) {
+    // 无负载时测心跳往返，有负载时测携带 packet 的命令往返。
+    frame.Clear();
+    if (payload.empty()) {
+      frame.mutable_heartbeat()->set_sequence(i);
+    } else {
+      frame.mutable_command()->set_request_seq(i + 1);
+      frame.mutable_command()->set_packet(payload);
+    }
+    const auto started = Clock::now();
+    if (!stream->Write(frame) || !stream->Read(&reply)) {
+      std::cerr << "stream to " << target << " failed\n";
+      std::exit(EXIT_FAILURE);
+    }
+    const double micros =
+        std::chrono::duration<double, std::micro>(Clock::now() - started)
+            .count();
+    if (i >= warmup)
+      samples.push_back(micros);
+  }
+  stream->WritesDone();
+  stream->Finish();
+
+  std::sort(samples.begin(), samples.end());
+  Result result;
+  result.p50 = samples[samples.size() / 2];
+  result.p99 = samples[samples.size() * 99 / 100];
+  for (const double sample : samples)
+    result.mean += sample;
+  result.mean /= static_cast<double>(samples.size());
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  const std::size_t roundTrips =
+      argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+  const std::size_t payloadBytes =
+      argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 0;
+  const std::string payload(payloadBytes, 'x');
+  const std::string socketPath =
+      (std::filesystem::temp_directory_path() /
+       ("wimi-transport-bench-" + std::to_string(::getpid()) + ".sock"))
+          .string();
+
+  EchoService service;
+  int tcpPort = 0;
+  grpc::ServerBuilder builder;
+  builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(),
+                           &tcpPort);
+  builder.AddListeningPort("unix:" + socketPath,
+                           grpc::InsecureServerCredentials());
+  builder.RegisterService(&service);
+  auto server = builder.BuildAndStart();
+  if (!server || tcpPort == 0) {
+    std::cerr << "failed to start echo server\n";
+    return EXIT_FAILURE;
+  }
+
+  const auto tcp =
+      Measure("127.0.0.1:" + std::to_string(tcpPort), roundTrips, payload);
+  const auto local = Measure("unix:" + socketPath, roundTrips, payload);
+  server->Shutdown();
+  std::filesystem::remove(socketPath);
+
+  std::cout << "round trips: " << roundTrips << ", payload: " << payloadBytes
+            << " bytes\n";
+  std::cout << "tcp loopback  p50: " << tcp.p50 << "us, p99: " << tcp.p99
+            << "us, mean: " << tcp.mean << "us\n";
+  std::cout << "unix socket   p50: " << local.p50 << "us, p99: " << local.p99
+            << "us, mean: " << local.mean << "us\n";
+  return EXIT_SUCCESS;
+}
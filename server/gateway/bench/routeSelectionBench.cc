@@ -0,0 +1,137 @@
+#include "Rendezvous.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Message 选路单次开销对比：旧路径每次加锁复制健康 link 列表，并对
+// "会话:节点" 字符串逐个哈希；新路径读原子快照，在整数键上做 rendezvous。
+// link 用只含 id 与健康位的桩代替，差异只来自选路本身。
+// 用法：gatewayRouteSelectionBench [iterations]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using wimi::connection::RendezvousNodeKey;
+using wimi::connection::SelectRendezvous;
+
+struct Link {
+  std::string id;
+  std::atomic<bool> healthy{true};
+};
+
+struct Route {
+  std::shared_ptr<Link> link;
+  uint64_t key{0};
+  uint32_t weight{1};
+};
+
+struct RoutingTable {
+  std::vector<Route> routes;
+  bool weighted{false};
+};
+
+// 与改造前 MessageLinkManager::SelectLink 的会话路径一致。
+std::shared_ptr<Link> SelectLegacy(
+    std::mutex &mutex,
+    const std::unordered_map<std::string, std::shared_ptr<Link>> &links,
+    int64_t conversationId) {
+  std::vector<std::shared_ptr<Link>> healthy;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto &[nodeId, link] : links) {
+      if (link->healthy.load(std::memory_order_acquire))
+        healthy.push_back(link);
+    }
+  }
+  std::shared_ptr<Link> selected;
+  std::size_t best = 0;
+  for (const auto &link : healthy) {
+    auto score = std::hash<std::string>{}(std::to_string(conversationId) +
+                                          ":" + link->id);
+    if (!selected || score > best) {
+      best = score;
+      selected = link;
+    }
+  }
+  return selected;
+}
+
+std::shared_ptr<Link> SelectSnapshot(
+    const std::atomic<std::shared_ptr<const RoutingTable>> &table,
+    int64_t conversationId) {
+  const auto current = table.load(std::memory_order_acquire);
+  const auto &routes = current->routes;
+  const auto index = SelectRendezvous(
+      routes, static_cast<uint64_t>(conversationId), current->weighted,
+      [](const Route &route) {
+        return route.link->healthy.load(std::memory_order_acquire);
+      });
+  return index == routes.size() ? nullptr : routes[index].link;
+}
+
+template <typename Select>
+double NanosecondsPerSelect(uint64_t iterations, Select select) {
+  uint64_t checksum = 0;
+  const auto started = Clock::now();
+  for (uint64_t i = 1; i <= iterations; ++i)
+    checksum += select(static_cast<int64_t>(i))->id.size();
+  const double seconds =
+      std::chrono::duration<double>(Clock::now() - started).count();
+  if (checksum == 0)
+    std::cerr << "unexpected empty selection\n";
+  return seconds * 1e9 / static_cast<double>(iterations);
+}
+
+void Run(std::size_t nodes, uint64_t iterations) {
+  std::mutex mutex;
+  std::unordered_map<std::string, std::shared_ptr<Link>> links;
+  auto uniform = std::make_shared<RoutingTable>();
+  auto weighted = std::make_shared<RoutingTable>();
+  for (std::size_t i = 0; i < nodes; ++i) {
+    auto link = std::make_shared<Link>();
+    link->id = "message-" + std::to_string(i + 1);
+    links[link->id] = link;
+    const uint64_t key = RendezvousNodeKey(link->id);
+    uniform->routes.push_back(Route{link, key, 1});
+    weighted->routes.push_back(
+        Route{link, key, static_cast<uint32_t>(i % 4 + 1)});
+  }
+  weighted->weighted = nodes > 1;
+  std::atomic<std::shared_ptr<const RoutingTable>> uniformTable(uniform);
+  std::atomic<std::shared_ptr<const RoutingTable>> weightedTable(weighted);
+
+  const double legacy =
+      NanosecondsPerSelect(iterations, [&](int64_t conversationId) {
+        return SelectLegacy(mutex, links, conversationId);
+      });
+  const double snapshot =
+      NanosecondsPerSelect(iterations, [&](int64_t conversationId) {
+        return SelectSnapshot(uniformTable, conversationId);
+      });
+  const double snapshotWeighted =
+      NanosecondsPerSelect(iterations, [&](int64_t conversationId) {
+        return SelectSnapshot(weightedTable, conversationId);
+      });
+  std::cout << "nodes=" << nodes << " legacy_ns=" << legacy
+            << " snapshot_ns=" << snapshot
+            << " snapshot_weighted_ns=" << snapshotWeighted << '\n';
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const uint64_t iterations =
+      argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  for (const std::size_t nodes : {2, 16, 64})
+    Run(nodes, iterations);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+#include "GatewayOptions.h"
+#include "GatewaySession.h"
+#include "LeaseRefresher.h"
+#include "MessageLink.h"
+#include "SessionRegistry.h"
+
+#include <boost/asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// SessionRegistry 锁竞争压测：多线程并发 Deliver，夹带少量 Attach 模拟重登。
+// 投递信封故意携带过期 generation，只走查表与 lease 比较，不触发 socket 写，
+// 因此吞吐差异只来自路由表本身。
+// 用法：gatewaySessionRegistryBench [threads] [sessions] [seconds]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using wimi::connection::GatewaySession;
+using wimi::connection::SessionRegistry;
+
+struct BenchResult {
+  uint64_t delivers{0};
+  uint64_t rebinds{0};
+  double seconds{0};
+};
+
+BenchResult Run(SessionRegistry &registry,
+                const std::vector<std::shared_ptr<GatewaySession>> &sessions,
+                std::size_t threads, std::chrono::seconds duration) {
+  std::atomic<bool> running{true};
+  std::atomic<uint64_t> delivers{0};
+  std::atomic<uint64_t> rebinds{0};
+  std::vector<std::thread> workers;
+  for (std::size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t]() {
+      std::mt19937_64 random(t + 1);
+      std::uniform_int_distribution<std::size_t> pick(0, sessions.size() - 1);
+      wimi::gateway::DeliveryEnvelope delivery;
+      delivery.set_protocol_id(ID_TEXT_SEND_REQ);
+      delivery.set_expected_connection_generation(0);
+      uint64_t localDelivers = 0;
+      uint64_t localRebinds = 0;
+      while (running.load(std::memory_order_relaxed)) {
+        const auto index = pick(random);
+        const int64_t uid = static_cast<int64_t>(index) + 1;
+        if ((localDelivers & 127) == 127) {
+          registry.Attach(uid, sessions[index], 1);
+          ++localRebinds;
+        }
+        delivery.set_recipient_uid(uid);
+        registry.Deliver(delivery);
+        ++localDelivers;
+      }
+      delivers.fetch_add(localDelivers);
+      rebinds.fetch_add(localRebinds);
+    });
+  }
+  const auto started = Clock::now();
+  std::this_thread::sleep_for(duration);
+  running.store(false);
+  for (auto &worker : workers)
+    worker.join();
+  BenchResult result;
+  result.delivers = delivers.load();
+  result.rebinds = rebinds.load();
+  result.seconds =
+      std::chrono::duration<double>(Clock::now() - started).count();
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const std::size_t threads =
+      argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+               : std::max(2U, std::thread::hardware_concurrency());
+  const std::size_t sessionCount =
+      argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+  const std::chrono::seconds duration(
+      argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 3);
+
+  boost::asio::io_context ioContext;
+  boost::asio::thread_pool businessPool(1);
+  wimi::connection::GatewayOptions options;
+  wimi::connection::TimingWheel timers(
+      ioContext, std::chrono::milliseconds(options.timerTickMilliseconds),
+      options.timerSlots);
+  wimi::connection::LeaseRefresher leaseRefresher(
+      ioContext, businessPool, options.leaseTtlSeconds,
+      std::chrono::milliseconds(options.leaseRefreshFlushMilliseconds),
+      options.leaseRefreshBatchSize);
+  wimi::connection::MessageLinkManager messageLinks(ioContext, businessPool,
+                                                    "bench-gateway", "bench");
+
+  for (const std::size_t shardCount : {1UL, 16UL, 64UL, 256UL}) {
+    SessionRegistry registry("bench-gateway", "bench", 60, shardCount);
+    wimi::connection::GatewayServices services{
+        registry, messageLinks, businessPool, leaseRefresher, options, {}};
+    std::vector<std::shared_ptr<GatewaySession>> sessions;
+    sessions.reserve(sessionCount);
+    for (std::size_t i = 0; i < sessionCount; ++i) {
+      auto session = std::make_shared<GatewaySession>(
+          boost::asio::ip::tcp::socket(ioContext), services, timers);
+      registry.Attach(static_cast<int64_t>(i) + 1, session, 1);
+      sessions.push_back(std::move(session));
+    }
+
+    const auto result = Run(registry, sessions, threads, duration);
+    std::cout << "shards=" << registry.ShardCount() << " threads=" << threads
+              << " sessions=" << registry.Size()
+              << " delivers/s=" << static_cast<uint64_t>(result.delivers /
+                                                         result.seconds)
+              << " rebinds/s="
+              << static_cast<uint64_t>(result.rebinds / result.seconds)
+              << '\n';
+  }
+
+  businessPool.stop();
+  businessPool.join();
+  return EXIT_SUCCESS;
+}
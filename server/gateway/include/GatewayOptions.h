@@ -0,0 +1,301 @@
+#pragma once
+
+#include "Const.h"
+
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <thread>
+
+namespace wimi::connection {
+
+// Gateway 进程级调优参数，统一从 server.gateway 读取。
+struct GatewayOptions {
+  // ioThreads 为 0 时：共享模式沿用 clamp(核数, 2, 8)，thread-per-core 取核数。
+  // thread-per-core 模式下每个线程独占一个 io_context 与 SO_REUSEPORT
+  // acceptor，会话整个生命周期停留在同一线程，不再经过 strand 调度。
+  std::size_t ioThreads{0};
+  bool threadPerCore{false};
+  bool pinThreads{true};
+  // 聚合写：一次 async_write 排空发送队列中的多帧，受帧数和字节数双重约束。
+  bool gatherWrite{true};
+  std::size_t gatherMaxFrames{64};
+  std::size_t gatherMaxBytes{256 * 1024};
+  // 写调度：超过 bulkFrameBytes 的帧进入大帧队列，小帧（推送、PONG、ACK
+  // 响应）总是先写；客户端支持时大帧按 fragmentBytes 切片，每轮只带一片。
+  std::size_t bulkFrameBytes{64 * 1024};
+  bool fragmentation{true};
+  std::size_t fragmentBytes{32 * 1024};
+  // 慢消费者策略：会话排队字节超过 sessionBudget 后，可丢弃推送直接丢弃，
+  // 可补拉推送返回 BACKPRESSURED；超过 sessionLimit 断开连接。
+  // Gateway 总排队字节超过 gatewayBudget 时，所有会话按超预算处理，
+  // 自身也已超预算的会话被断开。
+  std::size_t sessionWriteBudgetBytes{4 * 1024 * 1024};
+  std::size_t sessionWriteLimitBytes{32 * 1024 * 1024};
+  std::size_t gatewayWriteBudgetBytes{1024 * 1024 * 1024};
+  // 到每个 Message 节点的并行流数；命令按会话哈希选流，会话内保持有序。
+  // 流平均分到 channelsPerNode 个 gRPC channel 上，每个 channel 一条
+  // HTTP/2 连接。
+  std::size_t messageStreamsPerNode{1};
+  std::size_t messageChannelsPerNode{1};
+  // 幂等拉取的对冲：等待超过所在流近期延迟的 hedgePercentile 分位后向
+  // 另一节点发送副本，先到的结果生效；对冲量不超过转发量的
+  // hedgeBudgetPercent%。
+  bool messageHedging{false};
+  double messageHedgePercentile{0.95};
+  double messageHedgeBudgetPercent{2.0};
+  long messageHedgeMinDelayMilliseconds{10};
+  // 拓扑中 hostId 与本机相同且提供 localSocket 的节点走 Unix 域套接字。
+  // hostId 未配置时取 /etc/machine-id。
+  bool messageLocalTransport{true};
+  std::string messageHostId;
+  // 本地会话路由表分片数，向上取整到 2 的幂。
+  std::size_t registryShards{64};
+  long leaseTtlSeconds{60};
+  // lease 续约排队后按该间隔成批提交，每批一次 EVAL。
+  long leaseRefreshFlushMilliseconds{200};
+  std::size_t leaseRefreshBatchSize{256};
+  // 每个 io_context 一个时间轮，驱动传输 ACK 重传和空闲读超时。
+  long timerTickMilliseconds{100};
+  std::size_t timerSlots{512};
+  long retransmitTimeoutMilliseconds{5000};
+  unsigned int retransmitAttempts{3};
+  // 客户端每 20 秒发一次 PING；连续错过约三次即判定为死连接。0 表示关闭。
+  long idleReadTimeoutSeconds{65};
+  // 热重启交接地址（Unix 域套接字路径），为空表示关闭。启动时该地址上有
+  // 旧进程在等待则接管它的监听 socket 与已登录会话，否则自己监听，供
+  // 下一次升级使用。每个会话最多等待 drain 毫秒静止后迁移。
+  std::string handoffSocket;
+  long handoffDrainMilliseconds{2000};
+  // 登录准入：并发登录攒成最多 loginBatchSize 个一批，最早一个最多等
+  // loginWindowMicroseconds；同时在途 loginMaxInflightBatches 批，排队超过
+  // loginMaxQueued 时拒绝。loginAdmission 为 false 时逐个登录。
+  bool loginAdmission{true};
+  std::size_t loginBatchSize{256};
+  long loginWindowMicroseconds{2000};
+  std::size_t loginMaxInflightBatches{2};
+  std::size_t loginMaxQueued{20000};
+  // 会话恢复：断线后待确认推送与资料停放 resumeTtlSeconds，客户端带
+  // resume token 重连本 Gateway 时免去 token 校验与 MySQL；最多停放
+  // resumeMaxParked 个会话。
+  bool sessionResume{true};
+  long resumeTtlSeconds{120};
+  std::size_t resumeMaxParked{100000};
+  // 计划内下线（SIGUSR1）：每秒最多关闭 drainSessionsPerSecond 个会话，
+  // 每 drainWaveMilliseconds 一批；关闭前推送重连目标与新凭证，客户端在
+  // [0, drainReconnectJitterMilliseconds] 内随机等待后直连目标 Gateway。
+  double drainSessionsPerSecond{500};
+  long drainWaveMilliseconds{200};
+  long drainReconnectJitterMilliseconds{5000};
+  long drainTokenTtlSeconds{15 * 60};
+  long drainLingerMilliseconds{5000};
+};
+
+inline GatewayOptions LoadGatewayOptions(const YAML::Node &server) {
+  GatewayOptions result;
+  if (auto source = server["gateway"]) {
+    if (source["ioThreads"])
+      result.ioThreads = source["ioThreads"].as<std::size_t>();
+    if (source["threadPerCore"])
+      result.threadPerCore = source["threadPerCore"].as<bool>();
+    if (source["pinThreads"])
+      result.pinThreads = source["pinThreads"].as<bool>();
+    if (auto write = source["write"]) {
+      if (write["gather"])
+        result.gatherWrite = write["gather"].as<bool>();
+      if (write["gatherMaxFrames"])
+        result.gatherMaxFrames = write["gatherMaxFrames"].as<std::size_t>();
+      if (write["gatherMaxBytes"])
+        result.gatherMaxBytes = write["gatherMaxBytes"].as<std::size_t>();
+      if (write["bulkFrameBytes"])
+        result.bulkFrameBytes = write["bulkFrameBytes"].as<std::size_t>();
+      if (write["fragmentation"])
+        result.fragmentation = write["fragmentation"].as<bool>();
+      if (write["fragmentBytes"])
+        result.fragmentBytes = write["fragmentBytes"].as<std::size_t>();
+      if (write["sessionBudgetBytes"])
+        result.sessionWriteBudgetBytes =
+            write["sessionBudgetBytes"].as<std::size_t>();
+      if (write["sessionLimitBytes"])
+        result.sessionWriteLimitBytes =
+            write["sessionLimitBytes"].as<std::size_t>();
+      if (write["gatewayBudgetBytes"])
+        result.gatewayWriteBudgetBytes =
+            write["gatewayBudgetBytes"].as<std::size_t>();
+    }
+    if (auto message = source["message"]) {
+      if (message["streamsPerNode"])
+        result.messageStreamsPerNode =
+            message["streamsPerNode"].as<std::size_t>();
+      if (message["channelsPerNode"])
+        result.messageChannelsPerNode =
+            message["channelsPerNode"].as<std::size_t>();
+      if (message["localTransport"])
+        result.messageLocalTransport = message["localTransport"].as<bool>();
+      if (message["hostId"])
+        result.messageHostId = message["hostId"].as<std::string>();
+      if (auto hedge = message["hedge"]) {
+        if (hedge["enabled"])
+          result.messageHedging = hedge["enabled"].as<bool>();
+        if (hedge["percentile"])
+          result.messageHedgePercentile = hedge["percentile"].as<double>();
+        if (hedge["budgetPercent"])
+          result.messageHedgeBudgetPercent =
+              hedge["budgetPercent"].as<double>();
+        if (hedge["minDelayMilliseconds"])
+          result.messageHedgeMinDelayMilliseconds =
+              hedge["minDelayMilliseconds"].as<long>();
+      }
+    }
+    if (auto registry = source["registry"]) {
+      if (registry["shards"])
+        result.registryShards = registry["shards"].as<std::size_t>();
+      if (registry["leaseTtlSeconds"])
+        result.leaseTtlSeconds = registry["leaseTtlSeconds"].as<long>();
+      if (registry["refreshFlushMilliseconds"])
+        result.leaseRefreshFlushMilliseconds =
+            registry["refreshFlushMilliseconds"].as<long>();
+      if (registry["refreshBatchSize"])
+        result.leaseRefreshBatchSize =
+            registry["refreshBatchSize"].as<std::size_t>();
+    }
+    if (auto timers = source["timers"]) {
+      if (timers["tickMilliseconds"])
+        result.timerTickMilliseconds = timers["tickMilliseconds"].as<long>();
+      if (timers["slots"])
+        result.timerSlots = timers["slots"].as<std::size_t>();
+      if (timers["retransmitTimeoutMilliseconds"])
+        result.retransmitTimeoutMilliseconds =
+            timers["retransmitTimeoutMilliseconds"].as<long>();
+      if (timers["retransmitAttempts"])
+        result.retransmitAttempts =
+            timers["retransmitAttempts"].as<unsigned int>();
+      if (timers["idleReadTimeoutSeconds"])
+        result.idleReadTimeoutSeconds =
+            timers["idleReadTimeoutSeconds"].as<long>();
+    }
+    if (auto handoff = source["handoff"]) {
+      if (handoff["socket"])
+        result.handoffSocket = handoff["socket"].as<std::string>();
+      if (handoff["drainMilliseconds"])
+        result.handoffDrainMilliseconds =
+            handoff["drainMilliseconds"].as<long>();
+    }
+    if (auto login = source["login"]) {
+      if (login["admission"])
+        result.loginAdmission = login["admission"].as<bool>();
+      if (login["batchSize"])
+        result.loginBatchSize = login["batchSize"].as<std::size_t>();
+      if (login["windowMicroseconds"])
+        result.loginWindowMicroseconds =
+            login["windowMicroseconds"].as<long>();
+      if (login["maxInflightBatches"])
+        result.loginMaxInflightBatches =
+            login["maxInflightBatches"].as<std::size_t>();
+      if (login["maxQueued"])
+        result.loginMaxQueued = login["maxQueued"].as<std::size_t>();
+    }
+    if (auto resume = source["resume"]) {
+      if (resume["enabled"])
+        result.sessionResume = resume["enabled"].as<bool>();
+      if (resume["ttlSeconds"])
+        result.resumeTtlSeconds = resume["ttlSeconds"].as<long>();
+      if (resume["maxParked"])
+        result.resumeMaxParked = resume["maxParked"].as<std::size_t>();
+    }
+    if (auto drain = source["drain"]) {
+      if (drain["sessionsPerSecond"])
+        result.drainSessionsPerSecond =
+            drain["sessionsPerSecond"].as<double>();
+      if (drain["waveMilliseconds"])
+        result.drainWaveMilliseconds = drain["waveMilliseconds"].as<long>();
+      if (drain["reconnectJitterMilliseconds"])
+        result.drainReconnectJitterMilliseconds =
+            drain["reconnectJitterMilliseconds"].as<long>();
+      if (drain["tokenTtlSeconds"])
+        result.drainTokenTtlSeconds = drain["tokenTtlSeconds"].as<long>();
+      if (drain["lingerMilliseconds"])
+        result.drainLingerMilliseconds =
+            drain["lingerMilliseconds"].as<long>();
+    }
+  }
+
+  const std::size_t cores =
+      std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+  if (result.ioThreads == 0)
+    result.ioThreads = result.threadPerCore
+                           ? cores
+                           : std::clamp<std::size_t>(cores, 2, 8);
+  // IOV_MAX 在 Linux 上为 1024，超过后内核会拆分写入，聚合失去意义。
+  result.gatherMaxFrames =
+      std::clamp<std::size_t>(result.gatherMaxFrames, 1, 1024);
+  result.gatherMaxBytes = std::max<std::size_t>(result.gatherMaxBytes, 1);
+  result.bulkFrameBytes =
+      std::max<std::size_t>(result.bulkFrameBytes, PROTOCOL_DATA_MTU);
+  result.fragmentBytes =
+      std::max<std::size_t>(result.fragmentBytes, PROTOCOL_DATA_MTU);
+  // 硬上限至少能容纳一个最大帧，否则一次大的拉取响应就会断开连接。
+  result.sessionWriteBudgetBytes =
+      std::max<std::size_t>(result.sessionWriteBudgetBytes, 64 * 1024);
+  result.sessionWriteLimitBytes = std::max<std::size_t>(
+      {result.sessionWriteLimitBytes, result.sessionWriteBudgetBytes,
+       PROTOCOL_HEADER_TOTAL + PROTOCOL_RECV_MSS});
+  result.gatewayWriteBudgetBytes = std::max(result.gatewayWriteBudgetBytes,
+                                            result.sessionWriteLimitBytes);
+  result.messageStreamsPerNode =
+      std::clamp<std::size_t>(result.messageStreamsPerNode, 1, 64);
+  result.messageChannelsPerNode = std::clamp<std::size_t>(
+      result.messageChannelsPerNode, 1, result.messageStreamsPerNode);
+  if (result.messageLocalTransport && result.messageHostId.empty()) {
+    std::ifstream machineId("/etc/machine-id");
+    std::getline(machineId, result.messageHostId);
+  }
+  result.messageHedgePercentile =
+      std::clamp(result.messageHedgePercentile, 0.5, 0.999);
+  result.messageHedgeBudgetPercent =
+      std::clamp(result.messageHedgeBudgetPercent, 0.0, 10.0);
+  result.messageHedgeMinDelayMilliseconds =
+      std::max<long>(result.messageHedgeMinDelayMilliseconds, 1);
+  result.registryShards =
+      std::clamp<std::size_t>(result.registryShards, 1, 4096);
+  result.leaseTtlSeconds = std::max<long>(result.leaseTtlSeconds, 1);
+  result.leaseRefreshFlushMilliseconds =
+      std::clamp<long>(result.leaseRefreshFlushMilliseconds, 10, 5000);
+  result.leaseRefreshBatchSize =
+      std::clamp<std::size_t>(result.leaseRefreshBatchSize, 1, 4096);
+  result.timerTickMilliseconds =
+      std::clamp<long>(result.timerTickMilliseconds, 1, 1000);
+  result.timerSlots = std::clamp<std::size_t>(result.timerSlots, 16, 65536);
+  result.retransmitTimeoutMilliseconds = std::max<long>(
+      result.retransmitTimeoutMilliseconds, result.timerTickMilliseconds);
+  result.retransmitAttempts = std::max(result.retransmitAttempts, 1U);
+  result.idleReadTimeoutSeconds =
+      std::max<long>(result.idleReadTimeoutSeconds, 0);
+  result.handoffDrainMilliseconds =
+      std::clamp<long>(result.handoffDrainMilliseconds, 10, 60000);
+  result.loginBatchSize =
+      std::clamp<std::size_t>(result.loginBatchSize, 1, 4096);
+  result.loginWindowMicroseconds =
+      std::clamp<long>(result.loginWindowMicroseconds, 0, 1000000);
+  result.loginMaxInflightBatches =
+      std::clamp<std::size_t>(result.loginMaxInflightBatches, 1, 64);
+  result.loginMaxQueued = std::max(result.loginMaxQueued,
+                                   result.loginBatchSize);
+  result.resumeTtlSeconds = std::clamp<long>(result.resumeTtlSeconds, 1, 3600);
+  result.drainSessionsPerSecond =
+      std::max(result.drainSessionsPerSecond, 1.0);
+  result.drainWaveMilliseconds =
+      std::clamp<long>(result.drainWaveMilliseconds, 10, 60000);
+  result.drainReconnectJitterMilliseconds =
+      std::clamp<long>(result.drainReconnectJitterMilliseconds, 0, 600000);
+  result.drainTokenTtlSeconds =
+      std::clamp<long>(result.drainTokenTtlSeconds, 60, 24 * 3600);
+  result.drainLingerMilliseconds =
+      std::clamp<long>(result.drainLingerMilliseconds, 0, 600000);
+  return result;
+}
+
+}  // namespace wimi::connection
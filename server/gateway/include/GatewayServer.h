@@ -1,26 +1,32 @@
 #pragma once
 
+#include "GatewayServices.h"
+#include "TimingWheel.h"
+#include "gateway_handoff.pb.h"
+
 #include <boost/asio.hpp>
 
 namespace wimi::connection {
 
-class MessageLinkManager;
-class SessionRegistry;
-
 class GatewayServer {
  public:
+  // listenerHandle 为热重启时从旧进程继承的监听 socket；-1 表示自行监听。
   GatewayServer(boost::asio::io_context &ioContext, unsigned short port,
-                SessionRegistry &registry, MessageLinkManager &messageLinks,
-                boost::asio::thread_pool &businessPool);
+                GatewayServices &services, int listenerHandle = -1);
 
   boost::asio::awaitable<void> Run();
+  // 以下供热重启交接使用，可在任意线程调用。
+  // 复制监听 socket，返回的描述符归调用方所有。
+  int DuplicateListener();
+  void StopAccepting();
+  // 接管旧进程交来的客户端连接，fd 所有权转移给本对象。
+  void Adopt(int fd, gateway::HandoffSession state);
 
  private:
   boost::asio::io_context &ioContext;
   boost::asio::ip::tcp::acceptor acceptor;
-  SessionRegistry &registry;
-  MessageLinkManager &messageLinks;
-  boost::asio::thread_pool &businessPool;
+  GatewayServices &services;
+  TimingWheel timers;
 };
 
 }  // namespace wimi::connection
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Const.h"
+#include "TcpMessageCodec.h"
+
+#include <boost/asio.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace wimi::connection {
+
+class GatewaySession;
+class LeaseRefresher;
+class LoginAdmission;
+class MessageLinkManager;
+class SessionParking;
+class SessionRegistry;
+struct GatewayOptions;
+
+// 登录结果；成功时 generation 为已发布的 lease 代次。
+struct LoginResult {
+  int error{ErrorCodes::InternalError};
+  TcpPacket response;
+  int64_t generation{0};
+};
+
+// 在 businessPool 上执行的登录校验；成功时须已把会话登记到 SessionRegistry。
+using LoginHandler = std::function<LoginResult(
+    const TcpPacket &request, const std::shared_ptr<GatewaySession> &session)>;
+
+// 所有会话共享的进程级依赖。会话只持有这一份引用，空闲连接不再为每个
+// 依赖各存一个指针。
+struct GatewayServices {
+  SessionRegistry &registry;
+  MessageLinkManager &messageLinks;
+  boost::asio::thread_pool &businessPool;
+  LeaseRefresher &leaseRefresher;
+  const GatewayOptions &options;
+  // 为空时走 Redis token 校验 + MySQL 资料 + lease 发布；压测替换为本地桩。
+  LoginHandler login;
+  // 非空且未替换 login 时，登录经准入队列成批处理，否则逐个在
+  // businessPool 上执行。
+  LoginAdmission *admission{nullptr};
+  // 非空时登录响应签发 resume token，断线重连可恢复停放的会话。
+  SessionParking *parking{nullptr};
+};
+
+}  // namespace wimi::connection
@@ -1,72 +1,168 @@
 #pragma once
 
+#include "GatewayOptions.h"
+#include "GatewayServices.h"
+#include "ReceiveBuffer.h"
 #include "Redis.h"
+#include "SessionParking.h"
 #include "TcpMessageCodec.h"
+#include "TimingWheel.h"
+#include "gateway_handoff.pb.h"
 
 #include <boost/asio.hpp>
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <deque>
+#include <future>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 namespace wimi::connection {
 
-class MessageLinkManager;
-class SessionRegistry;
-
-class GatewaySession : public std::enable_shared_from_this<GatewaySession> {
+class GatewaySession : public std::enable_shared_from_this<GatewaySession>,
+                       public TimingWheel::Listener {
  public:
-  GatewaySession(boost::asio::ip::tcp::socket socket, SessionRegistry &registry,
-                 MessageLinkManager &messageLinks,
-                 boost::asio::thread_pool &businessPool);
+  // 已带 TLV 头的不可变帧；发送队列与重传表共享同一份缓冲，不再逐处复制。
+  using OutboundFrame = std::shared_ptr<const std::string>;
+
+  // 出站帧在会话超出字节预算时的处理方式：Essential（请求响应等）继续
+  // 入队直到硬上限；Deferrable（已持久化、客户端可补拉的推送）返回背压；
+  // Droppable（不落库的通知）直接丢弃。
+  enum class FrameClass : uint8_t { Essential, Deferrable, Droppable };
+
+  // 聚合写统计；frames / writes 即每次 socket 写平均携带的帧数。
+  // queued* 为当前排队量，其余为累计值。
+  struct WriteStats {
+    uint64_t writes{0};
+    uint64_t frames{0};
+    uint64_t bytes{0};
+    std::size_t maxFramesPerWrite{0};
+    std::size_t queuedFrames{0};
+    std::size_t queuedBytes{0};
+  };
+
+  GatewaySession(boost::asio::ip::tcp::socket socket,
+                 GatewayServices &services, TimingWheel &timers);
+  // 热重启接管的连接沿用旧进程的连接号，lease 与 Message 路由保持不变。
+  GatewaySession(boost::asio::ip::tcp::socket socket,
+                 GatewayServices &services, TimingWheel &timers,
+                 uint64_t connectionId);
 
   void Start();
   void Close();
-  bool SendRaw(std::string packet, uint32_t protocolId);
-  bool SendReliable(std::string packet, uint32_t protocolId, int64_t ackSeq);
-  const std::string &ConnectionId() const;
+  bool SendRaw(std::string_view packet, uint32_t protocolId);
+  bool SendFrame(OutboundFrame frame,
+                 FrameClass frameClass = FrameClass::Essential);
+  bool SendReliable(OutboundFrame frame, int64_t ackSeq,
+                    FrameClass frameClass = FrameClass::Deferrable);
+  // 计划内下线：推送重连指引后关闭连接，已排队的帧照常写完。
+  bool Redirect(const TcpPacket &redirect);
+  // 进程内单调递增的连接号；与 instanceId 组合后全局唯一，对外以十进制
+  // 字符串写入 lease 与 CommandEnvelope。
+  uint64_t ConnectionId() const;
+  WriteStats GetWriteStats() const;
+  // 批量续约发现 generation 已被取代；在会话执行器上关闭连接。
+  void OnLeaseFenced(int64_t generation);
+  void OnTimerExpired(TimingWheel::TimerKind kind, int64_t key,
+                      uint64_t ticket) override;
 
- private:
-  struct AuthResult {
-    int error{ErrorCodes::InternalError};
-    TcpPacket response;
-    db::SessionLease lease;
-  };
+  // 热重启：等读循环停在等待可读、写队列排空且没有在途命令后，交出
+  // socket 与最小会话状态；返回的 fd 归调用方所有。drainTimeout 内未能
+  // 静止时返回 -1，会话照常运行。state 在 future 就绪后可读。
+  std::future<int> Handoff(std::chrono::milliseconds drainTimeout,
+                           gateway::HandoffSession &state);
+  // 新进程接管：恢复登录态、半帧输入和待确认推送并登记本地路由；
+  // 须在 Start 之前调用。
+  void Resume(const gateway::HandoffSession &state);
+
+  static OutboundFrame EncodeFrame(uint32_t protocolId,
+                                   std::string_view payload);
+  // 下一个待分配的连接号；新进程从旧进程的值继续分配。
+  static uint64_t NextConnectionId();
+  static void ReserveConnectionIds(uint64_t next);
 
+ private:
   boost::asio::awaitable<void> Run();
   boost::asio::awaitable<void> HandlePacket(uint32_t protocolId,
-                                            std::string payload);
+                                            std::string_view payload);
   boost::asio::awaitable<void> WriteLoop();
-  AuthResult Authenticate(TcpPacket request);
+  boost::asio::awaitable<int> Export(std::chrono::milliseconds drainTimeout,
+                                     gateway::HandoffSession &state);
+  LoginResult Authenticate(const TcpPacket &request);
+  boost::asio::awaitable<LoginResult> Admit(TcpPacket request);
+  // 带 resume token 的登录：领取停放状态、发布新 lease 并重放待确认推送；
+  // 领取失败时返回 false，由调用方走完整登录。
+  boost::asio::awaitable<bool> ResumeParked(const TcpPacket &request,
+                                            bool fragmentation);
+  // 在旧会话执行器上交出待确认推送并关闭连接，供新连接接管。
+  boost::asio::awaitable<std::vector<ParkedWrite>> Surrender();
+  std::vector<ParkedWrite> TakeReliableWrites();
   void CloseInContext();
+  // 读写失败或读空闲超时：先停放待确认推送等待客户端恢复，再关闭。
+  void CloseLost();
+  void ReleaseQueued(std::size_t frames, std::size_t bytes);
   void SendError(uint32_t requestId, int error, const std::string &message);
   void ArmReliableWrite(int64_t ackSeq);
+  void RetryReliableWrite(int64_t ackSeq, uint64_t ticket);
+  void ArmIdleRead(std::chrono::steady_clock::duration delay);
+  void CheckIdleRead(uint64_t ticket);
   void AcknowledgeTransport(int64_t ackSeq);
-  std::string NextRequestId();
+  void EraseReliableWrite(int64_t ackSeq);
 
   boost::asio::ip::tcp::socket socket;
-  boost::asio::strand<boost::asio::any_io_executor> strand;
-  SessionRegistry &registry;
-  MessageLinkManager &messageLinks;
-  boost::asio::thread_pool &businessPool;
-  std::string connectionId;
+  // 会话内所有状态都在该执行器上串行访问：共享 io_context 时是 strand；
+  // thread-per-core 模式下 io_context 只有一个线程，直接用其执行器。
+  boost::asio::any_io_executor executor;
+  GatewayServices &services;
+  TimingWheel &timers;
+  const uint64_t connectionId;
+  ReceiveBuffer receiveBuffer;
   std::atomic<int64_t> userId{0};
-  db::SessionLease lease;
+  int64_t leaseGeneration{0};
   std::atomic<bool> closed{false};
   std::atomic<std::size_t> queuedWrites{0};
-  std::atomic<uint64_t> requestSequence{0};
-  std::deque<std::shared_ptr<std::string>> writeQueue;
+  std::atomic<std::size_t> queuedBytes{0};
+  // 两级写调度：queue 放小帧，bulk 放大帧；activeBulk 是正在分片发送的
+  // 大帧，fragmentHeader 存放当前在途分片的帧头。只在有数据待写时分配，
+  // WriteLoop 排空后释放，空闲连接只剩一个空指针。
+  struct WriteQueues {
+    std::deque<OutboundFrame> queue;
+    std::deque<OutboundFrame> bulk;
+    OutboundFrame activeBulk;
+    std::size_t activeBulkOffset{0};
+    std::array<char, PROTOCOL_HEADER_TOTAL> fragmentHeader{};
+  };
+  std::unique_ptr<WriteQueues> writes;
+  bool clientFragmentation{false};
   bool writeActive{false};
+  std::atomic<uint64_t> socketWrites{0};
+  std::atomic<uint64_t> framesWritten{0};
+  std::atomic<uint64_t> bytesWritten{0};
+  std::atomic<std::size_t> maxFramesPerWrite{0};
   bool closeAfterWrite{false};
+  // 读循环正停在等待客户端数据上，缓冲区里至多有半帧。
+  bool readParked{false};
+  // 已交给新进程：退出时不关闭连接、不清理 lease。
+  bool handedOff{false};
+  // 登录签发的恢复凭证；主动关闭时撤销，网络断开时停放会话。
+  std::string resumeToken;
+  std::atomic<uint32_t> inflightCommands{0};
   struct ReliableWrite {
-    std::string packet;
-    uint32_t protocolId{0};
+    OutboundFrame frame;
     unsigned int attempts{1};
-    std::shared_ptr<boost::asio::steady_timer> timer;
+    // 时间轮不支持取消，到期时 ticket 不一致说明该项已被确认或重新登记。
+    uint64_t ticket{0};
   };
-  std::unordered_map<int64_t, ReliableWrite> reliableWrites;
+  // 同样按需分配，最后一条被确认或放弃时释放。
+  std::unique_ptr<std::unordered_map<int64_t, ReliableWrite>> reliableWrites;
+  uint64_t timerTickets{0};
+  uint64_t idleTicket{0};
+  std::chrono::steady_clock::time_point lastReadAt{};
   std::chrono::steady_clock::time_point lastLeaseRefresh{};
   std::chrono::steady_clock::time_point rateWindowStarted{
       std::chrono::steady_clock::now()};
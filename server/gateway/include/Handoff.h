@@ -0,0 +1,82 @@
+#pragma once
+
+#include "gateway_handoff.pb.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace wimi::connection {
+
+class GatewayServer;
+class MessageLinkManager;
+class SessionRegistry;
+
+// 热重启交接通道：Unix 域流套接字上收发 HandoffRecord，fd 以 SCM_RIGHTS
+// 随记录发送。阻塞 I/O，只在启动阶段或专用线程上使用。
+class HandoffChannel {
+ public:
+  explicit HandoffChannel(int fd = -1);
+  ~HandoffChannel();
+  HandoffChannel(HandoffChannel &&other) noexcept;
+  HandoffChannel &operator=(HandoffChannel &&other) noexcept;
+  HandoffChannel(const HandoffChannel &) = delete;
+  HandoffChannel &operator=(const HandoffChannel &) = delete;
+
+  // 连接旧进程的交接地址；没有进程在监听时返回无效通道。
+  static HandoffChannel Connect(const std::string &path);
+
+  bool Valid() const;
+  // fds 仍归调用方所有，对端收到的是内核复制出的新描述符。
+  bool Send(const gateway::HandoffRecord &record,
+            const std::vector<int> &fds = {});
+  // 收到的 fd 追加到 fds，归调用方所有；失败时已收到的 fd 也会关闭。
+  bool Receive(gateway::HandoffRecord &record, std::vector<int> &fds);
+
+ private:
+  int fd;
+};
+
+// 旧进程侧：在交接地址上等待新进程，先交出监听 socket，待新进程就绪后
+// 逐个迁移已登录会话，最后调用 onComplete 让本进程退出。未登录的连接
+// 不迁移，随旧进程关闭后由客户端重连。
+class HandoffServer {
+ public:
+  HandoffServer(std::string socketPath, SessionRegistry &registry,
+                std::vector<GatewayServer *> servers,
+                std::chrono::milliseconds drainTimeout,
+                std::function<void()> onComplete);
+  ~HandoffServer();
+
+  bool Start();
+  void Stop();
+  // 交接完成后为 true；此时本进程不再清理 Redis lease。
+  bool HandedOff() const;
+
+ private:
+  void Serve();
+  bool Transfer(HandoffChannel &channel);
+
+  std::string socketPath;
+  SessionRegistry &registry;
+  std::vector<GatewayServer *> servers;
+  std::chrono::milliseconds drainTimeout;
+  std::function<void()> onComplete;
+  int listener{-1};
+  std::thread thread;
+  std::atomic<bool> stopping{false};
+  std::atomic<bool> handedOff{false};
+};
+
+// 新进程侧：Message 流就绪后通知旧进程开始迁移，按轮转把收到的连接交给
+// 各 GatewayServer 接管，直到 HandoffDone。返回接管的会话数。
+std::size_t AdoptHandoffSessions(
+    HandoffChannel &channel, MessageLinkManager &messageLinks,
+    const std::vector<std::unique_ptr<GatewayServer>> &servers);
+
+}  // namespace wimi::connection
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+namespace wimi::connection {
+
+class LatencyHistogram;
+
+// 幂等拉取的对冲请求调度。命令转发后按所在流近期延迟的分位数登记
+// 对冲时刻，由 manager 的截止时间扫描循环取出到期项，再向另一个节点
+// 发送副本。所有转发命令按比例积攒预算，每次对冲消耗一份，对冲量
+// 不会超过流量的 budgetRatio。
+class HedgeScheduler {
+ public:
+  struct Policy {
+    bool enabled{false};
+    // 等待时间取所在流命令延迟的该分位数。
+    double percentile{0.95};
+    // 对冲数占转发命令数的上限比例。
+    double budgetRatio{0.02};
+    int64_t minDelayMilliseconds{10};
+    // 直方图样本少于该数时不对冲，避免用几条样本估计分位数。
+    uint64_t minimumSamples{20};
+  };
+
+  // 在开始转发之前设置，之后只读。
+  void SetPolicy(Policy policy);
+  const Policy &GetPolicy() const;
+  // 返回等待多久后对冲；样本不足或未启用时返回 0。
+  int64_t DelayFor(const LatencyHistogram &histogram) const;
+  // 每转发一条命令调用一次，积攒对冲预算。
+  void Accrue();
+  // 预算足够时扣除一次并返回 true。
+  bool TryAcquire();
+  void Schedule(uint64_t requestSeq, int64_t dueAtUnixMilliseconds);
+  std::vector<uint64_t> TakeDue(int64_t nowUnixMilliseconds);
+  // 已完成的对冲序号，用于识别落败一方迟到的结果；只保留最近若干条。
+  void Settle(uint64_t requestSeq);
+  bool Settled(uint64_t requestSeq) const;
+
+ private:
+  struct Due {
+    int64_t at{0};
+    uint64_t requestSeq{0};
+  };
+  static bool DueLater(const Due &left, const Due &right);
+
+  Policy policy;
+  // 以千分之一次对冲为单位。
+  std::atomic<int64_t> budget{0};
+  mutable std::mutex mutex;
+  std::vector<Due> due;
+  std::deque<uint64_t> settledOrder;
+  std::unordered_set<uint64_t> settled;
+};
+
+}  // namespace wimi::connection
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Redis.h"
+
+#include <boost/asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace wimi::connection {
+
+class GatewaySession;
+
+// Gateway 级 lease 续约管线。会话到期时只把 (uid, lease) 放进队列，
+// 后台按固定间隔把整队交给 businessPool，分批用一次 EVAL 做 CAS 续约，
+// 所有批次走同一条 pipeline；被取代的会话按结果逐个通知关闭。
+class LeaseRefresher {
+ public:
+  LeaseRefresher(boost::asio::io_context &ioContext,
+                 boost::asio::thread_pool &businessPool, long leaseTtlSeconds,
+                 std::chrono::milliseconds flushInterval,
+                 std::size_t batchSize);
+
+  void Start();
+  void Stop();
+  void Enqueue(int64_t uid, db::SessionLease lease,
+               std::weak_ptr<GatewaySession> session);
+  std::size_t Pending() const;
+
+ private:
+  struct Request {
+    int64_t uid{0};
+    db::SessionLease lease;
+    std::weak_ptr<GatewaySession> session;
+  };
+
+  boost::asio::awaitable<void> Run();
+  void Flush(std::vector<Request> &requests);
+
+  boost::asio::io_context &ioContext;
+  boost::asio::thread_pool &businessPool;
+  long leaseTtlSeconds;
+  std::chrono::milliseconds flushInterval;
+  std::size_t batchSize;
+  mutable std::mutex mutex;
+  std::vector<Request> queue;
+  std::atomic<bool> stopping{false};
+};
+
+}  // namespace wimi::connection
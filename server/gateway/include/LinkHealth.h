@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace wimi::connection {
+
+// 单条 Gateway-Message 流的命令延迟直方图，桶上界按毫秒递增，最后一桶
+// 收纳更慢的样本。计数只增不减，由 Decay 周期性减半让分位数跟随近况。
+class LatencyHistogram {
+ public:
+  static constexpr std::array<int64_t, 12> kBucketBounds = {
+      1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000};
+  static constexpr std::size_t kBucketCount = kBucketBounds.size() + 1;
+
+  void Record(int64_t milliseconds);
+  // 返回落入分位 quantile 的桶上界；样本不足 minimumSamples 时返回 0。
+  int64_t Quantile(double quantile, uint64_t minimumSamples = 1) const;
+  uint64_t Count() const;
+  void Decay();
+  // "le_1=3 le_2=0 ... inf=1"，供周期日志输出。
+  std::string Format() const;
+
+ private:
+  std::array<std::atomic<uint64_t>, kBucketCount> buckets{};
+};
+
+// 每条流的健康估计：心跳往返延迟、命令往返延迟与失败率各自做 EWMA。
+// 心跳在 gRPC 线程上应答，只反映网络；命令延迟还包含 Message 的 worker
+// 与 MySQL 耗时，节点变慢时先在这里体现。可在多个线程上并发更新。
+class LinkHealth {
+ public:
+  void ObserveHeartbeat(int64_t roundTripMilliseconds);
+  void ObserveCommand(int64_t latencyMilliseconds, bool failed);
+  // 周期调用：失败率向 0 衰减，流量被移走的节点也能恢复。
+  void Decay();
+
+  double HeartbeatRttMs() const;
+  double CommandLatencyMs() const;
+  // 取两者较大值，没有任何样本时为 0。
+  double LatencyMs() const;
+  double ErrorRate() const;
+  // 只记录命令往返，不含心跳；对冲延迟按它取分位。
+  LatencyHistogram &CommandLatencyHistogram();
+  const LatencyHistogram &CommandLatencyHistogram() const;
+
+  // 最少负载选路的代价：在途数乘以延迟，再按失败率放大。
+  double Cost(std::size_t inflight) const;
+
+ private:
+  std::atomic<double> heartbeatRttMs{0};
+  std::atomic<double> commandLatencyMs{0};
+  std::atomic<double> errorRate{0};
+  LatencyHistogram commandLatencyHistogram;
+};
+
+}  // namespace wimi::connection
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "DbGlobal.h"
+#include "GatewayServices.h"
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace wimi::connection {
+
+class GatewaySession;
+class SessionRegistry;
+
+// 登录批处理依赖的存储操作，结果均与输入同序。默认实现走 Redis/MySQL，
+// 单测替换为内存桩。
+class LoginBackend {
+ public:
+  virtual ~LoginBackend() = default;
+  // 空表表示 Redis 不可用。
+  virtual std::vector<bool> ValidateTokens(
+      const std::vector<std::pair<long, std::string>> &tokens) = 0;
+  // 查不到的位置为 nullptr；查询失败返回 false。
+  virtual bool LoadProfiles(const std::vector<long> &uids,
+                            std::vector<db::UserInfo::Ptr> &profiles) = 0;
+  virtual bool InsertProfile(const db::UserInfo::Ptr &profile) = 0;
+  // 发布 lease 并登记本地路由；<= 0 表示发布失败，空表表示 Redis 不可用。
+  virtual std::vector<int64_t> BindSessions(
+      const std::vector<std::pair<int64_t, std::shared_ptr<GatewaySession>>>
+          &sessions) = 0;
+};
+
+std::unique_ptr<LoginBackend> MakeStorageLoginBackend(
+    SessionRegistry &registry);
+
+// 登录准入：并发登录先进队列，凑满 batchSize 或最早一个等满 window 后
+// 成批交给 businessPool，一批只做一次 MGET 校验凭证、一次 WHERE uid IN
+// 加载资料、一条 pipeline 发布 lease。同时在途的批次不超过
+// maxInflightBatches，其余登录留在队列里合并成更大的批次；排队数达到
+// maxQueued 时直接返回 RESOURCE_EXHAUSTED，客户端退避重试。
+class LoginAdmission {
+ public:
+  struct Policy {
+    std::size_t batchSize{256};
+    std::chrono::microseconds window{2000};
+    std::size_t maxInflightBatches{2};
+    std::size_t maxQueued{20000};
+  };
+  // 在 businessPool 线程上调用。
+  using Completion = std::function<void(LoginResult)>;
+
+  LoginAdmission(boost::asio::io_context &ioContext,
+                 boost::asio::thread_pool &businessPool,
+                 std::unique_ptr<LoginBackend> backend, Policy policy);
+
+  void Submit(TcpPacket request, std::shared_ptr<GatewaySession> session,
+              Completion done);
+  std::size_t Pending() const;
+  std::size_t Inflight() const;
+
+ private:
+  struct Login {
+    TcpPacket request;
+    std::shared_ptr<GatewaySession> session;
+    Completion done;
+    std::chrono::steady_clock::time_point queuedAt;
+  };
+
+  // 调用方持有 mutex；把已就绪的批次派发到 businessPool，仍有排队时
+  // 按最早一个登录的到期时间布置定时器。
+  void DispatchLocked(std::chrono::steady_clock::time_point now);
+  void Process(std::vector<Login> &batch);
+
+  boost::asio::thread_pool &businessPool;
+  std::unique_ptr<LoginBackend> backend;
+  Policy policy;
+  mutable std::mutex mutex;
+  std::deque<Login> queue;
+  std::size_t inflight{0};
+  boost::asio::steady_timer timer;
+  bool timerArmed{false};
+};
+
+}  // namespace wimi::connection
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "HedgeScheduler.h"
+#include "PendingCommandTable.h"
 #include "gateway_message.pb.h"
 
 #include <boost/asio/awaitable.hpp>
@@ -14,6 +16,7 @@
 #include <mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace wimi::connection {
@@ -22,22 +25,36 @@ class MessageLink;
 
 class MessageLinkManager {
  public:
-  using CommandCallback =
-      std::function<void(const gateway::CommandResult &result)>;
+  using CommandCallback = PendingCommandTable::Callback;
   using DeliveryHandler = std::function<gateway::DeliveryStatus(
       const gateway::DeliveryEnvelope &delivery)>;
+  // 填写 ack.recipients，与 multicast.targets 同序。
+  using MulticastHandler =
+      std::function<void(const gateway::MulticastDelivery &multicast,
+                         gateway::MulticastDeliveryAck &ack)>;
 
+  // 每个 Message 节点建立 streamsPerNode 条并行流，分布在
+  // channelsPerNode 个 gRPC channel（各一条 HTTP/2 连接）上。
   MessageLinkManager(boost::asio::io_context &ioContext,
                      boost::asio::thread_pool &controlPool,
-                     std::string gatewayId, std::string instanceId);
+                     std::string gatewayId, std::string instanceId,
+                     std::size_t streamsPerNode = 1,
+                     std::size_t channelsPerNode = 1);
   ~MessageLinkManager();
 
   void Start();
   void Stop();
+  bool Stopping() const;
   bool Ready() const;
   std::size_t HealthyLinkCount() const;
   bool Forward(gateway::CommandEnvelope command, CommandCallback callback);
   void SetDeliveryHandler(DeliveryHandler handler);
+  void SetMulticastHandler(MulticastHandler handler);
+  // 以下两项在 Start 之前调用。
+  void SetHedgePolicy(HedgeScheduler::Policy policy);
+  // 拓扑中 hostId 与之相同的节点视为同机，经 Unix 域套接字连接；
+  // 空字符串关闭本机传输。
+  void SetLocalHostId(std::string hostId);
 
  private:
   friend class MessageLink;
@@ -46,13 +63,30 @@ class MessageLinkManager {
     std::string id;
     std::string host;
     unsigned short port{0};
+    // State 下发或本地配置的路由权重，0 按 1 处理。
+    std::uint32_t weight{1};
+    // 同机部署时 Message 监听的 Unix 域套接字路径与所在主机标识。
+    std::string localSocket;
+    std::string hostId;
   };
-  struct PendingCommand {
-    gateway::CommandEnvelope command;
-    CommandCallback callback;
-    std::string linkId;
-    unsigned int attempts{0};
-    std::shared_ptr<boost::asio::steady_timer> deadlineTimer;
+  // 不可变选路表：只在拓扑或 link 健康状态变化时整体重建并原子替换，
+  // SelectLink 只读当前表，不加锁、不分配。每个节点一项，streams 按
+  // 流序号排列，尚未就绪的流为空。
+  struct Route {
+    std::vector<std::shared_ptr<MessageLink>> streams;
+    std::string nodeId;
+    std::uint64_t key{0};
+    std::uint32_t weight{1};
+  };
+  struct RoutingTable {
+    std::vector<Route> routes;
+    bool weighted{false};
+  };
+  // 降级状态切换的迟滞：streak 是判定结果与当前状态连续不同的轮数，
+  // healthRounds 到 holdUntil 之前不再切换。
+  struct Penalty {
+    std::uint32_t streak{0};
+    std::uint64_t holdUntil{0};
   };
   struct TopologySnapshot {
     std::uint64_t version{0};
@@ -61,37 +95,71 @@ class MessageLinkManager {
   };
 
   boost::asio::awaitable<void> TopologyLoop();
+  boost::asio::awaitable<void> DeadlineLoop();
   TopologySnapshot FetchTopology();
   std::vector<Node> LoadConfiguredNodes() const;
   void ApplyTopology(const TopologySnapshot &snapshot);
-  void StartLink(const Node &node);
-  void OnFrame(const std::string &nodeId,
+  void StartLink(const Node &node, std::uint32_t streamIndex);
+  bool IsLocal(const Node &node) const;
+  // linkId 是流标识 "<节点 ID>#<流序号>"；结果与 ACK 都回到原流。
+  void OnFrame(const std::string &linkId,
                const gateway::MessageToGatewayFrame &frame);
-  void OnLinkDone(const std::string &nodeId, MessageLink *source);
-  void RetryPending(const std::string &failedNodeId);
-  void ExpirePending(const std::string &requestId);
+  void OnCommandResult(const std::string &linkId,
+                       const gateway::CommandResult &result);
+  void OnDelivery(const std::string &linkId,
+                  const gateway::DeliveryEnvelope &delivery);
+  void OnMulticastDelivery(const std::string &linkId,
+                           const gateway::MulticastDelivery &multicast);
+  void OnLinkDone(const std::string &linkId, MessageLink *source);
+  void RetryPending(const std::string &failedLinkId,
+                    const std::string &failedNodeId);
+  void ExpirePending();
+  void FireHedges();
+  // 对冲命令完成后撤回另一条流上的副本。
+  void CancelHedgeLoser(uint64_t requestSeq,
+                        const PendingCommandTable::Entry &entry,
+                        const std::string &winnerLinkId);
   void RetireLink(std::shared_ptr<MessageLink> link);
-  std::shared_ptr<MessageLink> SelectLink(int64_t conversationId,
-                                          const std::string &excluded = {});
+  void ScheduleRouteRebuild();
+  // 按各节点流的延迟与失败率判定降级节点，变化时重建选路表；
+  // logHistograms 为 true 时输出每条流的命令延迟直方图。
+  void RefreshLinkHealth(bool logHistograms);
+  std::shared_ptr<MessageLink> FindLink(const std::string &linkId) const;
+  void RebuildRoutes();
+  // excludedNode 是节点 ID：重试时整个失败节点都不参与选路。
+  std::shared_ptr<MessageLink> SelectLink(
+      int64_t conversationId, const std::string &excludedNode = {});
 
   boost::asio::io_context &ioContext;
   boost::asio::thread_pool &controlPool;
   std::string gatewayId;
   std::string instanceId;
+  const std::uint32_t streamsPerNode;
+  const std::uint32_t channelsPerNode;
   std::string stateAddress;
   std::shared_ptr<grpc::ChannelCredentials> messageCredentials;
+  std::string localHostId;
   std::atomic<bool> stopping{false};
   std::atomic<std::uint64_t> topologyVersion{0};
 
   mutable std::mutex linksMutex;
   std::unordered_map<std::string, Node> configuredNodes;
+  // 按流标识索引，每个节点 streamsPerNode 项。
   std::unordered_map<std::string, std::shared_ptr<MessageLink>> links;
   std::vector<std::shared_ptr<MessageLink>> retiredLinks;
   std::unordered_map<std::string, unsigned int> reconnectAttempts;
+  // 延迟或失败率明显偏离其他节点的节点，rendezvous 权重降为 1/4，
+  // 只分到一小部分会话。
+  std::unordered_set<std::string> degradedNodes;
+  std::unordered_map<std::string, Penalty> penalties;
+  std::uint64_t healthRounds{0};
+  std::atomic<std::shared_ptr<const RoutingTable>> routingTable;
+  std::atomic<bool> routeRebuildPending{false};
 
-  std::mutex pendingMutex;
-  std::unordered_map<std::string, PendingCommand> pending;
+  PendingCommandTable pending;
+  HedgeScheduler hedges;
   DeliveryHandler deliveryHandler;
+  MulticastHandler multicastHandler;
 };
 
 }  // namespace wimi::connection
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "gateway_message.pb.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace wimi::connection {
+
+// Gateway 转发到 Message 的在途命令表，按 64 位 request_seq 分片。
+// 每个分片一把锁、一个按截止时间排序的最小堆；堆里的记录惰性删除，
+// 由 manager 的单个定时器周期性扫描到期项，不再为每条命令分配
+// steady_timer。
+class PendingCommandTable {
+ public:
+  using Callback = std::function<void(const gateway::CommandResult &result)>;
+
+  struct Entry {
+    gateway::CommandEnvelope command;
+    Callback callback;
+    std::string linkId;
+    unsigned int attempts{0};
+    // 最近一次写入流的时间，用于统计命令往返延迟。
+    int64_t sentAtUnixMs{0};
+    // 已向另一节点发出对冲副本时为副本所在流，结果以先到者为准。
+    std::string hedgeLinkId;
+  };
+
+  explicit PendingCommandTable(std::size_t shardCount = 64);
+
+  // 从 1 开始分配；0 留给没有携带整数 ID 的旧结果帧。
+  uint64_t NextSequence();
+  // 截止时间取 entry.command.deadline_unix_ms()。
+  void Insert(uint64_t requestSeq, Entry entry);
+  std::optional<Entry> Take(uint64_t requestSeq);
+  // 在分片锁内修改仍在途的命令；mutate 返回 false 表示放弃本次修改，
+  // 不存在或被放弃时返回 false。
+  template <typename Mutate>
+  bool Update(uint64_t requestSeq, Mutate mutate);
+  std::vector<uint64_t> SequencesOnLink(const std::string &linkId) const;
+  std::vector<Entry> TakeExpired(int64_t nowUnixMilliseconds);
+  std::vector<Entry> TakeAll();
+  std::size_t Size() const;
+  std::size_t ShardCount() const;
+
+ private:
+  struct Deadline {
+    int64_t at{0};
+    uint64_t requestSeq{0};
+  };
+  struct alignas(64) Shard {
+    mutable std::mutex mutex;
+    std::unordered_map<uint64_t, Entry> entries;
+    std::vector<Deadline> deadlines;
+  };
+
+  Shard &ShardFor(uint64_t requestSeq) const;
+  static bool ExpiresLater(const Deadline &left, const Deadline &right);
+  static void CompactDeadlines(Shard &shard);
+
+  std::size_t shardCount;
+  std::unique_ptr<Shard[]> shards;
+  std::atomic<uint64_t> nextSequence{0};
+};
+
+template <typename Mutate>
+bool PendingCommandTable::Update(uint64_t requestSeq, Mutate mutate) {
+  auto &shard = ShardFor(requestSeq);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto found = shard.entries.find(requestSeq);
+  return found != shard.entries.end() && mutate(found->second);
+}
+
+}  // namespace wimi::connection
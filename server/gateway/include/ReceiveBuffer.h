@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Const.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace wimi::connection {
+
+// 会话级 TLV 接收缓冲。一次 read_some 可能带来多帧，也可能只有半帧：
+// Next 依次切出完整帧并返回指向缓冲区内部的视图，不再逐帧分配 payload。
+// 视图在下一次 Prepare/Compact 之前有效。存储在首次 Prepare 时才分配，
+// 排空后整块归还，空闲连接不占接收缓冲。
+class ReceiveBuffer {
+ public:
+  struct Frame {
+    uint32_t protocolId{0};
+    std::string_view payload;
+  };
+  enum class ParseStatus { Frame, NeedMore, Oversized };
+
+  explicit ReceiveBuffer(std::size_t initialCapacity = 4096,
+                         std::size_t maxPayload = PROTOCOL_RECV_MSS);
+
+  // 返回可写尾部；无存储时先分配初始容量，当前半帧放不下时按需扩容，
+  // 上限为头部加 maxPayload。
+  std::span<char> Prepare();
+  void Commit(std::size_t bytes);
+  ParseStatus Next(Frame &frame);
+  // 一轮解析结束后调用：缓冲区排空则释放存储，否则把半帧挪到头部。
+  void Compact();
+
+  std::size_t Buffered() const;
+  // 尚未切出的字节，热重启时随会话交给新进程。
+  std::string_view Unparsed() const;
+  std::size_t Capacity() const;
+  uint32_t PendingPayloadSize() const;
+
+ private:
+  std::vector<char> storage;
+  std::size_t begin{0};
+  std::size_t end{0};
+  std::size_t initialCapacity;
+  std::size_t maxPayload;
+};
+
+}  // namespace wimi::connection
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace wimi::connection {
+
+// splitmix64 终结器：把相邻的整数打散成均匀分布的 64 位值。
+constexpr uint64_t MixRendezvousKey(uint64_t value) {
+  value += 0x9e3779b97f4a7c15ULL;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+  return value ^ (value >> 31);
+}
+
+// 节点 id 的整数键（FNV-1a 后再混合），路由快照重建时算一次，
+// 选路时不再拼接或哈希字符串。
+constexpr uint64_t RendezvousNodeKey(std::string_view nodeId) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (const char c : nodeId) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3ULL;
+  }
+  return MixRendezvousKey(hash);
+}
+
+// 加权 rendezvous 得分，越大越优。哈希高 53 位映射到 (0,1) 得 u，
+// weight / -ln(u) 让节点胜出的概率与权重成正比。
+inline double RendezvousScore(uint64_t hash, uint32_t weight) {
+  const double unit = (static_cast<double>(hash >> 11) + 0.5) * 0x1.0p-53;
+  return static_cast<double>(weight) / -std::log(unit);
+}
+
+// 为 flowKey 选出 candidates 中的 rendezvous 节点，返回下标；没有合格
+// 节点时返回 candidates.size()。Candidate 需提供 key 与 weight 成员，
+// eligible 过滤不可用节点，被过滤节点上的流只迁到各自的次优节点。
+// 等权时直接比较哈希，省掉 log；整个过程不分配内存。
+template <typename Candidates, typename Eligible>
+std::size_t SelectRendezvous(const Candidates &candidates, uint64_t flowKey,
+                             bool weighted, Eligible eligible) {
+  const uint64_t flow = MixRendezvousKey(flowKey);
+  std::size_t selected = candidates.size();
+  uint64_t bestHash = 0;
+  double bestScore = 0;
+  for (std::size_t i = 0; i < candidates.size(); ++i) {
+    const auto &candidate = candidates[i];
+    if (!eligible(candidate))
+      continue;
+    const uint64_t hash = MixRendezvousKey(flow ^ candidate.key);
+    if (!weighted) {
+      if (selected == candidates.size() || hash > bestHash) {
+        selected = i;
+        bestHash = hash;
+      }
+      continue;
+    }
+    const double score = RendezvousScore(hash, candidate.weight);
+    if (selected == candidates.size() || score > bestScore) {
+      selected = i;
+      bestScore = score;
+    }
+  }
+  return selected;
+}
+
+}  // namespace wimi::connection
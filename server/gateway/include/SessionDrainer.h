@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace wimi::connection {
+
+class GatewayServer;
+class SessionRegistry;
+
+// 计划内下线：停止 accept 后把已登录会话按速率分批关闭。关闭前先推送
+// GATEWAY_REDIRECT，带上按 uid 预选的目标 Gateway、新签发的连接凭证和
+// 随机化的重连延迟，客户端直接连目标 Gateway 登录，不再经过 Gate 的
+// signIn 与 State 选点；重连压力按批次和抖动摊开。
+class SessionDrainer {
+ public:
+  struct Policy {
+    // 每秒关闭的会话数，按 waveInterval 切成若干批。
+    double sessionsPerSecond{500};
+    std::chrono::milliseconds waveInterval{200};
+    // 客户端在 [0, reconnectJitter] 内随机等待后重连。
+    std::chrono::milliseconds reconnectJitter{5000};
+    long tokenTtlSeconds{15 * 60};
+    // 全部批次发出后最多等这么久让推送写完、连接关闭，再调用 onComplete。
+    std::chrono::milliseconds linger{5000};
+  };
+
+  // 候选重连目标；key 为 RendezvousNodeKey(id)。
+  struct Target {
+    std::string id;
+    std::string host;
+    unsigned short port{0};
+    uint32_t weight{1};
+    uint64_t key{0};
+  };
+
+  SessionDrainer(std::string gatewayId, SessionRegistry &registry,
+                 std::vector<GatewayServer *> servers, Policy policy,
+                 std::function<void()> onComplete);
+  ~SessionDrainer();
+
+  // 开始排空；已在排空时返回 false。
+  bool Start();
+  void Stop();
+  bool Draining() const;
+
+  // 同一 uid 在目标列表不变时总是选到同一个 Gateway，各目标分到的会话数
+  // 与权重成正比；targets 为空时返回 targets.size()。
+  static std::size_t SelectTarget(const std::vector<Target> &targets,
+                                  int64_t uid);
+  // 每批关闭的会话数，至少为 1。
+  static std::size_t WaveSize(const Policy &policy);
+
+ private:
+  void Run();
+  // 从 State 拉取可接入的 Gateway，排除自身；未配置 stateRPC 或调用失败
+  // 时为空，会话直接关闭，由客户端走 Gate 重连。
+  std::vector<Target> FetchTargets() const;
+  // 等待 delay 或 Stop；返回 false 表示已停止。
+  bool WaitFor(std::chrono::steady_clock::duration delay);
+
+  std::string gatewayId;
+  SessionRegistry &registry;
+  std::vector<GatewayServer *> servers;
+  Policy policy;
+  std::function<void()> onComplete;
+  std::string stateAddress;
+  std::thread thread;
+  mutable std::mutex mutex;
+  std::condition_variable wakeup;
+  bool draining{false};
+  bool stopping{false};
+};
+
+}  // namespace wimi::connection
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "TcpMessageCodec.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace wimi::connection {
+
+class GatewaySession;
+
+// 断线时仍未确认的可靠推送；frame 与原会话的重传表共享同一份缓冲。
+struct ParkedWrite {
+  int64_t ackSeq{0};
+  std::shared_ptr<const std::string> frame;
+};
+
+// 会话恢复：登录成功时签发 resume token，登记 uid、登录响应里的资料和
+// 在线会话。连接因网络原因断开时，会话把待确认推送停放在这里，保留
+// ttl；客户端在此期间带 token 重连本 Gateway，即可跳过 token 校验与
+// MySQL 资料加载，只发布新 lease 并重放推送。旧连接尚未察觉断线时，
+// Claim 返回的 session 仍在线，由新连接接管其待确认推送。
+// 停放数超过 maxParked 时淘汰最早停放的一项。
+class SessionParking {
+ public:
+  struct Claimed {
+    int64_t uid{0};
+    TcpPacket profile;
+    std::weak_ptr<GatewaySession> session;
+    std::vector<ParkedWrite> writes;
+  };
+
+  SessionParking(std::chrono::steady_clock::duration ttl,
+                 std::size_t maxParked);
+
+  std::string Issue(int64_t uid, const TcpPacket &profile,
+                    std::weak_ptr<GatewaySession> session);
+  // 网络断开：token 仍有效时停放待确认推送并开始计时，否则丢弃。
+  void Park(const std::string &token, std::vector<ParkedWrite> writes);
+  // 主动关闭（QUIT、fencing、重定向等）不再允许恢复。
+  void Revoke(const std::string &token);
+  // 一次性领取；uid 不符、已过期或已被领取时返回空。
+  std::optional<Claimed> Claim(const std::string &token, int64_t uid);
+  // 领取后恢复失败（如 lease 发布失败）：按原 token 重新停放领取到的
+  // 资料与待确认推送并重新计时，客户端可带同一 token 重试。
+  void Restore(const std::string &token, Claimed claimed);
+
+  std::size_t Size() const;
+  std::size_t Parked() const;
+
+ private:
+  struct Entry {
+    Claimed state;
+    bool parked{false};
+    std::chrono::steady_clock::time_point expiresAt{};
+  };
+
+  // 调用方持有 mutex；按停放顺序清理到期或超出上限的项。
+  void ExpireLocked(std::chrono::steady_clock::time_point now);
+
+  const std::chrono::steady_clock::duration ttl;
+  const std::size_t maxParked;
+  mutable std::mutex mutex;
+  std::unordered_map<std::string, Entry> entries;
+  // 停放顺序；领取或撤销后的 token 留在队列里，到队首时跳过。
+  std::deque<std::pair<std::chrono::steady_clock::time_point, std::string>>
+      parkedOrder;
+  std::size_t parked{0};
+};
+
+}  // namespace wimi::connection
@@ -3,11 +3,15 @@
 #include "Redis.h"
 #include "gateway_message.pb.h"
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
-#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace wimi::connection {
 
@@ -16,29 +20,71 @@ class GatewaySession;
 class SessionRegistry {
  public:
   SessionRegistry(std::string gatewayId, std::string instanceId,
-                  long leaseTtlSeconds = 60);
+                  long leaseTtlSeconds = 60, std::size_t shardCount = 64);
 
-  db::SessionLease Bind(int64_t uid,
-                        const std::shared_ptr<GatewaySession> &session);
-  bool Refresh(int64_t uid, const db::SessionLease &lease);
+  // 发布 lease 并登记本地路由，返回 generation；<= 0 表示发布失败。
+  int64_t Bind(int64_t uid, const std::shared_ptr<GatewaySession> &session);
+  // 登录准入的批量版本：一条 pipeline 发布全部 lease，返回与输入同序的
+  // generation；Redis 不可用时返回空表。
+  std::vector<int64_t> BindAll(
+      const std::vector<std::pair<int64_t, std::shared_ptr<GatewaySession>>>
+          &sessions);
   void Remove(int64_t uid, const std::shared_ptr<GatewaySession> &session,
-              const db::SessionLease &lease);
+              int64_t generation);
   gateway::DeliveryStatus Deliver(const gateway::DeliveryEnvelope &delivery);
+  // 多播扇出：推送帧只编码一次，所有目标会话共享同一份缓冲；逐个目标做
+  // 与 Deliver 相同的 lease 校验，结果按 targets 顺序写入 ack。
+  void DeliverMulticast(const gateway::MulticastDelivery &multicast,
+                        gateway::MulticastDeliveryAck &ack);
+
+  // 只维护本地路由表，不读写 Redis lease；Bind/Remove 在发布/清理 lease
+  // 前后调用它们，压测也用它们直接构造在线会话。
+  std::shared_ptr<GatewaySession> Attach(
+      int64_t uid, const std::shared_ptr<GatewaySession> &session,
+      int64_t generation);
+  bool Detach(int64_t uid, const std::shared_ptr<GatewaySession> &session);
+
+  // 本 Gateway 实例的 lease 只有 connectionId 与 generation 因连接而异，
+  // 会话和路由表只保存这两个整数，需要写 Redis 时再拼出完整 lease。
+  db::SessionLease MakeLease(uint64_t connectionId, int64_t generation) const;
+
+  // 当前在线会话快照，热重启时按此逐个迁移。
+  std::vector<std::pair<int64_t, std::shared_ptr<GatewaySession>>> Sessions()
+      const;
 
   const std::string &GatewayId() const;
   const std::string &InstanceId() const;
+  std::size_t ShardCount() const;
+  std::size_t Size() const;
 
  private:
   struct LocalSession {
     std::weak_ptr<GatewaySession> session;
-    db::SessionLease lease;
+    uint64_t connectionId{0};
+    int64_t generation{0};
   };
+  // 按 uid 分片，每片独占缓存行，避免相邻分片的锁互相伪共享。
+  // Deliver 是读多写少路径，只取共享锁；Bind/Remove 取独占锁。
+  struct alignas(64) Shard {
+    mutable std::shared_mutex mutex;
+    std::unordered_map<int64_t, LocalSession> sessions;
+  };
+
+  Shard &ShardFor(int64_t uid) const;
+  // 找到连接身份与信封一致的在线会话；找不到时 status 为 OFFLINE 或
+  // STALE_ROUTE。
+  std::shared_ptr<GatewaySession> FindCurrent(
+      int64_t uid, std::string_view expectedConnectionId,
+      uint64_t expectedGeneration, gateway::DeliveryStatus &status) const;
+  static gateway::DeliveryStatus Send(
+      GatewaySession &session, std::shared_ptr<const std::string> frame,
+      int64_t messageId, int64_t transportSeq);
 
   std::string gatewayId;
   std::string instanceId;
   long leaseTtlSeconds;
-  std::mutex mutex;
-  std::unordered_map<int64_t, LocalSession> sessions;
+  std::size_t shardCount;
+  std::unique_ptr<Shard[]> shards;
 };
 
 }  // namespace wimi::connection
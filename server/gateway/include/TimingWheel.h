@@ -0,0 +1,65 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace wimi::connection {
+
+// 每个 io_context 一个的哈希时间轮，驱动传输 ACK 重传和空闲读超时。
+// 定时项只是槽内的一条记录，不再为每个在途推送分配 steady_timer；
+// 取消采用惰性方式：接收方到期时用 ticket 判断这条记录是否仍然有效。
+class TimingWheel {
+ public:
+  enum class TimerKind : uint8_t { TransportRetry, IdleRead };
+
+  class Listener {
+   public:
+    virtual ~Listener() = default;
+    // 在时间轮线程上调用，实现方负责切回自己的执行器。
+    virtual void OnTimerExpired(TimerKind kind, int64_t key,
+                                uint64_t ticket) = 0;
+  };
+
+  TimingWheel(boost::asio::io_context &ioContext,
+              std::chrono::milliseconds tick, std::size_t slotCount);
+
+  void Start();
+  void Stop();
+  // delay 向上取整到 tick；到期时间不早于 delay，最多晚一个 tick。
+  void Schedule(std::weak_ptr<Listener> listener, TimerKind kind, int64_t key,
+                uint64_t ticket, std::chrono::milliseconds delay);
+  // 推进一格并回调到期项，返回回调次数；正常由内部定时器驱动。
+  std::size_t Tick();
+  std::size_t Pending() const;
+  std::chrono::milliseconds TickInterval() const;
+
+ private:
+  struct Entry {
+    std::weak_ptr<Listener> listener;
+    uint64_t expiresAt{0};
+    uint64_t ticket{0};
+    int64_t key{0};
+    TimerKind kind{TimerKind::TransportRetry};
+  };
+
+  void ArmTicker();
+
+  boost::asio::steady_timer ticker;
+  const std::chrono::milliseconds tick;
+  const std::size_t slotMask;
+  mutable std::mutex mutex;
+  std::vector<std::vector<Entry>> slots;
+  std::vector<Entry> expired;
+  uint64_t currentTick{0};
+  std::size_t pending{0};
+  std::chrono::steady_clock::time_point startedAt;
+  std::atomic<bool> running{false};
+};
+
+}  // namespace wimi::connection
@@ -1,5 +1,6 @@
 #include "GatewayServer.h"
 
+#include "GatewayOptions.h"
 #include "GatewaySession.h"
 #include "Logger.h"
 #include "MessageLink.h"
@@ -7,31 +8,54 @@
 
 #include <boost/asio/redirect_error.hpp>
 #include <boost/asio/use_awaitable.hpp>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
 #include <chrono>
+#include <utility>
 
 namespace wimi::connection {
 namespace asio = boost::asio;
+namespace {
+
+using ReusePort =
+    asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
+}  // namespace
 
 GatewayServer::GatewayServer(asio::io_context &ioContext, unsigned short port,
-                             SessionRegistry &registry,
-                             MessageLinkManager &messageLinks,
-                             asio::thread_pool &businessPool)
+                             GatewayServices &services, int listenerHandle)
     : ioContext(ioContext),
-      acceptor(ioContext, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port)),
-      registry(registry),
-      messageLinks(messageLinks),
-      businessPool(businessPool) {
+      acceptor(ioContext),
+      services(services),
+      timers(ioContext,
+             std::chrono::milliseconds(services.options.timerTickMilliseconds),
+             services.options.timerSlots) {
+  // 继承来的 socket 已在监听，旧进程 accept 队列里的连接原样保留。
+  if (listenerHandle >= 0) {
+    acceptor.assign(asio::ip::tcp::v4(), listenerHandle);
+    return;
+  }
+  const asio::ip::tcp::endpoint endpoint(asio::ip::tcp::v4(), port);
+  acceptor.open(endpoint.protocol());
   acceptor.set_option(asio::socket_base::reuse_address(true));
+  // thread-per-core 模式下每个 io_context 各自监听同一端口，由内核按四元组
+  // 散列把新连接分给不同 acceptor，accept 不再集中在一个线程。
+  if (services.options.threadPerCore)
+    acceptor.set_option(ReusePort(true));
+  acceptor.bind(endpoint);
+  acceptor.listen();
 }
 
 asio::awaitable<void> GatewayServer::Run() {
+  timers.Start();
   asio::steady_timer readinessTimer(ioContext);
-  while (!messageLinks.Ready()) {
+  while (!services.messageLinks.Ready()) {
     readinessTimer.expires_after(std::chrono::milliseconds(100));
     co_await readinessTimer.async_wait(asio::use_awaitable);
   }
   LOG_INFO(netLogger, "Connection Gateway is ready, message streams: {}",
-           messageLinks.HealthyLinkCount());
+           services.messageLinks.HealthyLinkCount());
 
   while (acceptor.is_open()) {
     boost::system::error_code ec;
@@ -43,10 +67,38 @@ asio::awaitable<void> GatewayServer::Run() {
       LOG_WARN(netLogger, "Gateway accept failed: {}", ec.message());
       continue;
     }
-    std::make_shared<GatewaySession>(std::move(socket), registry, messageLinks,
-                                     businessPool)
+    std::make_shared<GatewaySession>(std::move(socket), services, timers)
         ->Start();
   }
 }
 
+int GatewayServer::DuplicateListener() {
+  return ::fcntl(acceptor.native_handle(), F_DUPFD_CLOEXEC, 0);
+}
+
+void GatewayServer::StopAccepting() {
+  asio::post(ioContext, [this]() {
+    boost::system::error_code ignored;
+    acceptor.close(ignored);
+  });
+}
+
+void GatewayServer::Adopt(int fd, gateway::HandoffSession state) {
+  asio::post(ioContext, [this, fd, state = std::move(state)]() {
+    asio::ip::tcp::socket socket(ioContext);
+    boost::system::error_code ec;
+    socket.assign(asio::ip::tcp::v4(), fd, ec);
+    if (ec) {
+      ::close(fd);
+      LOG_WARN(netLogger, "Gateway failed to adopt handed-off socket: {}",
+               ec.message());
+      return;
+    }
+    auto session = std::make_shared<GatewaySession>(
+        std::move(socket), services, timers, state.connection_id());
+    session->Resume(state);
+    session->Start();
+  });
+}
+
 }  // namespace wimi::connection
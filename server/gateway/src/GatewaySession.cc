@@ -2,24 +2,26 @@
 
 #include "Const.h"
 #include "DbGlobal.h"
+#include "LeaseRefresher.h"
+#include "LoginAdmission.h"
 #include "Logger.h"
 #include "MessageLink.h"
+#include "Metrics.h"
 #include "Mysql.h"
 #include "SessionRegistry.h"
 
 #include <boost/asio/co_spawn.hpp>
-#include <boost/asio/read.hpp>
 #include <boost/asio/redirect_error.hpp>
 #include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/use_future.hpp>
 #include <boost/asio/write.hpp>
-#include <boost/uuid/uuid_generators.hpp>
-#include <boost/uuid/uuid_io.hpp>
 #include <arpa/inet.h>
-#include <array>
+#include <algorithm>
 #include <chrono>
 #include <cstring>
 #include <exception>
 #include <utility>
+#include <vector>
 
 namespace wimi::connection {
 namespace asio = boost::asio;
@@ -34,44 +36,36 @@ int64_t NowUnixMilliseconds() {
       .count();
 }
 
-std::string NewUuid() {
-  return boost::uuids::to_string(boost::uuids::random_generator{}());
-}
+std::atomic<uint64_t> nextConnectionId{1};
 
 std::string ServiceName(uint32_t protocolId) {
   const auto found = serviceIDMap.find(static_cast<int>(protocolId));
   return found == serviceIDMap.end() ? "UNKNOWN_SERVICE" : found->second;
 }
 
-std::shared_ptr<std::string> EncodeFrame(uint32_t protocolId,
-                                         const std::string &payload) {
-  auto frame = std::make_shared<std::string>();
-  frame->resize(PROTOCOL_HEADER_TOTAL + payload.size());
-  const uint32_t wireId = htonl(protocolId);
-  const uint32_t wireSize = htonl(static_cast<uint32_t>(payload.size()));
-  std::memcpy(frame->data(), &wireId, sizeof(wireId));
-  std::memcpy(frame->data() + sizeof(wireId), &wireSize, sizeof(wireSize));
-  std::memcpy(frame->data() + PROTOCOL_HEADER_TOTAL, payload.data(),
-              payload.size());
-  return frame;
-}
-
 }  // namespace
 
 GatewaySession::GatewaySession(asio::ip::tcp::socket socket,
-                               SessionRegistry &registry,
-                               MessageLinkManager &messageLinks,
-                               asio::thread_pool &businessPool)
+                               GatewayServices &services, TimingWheel &timers)
+    : GatewaySession(
+          std::move(socket), services, timers,
+          nextConnectionId.fetch_add(1, std::memory_order_relaxed)) {}
+
+GatewaySession::GatewaySession(asio::ip::tcp::socket socket,
+                               GatewayServices &services, TimingWheel &timers,
+                               uint64_t connectionId)
     : socket(std::move(socket)),
-      strand(asio::make_strand(this->socket.get_executor())),
-      registry(registry),
-      messageLinks(messageLinks),
-      businessPool(businessPool),
-      connectionId(NewUuid()) {}
+      executor(services.options.threadPerCore
+                   ? asio::any_io_executor(this->socket.get_executor())
+                   : asio::any_io_executor(
+                         asio::make_strand(this->socket.get_executor()))),
+      services(services),
+      timers(timers),
+      connectionId(connectionId) {}
 
 void GatewaySession::Start() {
   auto self = shared_from_this();
-  asio::co_spawn(strand, Run(), [self](std::exception_ptr error) {
+  asio::co_spawn(executor, Run(), [self](std::exception_ptr error) {
     if (error) {
       try {
         std::rethrow_exception(error);
@@ -86,89 +80,207 @@ void GatewaySession::Start() {
 
 void GatewaySession::Close() {
   auto self = shared_from_this();
-  asio::post(strand, [self]() { self->CloseInContext(); });
+  asio::post(executor, [self]() { self->CloseInContext(); });
+}
+
+GatewaySession::OutboundFrame GatewaySession::EncodeFrame(
+    uint32_t protocolId, std::string_view payload) {
+  auto frame = std::make_shared<std::string>();
+  frame->resize(PROTOCOL_HEADER_TOTAL + payload.size());
+  const uint32_t wireId = htonl(protocolId);
+  const uint32_t wireSize = htonl(static_cast<uint32_t>(payload.size()));
+  std::memcpy(frame->data(), &wireId, sizeof(wireId));
+  std::memcpy(frame->data() + sizeof(wireId), &wireSize, sizeof(wireSize));
+  std::memcpy(frame->data() + PROTOCOL_HEADER_TOTAL, payload.data(),
+              payload.size());
+  return frame;
 }
 
-bool GatewaySession::SendRaw(std::string packet, uint32_t protocolId) {
+bool GatewaySession::SendRaw(std::string_view packet, uint32_t protocolId) {
   if (closed.load(std::memory_order_acquire))
     return false;
+  return SendFrame(EncodeFrame(protocolId, packet));
+}
+
+bool GatewaySession::Redirect(const TcpPacket &redirect) {
+  if (!SendRaw(SerializeTcpPacket(redirect), ID_GATEWAY_REDIRECT_REQ)) {
+    Close();
+    return false;
+  }
+  // 排在推送入队之后执行，WriteLoop 写完它再关闭 socket。
+  auto self = shared_from_this();
+  asio::post(executor, [self]() {
+    self->closeAfterWrite = true;
+    if (!self->writeActive && !self->writes)
+      self->CloseInContext();
+  });
+  return true;
+}
+
+bool GatewaySession::SendFrame(OutboundFrame frame, FrameClass frameClass) {
+  if (!frame || closed.load(std::memory_order_acquire))
+    return false;
+  const auto &options = services.options;
+  const std::size_t frameBytes = frame->size();
+
+  // 慢消费者策略第一级：超出会话或 Gateway 预算后，推送不再入队。
+  // Gateway 预算耗尽时自身也超预算的会话就是占用内存的慢消费者，直接断开。
+  const bool sessionOverBudget =
+      queuedBytes.load(std::memory_order_relaxed) + frameBytes >
+      options.sessionWriteBudgetBytes;
+  const bool gatewayOverBudget = Metrics::Get(Metric::GatewayQueuedBytes) +
+                                     frameBytes >
+                                 options.gatewayWriteBudgetBytes;
+  if (frameClass != FrameClass::Essential &&
+      (sessionOverBudget || gatewayOverBudget)) {
+    Metrics::Increment(frameClass == FrameClass::Droppable
+                           ? Metric::GatewayPushesDropped
+                           : Metric::GatewayPushesBackpressured);
+    if (sessionOverBudget && gatewayOverBudget) {
+      Metrics::Increment(Metric::GatewaySlowConsumerDisconnects);
+      LOG_WARN(netLogger,
+               "Gateway disconnecting slow consumer under memory pressure, "
+               "connection_id: {}, uid: {}, queued_bytes: {}",
+               connectionId, userId.load(std::memory_order_acquire),
+               queuedBytes.load(std::memory_order_relaxed));
+      Close();
+    }
+    return false;
+  }
+
+  // 第二级：任何帧都不能让会话越过硬上限，越过即断开。
   const auto queued = queuedWrites.fetch_add(1, std::memory_order_acq_rel) + 1;
-  if (queued > kMaxQueuedWrites) {
-    queuedWrites.fetch_sub(1, std::memory_order_acq_rel);
+  const auto bytes =
+      queuedBytes.fetch_add(frameBytes, std::memory_order_acq_rel) +
+      frameBytes;
+  Metrics::Increment(Metric::GatewayQueuedFrames);
+  Metrics::Increment(Metric::GatewayQueuedBytes, frameBytes);
+  if (queued > kMaxQueuedWrites || bytes > options.sessionWriteLimitBytes) {
+    ReleaseQueued(1, frameBytes);
+    Metrics::Increment(Metric::GatewaySlowConsumerDisconnects);
+    LOG_WARN(netLogger,
+             "Gateway disconnecting slow consumer, connection_id: {}, uid: {}, "
+             "queued_frames: {}, queued_bytes: {}",
+             connectionId, userId.load(std::memory_order_acquire), queued,
+             bytes);
     Close();
     return false;
   }
 
-  auto frame = EncodeFrame(protocolId, packet);
   auto self = shared_from_this();
-  asio::post(strand, [self, frame = std::move(frame)]() mutable {
+  asio::post(executor, [self, frame = std::move(frame)]() mutable {
     if (self->closed.load(std::memory_order_acquire)) {
-      self->queuedWrites.fetch_sub(1, std::memory_order_acq_rel);
+      self->ReleaseQueued(1, frame->size());
       return;
     }
-    self->writeQueue.push_back(std::move(frame));
+    if (!self->writes)
+      self->writes = std::make_unique<WriteQueues>();
+    auto &queue = frame->size() > self->services.options.bulkFrameBytes
+                      ? self->writes->bulk
+                      : self->writes->queue;
+    queue.push_back(std::move(frame));
     if (!self->writeActive) {
       self->writeActive = true;
-      asio::co_spawn(self->strand, self->WriteLoop(), asio::detached);
+      asio::co_spawn(self->executor, self->WriteLoop(), asio::detached);
     }
   });
   return true;
 }
 
-bool GatewaySession::SendReliable(std::string packet, uint32_t protocolId,
-                                  int64_t ackSeq) {
+bool GatewaySession::SendReliable(OutboundFrame frame, int64_t ackSeq,
+                                  FrameClass frameClass) {
   if (ackSeq <= 0)
-    return SendRaw(std::move(packet), protocolId);
-  if (!SendRaw(packet, protocolId))
+    return SendFrame(std::move(frame), frameClass);
+  if (!SendFrame(frame, frameClass))
     return false;
+  // 重传表只持有同一帧的引用计数，超时重发直接复用，不重新编码。
   auto self = shared_from_this();
-  asio::post(strand, [self, packet = std::move(packet), protocolId, ackSeq]() {
-    auto found = self->reliableWrites.find(ackSeq);
-    if (found != self->reliableWrites.end() && found->second.timer)
-      found->second.timer->cancel();
-    self->reliableWrites[ackSeq] =
-        ReliableWrite{std::move(packet), protocolId, 1, {}};
+  asio::post(executor, [self, frame = std::move(frame), ackSeq]() mutable {
+    if (self->closed.load(std::memory_order_acquire))
+      return;
+    // 同一序号重新登记时旧的时间轮项因 ticket 变化自然失效。
+    if (!self->reliableWrites)
+      self->reliableWrites =
+          std::make_unique<std::unordered_map<int64_t, ReliableWrite>>();
+    (*self->reliableWrites)[ackSeq] = ReliableWrite{std::move(frame), 1, 0};
     self->ArmReliableWrite(ackSeq);
   });
   return true;
 }
 
-const std::string &GatewaySession::ConnectionId() const {
+uint64_t GatewaySession::ConnectionId() const {
   return connectionId;
 }
 
+GatewaySession::WriteStats GatewaySession::GetWriteStats() const {
+  WriteStats stats;
+  stats.writes = socketWrites.load(std::memory_order_relaxed);
+  stats.frames = framesWritten.load(std::memory_order_relaxed);
+  stats.bytes = bytesWritten.load(std::memory_order_relaxed);
+  stats.maxFramesPerWrite = maxFramesPerWrite.load(std::memory_order_relaxed);
+  stats.queuedFrames = queuedWrites.load(std::memory_order_relaxed);
+  stats.queuedBytes = queuedBytes.load(std::memory_order_relaxed);
+  return stats;
+}
+
 asio::awaitable<void> GatewaySession::Run() {
   boost::system::error_code ec;
+  // 每次 read_some 尽量多读，随后切出缓冲区内所有完整帧；ACK/PING
+  // 突发只需一次系统调用。HandlePacket 拿到的是缓冲区视图，处理完当前
+  // 这批帧之前不会再写入缓冲区。空闲连接不常驻接收缓冲：缓冲区为空时
+  // 先等待可读，再按需分配并读取，解析排空后立即释放。
+  lastReadAt = std::chrono::steady_clock::now();
+  const long idleTimeout = services.options.idleReadTimeoutSeconds;
+  if (idleTimeout > 0)
+    ArmIdleRead(std::chrono::seconds(idleTimeout));
   while (!closed.load(std::memory_order_acquire)) {
-    std::array<uint32_t, 2> header{};
-    co_await asio::async_read(socket, asio::buffer(header),
-                              asio::redirect_error(asio::use_awaitable, ec));
-    if (ec)
-      break;
-
-    const uint32_t protocolId = ntohl(header[0]);
-    const uint32_t bodySize = ntohl(header[1]);
-    if (bodySize > PROTOCOL_RECV_MSS) {
-      LOG_WARN(netLogger, "Gateway rejected oversized frame: {}", bodySize);
+    readParked = true;
+    if (receiveBuffer.Buffered() == 0) {
+      co_await socket.async_wait(asio::ip::tcp::socket::wait_read,
+                                 asio::redirect_error(asio::use_awaitable, ec));
+      if (ec) {
+        CloseLost();
+        break;
+      }
+    }
+    const auto space = receiveBuffer.Prepare();
+    const std::size_t received = co_await socket.async_read_some(
+        asio::buffer(space.data(), space.size()),
+        asio::redirect_error(asio::use_awaitable, ec));
+    readParked = false;
+    if (ec) {
+      CloseLost();
       break;
     }
+    lastReadAt = std::chrono::steady_clock::now();
+    receiveBuffer.Commit(received);
 
-    std::string payload(bodySize, '\0');
-    co_await asio::async_read(socket, asio::buffer(payload),
-                              asio::redirect_error(asio::use_awaitable, ec));
-    if (ec)
+    ReceiveBuffer::Frame frame;
+    auto status = ReceiveBuffer::ParseStatus::NeedMore;
+    while (!closed.load(std::memory_order_acquire) &&
+           (status = receiveBuffer.Next(frame)) ==
+               ReceiveBuffer::ParseStatus::Frame)
+      co_await HandlePacket(frame.protocolId, frame.payload);
+    if (status == ReceiveBuffer::ParseStatus::Oversized) {
+      LOG_WARN(netLogger, "Gateway rejected oversized frame: {}",
+               receiveBuffer.PendingPayloadSize());
       break;
-    co_await HandlePacket(protocolId, std::move(payload));
+    }
+    receiveBuffer.Compact();
   }
 
+  readParked = false;
+  if (services.parking && !resumeToken.empty())
+    services.parking->Revoke(resumeToken);
   CloseInContext();
+  // 已交给新进程的会话 lease 仍然有效，不能清理。
   const int64_t uid = userId.load(std::memory_order_acquire);
-  if (uid > 0 && !lease.empty()) {
+  if (uid > 0 && leaseGeneration > 0 && !handedOff) {
     auto self = shared_from_this();
     co_await asio::co_spawn(
-        businessPool,
+        services.businessPool,
         [this, self, uid]() -> asio::awaitable<void> {
-          registry.Remove(uid, self, lease);
+          services.registry.Remove(uid, self, leaseGeneration);
           co_return;
         },
         asio::use_awaitable);
@@ -176,7 +288,7 @@ asio::awaitable<void> GatewaySession::Run() {
 }
 
 asio::awaitable<void> GatewaySession::HandlePacket(uint32_t protocolId,
-                                                   std::string payload) {
+                                                   std::string_view payload) {
   // 所有客户端包先统一完成 Protobuf 解码；失败包不能进入鉴权或 Message Core。
   TcpPacket request;
   if (!ParseTcpPacket(payload, request)) {
@@ -193,26 +305,45 @@ asio::awaitable<void> GatewaySession::HandlePacket(uint32_t protocolId,
   if (protocolId == ID_LOGIN_INIT_REQ) {
     const int64_t claimedUid = request.uid();
     const bool initProfile = request.init();
+    const bool fragmentation =
+        (request.transport_features() & PROTOCOL_FEATURE_FRAGMENTATION) != 0;
     LOG_DEBUG(businessLogger,
               "Gateway handling login, connection_id: {}, claimed_uid: {}, "
               "init_profile: {}",
               connectionId, claimedUid, initProfile);
-    auto result = co_await asio::co_spawn(
-        businessPool,
-        [this, self = shared_from_this(),
-         request =
-             std::move(request)]() mutable -> asio::awaitable<AuthResult> {
-          co_return Authenticate(std::move(request));
-        },
-        asio::use_awaitable);
+    if (services.parking && request.has_resume_token() &&
+        !request.resume_token().empty() &&
+        co_await ResumeParked(request, fragmentation))
+      co_return;
+    LoginResult result;
+    if (services.admission && !services.login) {
+      result = co_await Admit(std::move(request));
+    } else {
+      result = co_await asio::co_spawn(
+          services.businessPool,
+          [this, self = shared_from_this(),
+           request = std::move(request)]() -> asio::awaitable<LoginResult> {
+            co_return services.login ? services.login(request, self)
+                                     : Authenticate(request);
+          },
+          asio::use_awaitable);
+    }
     if (result.error == ErrorCodes::Success) {
-      lease = result.lease;
+      leaseGeneration = result.generation;
       userId.store(result.response.uid(), std::memory_order_release);
+      clientFragmentation = services.options.fragmentation && fragmentation;
       lastLeaseRefresh = std::chrono::steady_clock::now();
+      if (services.parking) {
+        if (!resumeToken.empty())
+          services.parking->Revoke(resumeToken);
+        resumeToken = services.parking->Issue(
+            result.response.uid(), result.response, weak_from_this());
+        result.response.set_resume_token(resumeToken);
+      }
       LOG_INFO(businessLogger,
                "Gateway login accepted, uid: {}, connection_id: {}, "
                "generation: {}",
-               result.response.uid(), connectionId, lease.generation);
+               result.response.uid(), connectionId, leaseGeneration);
     } else {
       LOG_WARN(businessLogger,
                "Gateway login rejected, connection_id: {}, claimed_uid: {}, "
@@ -238,29 +369,14 @@ asio::awaitable<void> GatewaySession::HandlePacket(uint32_t protocolId,
     co_return;
   }
 
-  // 活跃连接每 20 秒至多刷新一次 lease；CAS 失败表示该 generation
-  // 已被新连接取代。
-  if (std::chrono::steady_clock::now() - lastLeaseRefresh >=
-      std::chrono::seconds(20)) {
-    const bool refreshed = co_await asio::co_spawn(
-        businessPool,
-        [this, actor, currentLease = lease]() -> asio::awaitable<bool> {
-          co_return registry.Refresh(actor, currentLease);
-        },
-        asio::use_awaitable);
-    if (!refreshed) {
-      LOG_WARN(businessLogger,
-               "Gateway lease refresh fenced stale connection, uid: {}, "
-               "connection_id: {}, generation: {}",
-               actor, connectionId, lease.generation);
-      CloseInContext();
-      co_return;
-    }
-    lastLeaseRefresh = std::chrono::steady_clock::now();
-    LOG_DEBUG(businessLogger,
-              "Gateway lease refreshed, uid: {}, connection_id: {}, "
-              "generation: {}",
-              actor, connectionId, lease.generation);
+  // 活跃连接每 20 秒至多登记一次 lease 续约，由 LeaseRefresher 批量完成；
+  // CAS 失败表示该 generation 已被新连接取代，结果经 OnLeaseFenced 回到这里。
+  const auto now = std::chrono::steady_clock::now();
+  if (now - lastLeaseRefresh >= std::chrono::seconds(20)) {
+    lastLeaseRefresh = now;
+    services.leaseRefresher.Enqueue(
+        actor, services.registry.MakeLease(connectionId, leaseGeneration),
+        weak_from_this());
   }
 
   // PING 只维持客户端物理连接，Gateway 本地立即回复，不占用 Message 流。
@@ -326,17 +442,17 @@ asio::awaitable<void> GatewaySession::HandlePacket(uint32_t protocolId,
     co_return;
   }
 
-  // 通用业务包统一封装 CommandEnvelope；request_id 负责跨流关联，连接
+  // 通用业务包统一封装 CommandEnvelope；跨流关联用 MessageLinkManager
+  // 分配的整数 request_seq，request_id 只透传客户端自带的 ID。连接
   // generation 负责在 Message 节点拒绝已经被新登录替代的旧连接命令。
   request.set_uid(actor);
-  if (!request.has_request_id() || request.request_id().empty())
-    request.set_request_id(NextRequestId());
 
   gateway::CommandEnvelope command;
-  command.set_request_id(request.request_id());
+  if (request.has_request_id())
+    command.set_request_id(request.request_id());
   command.set_actor_uid(actor);
-  command.set_connection_id(connectionId);
-  command.set_connection_generation(lease.generation);
+  command.set_connection_id(std::to_string(connectionId));
+  command.set_connection_generation(leaseGeneration);
   command.set_service_id(protocolId);
   if (request.has_conversation_id())
     command.set_conversation_id(request.conversation_id());
@@ -349,57 +465,63 @@ asio::awaitable<void> GatewaySession::HandlePacket(uint32_t protocolId,
   command.set_packet(SerializeTcpPacket(request));
 
   const bool expectResponse = protocolId != ID_ACK;
-  const std::string requestId = command.request_id();
   const int64_t conversationId = command.conversation_id();
   LOG_DEBUG(businessLogger,
             "Gateway forwarding command, request_id: {}, uid: {}, "
             "connection_id: {}, generation: {}, protocol_id: {}, service: {}, "
             "conversation_id: {}, timeout_ms: {}, expect_response: {}",
-            requestId, actor, connectionId, lease.generation, protocolId,
-            ServiceName(protocolId), conversationId, timeout.count(),
-            expectResponse);
+            command.request_id(), actor, connectionId, leaseGeneration,
+            protocolId, ServiceName(protocolId), conversationId,
+            timeout.count(), expectResponse);
   auto weak = weak_from_this();
-  if (!messageLinks.Forward(
+  inflightCommands.fetch_add(1, std::memory_order_acq_rel);
+  if (!services.messageLinks.Forward(
           std::move(command),
-          [weak, expectResponse, actor, protocolId,
-           requestId](const gateway::CommandResult &result) {
+          [weak, expectResponse, actor,
+           protocolId](const gateway::CommandResult &result) {
             if (auto session = weak.lock()) {
+              session->inflightCommands.fetch_sub(1,
+                                                  std::memory_order_acq_rel);
               if (result.error() == ErrorCodes::AuthenticationRequired) {
                 LOG_WARN(businessLogger,
-                         "Message node fenced Gateway command, request_id: {}, "
-                         "uid: {}, protocol_id: {}, service: {}",
-                         requestId, actor, protocolId, ServiceName(protocolId));
+                         "Message node fenced Gateway command, request_seq: "
+                         "{}, uid: {}, protocol_id: {}, service: {}",
+                         result.request_seq(), actor, protocolId,
+                         ServiceName(protocolId));
                 session->Close();
                 return;
               }
               if (!expectResponse) {
                 LOG_DEBUG(businessLogger,
                           "Gateway command completed without client response, "
-                          "request_id: {}, uid: {}, protocol_id: {}, error: {}",
-                          requestId, actor, protocolId, result.error());
+                          "request_seq: {}, uid: {}, protocol_id: {}, "
+                          "error: {}",
+                          result.request_seq(), actor, protocolId,
+                          result.error());
                 return;
               }
               LOG_DEBUG(businessLogger,
-                        "Gateway received command result, request_id: {}, uid: "
-                        "{}, protocol_id: {}, response_service_id: {}, error: "
-                        "{}, retryable: {}",
-                        requestId, actor, protocolId,
+                        "Gateway received command result, request_seq: {}, "
+                        "uid: {}, protocol_id: {}, response_service_id: {}, "
+                        "error: {}, retryable: {}",
+                        result.request_seq(), actor, protocolId,
                         result.response_service_id(), result.error(),
                         result.retryable());
               if (!session->SendRaw(result.packet(),
                                     result.response_service_id()))
                 LOG_WARN(
                     netLogger,
-                    "Gateway failed to queue command response, request_id: "
+                    "Gateway failed to queue command response, request_seq: "
                     "{}, uid: {}, response_service_id: {}",
-                    requestId, actor, result.response_service_id());
+                    result.request_seq(), actor, result.response_service_id());
             }
           })) {
+    inflightCommands.fetch_sub(1, std::memory_order_acq_rel);
     LOG_WARN(netLogger,
-             "Gateway failed to forward command, request_id: {}, uid: {}, "
-             "protocol_id: {}, service: {}, healthy_message_streams: {}",
-             requestId, actor, protocolId, ServiceName(protocolId),
-             messageLinks.HealthyLinkCount());
+             "Gateway failed to forward command, uid: {}, protocol_id: {}, "
+             "service: {}, healthy_message_streams: {}",
+             actor, protocolId, ServiceName(protocolId),
+             services.messageLinks.HealthyLinkCount());
     if (expectResponse)
       SendError(protocolId, ErrorCodes::DependencyUnavailable,
                 "no healthy message stream");
@@ -408,24 +530,335 @@ asio::awaitable<void> GatewaySession::HandlePacket(uint32_t protocolId,
 
 asio::awaitable<void> GatewaySession::WriteLoop() {
   boost::system::error_code ec;
-  while (!writeQueue.empty() && !closed.load(std::memory_order_acquire)) {
-    auto frame = writeQueue.front();
-    co_await asio::async_write(socket, asio::buffer(*frame),
+  // 聚合写：每轮把小帧队列中已有的帧（受帧数/字节预算约束）收拢成一个
+  // buffer 序列交给一次 async_write，群推突发时不再是一帧一次系统调用。
+  // 大帧排在小帧之后，每轮至多附带一个分片，多兆字节的拉取响应不会把
+  // 实时推送和 PONG 堵在身后。在途帧由 batch/activeBulk 持有，写期间
+  // 新入队的帧留到下一轮。
+  // 队列排空后释放 writes，空闲会话只剩一个空指针。
+  const auto &options = services.options;
+  const std::size_t maxFrames =
+      options.gatherWrite ? options.gatherMaxFrames : 1;
+  std::vector<OutboundFrame> batch;
+  std::vector<asio::const_buffer> buffers;
+  batch.reserve(maxFrames + 1);
+  buffers.reserve(maxFrames + 2);
+  while (writes && !closed.load(std::memory_order_acquire)) {
+    auto &queue = writes->queue;
+    auto &bulkQueue = writes->bulk;
+    auto &activeBulk = writes->activeBulk;
+    auto &activeBulkOffset = writes->activeBulkOffset;
+    std::size_t batchBytes = 0;
+    std::size_t wireBytes = 0;
+    while (!queue.empty() && batch.size() < maxFrames) {
+      const auto frameBytes = queue.front()->size();
+      if (!batch.empty() && batchBytes + frameBytes > options.gatherMaxBytes)
+        break;
+      batchBytes += frameBytes;
+      buffers.push_back(asio::buffer(*queue.front()));
+      batch.push_back(std::move(queue.front()));
+      queue.pop_front();
+    }
+    wireBytes = batchBytes;
+
+    // 客户端不支持分片或帧不够大时整帧发送，只享受小帧优先。
+    if (!activeBulk && !bulkQueue.empty()) {
+      auto &bulk = bulkQueue.front();
+      if (clientFragmentation &&
+          bulk->size() - PROTOCOL_HEADER_TOTAL > options.fragmentBytes) {
+        activeBulk = std::move(bulk);
+        activeBulkOffset = PROTOCOL_HEADER_TOTAL;
+      } else {
+        batchBytes += bulk->size();
+        wireBytes += bulk->size();
+        buffers.push_back(asio::buffer(*bulk));
+        batch.push_back(std::move(bulk));
+      }
+      bulkQueue.pop_front();
+    }
+    bool bulkFinished = false;
+    if (activeBulk) {
+      // 没有小帧等待时放大分片，减少大帧独占链路时的系统调用次数；
+      // 新到的小帧最多等待一次 gatherMaxBytes 的写。
+      const std::size_t remaining = activeBulk->size() - activeBulkOffset;
+      const std::size_t fragmentLimit =
+          batch.empty()
+              ? std::max(options.fragmentBytes, options.gatherMaxBytes)
+              : options.fragmentBytes;
+      const std::size_t chunk = std::min(remaining, fragmentLimit);
+      bulkFinished = chunk == remaining;
+      uint32_t wireId = 0;
+      std::memcpy(&wireId, activeBulk->data(), sizeof(wireId));
+      wireId = htonl(ntohl(wireId) | PROTOCOL_FRAGMENT_FLAG |
+                     (bulkFinished ? PROTOCOL_FRAGMENT_END_FLAG : 0U));
+      const uint32_t wireSize = htonl(static_cast<uint32_t>(chunk));
+      std::memcpy(writes->fragmentHeader.data(), &wireId, sizeof(wireId));
+      std::memcpy(writes->fragmentHeader.data() + sizeof(wireId), &wireSize,
+                  sizeof(wireSize));
+      buffers.push_back(asio::buffer(writes->fragmentHeader));
+      buffers.push_back(
+          asio::buffer(activeBulk->data() + activeBulkOffset, chunk));
+      activeBulkOffset += chunk;
+      wireBytes += PROTOCOL_HEADER_TOTAL + chunk;
+    }
+
+    co_await asio::async_write(socket, buffers,
                                asio::redirect_error(asio::use_awaitable, ec));
-    writeQueue.pop_front();
-    queuedWrites.fetch_sub(1, std::memory_order_acq_rel);
+    std::size_t completedFrames = batch.size();
+    if (bulkFinished) {
+      ++completedFrames;
+      batchBytes += activeBulk->size();
+      activeBulk.reset();
+    }
+    ReleaseQueued(completedFrames, batchBytes);
+    socketWrites.fetch_add(1, std::memory_order_relaxed);
+    framesWritten.fetch_add(completedFrames, std::memory_order_relaxed);
+    bytesWritten.fetch_add(wireBytes, std::memory_order_relaxed);
+    if (batch.size() > maxFramesPerWrite.load(std::memory_order_relaxed))
+      maxFramesPerWrite.store(batch.size(), std::memory_order_relaxed);
+    Metrics::Increment(Metric::GatewaySocketWrites);
+    Metrics::Increment(Metric::GatewayFramesWritten, completedFrames);
+    batch.clear();
+    buffers.clear();
     if (ec) {
-      CloseInContext();
+      CloseLost();
       break;
     }
+    if (queue.empty() && bulkQueue.empty() && !activeBulk)
+      writes.reset();
   }
   writeActive = false;
-  if (closeAfterWrite && writeQueue.empty())
+  if (writes && closed.load(std::memory_order_acquire)) {
+    if (writes->activeBulk)
+      ReleaseQueued(1, writes->activeBulk->size());
+    writes.reset();
+  }
+  if (closeAfterWrite && !writes)
     CloseInContext();
 }
 
-GatewaySession::AuthResult GatewaySession::Authenticate(TcpPacket request) {
-  AuthResult result;
+std::future<int> GatewaySession::Handoff(
+    std::chrono::milliseconds drainTimeout, gateway::HandoffSession &state) {
+  auto self = shared_from_this();
+  return asio::co_spawn(
+      executor,
+      [self, drainTimeout, &state]() -> asio::awaitable<int> {
+        co_return co_await self->Export(drainTimeout, state);
+      },
+      asio::use_future);
+}
+
+asio::awaitable<int> GatewaySession::Export(
+    std::chrono::milliseconds drainTimeout, gateway::HandoffSession &state) {
+  // 在途命令的结果会回到旧进程，写到一半的分片也无法续写，等会话静止后
+  // 再交出；客户端发来的数据留在内核接收队列里随 fd 一起转移。
+  const auto deadline = std::chrono::steady_clock::now() + drainTimeout;
+  asio::steady_timer timer(executor);
+  while (!closed.load(std::memory_order_acquire) &&
+         (!readParked || writeActive ||
+          inflightCommands.load(std::memory_order_acquire) > 0)) {
+    if (std::chrono::steady_clock::now() >= deadline)
+      co_return -1;
+    timer.expires_after(std::chrono::milliseconds(5));
+    boost::system::error_code ignored;
+    co_await timer.async_wait(
+        asio::redirect_error(asio::use_awaitable, ignored));
+  }
+  if (closed.exchange(true))
+    co_return -1;
+  handedOff = true;
+  state.set_uid(userId.load(std::memory_order_acquire));
+  state.set_connection_id(connectionId);
+  state.set_generation(leaseGeneration);
+  state.set_fragmentation(clientFragmentation);
+  const auto input = receiveBuffer.Unparsed();
+  state.set_pending_input(input.data(), input.size());
+  if (reliableWrites) {
+    for (const auto &[ackSeq, write] : *reliableWrites) {
+      auto *pending = state.add_reliable_writes();
+      pending->set_ack_seq(ackSeq);
+      pending->set_frame(*write.frame);
+      pending->set_attempts(write.attempts);
+    }
+    reliableWrites.reset();
+  }
+  // release 同时取消挂起的读等待，Run 随后按 handedOff 退出。
+  boost::system::error_code ec;
+  const int fd = socket.release(ec);
+  if (ec) {
+    LOG_WARN(netLogger,
+             "Gateway failed to release socket for handoff, connection_id: "
+             "{}, error: {}",
+             connectionId, ec.message());
+    socket.close(ec);
+    co_return -1;
+  }
+  co_return fd;
+}
+
+void GatewaySession::Resume(const gateway::HandoffSession &state) {
+  userId.store(state.uid(), std::memory_order_release);
+  leaseGeneration = state.generation();
+  clientFragmentation = services.options.fragmentation && state.fragmentation();
+  lastLeaseRefresh = std::chrono::steady_clock::now();
+  std::string_view input = state.pending_input();
+  while (!input.empty()) {
+    const auto space = receiveBuffer.Prepare();
+    const std::size_t bytes = std::min(space.size(), input.size());
+    std::memcpy(space.data(), input.data(), bytes);
+    receiveBuffer.Commit(bytes);
+    input.remove_prefix(bytes);
+  }
+  // 待确认推送已经写到客户端，这里只恢复重传登记，不立即重发。
+  for (const auto &pending : state.reliable_writes()) {
+    if (!reliableWrites)
+      reliableWrites =
+          std::make_unique<std::unordered_map<int64_t, ReliableWrite>>();
+    (*reliableWrites)[pending.ack_seq()] = ReliableWrite{
+        std::make_shared<const std::string>(pending.frame()),
+        std::max(pending.attempts(), 1U), 0};
+    ArmReliableWrite(pending.ack_seq());
+  }
+  auto self = shared_from_this();
+  if (auto previous =
+          services.registry.Attach(state.uid(), self, leaseGeneration))
+    previous->Close();
+  // 立即续约一次，lease 的剩余 TTL 不受交接耗时影响。
+  services.leaseRefresher.Enqueue(
+      state.uid(), services.registry.MakeLease(connectionId, leaseGeneration),
+      weak_from_this());
+}
+
+uint64_t GatewaySession::NextConnectionId() {
+  return nextConnectionId.load(std::memory_order_relaxed);
+}
+
+void GatewaySession::ReserveConnectionIds(uint64_t next) {
+  uint64_t current = nextConnectionId.load(std::memory_order_relaxed);
+  while (current < next && !nextConnectionId.compare_exchange_weak(
+                               current, next, std::memory_order_relaxed)) {
+  }
+}
+
+asio::awaitable<LoginResult> GatewaySession::Admit(TcpPacket request) {
+  const auto current = userId.load(std::memory_order_acquire);
+  if (current > 0 && current != request.uid()) {
+    LoginResult result;
+    result.error = ErrorCodes::UidInvalid;
+    result.response =
+        MakeErrorPacket(ErrorCodes::UidInvalid, "connection is already bound");
+    co_return result;
+  }
+  // 准入批次在 businessPool 上完成，结果投递回会话执行器再恢复协程。
+  co_return co_await asio::async_initiate<const asio::use_awaitable_t<> &,
+                                          void(LoginResult)>(
+      [this, &request](auto handler) {
+        auto completion =
+            std::make_shared<decltype(handler)>(std::move(handler));
+        services.admission->Submit(
+            std::move(request), shared_from_this(),
+            [executor = executor, completion](LoginResult result) {
+              asio::post(executor, [completion,
+                                    result = std::move(result)]() mutable {
+                (*completion)(std::move(result));
+              });
+            });
+      },
+      asio::use_awaitable);
+}
+
+asio::awaitable<bool> GatewaySession::ResumeParked(const TcpPacket &request,
+                                                  bool fragmentation) {
+  const int64_t uid = request.uid();
+  if (userId.load(std::memory_order_acquire) > 0)
+    co_return false;
+  auto claimed = services.parking->Claim(request.resume_token(), uid);
+  if (!claimed)
+    co_return false;
+  // 旧连接还没察觉断线时由它交出待确认推送；它退出时的 lease 清理带着
+  // 旧 generation，不会误删新 lease。
+  auto writes = std::move(claimed->writes);
+  if (auto previous = claimed->session.lock())
+    writes = co_await asio::co_spawn(previous->executor, previous->Surrender(),
+                                     asio::use_awaitable);
+  // 资料与凭证都已在首次登录时校验过，这里只发布新 lease。
+  const int64_t generation = co_await asio::co_spawn(
+      services.businessPool,
+      [this, self = shared_from_this(), uid]() -> asio::awaitable<int64_t> {
+        co_return services.registry.Bind(uid, self);
+      },
+      asio::use_awaitable);
+  if (generation <= 0) {
+    LOG_WARN(businessLogger,
+             "Gateway failed to publish lease for resumed session, re-parked "
+             "it, uid: {}, connection_id: {}, parked_writes: {}",
+             uid, connectionId, writes.size());
+    // 领取已让 token 失效、旧会话也已交出推送；放回停放区，客户端按可
+    // 重试错误带同一 token 再来时仍能恢复，推送不丢。
+    claimed->writes = std::move(writes);
+    services.parking->Restore(request.resume_token(), std::move(*claimed));
+    SendRaw(SerializeTcpPacket(
+                MakeErrorPacket(ErrorCodes::DependencyUnavailable,
+                                "failed to publish session lease")),
+            ID_LOGIN_INIT_RSP);
+    co_return true;
+  }
+  leaseGeneration = generation;
+  userId.store(uid, std::memory_order_release);
+  clientFragmentation = services.options.fragmentation && fragmentation;
+  lastLeaseRefresh = std::chrono::steady_clock::now();
+  resumeToken =
+      services.parking->Issue(uid, claimed->profile, weak_from_this());
+
+  TcpPacket response = std::move(claimed->profile);
+  response.set_resume_token(resumeToken);
+  response.set_resumed(true);
+  LOG_INFO(businessLogger,
+           "Gateway resumed parked session, uid: {}, connection_id: {}, "
+           "generation: {}, replayed_writes: {}",
+           uid, connectionId, leaseGeneration, writes.size());
+  if (!SendRaw(SerializeTcpPacket(response), ID_LOGIN_INIT_RSP))
+    co_return true;
+  // 重放排在登录响应之后；新连接重新计重传次数，客户端按 seq 去重。
+  for (auto &write : writes) {
+    if (!SendFrame(write.frame, FrameClass::Deferrable))
+      break;
+    if (!reliableWrites)
+      reliableWrites =
+          std::make_unique<std::unordered_map<int64_t, ReliableWrite>>();
+    (*reliableWrites)[write.ackSeq] =
+        ReliableWrite{std::move(write.frame), 1, 0};
+    ArmReliableWrite(write.ackSeq);
+  }
+  co_return true;
+}
+
+asio::awaitable<std::vector<ParkedWrite>> GatewaySession::Surrender() {
+  if (closed.load(std::memory_order_acquire))
+    co_return std::vector<ParkedWrite>{};
+  auto writes = TakeReliableWrites();
+  resumeToken.clear();
+  CloseInContext();
+  co_return writes;
+}
+
+std::vector<ParkedWrite> GatewaySession::TakeReliableWrites() {
+  std::vector<ParkedWrite> writes;
+  if (!reliableWrites)
+    return writes;
+  writes.reserve(reliableWrites->size());
+  for (auto &[ackSeq, write] : *reliableWrites)
+    writes.push_back(ParkedWrite{ackSeq, std::move(write.frame)});
+  reliableWrites.reset();
+  std::sort(writes.begin(), writes.end(),
+            [](const ParkedWrite &left, const ParkedWrite &right) {
+              return left.ackSeq < right.ackSeq;
+            });
+  return writes;
+}
+
+LoginResult GatewaySession::Authenticate(const TcpPacket &request) {
+  LoginResult result;
   const int64_t uid = request.uid();
   if (uid <= 0 || !request.has_auth_token() ||
       !db::RedisDao::GetInstance()->validateChatAuthToken(
@@ -470,8 +903,8 @@ GatewaySession::AuthResult GatewaySession::Authenticate(TcpPacket request) {
     }
   }
 
-  result.lease = registry.Bind(uid, shared_from_this());
-  if (result.lease.empty()) {
+  result.generation = services.registry.Bind(uid, shared_from_this());
+  if (result.generation <= 0) {
     result.error = ErrorCodes::DependencyUnavailable;
     result.response = MakeErrorPacket(ErrorCodes::DependencyUnavailable,
                                       "failed to publish session lease");
@@ -491,56 +924,150 @@ GatewaySession::AuthResult GatewaySession::Authenticate(TcpPacket request) {
 void GatewaySession::CloseInContext() {
   if (closed.exchange(true))
     return;
-  for (auto &[_, write] : reliableWrites) {
-    if (write.timer)
-      write.timer->cancel();
+  // 时间轮里残留的项只持有弱引用，到期时找不到记录即丢弃。
+  reliableWrites.reset();
+  // 未写出的帧不会再发送，立即归还会话和 Gateway 的字节预算；
+  // 在途批次和 activeBulk 由 WriteLoop 在写返回后归还并释放 writes。
+  if (writes) {
+    std::size_t pendingBytes = 0;
+    for (const auto &frame : writes->queue)
+      pendingBytes += frame->size();
+    for (const auto &frame : writes->bulk)
+      pendingBytes += frame->size();
+    ReleaseQueued(writes->queue.size() + writes->bulk.size(), pendingBytes);
+    writes->queue.clear();
+    writes->bulk.clear();
+    if (!writeActive)
+      writes.reset();
   }
-  reliableWrites.clear();
   boost::system::error_code ignored;
   socket.shutdown(asio::ip::tcp::socket::shutdown_both, ignored);
   socket.close(ignored);
+  const auto stats = GetWriteStats();
+  LOG_DEBUG(netLogger,
+            "Gateway session closed, connection_id: {}, uid: {}, "
+            "socket_writes: {}, frames_written: {}, bytes_written: {}, "
+            "max_frames_per_write: {}",
+            connectionId, userId.load(std::memory_order_acquire), stats.writes,
+            stats.frames, stats.bytes, stats.maxFramesPerWrite);
 }
 
-void GatewaySession::ArmReliableWrite(int64_t ackSeq) {
-  auto found = reliableWrites.find(ackSeq);
-  if (found == reliableWrites.end() || closed.load(std::memory_order_acquire))
+void GatewaySession::CloseLost() {
+  if (closed.load(std::memory_order_acquire))
     return;
-  auto timer = std::make_shared<asio::steady_timer>(strand);
-  found->second.timer = timer;
-  timer->expires_after(std::chrono::seconds(5));
-  auto weak = weak_from_this();
-  timer->async_wait([weak, ackSeq](const boost::system::error_code &error) {
-    if (error)
-      return;
-    auto self = weak.lock();
-    if (!self)
-      return;
-    auto current = self->reliableWrites.find(ackSeq);
-    if (current == self->reliableWrites.end())
-      return;
-    if (current->second.attempts >= 3) {
-      LOG_WARN(netLogger,
-               "Gateway delivery transport ACK timed out, uid: {}, seq: {}",
-               self->userId.load(std::memory_order_acquire), ackSeq);
-      self->reliableWrites.erase(current);
-      return;
-    }
-    ++current->second.attempts;
-    if (!self->SendRaw(current->second.packet, current->second.protocolId)) {
-      self->reliableWrites.erase(current);
+  if (services.parking && !resumeToken.empty()) {
+    services.parking->Park(resumeToken, TakeReliableWrites());
+    resumeToken.clear();
+  }
+  CloseInContext();
+}
+
+void GatewaySession::ReleaseQueued(std::size_t frames, std::size_t bytes) {
+  if (frames == 0)
+    return;
+  queuedWrites.fetch_sub(frames, std::memory_order_acq_rel);
+  queuedBytes.fetch_sub(bytes, std::memory_order_acq_rel);
+  Metrics::Decrement(Metric::GatewayQueuedFrames, frames);
+  Metrics::Decrement(Metric::GatewayQueuedBytes, bytes);
+}
+
+void GatewaySession::OnLeaseFenced(int64_t generation) {
+  auto self = shared_from_this();
+  asio::post(executor, [self, generation]() {
+    if (self->closed.load(std::memory_order_acquire) ||
+        self->leaseGeneration != generation)
       return;
-    }
-    self->ArmReliableWrite(ackSeq);
+    LOG_WARN(businessLogger,
+             "Gateway lease refresh fenced stale connection, uid: {}, "
+             "connection_id: {}, generation: {}",
+             self->userId.load(std::memory_order_acquire), self->connectionId,
+             generation);
+    self->CloseInContext();
   });
 }
 
+void GatewaySession::OnTimerExpired(TimingWheel::TimerKind kind, int64_t key,
+                                    uint64_t ticket) {
+  auto self = shared_from_this();
+  asio::dispatch(executor, [self, kind, key, ticket]() {
+    if (kind == TimingWheel::TimerKind::TransportRetry)
+      self->RetryReliableWrite(key, ticket);
+    else
+      self->CheckIdleRead(ticket);
+  });
+}
+
+void GatewaySession::ArmReliableWrite(int64_t ackSeq) {
+  if (!reliableWrites || closed.load(std::memory_order_acquire))
+    return;
+  auto found = reliableWrites->find(ackSeq);
+  if (found == reliableWrites->end())
+    return;
+  found->second.ticket = ++timerTickets;
+  timers.Schedule(weak_from_this(), TimingWheel::TimerKind::TransportRetry,
+                  ackSeq, found->second.ticket,
+                  std::chrono::milliseconds(
+                      services.options.retransmitTimeoutMilliseconds));
+}
+
+void GatewaySession::RetryReliableWrite(int64_t ackSeq, uint64_t ticket) {
+  if (!reliableWrites || closed.load(std::memory_order_acquire))
+    return;
+  auto current = reliableWrites->find(ackSeq);
+  if (current == reliableWrites->end() || current->second.ticket != ticket)
+    return;
+  if (current->second.attempts >= services.options.retransmitAttempts) {
+    LOG_WARN(netLogger,
+             "Gateway delivery transport ACK timed out, uid: {}, seq: {}",
+             userId.load(std::memory_order_acquire), ackSeq);
+    EraseReliableWrite(ackSeq);
+    return;
+  }
+  ++current->second.attempts;
+  if (!SendFrame(current->second.frame, FrameClass::Deferrable)) {
+    EraseReliableWrite(ackSeq);
+    return;
+  }
+  ArmReliableWrite(ackSeq);
+}
+
+void GatewaySession::ArmIdleRead(std::chrono::steady_clock::duration delay) {
+  idleTicket = ++timerTickets;
+  timers.Schedule(
+      weak_from_this(), TimingWheel::TimerKind::IdleRead, 0, idleTicket,
+      std::chrono::ceil<std::chrono::milliseconds>(delay));
+}
+
+void GatewaySession::CheckIdleRead(uint64_t ticket) {
+  if (ticket != idleTicket || closed.load(std::memory_order_acquire))
+    return;
+  // 读操作只刷新时间戳，不逐次改期；到期时再按最近一次读取重新登记。
+  const auto timeout =
+      std::chrono::seconds(services.options.idleReadTimeoutSeconds);
+  const auto idle = std::chrono::steady_clock::now() - lastReadAt;
+  if (idle < timeout) {
+    ArmIdleRead(timeout - idle);
+    return;
+  }
+  LOG_INFO(netLogger,
+           "Gateway closing idle session, connection_id: {}, uid: {}, "
+           "idle_seconds: {}",
+           connectionId, userId.load(std::memory_order_acquire),
+           std::chrono::duration_cast<std::chrono::seconds>(idle).count());
+  CloseLost();
+}
+
 void GatewaySession::AcknowledgeTransport(int64_t ackSeq) {
-  auto found = reliableWrites.find(ackSeq);
-  if (found == reliableWrites.end())
+  EraseReliableWrite(ackSeq);
+}
+
+void GatewaySession::EraseReliableWrite(int64_t ackSeq) {
+  if (!reliableWrites)
     return;
-  if (found->second.timer)
-    found->second.timer->cancel();
-  reliableWrites.erase(found);
+  reliableWrites->erase(ackSeq);
+  // 在途推送全部确认后归还整张表，空闲会话不保留空 bucket 数组。
+  if (reliableWrites->empty())
+    reliableWrites.reset();
 }
 
 void GatewaySession::SendError(uint32_t requestId, int error,
@@ -550,10 +1077,4 @@ void GatewaySession::SendError(uint32_t requestId, int error,
           __getServiceResponseId(ServiceID(requestId)));
 }
 
-std::string GatewaySession::NextRequestId() {
-  return connectionId + ":" +
-         std::to_string(
-             requestSequence.fetch_add(1, std::memory_order_relaxed) + 1);
-}
-
 }  // namespace wimi::connection
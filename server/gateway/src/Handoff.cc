@@ -0,0 +1,397 @@
+#include "Handoff.h"
+
+#include "GatewayServer.h"
+#include "GatewaySession.h"
+#include "Logger.h"
+#include "MessageLink.h"
+#include "SessionRegistry.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <future>
+#include <utility>
+
+namespace wimi::connection {
+namespace {
+
+// Linux 单条消息最多携带 SCM_MAX_FD（253）个描述符。
+constexpr std::size_t kMaxRecordFds = 253;
+constexpr uint32_t kMaxRecordBytes = 64 * 1024 * 1024;
+// 每批并行排空的会话数；静止的会话一轮即可交出，忙碌会话互不拖累。
+constexpr std::size_t kExportBatch = 256;
+// 发出 hello 到本进程停止接入之间两边都在 accept。新进程跳过这么大一块
+// 连接号，本进程在此期间继续从原计数分配，两边不会撞号。
+constexpr uint64_t kHandoffConnectionIdBlock = uint64_t{1} << 32;
+
+void CloseAll(std::vector<int> &fds) {
+  for (const int fd : fds)
+    ::close(fd);
+  fds.clear();
+}
+
+bool MakeAddress(const std::string &path, sockaddr_un &address) {
+  if (path.empty() || path.size() >= sizeof(address.sun_path))
+    return false;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::memcpy(address.sun_path, path.data(), path.size());
+  return true;
+}
+
+// 读满 size 字节；途中收到的描述符一并追加到 fds。
+bool ReceiveExact(int fd, char *data, std::size_t size, std::vector<int> &fds) {
+  while (size > 0) {
+    iovec io{data, size};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * kMaxRecordFds)];
+    msghdr message{};
+    message.msg_iov = &io;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    const ssize_t received = ::recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+    if (received < 0 && errno == EINTR)
+      continue;
+    if (received <= 0)
+      return false;
+    for (auto *header = CMSG_FIRSTHDR(&message); header;
+         header = CMSG_NXTHDR(&message, header)) {
+      if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+        continue;
+      const std::size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      const auto *passed = reinterpret_cast<const int *>(CMSG_DATA(header));
+      fds.insert(fds.end(), passed, passed + count);
+    }
+    if ((message.msg_flags & MSG_CTRUNC) != 0)
+      return false;
+    data += received;
+    size -= static_cast<std::size_t>(received);
+  }
+  return true;
+}
+
+}  // namespace
+
+HandoffChannel::HandoffChannel(int fd) : fd(fd) {}
+
+HandoffChannel::~HandoffChannel() {
+  if (fd >= 0)
+    ::close(fd);
+}
+
+HandoffChannel::HandoffChannel(HandoffChannel &&other) noexcept
+    : fd(std::exchange(other.fd, -1)) {}
+
+HandoffChannel &HandoffChannel::operator=(HandoffChannel &&other) noexcept {
+  if (this != &other) {
+    if (fd >= 0)
+      ::close(fd);
+    fd = std::exchange(other.fd, -1);
+  }
+  return *this;
+}
+
+HandoffChannel HandoffChannel::Connect(const std::string &path) {
+  sockaddr_un address;
+  if (!MakeAddress(path, address))
+    return HandoffChannel();
+  const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return HandoffChannel();
+  if (::connect(fd, reinterpret_cast<const sockaddr *>(&address),
+                sizeof(address)) != 0) {
+    ::close(fd);
+    return HandoffChannel();
+  }
+  return HandoffChannel(fd);
+}
+
+bool HandoffChannel::Valid() const {
+  return fd >= 0;
+}
+
+bool HandoffChannel::Send(const gateway::HandoffRecord &record,
+                          const std::vector<int> &fds) {
+  if (fd < 0 || fds.size() > kMaxRecordFds)
+    return false;
+  std::string payload(sizeof(uint32_t), '\0');
+  if (!record.AppendToString(&payload) ||
+      payload.size() - sizeof(uint32_t) > kMaxRecordBytes)
+    return false;
+  const uint32_t wireSize =
+      htonl(static_cast<uint32_t>(payload.size() - sizeof(uint32_t)));
+  std::memcpy(payload.data(), &wireSize, sizeof(wireSize));
+
+  // 描述符只随第一段数据发送，剩余字节按普通流数据补齐。
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * kMaxRecordFds)];
+  std::size_t offset = 0;
+  bool attachFds = !fds.empty();
+  while (offset < payload.size()) {
+    iovec io{payload.data() + offset, payload.size() - offset};
+    msghdr message{};
+    message.msg_iov = &io;
+    message.msg_iovlen = 1;
+    if (attachFds) {
+      message.msg_control = control;
+      message.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+      auto *header = CMSG_FIRSTHDR(&message);
+      header->cmsg_level = SOL_SOCKET;
+      header->cmsg_type = SCM_RIGHTS;
+      header->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+      std::memcpy(CMSG_DATA(header), fds.data(), sizeof(int) * fds.size());
+    }
+    const ssize_t sent = ::sendmsg(fd, &message, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent <= 0)
+      return false;
+    attachFds = false;
+    offset += static_cast<std::size_t>(sent);
+  }
+  return true;
+}
+
+bool HandoffChannel::Receive(gateway::HandoffRecord &record,
+                             std::vector<int> &fds) {
+  if (fd < 0)
+    return false;
+  std::vector<int> received;
+  uint32_t wireSize = 0;
+  std::string payload;
+  bool ok = ReceiveExact(fd, reinterpret_cast<char *>(&wireSize),
+                         sizeof(wireSize), received);
+  if (ok) {
+    const uint32_t size = ntohl(wireSize);
+    ok = size <= kMaxRecordBytes;
+    if (ok) {
+      payload.resize(size);
+      ok = ReceiveExact(fd, payload.data(), payload.size(), received) &&
+           record.ParseFromString(payload);
+    }
+  }
+  if (!ok) {
+    CloseAll(received);
+    return false;
+  }
+  fds.insert(fds.end(), received.begin(), received.end());
+  return true;
+}
+
+HandoffServer::HandoffServer(std::string socketPath, SessionRegistry &registry,
+                             std::vector<GatewayServer *> servers,
+                             std::chrono::milliseconds drainTimeout,
+                             std::function<void()> onComplete)
+    : socketPath(std::move(socketPath)),
+      registry(registry),
+      servers(std::move(servers)),
+      drainTimeout(drainTimeout),
+      onComplete(std::move(onComplete)) {}
+
+HandoffServer::~HandoffServer() {
+  Stop();
+}
+
+bool HandoffServer::Start() {
+  sockaddr_un address;
+  if (!MakeAddress(socketPath, address)) {
+    LOG_WARN(netLogger, "Gateway handoff socket path is invalid: {}",
+             socketPath);
+    return false;
+  }
+  // 调用方已确认没有旧进程在该地址上等待交接，残留的文件直接删除。
+  ::unlink(socketPath.c_str());
+  listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listener < 0 ||
+      ::bind(listener, reinterpret_cast<const sockaddr *>(&address),
+             sizeof(address)) != 0 ||
+      ::listen(listener, 1) != 0) {
+    LOG_WARN(netLogger, "Gateway handoff listen failed, path: {}, error: {}",
+             socketPath, std::strerror(errno));
+    if (listener >= 0)
+      ::close(listener);
+    listener = -1;
+    return false;
+  }
+  ::chmod(socketPath.c_str(), 0600);
+  thread = std::thread([this]() { Serve(); });
+  LOG_INFO(netLogger, "Gateway handoff listening, path: {}", socketPath);
+  return true;
+}
+
+void HandoffServer::Stop() {
+  if (stopping.exchange(true))
+    return;
+  if (listener >= 0)
+    ::shutdown(listener, SHUT_RDWR);
+  if (thread.joinable())
+    thread.join();
+  if (listener >= 0) {
+    ::close(listener);
+    listener = -1;
+    // 交接完成后该地址已由新进程重新监听，不能删除。
+    if (!handedOff.load(std::memory_order_acquire))
+      ::unlink(socketPath.c_str());
+  }
+}
+
+bool HandoffServer::HandedOff() const {
+  return handedOff.load(std::memory_order_acquire);
+}
+
+void HandoffServer::Serve() {
+  while (!stopping.load(std::memory_order_acquire)) {
+    const int peer = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    if (peer < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      if (!stopping.load(std::memory_order_acquire))
+        LOG_WARN(netLogger, "Gateway handoff accept failed: {}",
+                 std::strerror(errno));
+      return;
+    }
+    HandoffChannel channel(peer);
+    if (Transfer(channel)) {
+      handedOff.store(true, std::memory_order_release);
+      if (onComplete)
+        onComplete();
+      return;
+    }
+  }
+}
+
+bool HandoffServer::Transfer(HandoffChannel &channel) {
+  // 监听 socket 复制后交出；新进程就绪之前两边都在 accept 同一个 socket，
+  // 新进程中途退出时本进程照常服务。
+  std::vector<int> listeners;
+  for (auto *server : servers) {
+    const int fd = server->DuplicateListener();
+    if (fd >= 0)
+      listeners.push_back(fd);
+  }
+  gateway::HandoffRecord record;
+  auto *hello = record.mutable_hello();
+  hello->set_gateway_id(registry.GatewayId());
+  hello->set_instance_id(registry.InstanceId());
+  hello->set_next_connection_id(GatewaySession::NextConnectionId() +
+                                kHandoffConnectionIdBlock);
+  hello->set_listener_count(static_cast<uint32_t>(listeners.size()));
+  const bool sent = channel.Send(record, listeners);
+  CloseAll(listeners);
+  if (!sent) {
+    LOG_WARN(netLogger, "Gateway handoff hello failed, keep serving");
+    return false;
+  }
+  std::vector<int> unexpected;
+  record.Clear();
+  if (!channel.Receive(record, unexpected) || !record.has_ready()) {
+    CloseAll(unexpected);
+    LOG_WARN(netLogger,
+             "Gateway handoff peer left before ready, keep serving");
+    return false;
+  }
+  CloseAll(unexpected);
+
+  // 新进程已在 accept，本进程停止接入新连接并开始迁移会话。此后即使
+  // 通道中断也不再回退，剩余会话随本进程退出，由客户端重连。
+  for (auto *server : servers)
+    server->StopAccepting();
+  const auto sessions = registry.Sessions();
+  uint32_t moved = 0;
+  uint32_t dropped = 0;
+  bool channelOpen = true;
+  for (std::size_t begin = 0; begin < sessions.size(); begin += kExportBatch) {
+    const std::size_t end = std::min(sessions.size(), begin + kExportBatch);
+    std::vector<gateway::HandoffSession> states(end - begin);
+    std::vector<std::future<int>> exports;
+    exports.reserve(end - begin);
+    for (std::size_t i = begin; i < end; ++i) {
+      const auto &[uid, session] = sessions[i];
+      // 先摘掉本地路由，迁移期间到达的推送按离线处理，由客户端补拉。
+      registry.Detach(uid, session);
+      exports.push_back(session->Handoff(drainTimeout, states[i - begin]));
+    }
+    for (std::size_t i = begin; i < end; ++i) {
+      const int fd = exports[i - begin].get();
+      if (fd < 0) {
+        ++dropped;
+        sessions[i].second->Close();
+        continue;
+      }
+      record.Clear();
+      *record.mutable_session() = std::move(states[i - begin]);
+      if (channelOpen && !channel.Send(record, {fd})) {
+        channelOpen = false;
+        LOG_ERROR(netLogger,
+                  "Gateway handoff channel failed after {} sessions",
+                  moved);
+      }
+      ::close(fd);
+      if (channelOpen)
+        ++moved;
+      else
+        ++dropped;
+    }
+  }
+  record.Clear();
+  record.mutable_done()->set_sessions(moved);
+  record.mutable_done()->set_dropped(dropped);
+  if (channelOpen)
+    channel.Send(record);
+  LOG_INFO(netLogger,
+           "Gateway handoff completed, sessions: {}, dropped: {}", moved,
+           dropped);
+  return true;
+}
+
+std::size_t AdoptHandoffSessions(
+    HandoffChannel &channel, MessageLinkManager &messageLinks,
+    const std::vector<std::unique_ptr<GatewayServer>> &servers) {
+  // 与 GatewayServer::Run 相同，Message 流就绪之前不接管任何连接。
+  while (!messageLinks.Ready()) {
+    if (messageLinks.Stopping())
+      return 0;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  gateway::HandoffRecord record;
+  record.mutable_ready();
+  if (servers.empty() || !channel.Send(record)) {
+    LOG_WARN(netLogger, "Gateway handoff ready notice failed");
+    return 0;
+  }
+
+  std::size_t adopted = 0;
+  std::vector<int> fds;
+  while (true) {
+    record.Clear();
+    fds.clear();
+    if (!channel.Receive(record, fds)) {
+      LOG_WARN(netLogger,
+               "Gateway handoff channel closed early, adopted sessions: {}",
+               adopted);
+      break;
+    }
+    if (record.has_done()) {
+      LOG_INFO(netLogger,
+               "Gateway handoff received, adopted sessions: {}, dropped by "
+               "previous process: {}",
+               adopted, record.done().dropped());
+      break;
+    }
+    if (!record.has_session() || fds.size() != 1) {
+      CloseAll(fds);
+      continue;
+    }
+    servers[adopted % servers.size()]->Adopt(
+        fds.front(), std::move(*record.mutable_session()));
+    ++adopted;
+  }
+  return adopted;
+}
+
+}  // namespace wimi::connection
@@ -0,0 +1,98 @@
+#include "HedgeScheduler.h"
+
+#include "LinkHealth.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace wimi::connection {
+namespace {
+
+constexpr int64_t kBudgetUnit = 1000;
+// 预算最多攒够 10 次对冲，流量低谷后的突发也受约束。
+constexpr int64_t kBudgetBurst = 10 * kBudgetUnit;
+constexpr std::size_t kSettledHistory = 4096;
+
+}  // namespace
+
+void HedgeScheduler::SetPolicy(Policy policy) {
+  this->policy = policy;
+}
+
+const HedgeScheduler::Policy &HedgeScheduler::GetPolicy() const {
+  return policy;
+}
+
+int64_t HedgeScheduler::DelayFor(const LatencyHistogram &histogram) const {
+  if (!policy.enabled)
+    return 0;
+  const int64_t quantile =
+      histogram.Quantile(policy.percentile, policy.minimumSamples);
+  if (quantile == 0)
+    return 0;
+  return std::max(quantile, policy.minDelayMilliseconds);
+}
+
+void HedgeScheduler::Accrue() {
+  if (!policy.enabled)
+    return;
+  const auto share = static_cast<int64_t>(
+      std::lround(policy.budgetRatio * static_cast<double>(kBudgetUnit)));
+  int64_t current = budget.load(std::memory_order_relaxed);
+  while (current < kBudgetBurst &&
+         !budget.compare_exchange_weak(current,
+                                       std::min(current + share, kBudgetBurst),
+                                       std::memory_order_relaxed)) {
+  }
+}
+
+bool HedgeScheduler::TryAcquire() {
+  int64_t current = budget.load(std::memory_order_relaxed);
+  while (current >= kBudgetUnit) {
+    if (budget.compare_exchange_weak(current, current - kBudgetUnit,
+                                     std::memory_order_relaxed))
+      return true;
+  }
+  return false;
+}
+
+// 堆顶为最早到期的对冲。
+bool HedgeScheduler::DueLater(const Due &left, const Due &right) {
+  return left.at > right.at;
+}
+
+void HedgeScheduler::Schedule(uint64_t requestSeq,
+                              int64_t dueAtUnixMilliseconds) {
+  std::lock_guard<std::mutex> lock(mutex);
+  due.push_back(Due{dueAtUnixMilliseconds, requestSeq});
+  std::push_heap(due.begin(), due.end(), DueLater);
+}
+
+std::vector<uint64_t> HedgeScheduler::TakeDue(int64_t nowUnixMilliseconds) {
+  std::vector<uint64_t> taken;
+  std::lock_guard<std::mutex> lock(mutex);
+  while (!due.empty() && due.front().at <= nowUnixMilliseconds) {
+    taken.push_back(due.front().requestSeq);
+    std::pop_heap(due.begin(), due.end(), DueLater);
+    due.pop_back();
+  }
+  return taken;
+}
+
+void HedgeScheduler::Settle(uint64_t requestSeq) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!settled.insert(requestSeq).second)
+    return;
+  settledOrder.push_back(requestSeq);
+  if (settledOrder.size() > kSettledHistory) {
+    settled.erase(settledOrder.front());
+    settledOrder.pop_front();
+  }
+}
+
+bool HedgeScheduler::Settled(uint64_t requestSeq) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return settled.contains(requestSeq);
+}
+
+}  // namespace wimi::connection
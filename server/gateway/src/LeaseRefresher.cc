@@ -0,0 +1,108 @@
+#include "LeaseRefresher.h"
+
+#include "GatewaySession.h"
+#include "Logger.h"
+#include "Metrics.h"
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <utility>
+
+namespace wimi::connection {
+namespace asio = boost::asio;
+
+LeaseRefresher::LeaseRefresher(asio::io_context &ioContext,
+                               asio::thread_pool &businessPool,
+                               long leaseTtlSeconds,
+                               std::chrono::milliseconds flushInterval,
+                               std::size_t batchSize)
+    : ioContext(ioContext),
+      businessPool(businessPool),
+      leaseTtlSeconds(leaseTtlSeconds),
+      flushInterval(flushInterval),
+      batchSize(std::max<std::size_t>(batchSize, 1)) {}
+
+void LeaseRefresher::Start() {
+  asio::co_spawn(ioContext, Run(), asio::detached);
+}
+
+void LeaseRefresher::Stop() {
+  stopping.store(true, std::memory_order_release);
+}
+
+void LeaseRefresher::Enqueue(int64_t uid, db::SessionLease lease,
+                             std::weak_ptr<GatewaySession> session) {
+  if (uid <= 0 || lease.empty() || stopping.load(std::memory_order_acquire))
+    return;
+  std::lock_guard<std::mutex> lock(mutex);
+  queue.push_back(Request{uid, std::move(lease), std::move(session)});
+}
+
+std::size_t LeaseRefresher::Pending() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return queue.size();
+}
+
+asio::awaitable<void> LeaseRefresher::Run() {
+  asio::steady_timer timer(ioContext);
+  // 两个 vector 轮流交换，稳定后入队和批处理都不再扩容。
+  std::vector<Request> requests;
+  while (!stopping.load(std::memory_order_acquire)) {
+    boost::system::error_code ec;
+    timer.expires_after(flushInterval);
+    co_await timer.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+    if (ec == asio::error::operation_aborted)
+      co_return;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      requests.swap(queue);
+    }
+    if (requests.empty())
+      continue;
+    // 同一时刻只有一轮在途，Redis 变慢时后续请求自然在队列里合并。
+    co_await asio::co_spawn(
+        businessPool,
+        [this, &requests]() -> asio::awaitable<void> {
+          Flush(requests);
+          co_return;
+        },
+        asio::use_awaitable);
+    requests.clear();
+  }
+}
+
+void LeaseRefresher::Flush(std::vector<Request> &requests) {
+  std::vector<std::pair<long, db::SessionLease>> leases;
+  leases.reserve(requests.size());
+  for (auto &request : requests)
+    leases.emplace_back(request.uid, std::move(request.lease));
+
+  const auto refreshed = db::RedisDao::GetInstance()->refreshSessionLeases(
+      leases, leaseTtlSeconds, batchSize);
+  Metrics::Increment(Metric::GatewayLeaseRefreshBatches,
+                     (leases.size() + batchSize - 1) / batchSize);
+  if (refreshed.empty()) {
+    // Redis 不可用不等于被取代：保留会话，下一个续约周期再试，
+    // lease TTL 足够覆盖两次重试。
+    LOG_WARN(businessLogger, "Gateway lease refresh batch failed, leases: {}",
+             leases.size());
+    return;
+  }
+
+  std::size_t fenced = 0;
+  for (std::size_t i = 0; i < requests.size(); ++i) {
+    if (refreshed[i])
+      continue;
+    ++fenced;
+    if (auto session = requests[i].session.lock())
+      session->OnLeaseFenced(leases[i].second.generation);
+  }
+  Metrics::Increment(Metric::GatewayLeasesRefreshed, leases.size() - fenced);
+  Metrics::Increment(Metric::GatewayLeasesFenced, fenced);
+  LOG_DEBUG(businessLogger,
+            "Gateway lease refresh batch done, leases: {}, fenced: {}",
+            leases.size(), fenced);
+}
+
+}  // namespace wimi::connection
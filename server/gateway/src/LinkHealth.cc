@@ -0,0 +1,139 @@
+#include "LinkHealth.h"
+
+#include <algorithm>
+
+namespace wimi::connection {
+namespace {
+
+// 心跳 5 秒一次，权重取大些；命令样本密集，权重小以平滑抖动。
+constexpr double kHeartbeatAlpha = 0.3;
+constexpr double kCommandAlpha = 0.05;
+constexpr double kErrorAlpha = 0.05;
+constexpr double kErrorDecay = 0.8;
+// 失败率对选路代价的放大倍数：失败率 25% 时代价翻倍。
+constexpr double kErrorPenalty = 4.0;
+
+void Blend(std::atomic<double> &average, double sample, double alpha) {
+  double current = average.load(std::memory_order_relaxed);
+  double next = 0;
+  do {
+    // 0 表示尚无样本，首个样本直接作为初值。
+    next = current == 0 ? sample : current + alpha * (sample - current);
+  } while (!average.compare_exchange_weak(current, next,
+                                          std::memory_order_relaxed));
+}
+
+}  // namespace
+
+void LatencyHistogram::Record(int64_t milliseconds) {
+  const auto bound = std::lower_bound(kBucketBounds.begin(),
+                                      kBucketBounds.end(), milliseconds);
+  buckets[bound - kBucketBounds.begin()].fetch_add(1,
+                                                   std::memory_order_relaxed);
+}
+
+int64_t LatencyHistogram::Quantile(double quantile,
+                                   uint64_t minimumSamples) const {
+  std::array<uint64_t, kBucketCount> counts{};
+  uint64_t total = 0;
+  for (std::size_t i = 0; i < kBucketCount; ++i) {
+    counts[i] = buckets[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+  if (total == 0 || total < minimumSamples)
+    return 0;
+  const auto rank = static_cast<uint64_t>(
+      std::clamp(quantile, 0.0, 1.0) * static_cast<double>(total - 1));
+  uint64_t seen = 0;
+  for (std::size_t i = 0; i < kBucketBounds.size(); ++i) {
+    seen += counts[i];
+    if (seen > rank)
+      return kBucketBounds[i];
+  }
+  // 溢出桶没有上界，按最后一个上界的两倍估计。
+  return kBucketBounds.back() * 2;
+}
+
+uint64_t LatencyHistogram::Count() const {
+  uint64_t total = 0;
+  for (const auto &bucket : buckets)
+    total += bucket.load(std::memory_order_relaxed);
+  return total;
+}
+
+void LatencyHistogram::Decay() {
+  for (auto &bucket : buckets)
+    bucket.fetch_sub(bucket.load(std::memory_order_relaxed) / 2,
+                     std::memory_order_relaxed);
+}
+
+std::string LatencyHistogram::Format() const {
+  std::string formatted;
+  for (std::size_t i = 0; i < kBucketCount; ++i) {
+    if (!formatted.empty())
+      formatted += ' ';
+    formatted += i < kBucketBounds.size()
+                     ? "le_" + std::to_string(kBucketBounds[i])
+                     : std::string("inf");
+    formatted += '=';
+    formatted += std::to_string(buckets[i].load(std::memory_order_relaxed));
+  }
+  return formatted;
+}
+
+void LinkHealth::ObserveHeartbeat(int64_t roundTripMilliseconds) {
+  Blend(heartbeatRttMs,
+        static_cast<double>(std::max<int64_t>(roundTripMilliseconds, 0)),
+        kHeartbeatAlpha);
+}
+
+void LinkHealth::ObserveCommand(int64_t latencyMilliseconds, bool failed) {
+  const int64_t latency = std::max<int64_t>(latencyMilliseconds, 0);
+  Blend(commandLatencyMs, static_cast<double>(latency), kCommandAlpha);
+  commandLatencyHistogram.Record(latency);
+  double current = errorRate.load(std::memory_order_relaxed);
+  const double sample = failed ? 1.0 : 0.0;
+  while (!errorRate.compare_exchange_weak(
+      current, current + kErrorAlpha * (sample - current),
+      std::memory_order_relaxed)) {
+  }
+}
+
+void LinkHealth::Decay() {
+  double current = errorRate.load(std::memory_order_relaxed);
+  while (!errorRate.compare_exchange_weak(current, current * kErrorDecay,
+                                          std::memory_order_relaxed)) {
+  }
+}
+
+double LinkHealth::HeartbeatRttMs() const {
+  return heartbeatRttMs.load(std::memory_order_relaxed);
+}
+
+double LinkHealth::CommandLatencyMs() const {
+  return commandLatencyMs.load(std::memory_order_relaxed);
+}
+
+double LinkHealth::LatencyMs() const {
+  return std::max(HeartbeatRttMs(), CommandLatencyMs());
+}
+
+double LinkHealth::ErrorRate() const {
+  return errorRate.load(std::memory_order_relaxed);
+}
+
+LatencyHistogram &LinkHealth::CommandLatencyHistogram() {
+  return commandLatencyHistogram;
+}
+
+const LatencyHistogram &LinkHealth::CommandLatencyHistogram() const {
+  return commandLatencyHistogram;
+}
+
+double LinkHealth::Cost(std::size_t inflight) const {
+  // 延迟不足 1ms 按 1ms 计，避免没有样本的新流代价为 0 吸走全部流量。
+  return static_cast<double>(inflight + 1) * std::max(LatencyMs(), 1.0) *
+         (1.0 + kErrorPenalty * ErrorRate());
+}
+
+}  // namespace wimi::connection
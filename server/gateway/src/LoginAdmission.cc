@@ -0,0 +1,254 @@
+#include "LoginAdmission.h"
+
+#include "GatewaySession.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include "Mysql.h"
+#include "Redis.h"
+#include "SessionRegistry.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace wimi::connection {
+namespace asio = boost::asio;
+namespace {
+
+class StorageLoginBackend final : public LoginBackend {
+ public:
+  explicit StorageLoginBackend(SessionRegistry &registry)
+      : registry(registry) {}
+
+  std::vector<bool> ValidateTokens(
+      const std::vector<std::pair<long, std::string>> &tokens) override {
+    return db::RedisDao::GetInstance()->validateChatAuthTokens(tokens);
+  }
+
+  bool LoadProfiles(const std::vector<long> &uids,
+                    std::vector<db::UserInfo::Ptr> &profiles) override {
+    return db::MysqlDao::GetInstance()->getUserInfos(uids, profiles);
+  }
+
+  bool InsertProfile(const db::UserInfo::Ptr &profile) override {
+    return db::MysqlDao::GetInstance()->insertUserInfo(profile) == 0;
+  }
+
+  std::vector<int64_t> BindSessions(
+      const std::vector<std::pair<int64_t, std::shared_ptr<GatewaySession>>>
+          &sessions) override {
+    return registry.BindAll(sessions);
+  }
+
+ private:
+  SessionRegistry &registry;
+};
+
+LoginResult Reject(int error, const std::string &message = {}) {
+  LoginResult result;
+  result.error = error;
+  result.response = MakeErrorPacket(error, message);
+  return result;
+}
+
+}  // namespace
+
+std::unique_ptr<LoginBackend> MakeStorageLoginBackend(
+    SessionRegistry &registry) {
+  return std::make_unique<StorageLoginBackend>(registry);
+}
+
+LoginAdmission::LoginAdmission(asio::io_context &ioContext,
+                               asio::thread_pool &businessPool,
+                               std::unique_ptr<LoginBackend> backend,
+                               Policy policy)
+    : businessPool(businessPool),
+      backend(std::move(backend)),
+      policy(policy),
+      timer(ioContext) {
+  this->policy.batchSize = std::max<std::size_t>(this->policy.batchSize, 1);
+  this->policy.maxInflightBatches =
+      std::max<std::size_t>(this->policy.maxInflightBatches, 1);
+}
+
+void LoginAdmission::Submit(TcpPacket request,
+                            std::shared_ptr<GatewaySession> session,
+                            Completion done) {
+  const auto now = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (queue.size() < policy.maxQueued) {
+      queue.push_back(
+          Login{std::move(request), std::move(session), std::move(done), now});
+      Metrics::Increment(Metric::GatewayLoginsQueued);
+      DispatchLocked(now);
+      return;
+    }
+  }
+  Metrics::Increment(Metric::GatewayLoginsRejected);
+  done(Reject(ErrorCodes::ResourceExhausted, "login queue is full"));
+}
+
+std::size_t LoginAdmission::Pending() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return queue.size();
+}
+
+std::size_t LoginAdmission::Inflight() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return inflight;
+}
+
+void LoginAdmission::DispatchLocked(std::chrono::steady_clock::time_point now) {
+  while (!queue.empty() && inflight < policy.maxInflightBatches &&
+         (queue.size() >= policy.batchSize ||
+          now >= queue.front().queuedAt + policy.window)) {
+    const std::size_t size = std::min(queue.size(), policy.batchSize);
+    auto batch = std::make_shared<std::vector<Login>>();
+    batch->reserve(size);
+    for (std::size_t i = 0; i < size; ++i) {
+      batch->push_back(std::move(queue.front()));
+      queue.pop_front();
+    }
+    ++inflight;
+    asio::post(businessPool, [this, batch]() {
+      Process(*batch);
+      std::lock_guard<std::mutex> lock(mutex);
+      --inflight;
+      DispatchLocked(std::chrono::steady_clock::now());
+    });
+  }
+  // 队列满额时由在途批次完成后接着派发；否则等最早一个登录到期。
+  if (queue.empty() || timerArmed || inflight >= policy.maxInflightBatches)
+    return;
+  timerArmed = true;
+  timer.expires_at(queue.front().queuedAt + policy.window);
+  timer.async_wait([this](const boost::system::error_code &error) {
+    std::lock_guard<std::mutex> lock(mutex);
+    timerArmed = false;
+    if (!error)
+      DispatchLocked(std::chrono::steady_clock::now());
+  });
+}
+
+void LoginAdmission::Process(std::vector<Login> &batch) {
+  const auto started = std::chrono::steady_clock::now();
+  uint64_t queuedMicros = 0;
+  for (const auto &login : batch)
+    queuedMicros += std::chrono::duration_cast<std::chrono::microseconds>(
+                        started - login.queuedAt)
+                        .count();
+  Metrics::Decrement(Metric::GatewayLoginsQueued, batch.size());
+  Metrics::Increment(Metric::GatewayLoginsAdmitted, batch.size());
+  Metrics::Increment(Metric::GatewayLoginQueueMicroseconds, queuedMicros);
+  Metrics::Increment(Metric::GatewayLoginBatches);
+
+  std::vector<LoginResult> results(batch.size());
+  std::vector<bool> pending(batch.size(), true);
+  auto fail = [&](std::size_t i, LoginResult result) {
+    results[i] = std::move(result);
+    pending[i] = false;
+  };
+
+  // 第一步：一次 MGET 校验全部凭证。
+  std::vector<std::pair<long, std::string>> tokens;
+  std::vector<std::size_t> tokenOwners;
+  for (std::size_t i = 0; i < batch.size(); ++i) {
+    const auto &request = batch[i].request;
+    if (request.uid() <= 0 || !request.has_auth_token()) {
+      fail(i, Reject(ErrorCodes::TokenInvalid,
+                     "invalid or expired connection token"));
+      continue;
+    }
+    tokens.emplace_back(request.uid(), request.auth_token());
+    tokenOwners.push_back(i);
+  }
+  const auto valid = backend->ValidateTokens(tokens);
+  for (std::size_t k = 0; k < tokenOwners.size(); ++k) {
+    if (valid.empty())
+      fail(tokenOwners[k], Reject(ErrorCodes::DependencyUnavailable,
+                                  "connection token store unavailable"));
+    else if (!valid[k])
+      fail(tokenOwners[k], Reject(ErrorCodes::TokenInvalid,
+                                  "invalid or expired connection token"));
+  }
+
+  // 第二步：首次登录先写入资料；写入失败说明资料可能已存在，与普通登录
+  // 一起用一次 WHERE uid IN 加载。
+  std::vector<db::UserInfo::Ptr> profiles(batch.size());
+  std::vector<long> loadUids;
+  std::vector<std::size_t> loadOwners;
+  for (std::size_t i = 0; i < batch.size(); ++i) {
+    if (!pending[i])
+      continue;
+    const auto &request = batch[i].request;
+    if (request.init()) {
+      auto initial = std::make_shared<db::UserInfo>(
+          request.uid(), request.name(), request.age(), request.sex(),
+          request.head_image_url());
+      if (backend->InsertProfile(initial)) {
+        profiles[i] = std::move(initial);
+        continue;
+      }
+    }
+    loadUids.push_back(request.uid());
+    loadOwners.push_back(i);
+  }
+  std::vector<db::UserInfo::Ptr> loaded;
+  const bool profilesLoaded =
+      loadUids.empty() || backend->LoadProfiles(loadUids, loaded);
+  for (std::size_t k = 0; k < loadOwners.size(); ++k) {
+    const std::size_t i = loadOwners[k];
+    if (!profilesLoaded)
+      fail(i, Reject(ErrorCodes::MysqlFailed));
+    else if (k >= loaded.size() || !loaded[k])
+      fail(i, batch[i].request.init()
+                  ? Reject(ErrorCodes::MysqlFailed)
+                  : Reject(ErrorCodes::NotFound, "user profile not found"));
+    else
+      profiles[i] = loaded[k];
+  }
+
+  // 第三步：一条 pipeline 发布 lease 并登记本地路由。
+  std::vector<std::pair<int64_t, std::shared_ptr<GatewaySession>>> bindings;
+  std::vector<std::size_t> bindOwners;
+  for (std::size_t i = 0; i < batch.size(); ++i) {
+    if (!pending[i])
+      continue;
+    bindings.emplace_back(batch[i].request.uid(), batch[i].session);
+    bindOwners.push_back(i);
+  }
+  const auto generations = bindings.empty()
+                               ? std::vector<int64_t>{}
+                               : backend->BindSessions(bindings);
+  for (std::size_t k = 0; k < bindOwners.size(); ++k) {
+    const std::size_t i = bindOwners[k];
+    const int64_t generation = k < generations.size() ? generations[k] : 0;
+    if (generation <= 0) {
+      fail(i, Reject(ErrorCodes::DependencyUnavailable,
+                     "failed to publish session lease"));
+      continue;
+    }
+    const auto &profile = profiles[i];
+    auto &result = results[i];
+    result.error = ErrorCodes::Success;
+    result.generation = generation;
+    result.response.set_uid(batch[i].request.uid());
+    result.response.set_name(profile->name);
+    result.response.set_age(profile->age);
+    result.response.set_sex(profile->sex);
+    result.response.set_head_image_url(profile->headImageURL);
+    result.response.set_error(ErrorCodes::Success);
+  }
+
+  LOG_DEBUG(businessLogger,
+            "Gateway login batch done, logins: {}, queued_us: {}, "
+            "elapsed_us: {}",
+            batch.size(), queuedMicros / batch.size(),
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - started)
+                .count());
+  for (std::size_t i = 0; i < batch.size(); ++i)
+    batch[i].done(std::move(results[i]));
+}
+
+}  // namespace wimi::connection
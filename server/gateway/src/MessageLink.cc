@@ -2,8 +2,13 @@
 
 #include "Configer.h"
 #include "Const.h"
+#include "GatewayFrameBatch.h"
 #include "GrpcSecurity.h"
+#include "LinkHealth.h"
 #include "Logger.h"
+#include "Metrics.h"
+#include "Rendezvous.h"
+#include "StreamCredit.h"
 #include "TcpMessageCodec.h"
 #include "gateway_message.grpc.pb.h"
 #include "state.grpc.pb.h"
@@ -17,6 +22,7 @@
 #include <grpcpp/create_channel.h>
 #include <grpcpp/security/credentials.h>
 #include <algorithm>
+#include <charconv>
 #include <chrono>
 #include <deque>
 #include <limits>
@@ -30,6 +36,33 @@ namespace {
 constexpr std::size_t kMaxStreamQueue = 4096;
 constexpr auto kReconnectBase = std::chrono::milliseconds(200);
 constexpr auto kReconnectMaximum = std::chrono::seconds(10);
+// 在途命令截止时间的扫描间隔；命令超时以秒计，10ms 的误差可以忽略。
+constexpr auto kPendingSweepInterval = std::chrono::milliseconds(10);
+// 节点降级判定：延迟超过各节点中位数的 3 倍且不低于 50ms，或失败率
+// 超过 20%。降级节点的 rendezvous 权重只保留健康节点的 1/4。
+constexpr double kDegradedLatencyRatio = 3.0;
+constexpr double kDegradedLatencyFloorMs = 50.0;
+constexpr double kDegradedErrorRate = 0.2;
+constexpr uint32_t kHealthyWeightScale = 4;
+// 降级状态的迟滞：判定结果连续 3 轮（约 15 秒）与当前状态不同才切换，
+// 切换后至少保持 60 轮（约 5 分钟）。每次切换都会让落在该节点上的会话
+// 改道一次，迟滞把这种迁移限制在每个节点每 5 分钟至多一次。
+constexpr uint32_t kPenaltyConfirmRounds = 3;
+constexpr uint64_t kPenaltyHoldRounds = 60;
+// 本机套接字连续失败这么多次后退回 TCP，直到一次注册成功清零计数。
+constexpr unsigned int kLocalTransportAttempts = 3;
+// 拓扑循环每 5 秒一轮，每 12 轮（约一分钟）输出一次命令延迟直方图。
+constexpr uint64_t kHistogramLogRounds = 12;
+
+// 每个进程一个随机纪元。热重启的新进程沿用 instanceId，Message 据此把
+// 它的流与仍在交接、还欠着命令结果的旧进程区分开。
+uint64_t ProcessEpoch() {
+  static const uint64_t epoch = [] {
+    std::random_device device;
+    return (static_cast<uint64_t>(device()) << 32 | device()) | 1;
+  }();
+  return epoch;
+}
 
 int64_t NowUnixMilliseconds() {
   return std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -52,29 +85,91 @@ bool CanRetryOnAnotherMessageNode(uint32_t serviceId) {
   }
 }
 
+// 只读拉取可以同时在两个节点执行，慢的一方结果直接丢弃；发送、ACK
+// 虽可在失败后换节点重试，但不参与对冲。
+bool IsIdempotentPull(uint32_t serviceId) {
+  switch (serviceId) {
+    case ID_PULL_FRIEND_LIST_REQ:
+    case ID_PULL_FRIEND_APPLY_LIST_REQ:
+    case ID_PULL_SESSION_MESSAGE_LIST_REQ:
+    case ID_PULL_MESSAGE_LIST_REQ:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// v4 起结果按 request_seq 配对，request_id 只保留客户端自带的 ID 供追踪；
+// 旧 Message 节点只回显 request_id，就把序号按十进制写进去。
+void StampRequestSeq(gateway::CommandEnvelope &command, uint64_t requestSeq,
+                     uint32_t protocolVersion) {
+  command.set_request_seq(requestSeq);
+  if (protocolVersion < kGatewayStreamRequestSeqProtocolVersion)
+    command.set_request_id(std::to_string(requestSeq));
+}
+
+std::string StreamLinkId(const std::string &nodeId, uint32_t streamIndex) {
+  return nodeId + "#" + std::to_string(streamIndex);
+}
+
+uint64_t ResultRequestSeq(const gateway::CommandResult &result) {
+  if (result.request_seq() != 0)
+    return result.request_seq();
+  uint64_t requestSeq = 0;
+  const auto &id = result.request_id();
+  std::from_chars(id.data(), id.data() + id.size(), requestSeq);
+  return requestSeq;
+}
+
+gateway::CommandResult MakeFailedResult(const gateway::CommandEnvelope &command,
+                                        int error, const char *message) {
+  gateway::CommandResult result;
+  result.set_request_id(command.request_id());
+  result.set_request_seq(command.request_seq());
+  result.set_response_service_id(
+      __getServiceResponseId(ServiceID(command.service_id())));
+  result.set_error(error);
+  result.set_retryable(true);
+  result.set_packet(SerializeTcpPacket(MakeErrorPacket(error, message)));
+  return result;
+}
+
 }  // namespace
 
 class MessageLink final
     : public grpc::ClientBidiReactor<gateway::GatewayToMessageFrame,
                                      gateway::MessageToGatewayFrame> {
  public:
-  MessageLink(MessageLinkManager::Node node, std::string gatewayId,
-              std::string instanceId, MessageLinkManager &manager)
+  MessageLink(MessageLinkManager::Node node, uint32_t streamIndex,
+              bool local, std::string gatewayId, std::string instanceId,
+              MessageLinkManager &manager)
       : node(std::move(node)),
+        streamIndex(streamIndex),
+        id(StreamLinkId(this->node.id, streamIndex)),
+        endpoint(local ? "unix:" + this->node.localSocket
+                       : this->node.host + ":" +
+                             std::to_string(this->node.port)),
         gatewayId(std::move(gatewayId)),
         instanceId(std::move(instanceId)),
         manager(manager) {
-    auto channel = grpc::CreateChannel(
-        this->node.host + ":" + std::to_string(this->node.port),
-        manager.messageCredentials);
+    // 通道参数不同的 channel 不共享子通道：channel 序号相同的流复用一条
+    // HTTP/2 连接，不同序号各自建连。
+    grpc::ChannelArguments arguments;
+    arguments.SetInt("wimi.message_channel_index",
+                     static_cast<int>(streamIndex % manager.channelsPerNode));
+    // Unix 域套接字没有主机名，TLS 仍按节点地址校验证书。
+    if (local)
+      arguments.SetSslTargetNameOverride(this->node.host);
+    auto channel = grpc::CreateCustomChannel(
+        endpoint, manager.messageCredentials, arguments);
     stub = gateway::GatewayMessageTransport::NewStub(channel);
   }
 
   void Start() {
     LOG_INFO(netLogger,
-             "Opening Gateway-Message stream, node: {}, endpoint: {}:{}, "
+             "Opening Gateway-Message stream, link: {}, endpoint: {}, "
              "gateway_id: {}, instance_id: {}",
-             node.id, node.host, node.port, gatewayId, instanceId);
+             id, endpoint, gatewayId, instanceId);
     stub->async()->Connect(&context, this);
     AddHold();
     externalHold.store(true, std::memory_order_release);
@@ -82,12 +177,15 @@ class MessageLink final
 
     gateway::GatewayToMessageFrame frame;
     auto *registration = frame.mutable_register_gateway();
-    registration->set_protocol_version(1);
+    registration->set_protocol_version(kGatewayStreamProtocolVersion);
     registration->set_gateway_id(gatewayId);
     registration->set_instance_id(instanceId);
     registration->set_stream_epoch(
         static_cast<uint64_t>(NowUnixMilliseconds()));
     registration->set_capacity(kMaxStreamQueue);
+    registration->set_stream_index(streamIndex);
+    registration->set_stream_count(manager.streamsPerNode);
+    registration->set_process_epoch(ProcessEpoch());
     Enqueue(std::move(frame));
     StartCall();
   }
@@ -95,22 +193,34 @@ class MessageLink final
   void Stop() {
     if (stopped.exchange(true))
       return;
-    healthy.store(false, std::memory_order_release);
+    SetHealthy(false);
     context.TryCancel();
     ReleaseHold();
   }
 
+  // 命令帧受 Message 授予的信用约束：信用耗尽时停放在本流，收到
+  // CreditGrant 后按序放行；停放也满才返回 false。CreditGrant 不受队列
+  // 上限约束：它已从 deliveryReturn 中取出，丢掉就永久少了这部分投递信用，
+  // Message 端会一直停放投递。
   bool Enqueue(gateway::GatewayToMessageFrame frame) {
     bool startWrite = false;
     {
       std::lock_guard<std::mutex> lock(writeMutex);
-      if (stopped || writeQueue.size() >= kMaxStreamQueue)
+      if (stopped || (writeQueue.size() >= kMaxStreamQueue &&
+                      !frame.has_credit_grant()))
         return false;
+      if (frame.has_command()) {
+        using Admission = decltype(commandCredits)::Admission;
+        const auto admission = commandCredits.Admit(frame);
+        if (admission == Admission::Rejected)
+          return false;
+        if (admission == Admission::Parked)
+          return true;
+      }
       writeQueue.push_back(std::move(frame));
       if (!writeInFlight) {
         writeInFlight = true;
-        writeFrame = std::move(writeQueue.front());
-        writeQueue.pop_front();
+        writeFrames = TakeNextStreamFrame(writeQueue, writeFrame, batching);
         startWrite = true;
       }
     }
@@ -147,12 +257,21 @@ class MessageLink final
     }
   }
 
+  // 流标识 "<节点 ID>#<流序号>"。
   const std::string &Id() const {
+    return id;
+  }
+
+  const std::string &NodeId() const {
     return node.id;
   }
 
+  uint32_t StreamIndex() const {
+    return streamIndex;
+  }
+
   void Drain() {
-    healthy.store(false, std::memory_order_release);
+    SetHealthy(false);
     Stop();
   }
 
@@ -160,21 +279,51 @@ class MessageLink final
     return lastReadAt.load(std::memory_order_relaxed);
   }
 
+  uint32_t ProtocolVersion() const {
+    return protocolVersion.load(std::memory_order_acquire);
+  }
+
+  LinkHealth &Health() {
+    return health;
+  }
+
   void OnReadDone(bool ok) override {
     if (!ok) {
       LOG_WARN(netLogger,
-               "Gateway-Message read side closed, node: {}, gateway_id: {}",
-               node.id, gatewayId);
+               "Gateway-Message read side closed, link: {}, gateway_id: {}",
+               id, gatewayId);
       stopped.store(true, std::memory_order_release);
-      healthy.store(false, std::memory_order_release);
+      SetHealthy(false);
       ReleaseHold();
       return;
     }
     lastReadAt.store(NowUnixMilliseconds(), std::memory_order_relaxed);
-    if (readFrame.has_register_result())
-      healthy.store(readFrame.register_result().accepted(),
-                    std::memory_order_release);
-    manager.OnFrame(node.id, readFrame);
+    if (readFrame.has_register_result()) {
+      // 旧 Message 节点不回填协商版本，按 v1 处理，继续逐帧发送。
+      const uint32_t negotiated =
+          readFrame.register_result().accepted()
+              ? std::max(readFrame.register_result().protocol_version(), 1U)
+              : 1U;
+      protocolVersion.store(negotiated, std::memory_order_release);
+      {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        batching = negotiated >= kGatewayStreamBatchProtocolVersion;
+        // 信用窗口在流进入 healthy 之前打开，第一条命令就受约束。
+        if (negotiated >= kGatewayStreamCreditProtocolVersion &&
+            readFrame.register_result().capacity() > 0)
+          commandCredits.Enable(readFrame.register_result().capacity());
+      }
+      SetHealthy(readFrame.register_result().accepted());
+    }
+    if (readFrame.has_heartbeat_ack())
+      health.ObserveHeartbeat(NowUnixMilliseconds() -
+                              readFrame.heartbeat_ack().sent_at_unix_ms());
+    if (readFrame.has_credit_grant()) {
+      GrantCommandCredits(readFrame.credit_grant().credits());
+    } else {
+      manager.OnFrame(id, readFrame);
+      ReturnDeliveryCredits(readFrame);
+    }
     readFrame.Clear();
     StartRead(&readFrame);
   }
@@ -182,19 +331,21 @@ class MessageLink final
   void OnWriteDone(bool ok) override {
     if (!ok) {
       LOG_WARN(netLogger,
-               "Gateway-Message write side closed, node: {}, gateway_id: {}",
-               node.id, gatewayId);
+               "Gateway-Message write side closed, link: {}, gateway_id: {}",
+               id, gatewayId);
       stopped.store(true, std::memory_order_release);
-      healthy.store(false, std::memory_order_release);
+      SetHealthy(false);
       ReleaseHold();
       return;
     }
+    Metrics::Increment(Metric::GatewayStreamWrites);
+    Metrics::Increment(Metric::GatewayStreamFramesWritten, writeFrames);
+    // 上一次写在途期间入队的同类帧在这里合并成一个批量帧。
     bool startWrite = false;
     {
       std::lock_guard<std::mutex> lock(writeMutex);
       if (!writeQueue.empty()) {
-        writeFrame = std::move(writeQueue.front());
-        writeQueue.pop_front();
+        writeFrames = TakeNextStreamFrame(writeQueue, writeFrame, batching);
         startWrite = true;
       } else {
         writeInFlight = false;
@@ -206,16 +357,70 @@ class MessageLink final
 
   void OnDone(const grpc::Status &status) override {
     stopped.store(true, std::memory_order_release);
-    healthy.store(false, std::memory_order_release);
-    LOG_WARN(netLogger, "Gateway-Message stream closed, node: {}, status: {}",
-             node.id, status.error_message());
+    SetHealthy(false);
+    // 停放的命令仍在 pending 表中，随后由 RetryPending 换流重试或到期失败。
+    std::size_t dropped = 0;
+    {
+      std::lock_guard<std::mutex> lock(writeMutex);
+      dropped = commandCredits.Close();
+    }
+    LOG_WARN(netLogger,
+             "Gateway-Message stream closed, link: {}, status: {}, "
+             "commands parked for credit: {}",
+             id, status.error_message(), dropped);
 
     // 当 gRPC 流最终 OnDone，manager 会在 OnLinkDone 中移除旧 link、
     // 尝试重试 pending 命令，并用指数退避加 jitter 重连
-    manager.OnLinkDone(node.id, this);
+    manager.OnLinkDone(id, this);
   }
 
  private:
+  // 健康状态翻转时通知 manager 重建选路表。
+  void SetHealthy(bool value) {
+    if (healthy.exchange(value, std::memory_order_acq_rel) != value)
+      manager.ScheduleRouteRebuild();
+  }
+
+  void GrantCommandCredits(uint32_t credits) {
+    bool startWrite = false;
+    {
+      std::lock_guard<std::mutex> lock(writeMutex);
+      if (stopped)
+        return;
+      commandCredits.Grant(
+          credits, [this](gateway::GatewayToMessageFrame frame) {
+            writeQueue.push_back(std::move(frame));
+          });
+      if (!writeInFlight && !writeQueue.empty()) {
+        writeInFlight = true;
+        writeFrames = TakeNextStreamFrame(writeQueue, writeFrame, batching);
+        startWrite = true;
+      }
+    }
+    if (startWrite)
+      StartWrite(&writeFrame);
+  }
+
+  // 投递在 OnFrame 中同步交给本地会话，返回后即可归还信用；按容量的
+  // 四分之一攒批回送，避免每条投递一个 CreditGrant。
+  void ReturnDeliveryCredits(const gateway::MessageToGatewayFrame &frame) {
+    if (ProtocolVersion() < kGatewayStreamCreditProtocolVersion)
+      return;
+    uint32_t consumed = 0;
+    if (frame.has_delivery() || frame.has_multicast_delivery())
+      consumed = 1;
+    else if (frame.has_delivery_batch())
+      consumed = frame.delivery_batch().deliveries_size();
+    if (consumed == 0)
+      return;
+    const uint32_t credits = deliveryReturn.Consume(consumed);
+    if (credits == 0)
+      return;
+    gateway::GatewayToMessageFrame grant;
+    grant.mutable_credit_grant()->set_credits(credits);
+    Enqueue(std::move(grant));
+  }
+
   void ReleaseHold() {
     bool expected = true;
     if (externalHold.compare_exchange_strong(expected, false,
@@ -224,6 +429,9 @@ class MessageLink final
   }
 
   MessageLinkManager::Node node;
+  const uint32_t streamIndex;
+  const std::string id;
+  const std::string endpoint;
   std::string gatewayId;
   std::string instanceId;
   MessageLinkManager &manager;
@@ -233,22 +441,37 @@ class MessageLink final
   gateway::GatewayToMessageFrame writeFrame;
   std::mutex writeMutex;
   std::deque<gateway::GatewayToMessageFrame> writeQueue;
+  std::size_t writeFrames{0};
   bool writeInFlight{false};
+  // 注册结果协商出 v2 后才发送批量帧。
+  bool batching{false};
+  // v5：Message 授予的命令信用，写锁内使用。
+  StreamCreditWindow<gateway::GatewayToMessageFrame> commandCredits{
+      kMaxStreamQueue, Metric::GatewayStreamCommandCredits};
+  StreamCreditReturn deliveryReturn{kMaxStreamQueue};
   std::atomic<bool> externalHold{false};
   std::atomic<bool> stopped{false};
   std::atomic<bool> healthy{false};
   std::atomic<std::size_t> inflight{0};
+  std::atomic<uint32_t> protocolVersion{1};
   std::atomic<int64_t> lastReadAt{NowUnixMilliseconds()};
+  LinkHealth health;
 };
 
 MessageLinkManager::MessageLinkManager(asio::io_context &ioContext,
                                        asio::thread_pool &controlPool,
                                        std::string gatewayId,
-                                       std::string instanceId)
+                                       std::string instanceId,
+                                       std::size_t streamsPerNode,
+                                       std::size_t channelsPerNode)
     : ioContext(ioContext),
       controlPool(controlPool),
       gatewayId(std::move(gatewayId)),
-      instanceId(std::move(instanceId)) {
+      instanceId(std::move(instanceId)),
+      streamsPerNode(static_cast<uint32_t>(
+          std::clamp<std::size_t>(streamsPerNode, 1, 64))),
+      channelsPerNode(static_cast<uint32_t>(std::clamp<std::size_t>(
+          channelsPerNode, 1, this->streamsPerNode))) {
   auto config = Configer::getNode("server");
   messageCredentials = BuildChannelCredentials(LoadGrpcSecurityConfig(config));
   if (config["stateRPC"]) {
@@ -268,11 +491,13 @@ void MessageLinkManager::Start() {
   initial.nodes = LoadConfiguredNodes();
   ApplyTopology(initial);
   asio::co_spawn(ioContext, TopologyLoop(), asio::detached);
+  asio::co_spawn(ioContext, DeadlineLoop(), asio::detached);
 }
 
 void MessageLinkManager::Stop() {
   if (stopping.exchange(true))
     return;
+  routingTable.store(nullptr, std::memory_order_release);
   std::vector<std::shared_ptr<MessageLink>> current;
   {
     std::lock_guard<std::mutex> lock(linksMutex);
@@ -282,30 +507,18 @@ void MessageLinkManager::Stop() {
   for (auto &link : current)
     link->Stop();
 
-  std::vector<PendingCommand> abandoned;
-  {
-    std::lock_guard<std::mutex> lock(pendingMutex);
-    for (auto &[_, command] : pending)
-      abandoned.push_back(std::move(command));
-    pending.clear();
-  }
-  for (auto &command : abandoned) {
-    if (command.deadlineTimer)
-      command.deadlineTimer->cancel();
-    if (!command.callback)
-      continue;
-    gateway::CommandResult result;
-    result.set_request_id(command.command.request_id());
-    result.set_response_service_id(
-        __getServiceResponseId(ServiceID(command.command.service_id())));
-    result.set_error(ErrorCodes::DependencyUnavailable);
-    result.set_retryable(true);
-    result.set_packet(SerializeTcpPacket(MakeErrorPacket(
-        ErrorCodes::DependencyUnavailable, "message links are stopping")));
-    command.callback(result);
+  for (auto &command : pending.TakeAll()) {
+    if (command.callback)
+      command.callback(MakeFailedResult(command.command,
+                                        ErrorCodes::DependencyUnavailable,
+                                        "message links are stopping"));
   }
 }
 
+bool MessageLinkManager::Stopping() const {
+  return stopping.load(std::memory_order_acquire);
+}
+
 bool MessageLinkManager::Ready() const {
   return HealthyLinkCount() > 0;
 }
@@ -318,8 +531,6 @@ std::size_t MessageLinkManager::HealthyLinkCount() const {
 
 bool MessageLinkManager::Forward(gateway::CommandEnvelope command,
                                  CommandCallback callback) {
-  if (command.request_id().empty())
-    return false;
   const int64_t now = NowUnixMilliseconds();
   if (command.deadline_unix_ms() <= now)
     return false;
@@ -327,50 +538,31 @@ bool MessageLinkManager::Forward(gateway::CommandEnvelope command,
   if (!link)
     return false;
 
-  const std::string requestId = command.request_id();
-  auto deadlineTimer = std::make_shared<asio::steady_timer>(ioContext);
-  deadlineTimer->expires_after(
-      std::chrono::milliseconds(command.deadline_unix_ms() - now));
-  {
-    std::lock_guard<std::mutex> lock(pendingMutex);
-    if (pending.contains(requestId))
-      return false;
-    pending.emplace(requestId, PendingCommand{command, std::move(callback),
-                                              link->Id(), 0, deadlineTimer});
-  }
-  deadlineTimer->async_wait(
-      [this, requestId](const boost::system::error_code &error) {
-        if (!error)
-          ExpirePending(requestId);
-      });
-
+  const uint64_t requestSeq = pending.NextSequence();
+  StampRequestSeq(command, requestSeq, link->ProtocolVersion());
+  // 对冲时刻按命令写入前的延迟分布计算。
+  const bool hedge = IsIdempotentPull(command.service_id());
+  const int64_t hedgeDelay =
+      hedge ? hedges.DelayFor(link->Health().CommandLatencyHistogram()) : 0;
+  const int64_t deadline = command.deadline_unix_ms();
   gateway::GatewayToMessageFrame frame;
-  *frame.mutable_command() = std::move(command);
+  *frame.mutable_command() = command;
+  pending.Insert(requestSeq,
+                 PendingCommandTable::Entry{std::move(command),
+                                            std::move(callback), link->Id(), 0,
+                                            now});
   if (!link->Enqueue(std::move(frame))) {
-    PendingCommand rejected;
-    {
-      std::lock_guard<std::mutex> lock(pendingMutex);
-      auto found = pending.find(requestId);
-      if (found != pending.end()) {
-        rejected = std::move(found->second);
-        pending.erase(found);
-      }
-    }
-    deadlineTimer->cancel();
-    if (rejected.callback) {
-      gateway::CommandResult result;
-      result.set_request_id(requestId);
-      result.set_response_service_id(
-          __getServiceResponseId(ServiceID(rejected.command.service_id())));
-      result.set_error(ErrorCodes::ResourceExhausted);
-      result.set_retryable(true);
-      result.set_packet(SerializeTcpPacket(MakeErrorPacket(
-          ErrorCodes::ResourceExhausted, "message stream queue is full")));
-      rejected.callback(result);
-    }
+    auto rejected = pending.Take(requestSeq);
+    if (rejected && rejected->callback)
+      rejected->callback(MakeFailedResult(rejected->command,
+                                          ErrorCodes::ResourceExhausted,
+                                          "message stream queue is full"));
     return true;
   }
   link->IncrementInflight();
+  hedges.Accrue();
+  if (hedgeDelay > 0 && now + hedgeDelay < deadline)
+    hedges.Schedule(requestSeq, now + hedgeDelay);
   return true;
 }
 
@@ -378,9 +570,22 @@ void MessageLinkManager::SetDeliveryHandler(DeliveryHandler handler) {
   deliveryHandler = std::move(handler);
 }
 
+void MessageLinkManager::SetMulticastHandler(MulticastHandler handler) {
+  multicastHandler = std::move(handler);
+}
+
+void MessageLinkManager::SetHedgePolicy(HedgeScheduler::Policy policy) {
+  hedges.SetPolicy(policy);
+}
+
+void MessageLinkManager::SetLocalHostId(std::string hostId) {
+  localHostId = std::move(hostId);
+}
+
 asio::awaitable<void> MessageLinkManager::TopologyLoop() {
   asio::steady_timer timer(ioContext);
   uint64_t heartbeatSequence = 0;
+  uint64_t round = 0;
 
   // 如果配置了 stateRPC，循环会定期调用 StateService 拉最新 message
   // 节点拓扑；否则就使用本地配置。
@@ -413,6 +618,7 @@ asio::awaitable<void> MessageLinkManager::TopologyLoop() {
       if (now - link->LastReadAt() > 30000)
         link->Stop();
     }
+    RefreshLinkHealth(++round % kHistogramLogRounds == 0);
 
     timer.expires_after(std::chrono::seconds(5));
     boost::system::error_code ec;
@@ -422,6 +628,21 @@ asio::awaitable<void> MessageLinkManager::TopologyLoop() {
   }
 }
 
+// 所有在途命令共用这一个定时器：每轮扫描各分片的截止时间堆，
+// 到期命令以 DeadlineExceeded 完成；对冲副本也在这里按时发出。
+asio::awaitable<void> MessageLinkManager::DeadlineLoop() {
+  asio::steady_timer timer(ioContext);
+  while (!stopping.load(std::memory_order_acquire)) {
+    timer.expires_after(kPendingSweepInterval);
+    boost::system::error_code ec;
+    co_await timer.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+    if (ec == asio::error::operation_aborted)
+      break;
+    ExpirePending();
+    FireHedges();
+  }
+}
+
 MessageLinkManager::TopologySnapshot MessageLinkManager::FetchTopology() {
   TopologySnapshot snapshot;
   if (stateAddress.empty())
@@ -447,7 +668,9 @@ MessageLinkManager::TopologySnapshot MessageLinkManager::FetchTopology() {
         source.port() <= 0)
       continue;
     snapshot.nodes.push_back(Node{source.node_id(), source.host(),
-                                  static_cast<unsigned short>(source.port())});
+                                  static_cast<unsigned short>(source.port()),
+                                  std::max(source.weight(), 1U),
+                                  source.local_socket(), source.host_id()});
   }
   return snapshot;
 }
@@ -464,9 +687,13 @@ std::vector<MessageLinkManager::Node> MessageLinkManager::LoadConfiguredNodes()
     auto source = message["m" + std::to_string(i)];
     if (!source)
       continue;
-    nodes.push_back(Node{source["name"].as<std::string>(),
-                         source["host"].as<std::string>(),
-                         source["streamPort"].as<unsigned short>()});
+    const uint32_t weight =
+        source["weight"] ? source["weight"].as<uint32_t>() : 1;
+    nodes.push_back(Node{
+        source["name"].as<std::string>(), source["host"].as<std::string>(),
+        source["streamPort"].as<unsigned short>(), std::max(weight, 1U),
+        source["localSocket"] ? source["localSocket"].as<std::string>() : "",
+        source["hostId"] ? source["hostId"].as<std::string>() : ""});
   }
   return nodes;
 }
@@ -483,12 +710,15 @@ void MessageLinkManager::ApplyTopology(const TopologySnapshot &snapshot) {
   {
     std::lock_guard<std::mutex> lock(linksMutex);
     for (auto current = links.begin(); current != links.end();) {
-      const auto wanted = desired.find(current->first);
-      const auto configured = configuredNodes.find(current->first);
+      const auto &nodeId = current->second->NodeId();
+      const auto wanted = desired.find(nodeId);
+      const auto configured = configuredNodes.find(nodeId);
       const bool endpointChanged =
           wanted != desired.end() && configured != configuredNodes.end() &&
           (wanted->second.host != configured->second.host ||
-           wanted->second.port != configured->second.port);
+           wanted->second.port != configured->second.port ||
+           wanted->second.localSocket != configured->second.localSocket ||
+           wanted->second.hostId != configured->second.hostId);
       if (wanted == desired.end() || endpointChanged) {
         removed.push_back(current->second);
         RetireLink(current->second);
@@ -502,74 +732,78 @@ void MessageLinkManager::ApplyTopology(const TopologySnapshot &snapshot) {
   }
   for (auto &link : removed)
     link->Stop();
+  // 权重变化不会触发任何健康翻转，拓扑应用后总是重建一次。
+  ScheduleRouteRebuild();
 
   for (const auto &node : snapshot.nodes) {
-    bool start = false;
-    {
-      std::lock_guard<std::mutex> lock(linksMutex);
-      start = !links.contains(node.id);
+    for (uint32_t streamIndex = 0; streamIndex < streamsPerNode;
+         ++streamIndex) {
+      bool start = false;
+      {
+        std::lock_guard<std::mutex> lock(linksMutex);
+        start = !links.contains(StreamLinkId(node.id, streamIndex));
+      }
+      if (start)
+        StartLink(node, streamIndex);
     }
-    if (start)
-      StartLink(node);
   }
 }
 
-void MessageLinkManager::StartLink(const Node &node) {
-  auto link = std::make_shared<MessageLink>(node, gatewayId, instanceId, *this);
+bool MessageLinkManager::IsLocal(const Node &node) const {
+  return !localHostId.empty() && !node.localSocket.empty() &&
+         node.hostId == localHostId;
+}
+
+void MessageLinkManager::StartLink(const Node &node, uint32_t streamIndex) {
+  // 本机套接字不可用（路径错误、权限、Message 未监听）时连续重连会失败，
+  // 超过次数后改走 TCP，不让本机优化影响可用性。
+  bool local = IsLocal(node);
+  if (local) {
+    std::lock_guard<std::mutex> lock(linksMutex);
+    const auto attempts =
+        reconnectAttempts.find(StreamLinkId(node.id, streamIndex));
+    local = attempts == reconnectAttempts.end() ||
+            attempts->second < kLocalTransportAttempts;
+  }
+  auto link = std::make_shared<MessageLink>(node, streamIndex, local,
+                                            gatewayId, instanceId, *this);
   {
     std::lock_guard<std::mutex> lock(linksMutex);
-    auto found = links.find(node.id);
+    auto found = links.find(link->Id());
     if (found != links.end()) {
       auto old = found->second;
       RetireLink(old);
       old->Stop();
     }
-    links[node.id] = link;
+    links[link->Id()] = link;
   }
   link->Start();
 }
 
-void MessageLinkManager::OnFrame(const std::string &nodeId,
+void MessageLinkManager::OnFrame(const std::string &linkId,
                                  const gateway::MessageToGatewayFrame &frame) {
-  // CommandResult 通过 request_id 与在途命令配对，只完成一次回调并取消
-  // deadline。
+  // v2 批量帧逐条走单帧路径；批内每条投递各自生成 ACK，由写端在上一次
+  // 写完成后合并成 DeliveryAckBatch。
   if (frame.has_command_result()) {
-    PendingCommand command;
-    bool found = false;
-    {
-      std::lock_guard<std::mutex> lock(pendingMutex);
-      auto pendingIt = pending.find(frame.command_result().request_id());
-      if (pendingIt != pending.end()) {
-        command = std::move(pendingIt->second);
-        pending.erase(pendingIt);
-        found = true;
-      }
-    }
-    if (found && command.deadlineTimer)
-      command.deadlineTimer->cancel();
-    {
-      std::lock_guard<std::mutex> lock(linksMutex);
-      auto link = links.find(nodeId);
-      if (link != links.end())
-        link->second->DecrementInflight();
-    }
-    if (found && command.callback) {
-      LOG_DEBUG(businessLogger,
-                "Gateway received Message command result, node: {}, "
-                "request_id: {}, response_service_id: {}, error: {}, "
-                "retryable: {}",
-                nodeId, frame.command_result().request_id(),
-                frame.command_result().response_service_id(),
-                frame.command_result().error(),
-                frame.command_result().retryable());
-      command.callback(frame.command_result());
-    } else {
-      LOG_WARN(businessLogger,
-               "Gateway ignored unmatched Message command result, node: {}, "
-               "request_id: {}, response_service_id: {}",
-               nodeId, frame.command_result().request_id(),
-               frame.command_result().response_service_id());
-    }
+    OnCommandResult(linkId, frame.command_result());
+    return;
+  }
+  if (frame.has_command_result_batch()) {
+    for (const auto &result : frame.command_result_batch().results())
+      OnCommandResult(linkId, result);
+    return;
+  }
+  if (frame.has_delivery()) {
+    OnDelivery(linkId, frame.delivery());
+    return;
+  }
+  if (frame.has_delivery_batch()) {
+    for (const auto &delivery : frame.delivery_batch().deliveries())
+      OnDelivery(linkId, delivery);
+    return;
+  }
+  if (frame.has_multicast_delivery()) {
+    OnMulticastDelivery(linkId, frame.multicast_delivery());
     return;
   }
 
@@ -579,18 +813,19 @@ void MessageLinkManager::OnFrame(const std::string &nodeId,
     if (frame.register_result().accepted()) {
       {
         std::lock_guard<std::mutex> lock(linksMutex);
-        reconnectAttempts[nodeId] = 0;
+        reconnectAttempts[linkId] = 0;
       }
       LOG_INFO(netLogger,
-               "Gateway-Message registration accepted, node: {}, "
-               "message_node_id: {}, stream_epoch: {}",
-               nodeId, frame.register_result().message_node_id(),
-               frame.register_result().stream_epoch());
+               "Gateway-Message registration accepted, link: {}, "
+               "message_node_id: {}, stream_epoch: {}, protocol_version: {}",
+               linkId, frame.register_result().message_node_id(),
+               frame.register_result().stream_epoch(),
+               std::max(frame.register_result().protocol_version(), 1U));
     } else {
       LOG_ERROR(netLogger,
-                "Gateway-Message registration rejected, node: {}, "
+                "Gateway-Message registration rejected, link: {}, "
                 "message_node_id: {}, stream_epoch: {}, reason: {}",
-                nodeId, frame.register_result().message_node_id(),
+                linkId, frame.register_result().message_node_id(),
                 frame.register_result().stream_epoch(),
                 frame.register_result().reason());
     }
@@ -601,9 +836,9 @@ void MessageLinkManager::OnFrame(const std::string &nodeId,
   if (frame.has_heartbeat_ack()) {
     LOG_TRACE(
         netLogger,
-        "Gateway received Message heartbeat ACK, node: {}, sequence: {}, "
+        "Gateway received Message heartbeat ACK, link: {}, sequence: {}, "
         "round_trip_ms: {}",
-        nodeId, frame.heartbeat_ack().sequence(),
+        linkId, frame.heartbeat_ack().sequence(),
         std::max<int64_t>(0, NowUnixMilliseconds() -
                                  frame.heartbeat_ack().sent_at_unix_ms()));
     return;
@@ -612,14 +847,14 @@ void MessageLinkManager::OnFrame(const std::string &nodeId,
   // DrainNotice 立即把节点移出健康集合，禁止新命令继续路由到正在下线的流。
   if (frame.has_drain_notice()) {
     LOG_WARN(netLogger,
-             "Gateway received Message drain notice, node: {}, "
+             "Gateway received Message drain notice, link: {}, "
              "message_node_id: {}, reason: {}",
-             nodeId, frame.drain_notice().message_node_id(),
+             linkId, frame.drain_notice().message_node_id(),
              frame.drain_notice().reason());
     std::shared_ptr<MessageLink> link;
     {
       std::lock_guard<std::mutex> lock(linksMutex);
-      auto found = links.find(nodeId);
+      auto found = links.find(linkId);
       if (found != links.end())
         link = found->second;
     }
@@ -628,90 +863,171 @@ void MessageLinkManager::OnFrame(const std::string &nodeId,
     return;
   }
 
-  // Delivery 先交给本地 SessionRegistry 做 generation 校验和物理推送，再沿原流
-  // 返回 DeliveryAck；业务消息已持久化，因此离线/背压不会回滚 ACCEPTED。
-  if (frame.has_delivery()) {
+  // oneof 理论上只会命中上述分支；空 frame 作为协议异常保留可观测性。
+  LOG_WARN(netLogger, "Gateway received empty Message frame, link: {}", linkId);
+}
+
+// CommandResult 按 request_seq 在 PendingCommandTable 中找到在途命令（旧
+// Message 节点回显在 request_id 里的序号同样认），只完成一次回调并取消
+// deadline。
+void MessageLinkManager::OnCommandResult(
+    const std::string &linkId, const gateway::CommandResult &result) {
+  const uint64_t requestSeq = ResultRequestSeq(result);
+  auto command = pending.Take(requestSeq);
+  if (command && !command->hedgeLinkId.empty())
+    CancelHedgeLoser(requestSeq, *command, linkId);
+  if (auto link = FindLink(linkId)) {
+    link->DecrementInflight();
+    // 可重试错误多为超时、限流、依赖不可用，计入失败率；业务错误不计。
+    if (command)
+      link->Health().ObserveCommand(
+          NowUnixMilliseconds() - command->sentAtUnixMs,
+          result.error() != 0 && result.retryable());
+  }
+  if (command && command->callback) {
     LOG_DEBUG(businessLogger,
-              "Gateway handling Message delivery, node: {}, delivery_id: {}, "
-              "recipient_uid: {}, message_id: {}, conversation_id: {}, "
-              "conversation_seq: {}",
-              nodeId, frame.delivery().delivery_id(),
-              frame.delivery().recipient_uid(), frame.delivery().message_id(),
-              frame.delivery().conversation_id(),
-              frame.delivery().conversation_seq());
-    gateway::DeliveryStatus status = gateway::DELIVERY_STATUS_OFFLINE;
-    if (deliveryHandler) {
-      status = deliveryHandler(frame.delivery());
-    } else {
-      LOG_ERROR(businessLogger,
-                "Gateway delivery handler is not installed, node: {}, "
-                "delivery_id: {}",
-                nodeId, frame.delivery().delivery_id());
-    }
-    std::shared_ptr<MessageLink> link;
-    {
-      std::lock_guard<std::mutex> lock(linksMutex);
-      auto found = links.find(nodeId);
-      if (found != links.end())
-        link = found->second;
-    }
-    if (link) {
-      gateway::GatewayToMessageFrame ackFrame;
-      auto *ack = ackFrame.mutable_delivery_ack();
-      ack->set_delivery_id(frame.delivery().delivery_id());
-      ack->set_status(status);
-      ack->set_gateway_id(gatewayId);
-      ack->set_instance_id(instanceId);
-      if (!link->Enqueue(std::move(ackFrame))) {
-        LOG_WARN(netLogger,
-                 "Gateway failed to enqueue delivery ACK, node: {}, "
-                 "delivery_id: {}, status: {}",
-                 nodeId, frame.delivery().delivery_id(),
-                 static_cast<int>(status));
-      } else {
-        LOG_DEBUG(businessLogger,
-                  "Gateway enqueued delivery ACK, node: {}, delivery_id: {}, "
-                  "status: {}",
-                  nodeId, frame.delivery().delivery_id(),
-                  static_cast<int>(status));
-      }
-    } else {
-      LOG_WARN(netLogger,
-               "Gateway cannot return delivery ACK because link is absent, "
-               "node: {}, delivery_id: {}, status: {}",
-               nodeId, frame.delivery().delivery_id(),
-               static_cast<int>(status));
-    }
+              "Gateway received Message command result, link: {}, "
+              "request_seq: {}, request_id: {}, response_service_id: {}, "
+              "error: {}, retryable: {}",
+              linkId, result.request_seq(), result.request_id(),
+              result.response_service_id(), result.error(),
+              result.retryable());
+    command->callback(result);
+  } else if (hedges.Settled(requestSeq)) {
+    LOG_DEBUG(businessLogger,
+              "Gateway dropped losing hedged result, link: {}, "
+              "request_seq: {}, error: {}",
+              linkId, requestSeq, result.error());
+  } else {
+    LOG_WARN(businessLogger,
+             "Gateway ignored unmatched Message command result, link: {}, "
+             "request_seq: {}, request_id: {}, response_service_id: {}",
+             linkId, result.request_seq(), result.request_id(),
+             result.response_service_id());
+  }
+}
+
+// Delivery 先交给本地 SessionRegistry 做 generation 校验和物理推送，再沿原流
+// 返回 DeliveryAck；业务消息已持久化，因此离线/背压不会回滚 ACCEPTED。
+void MessageLinkManager::OnDelivery(
+    const std::string &linkId, const gateway::DeliveryEnvelope &delivery) {
+  LOG_DEBUG(businessLogger,
+            "Gateway handling Message delivery, link: {}, delivery_id: {}, "
+            "recipient_uid: {}, message_id: {}, conversation_id: {}, "
+            "conversation_seq: {}",
+            linkId, delivery.delivery_id(), delivery.recipient_uid(),
+            delivery.message_id(), delivery.conversation_id(),
+            delivery.conversation_seq());
+  gateway::DeliveryStatus status = gateway::DELIVERY_STATUS_OFFLINE;
+  if (deliveryHandler) {
+    status = deliveryHandler(delivery);
+  } else {
+    LOG_ERROR(businessLogger,
+              "Gateway delivery handler is not installed, link: {}, "
+              "delivery_id: {}",
+              linkId, delivery.delivery_id());
+  }
+  std::shared_ptr<MessageLink> link;
+  {
+    std::lock_guard<std::mutex> lock(linksMutex);
+    auto found = links.find(linkId);
+    if (found != links.end())
+      link = found->second;
+  }
+  if (!link) {
+    LOG_WARN(netLogger,
+             "Gateway cannot return delivery ACK because link is absent, "
+             "link: {}, delivery_id: {}, status: {}",
+             linkId, delivery.delivery_id(), static_cast<int>(status));
     return;
   }
+  gateway::GatewayToMessageFrame ackFrame;
+  auto *ack = ackFrame.mutable_delivery_ack();
+  ack->set_delivery_id(delivery.delivery_id());
+  ack->set_status(status);
+  ack->set_gateway_id(gatewayId);
+  ack->set_instance_id(instanceId);
+  if (!link->Enqueue(std::move(ackFrame))) {
+    LOG_WARN(netLogger,
+             "Gateway failed to enqueue delivery ACK, link: {}, "
+             "delivery_id: {}, status: {}",
+             linkId, delivery.delivery_id(), static_cast<int>(status));
+  } else {
+    LOG_DEBUG(businessLogger,
+              "Gateway enqueued delivery ACK, link: {}, delivery_id: {}, "
+              "status: {}",
+              linkId, delivery.delivery_id(), static_cast<int>(status));
+  }
+}
 
-  // oneof 理论上只会命中上述分支；空 frame 作为协议异常保留可观测性。
-  LOG_WARN(netLogger, "Gateway received empty Message frame, node: {}", nodeId);
+// 群消息多播：本地逐个目标校验并共享同一帧扇出，整批只回一条聚合 ACK。
+void MessageLinkManager::OnMulticastDelivery(
+    const std::string &linkId, const gateway::MulticastDelivery &multicast) {
+  gateway::GatewayToMessageFrame ackFrame;
+  auto *ack = ackFrame.mutable_multicast_delivery_ack();
+  if (multicastHandler) {
+    multicastHandler(multicast, *ack);
+  } else {
+    LOG_ERROR(businessLogger,
+              "Gateway multicast handler is not installed, link: {}, "
+              "delivery_id: {}",
+              linkId, multicast.delivery_id());
+  }
+  ack->set_delivery_id(multicast.delivery_id());
+  ack->set_gateway_id(gatewayId);
+  ack->set_instance_id(instanceId);
+  std::size_t queued = 0;
+  for (const auto &recipient : ack->recipients())
+    queued += recipient.status() == gateway::DELIVERY_STATUS_QUEUED;
+  Metrics::Increment(Metric::GatewayMulticastDeliveries);
+  Metrics::Increment(Metric::GatewayMulticastRecipients,
+                     multicast.targets_size());
+  LOG_DEBUG(businessLogger,
+            "Gateway handled Message multicast, link: {}, delivery_id: {}, "
+            "message_id: {}, targets: {}, queued: {}",
+            linkId, multicast.delivery_id(), multicast.message_id(),
+            multicast.targets_size(), queued);
+
+  std::shared_ptr<MessageLink> link;
+  {
+    std::lock_guard<std::mutex> lock(linksMutex);
+    auto found = links.find(linkId);
+    if (found != links.end())
+      link = found->second;
+  }
+  if (!link || !link->Enqueue(std::move(ackFrame)))
+    LOG_WARN(netLogger,
+             "Gateway failed to return multicast ACK, link: {}, "
+             "delivery_id: {}",
+             linkId, multicast.delivery_id());
 }
 
-void MessageLinkManager::OnLinkDone(const std::string &nodeId,
+void MessageLinkManager::OnLinkDone(const std::string &linkId,
                                     MessageLink *source) {
-  asio::post(ioContext, [this, nodeId, source]() {
+  asio::post(ioContext, [this, linkId, source]() {
     if (stopping.load(std::memory_order_acquire))
       return;
     Node node;
+    uint32_t streamIndex = 0;
     {
       std::lock_guard<std::mutex> lock(linksMutex);
-      auto found = links.find(nodeId);
+      auto found = links.find(linkId);
       if (found == links.end() || found->second.get() != source)
         return;
+      streamIndex = source->StreamIndex();
       RetireLink(found->second);
       links.erase(found);
-      auto configured = configuredNodes.find(nodeId);
+      ScheduleRouteRebuild();
+      auto configured = configuredNodes.find(source->NodeId());
       if (configured == configuredNodes.end())
         return;
       node = configured->second;
     }
-    RetryPending(nodeId);
+    RetryPending(linkId, node.id);
     unsigned int attempt = 0;
     {
       std::lock_guard<std::mutex> lock(linksMutex);
-      attempt = reconnectAttempts[nodeId]++;
+      attempt = reconnectAttempts[linkId]++;
     }
     const auto exponent = std::min(attempt, 6U);
     auto delay = kReconnectBase * (1U << exponent);
@@ -725,43 +1041,33 @@ void MessageLinkManager::OnLinkDone(const std::string &nodeId,
     delay += std::chrono::milliseconds(jitter(random));
     auto timer = std::make_shared<asio::steady_timer>(ioContext);
     timer->expires_after(delay);
-    timer->async_wait([this, node, timer](const boost::system::error_code &ec) {
+    timer->async_wait([this, node, streamIndex, linkId,
+                       timer](const boost::system::error_code &ec) {
       if (ec || stopping.load(std::memory_order_acquire))
         return;
       {
         std::lock_guard<std::mutex> lock(linksMutex);
         auto configured = configuredNodes.find(node.id);
-        if (configured == configuredNodes.end() || links.contains(node.id) ||
+        if (configured == configuredNodes.end() || links.contains(linkId) ||
             configured->second.host != node.host ||
             configured->second.port != node.port)
           return;
       }
-      StartLink(node);
+      StartLink(node, streamIndex);
     });
   });
 }
 
-void MessageLinkManager::ExpirePending(const std::string &requestId) {
-  PendingCommand expired;
-  {
-    std::lock_guard<std::mutex> lock(pendingMutex);
-    auto found = pending.find(requestId);
-    if (found == pending.end())
-      return;
-    expired = std::move(found->second);
-    pending.erase(found);
+void MessageLinkManager::ExpirePending() {
+  const int64_t now = NowUnixMilliseconds();
+  for (auto &expired : pending.TakeExpired(now)) {
+    if (auto link = FindLink(expired.linkId))
+      link->Health().ObserveCommand(now - expired.sentAtUnixMs, true);
+    if (expired.callback)
+      expired.callback(MakeFailedResult(expired.command,
+                                        ErrorCodes::DeadlineExceeded,
+                                        "message command deadline exceeded"));
   }
-  if (!expired.callback)
-    return;
-  gateway::CommandResult result;
-  result.set_request_id(requestId);
-  result.set_response_service_id(
-      __getServiceResponseId(ServiceID(expired.command.service_id())));
-  result.set_error(ErrorCodes::DeadlineExceeded);
-  result.set_retryable(true);
-  result.set_packet(SerializeTcpPacket(MakeErrorPacket(
-      ErrorCodes::DeadlineExceeded, "message command deadline exceeded")));
-  expired.callback(result);
 }
 
 void MessageLinkManager::RetireLink(std::shared_ptr<MessageLink> link) {
@@ -775,76 +1081,324 @@ void MessageLinkManager::RetireLink(std::shared_ptr<MessageLink> link) {
       });
 }
 
-void MessageLinkManager::RetryPending(const std::string &failedNodeId) {
-  std::vector<std::string> requestIds;
-  {
-    std::lock_guard<std::mutex> lock(pendingMutex);
-    for (const auto &[requestId, command] : pending) {
-      if (command.linkId == failedNodeId)
-        requestIds.push_back(requestId);
+void MessageLinkManager::RetryPending(const std::string &failedLinkId,
+                                      const std::string &failedNodeId) {
+  for (const uint64_t requestSeq : pending.SequencesOnLink(failedLinkId)) {
+    gateway::CommandEnvelope command;
+    const bool retry = pending.Update(
+        requestSeq, [&command](PendingCommandTable::Entry &entry) {
+          // 对冲副本仍在另一节点执行，直接由它接管，不再重发。
+          if (!entry.hedgeLinkId.empty()) {
+            entry.linkId = std::move(entry.hedgeLinkId);
+            entry.hedgeLinkId.clear();
+            return false;
+          }
+          if (entry.attempts >= 1 ||
+              !CanRetryOnAnotherMessageNode(entry.command.service_id()))
+            return false;
+          entry.attempts++;
+          command = entry.command;
+          return true;
+        });
+    if (!retry)
+      continue;
+    if (command.deadline_unix_ms() > 0 &&
+        command.deadline_unix_ms() <= NowUnixMilliseconds())
+      continue;
+    auto link = SelectLink(command.conversation_id(), failedNodeId);
+    if (!link)
+      continue;
+    StampRequestSeq(command, requestSeq, link->ProtocolVersion());
+    gateway::GatewayToMessageFrame frame;
+    *frame.mutable_command() = std::move(command);
+    if (link->Enqueue(std::move(frame))) {
+      link->IncrementInflight();
+      const int64_t sentAt = NowUnixMilliseconds();
+      pending.Update(requestSeq,
+                     [&link, sentAt](PendingCommandTable::Entry &entry) {
+                       entry.linkId = link->Id();
+                       entry.sentAtUnixMs = sentAt;
+                       return true;
+                     });
     }
   }
+}
 
-  for (const auto &requestId : requestIds) {
-    PendingCommand failed;
-    {
-      std::lock_guard<std::mutex> lock(pendingMutex);
-      auto found = pending.find(requestId);
-      if (found == pending.end() || found->second.attempts >= 1 ||
-          !CanRetryOnAnotherMessageNode(found->second.command.service_id()))
-        continue;
-      found->second.attempts++;
-      failed = found->second;
-    }
-    if (failed.command.deadline_unix_ms() > 0 &&
-        failed.command.deadline_unix_ms() <= NowUnixMilliseconds())
+void MessageLinkManager::FireHedges() {
+  const int64_t now = NowUnixMilliseconds();
+  for (const uint64_t requestSeq : hedges.TakeDue(now)) {
+    gateway::CommandEnvelope command;
+    std::string primaryLinkId;
+    const bool due = pending.Update(
+        requestSeq, [&](const PendingCommandTable::Entry &entry) {
+          if (!entry.hedgeLinkId.empty() || entry.attempts > 0)
+            return false;
+          command = entry.command;
+          primaryLinkId = entry.linkId;
+          return true;
+        });
+    if (!due || command.deadline_unix_ms() <= now)
       continue;
-    auto retry = SelectLink(failed.command.conversation_id(), failedNodeId);
-    if (!retry)
+    const auto primary = FindLink(primaryLinkId);
+    if (!primary)
+      continue;
+    auto link = SelectLink(command.conversation_id(), primary->NodeId());
+    if (!link)
+      continue;
+    if (!hedges.TryAcquire()) {
+      Metrics::Increment(Metric::GatewayHedgesOverBudget);
       continue;
+    }
+    StampRequestSeq(command, requestSeq, link->ProtocolVersion());
     gateway::GatewayToMessageFrame frame;
-    *frame.mutable_command() = failed.command;
-    if (retry->Enqueue(std::move(frame))) {
-      retry->IncrementInflight();
-      std::lock_guard<std::mutex> lock(pendingMutex);
-      auto found = pending.find(requestId);
-      if (found != pending.end())
-        found->second.linkId = retry->Id();
+    *frame.mutable_command() = std::move(command);
+    if (!link->Enqueue(std::move(frame)))
+      continue;
+    link->IncrementInflight();
+    Metrics::Increment(Metric::GatewayHedgesSent);
+    // 副本写出前原命令可能已经完成，此时副本的结果会按落败处理。
+    if (!pending.Update(requestSeq,
+                        [&link](PendingCommandTable::Entry &entry) {
+                          entry.hedgeLinkId = link->Id();
+                          return true;
+                        }))
+      hedges.Settle(requestSeq);
+    LOG_DEBUG(businessLogger,
+              "Gateway hedged Message command, request_seq: {}, "
+              "primary_link: {}, hedge_link: {}",
+              requestSeq, primaryLinkId, link->Id());
+  }
+}
+
+void MessageLinkManager::CancelHedgeLoser(
+    uint64_t requestSeq, const PendingCommandTable::Entry &entry,
+    const std::string &winnerLinkId) {
+  hedges.Settle(requestSeq);
+  const bool hedgeWon = winnerLinkId == entry.hedgeLinkId;
+  if (hedgeWon)
+    Metrics::Increment(Metric::GatewayHedgesWon);
+  const auto loser = FindLink(hedgeWon ? entry.linkId : entry.hedgeLinkId);
+  // 旧节点不认识撤回帧，副本照常执行，结果由 Settled 识别后丢弃。
+  if (!loser ||
+      loser->ProtocolVersion() < kGatewayStreamCancelProtocolVersion)
+    return;
+  gateway::GatewayToMessageFrame frame;
+  frame.mutable_command_cancel()->set_request_seq(requestSeq);
+  loser->Enqueue(std::move(frame));
+}
+
+// 健康回调可能在 gRPC 线程上、甚至持有 linksMutex 时触发，统一投递到
+// ioContext 上重建；短时间内的多次变化合并成一次。
+void MessageLinkManager::ScheduleRouteRebuild() {
+  if (routeRebuildPending.exchange(true, std::memory_order_acq_rel))
+    return;
+  asio::post(ioContext, [this]() {
+    routeRebuildPending.store(false, std::memory_order_release);
+    RebuildRoutes();
+  });
+}
+
+void MessageLinkManager::RefreshLinkHealth(bool logHistograms) {
+  struct NodeHealth {
+    double latencyMs{0};
+    double errorRate{0};
+  };
+  std::unordered_map<std::string, NodeHealth> nodes;
+  {
+    std::lock_guard<std::mutex> lock(linksMutex);
+    for (const auto &[linkId, link] : links) {
+      if (!link->Healthy())
+        continue;
+      auto &health = link->Health();
+      auto &node = nodes[link->NodeId()];
+      node.latencyMs = std::max(node.latencyMs, health.LatencyMs());
+      node.errorRate = std::max(node.errorRate, health.ErrorRate());
+      // 直方图每次输出后减半，分位数反映最近一两分钟。
+      if (logHistograms) {
+        auto &histogram = health.CommandLatencyHistogram();
+        LOG_INFO(netLogger,
+                 "Gateway-Message link latency, link: {}, "
+                 "heartbeat_rtt_ms: {:.1f}, command_latency_ms: {:.1f}, "
+                 "error_rate: {:.3f}, command_p50_ms: {}, "
+                 "command_p99_ms: {}, command_latency_buckets: {}",
+                 linkId, health.HeartbeatRttMs(), health.CommandLatencyMs(),
+                 health.ErrorRate(), histogram.Quantile(0.5),
+                 histogram.Quantile(0.99), histogram.Format());
+        histogram.Decay();
+      }
+      health.Decay();
+    }
+  }
+
+  // 以各节点延迟的中位数为基准，只有一个节点时没有可比对象，不降级。
+  std::vector<double> latencies;
+  for (const auto &[_, node] : nodes)
+    latencies.push_back(node.latencyMs);
+  double median = 0;
+  if (!latencies.empty()) {
+    auto middle = latencies.begin() + latencies.size() / 2;
+    std::nth_element(latencies.begin(), middle, latencies.end());
+    median = *middle;
+  }
+  std::unordered_set<std::string> degraded;
+  for (const auto &[nodeId, node] : nodes) {
+    const bool slow = node.latencyMs > kDegradedLatencyFloorMs &&
+                      node.latencyMs > median * kDegradedLatencyRatio;
+    if (nodes.size() > 1 && (slow || node.errorRate > kDegradedErrorRate))
+      degraded.insert(nodeId);
+  }
+  // 全部节点都降级等于没有降级，保持原权重。
+  if (degraded.size() == nodes.size())
+    degraded.clear();
+
+  bool changed = false;
+  {
+    std::lock_guard<std::mutex> lock(linksMutex);
+    ++healthRounds;
+    // 没有健康流的节点已不在选路表里，降级状态随之清掉。
+    const auto unrouted = [&nodes](const std::string &nodeId) {
+      return !nodes.contains(nodeId);
+    };
+    changed = std::erase_if(degradedNodes, unrouted) > 0;
+    std::erase_if(penalties, [&unrouted](const auto &entry) {
+      return unrouted(entry.first);
+    });
+    for (const auto &[nodeId, node] : nodes) {
+      const bool observed = degraded.contains(nodeId);
+      auto &penalty = penalties[nodeId];
+      if (observed == degradedNodes.contains(nodeId)) {
+        penalty.streak = 0;
+        continue;
+      }
+      if (++penalty.streak < kPenaltyConfirmRounds ||
+          healthRounds < penalty.holdUntil)
+        continue;
+      penalty.streak = 0;
+      penalty.holdUntil = healthRounds + kPenaltyHoldRounds;
+      changed = true;
+      if (observed) {
+        degradedNodes.insert(nodeId);
+        LOG_WARN(netLogger,
+                 "Gateway lowers route weight of degraded Message node, "
+                 "message_node_id: {}, latency_ms: {:.1f}, "
+                 "median_ms: {:.1f}, error_rate: {:.3f}",
+                 nodeId, node.latencyMs, median, node.errorRate);
+      } else {
+        degradedNodes.erase(nodeId);
+        LOG_INFO(netLogger,
+                 "Gateway restores recovered Message node, "
+                 "message_node_id: {}",
+                 nodeId);
+      }
     }
   }
+  if (changed)
+    ScheduleRouteRebuild();
 }
 
-std::shared_ptr<MessageLink> MessageLinkManager::SelectLink(
-    int64_t conversationId, const std::string &excluded) {
-  std::vector<std::shared_ptr<MessageLink>> healthy;
+std::shared_ptr<MessageLink> MessageLinkManager::FindLink(
+    const std::string &linkId) const {
+  std::lock_guard<std::mutex> lock(linksMutex);
+  auto found = links.find(linkId);
+  return found == links.end() ? nullptr : found->second;
+}
+
+void MessageLinkManager::RebuildRoutes() {
+  if (stopping.load(std::memory_order_acquire))
+    return;
+  auto table = std::make_shared<RoutingTable>();
   {
     std::lock_guard<std::mutex> lock(linksMutex);
-    for (const auto &[nodeId, link] : links) {
-      if (nodeId != excluded && link->Healthy())
-        healthy.push_back(link);
+    std::unordered_map<std::string, std::size_t> routeIndexes;
+    for (const auto &[_, link] : links) {
+      if (!link->Healthy())
+        continue;
+      const auto &nodeId = link->NodeId();
+      const auto [slot, inserted] =
+          routeIndexes.try_emplace(nodeId, table->routes.size());
+      if (inserted) {
+        const auto configured = configuredNodes.find(nodeId);
+        Route route;
+        route.streams.resize(streamsPerNode);
+        route.nodeId = nodeId;
+        route.key = RendezvousNodeKey(nodeId);
+        route.weight = configured == configuredNodes.end()
+                           ? 1
+                           : configured->second.weight;
+        if (!degradedNodes.contains(nodeId))
+          route.weight *= kHealthyWeightScale;
+        table->weighted = table->weighted ||
+                          (!table->routes.empty() &&
+                           route.weight != table->routes.front().weight);
+        table->routes.push_back(std::move(route));
+      }
+      auto &streams = table->routes[slot->second].streams;
+      if (link->StreamIndex() < streams.size())
+        streams[link->StreamIndex()] = link;
     }
   }
-  if (healthy.empty())
-    return {};
+  LOG_DEBUG(netLogger, "Gateway rebuilt Message routes, healthy nodes: {}",
+            table->routes.size());
+  routingTable.store(std::move(table), std::memory_order_release);
+}
 
+std::shared_ptr<MessageLink> MessageLinkManager::SelectLink(
+    int64_t conversationId, const std::string &excludedNode) {
+  const auto table = routingTable.load(std::memory_order_acquire);
+  if (!table)
+    return {};
+  // 选路表在健康翻转后异步重建，这里再核对一次 Healthy 覆盖重建前的窗口。
+  const auto usable = [](const std::shared_ptr<MessageLink> &link) {
+    return link && link->Healthy();
+  };
+  const auto included = [&excludedNode](const Route &route) {
+    return excludedNode.empty() || route.nodeId != excludedNode;
+  };
+  const auto &routes = table->routes;
+
+  // 会话按加权 rendezvous 粘到同一节点；节点增减只迁移落在它上面的会话。
+  // 节点内按会话取模选流，同一会话的命令始终走同一条流，该流不可用时
+  // 才顺延到下一条。
   if (conversationId > 0) {
-    std::shared_ptr<MessageLink> selected;
-    std::size_t best = 0;
-    for (const auto &link : healthy) {
-      auto score = std::hash<std::string>{}(std::to_string(conversationId) +
-                                            ":" + link->Id());
-      if (!selected || score > best) {
-        best = score;
-        selected = link;
-      }
+    const auto index = SelectRendezvous(
+        routes, static_cast<uint64_t>(conversationId), table->weighted,
+        [&](const Route &route) {
+          return included(route) && std::any_of(route.streams.begin(),
+                                                 route.streams.end(), usable);
+        });
+    if (index == routes.size())
+      return {};
+    const auto &streams = routes[index].streams;
+    const std::size_t first =
+        static_cast<uint64_t>(conversationId) % streams.size();
+    for (std::size_t i = 0; i < streams.size(); ++i) {
+      const auto &link = streams[(first + i) % streams.size()];
+      if (usable(link))
+        return link;
     }
-    return selected;
+    return {};
   }
 
-  return *std::min_element(healthy.begin(), healthy.end(),
-                           [](const auto &left, const auto &right) {
-                             return left->Inflight() < right->Inflight();
-                           });
+  // 无会话命令按代价选流：在途数乘以 EWMA 延迟并按失败率放大，变慢的
+  // 节点即使在途不多也会少分到命令。
+  const std::shared_ptr<MessageLink> *selected = nullptr;
+  double selectedCost = 0;
+  for (const auto &route : routes) {
+    if (!included(route))
+      continue;
+    for (const auto &link : route.streams) {
+      if (!usable(link))
+        continue;
+      const double cost = link->Health().Cost(link->Inflight());
+      if (!selected || cost < selectedCost) {
+        selected = &link;
+        selectedCost = cost;
+      }
+    }
+  }
+  if (!selected)
+    return {};
+  return *selected;
 }
 
 }  // namespace wimi::connection
@@ -0,0 +1,131 @@
+#include "PendingCommandTable.h"
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+namespace wimi::connection {
+namespace {
+
+// 已完成命令的堆记录超过在途数两倍后按表重建，堆不会随吞吐无限增长。
+constexpr std::size_t kDeadlineCompactSlack = 64;
+
+}  // namespace
+
+PendingCommandTable::PendingCommandTable(std::size_t shardCount)
+    : shardCount(std::bit_ceil(std::max<std::size_t>(shardCount, 1))),
+      shards(std::make_unique<Shard[]>(this->shardCount)) {}
+
+PendingCommandTable::Shard &PendingCommandTable::ShardFor(
+    uint64_t requestSeq) const {
+  // 序号连续分配，取低位即可让相邻命令轮流落到不同分片。
+  return shards[requestSeq & (shardCount - 1)];
+}
+
+// 堆顶为最早到期的记录。
+bool PendingCommandTable::ExpiresLater(const Deadline &left,
+                                       const Deadline &right) {
+  return left.at > right.at;
+}
+
+uint64_t PendingCommandTable::NextSequence() {
+  return nextSequence.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+void PendingCommandTable::Insert(uint64_t requestSeq, Entry entry) {
+  const int64_t deadline = entry.command.deadline_unix_ms();
+  auto &shard = ShardFor(requestSeq);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.entries.insert_or_assign(requestSeq, std::move(entry));
+  shard.deadlines.push_back(Deadline{deadline, requestSeq});
+  std::push_heap(shard.deadlines.begin(), shard.deadlines.end(),
+                 ExpiresLater);
+  if (shard.deadlines.size() >
+      shard.entries.size() * 2 + kDeadlineCompactSlack)
+    CompactDeadlines(shard);
+}
+
+std::optional<PendingCommandTable::Entry> PendingCommandTable::Take(
+    uint64_t requestSeq) {
+  auto &shard = ShardFor(requestSeq);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto found = shard.entries.find(requestSeq);
+  if (found == shard.entries.end())
+    return std::nullopt;
+  auto entry = std::move(found->second);
+  shard.entries.erase(found);
+  return entry;
+}
+
+std::vector<uint64_t> PendingCommandTable::SequencesOnLink(
+    const std::string &linkId) const {
+  std::vector<uint64_t> sequences;
+  for (std::size_t i = 0; i < shardCount; ++i) {
+    std::lock_guard<std::mutex> lock(shards[i].mutex);
+    for (const auto &[requestSeq, entry] : shards[i].entries) {
+      if (entry.linkId == linkId)
+        sequences.push_back(requestSeq);
+    }
+  }
+  return sequences;
+}
+
+std::vector<PendingCommandTable::Entry> PendingCommandTable::TakeExpired(
+    int64_t nowUnixMilliseconds) {
+  std::vector<Entry> expired;
+  for (std::size_t i = 0; i < shardCount; ++i) {
+    auto &shard = shards[i];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    while (!shard.deadlines.empty() &&
+           shard.deadlines.front().at <= nowUnixMilliseconds) {
+      const uint64_t requestSeq = shard.deadlines.front().requestSeq;
+      std::pop_heap(shard.deadlines.begin(), shard.deadlines.end(),
+                    ExpiresLater);
+      shard.deadlines.pop_back();
+      // 已完成的命令只剩堆里的记录，这里顺手丢弃。
+      auto found = shard.entries.find(requestSeq);
+      if (found == shard.entries.end())
+        continue;
+      expired.push_back(std::move(found->second));
+      shard.entries.erase(found);
+    }
+  }
+  return expired;
+}
+
+std::vector<PendingCommandTable::Entry> PendingCommandTable::TakeAll() {
+  std::vector<Entry> taken;
+  for (std::size_t i = 0; i < shardCount; ++i) {
+    auto &shard = shards[i];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (auto &[_, entry] : shard.entries)
+      taken.push_back(std::move(entry));
+    shard.entries.clear();
+    shard.deadlines.clear();
+  }
+  return taken;
+}
+
+std::size_t PendingCommandTable::Size() const {
+  std::size_t total = 0;
+  for (std::size_t i = 0; i < shardCount; ++i) {
+    std::lock_guard<std::mutex> lock(shards[i].mutex);
+    total += shards[i].entries.size();
+  }
+  return total;
+}
+
+std::size_t PendingCommandTable::ShardCount() const {
+  return shardCount;
+}
+
+void PendingCommandTable::CompactDeadlines(Shard &shard) {
+  shard.deadlines.clear();
+  for (const auto &[requestSeq, entry] : shard.entries)
+    shard.deadlines.push_back(
+        Deadline{entry.command.deadline_unix_ms(), requestSeq});
+  std::make_heap(shard.deadlines.begin(), shard.deadlines.end(),
+                 ExpiresLater);
+}
+
+}  // namespace wimi::connection
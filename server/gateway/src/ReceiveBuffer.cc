@@ -0,0 +1,96 @@
+#include "ReceiveBuffer.h"
+
+#include <arpa/inet.h>
+#include <algorithm>
+#include <cstring>
+
+namespace wimi::connection {
+namespace {
+
+uint32_t ReadWord(const char *source) {
+  uint32_t value = 0;
+  std::memcpy(&value, source, sizeof(value));
+  return ntohl(value);
+}
+
+}  // namespace
+
+ReceiveBuffer::ReceiveBuffer(std::size_t initialCapacity,
+                             std::size_t maxPayload)
+    : initialCapacity(
+          std::max<std::size_t>(initialCapacity, PROTOCOL_HEADER_TOTAL)),
+      maxPayload(maxPayload) {}
+
+std::span<char> ReceiveBuffer::Prepare() {
+  if (storage.empty())
+    storage.resize(initialCapacity);
+  if (end == storage.size() && begin > 0) {
+    std::memmove(storage.data(), storage.data() + begin, end - begin);
+    end -= begin;
+    begin = 0;
+  }
+  if (end == storage.size()) {
+    // 只有当前半帧本身超过容量时才会走到这里；按帧长一次扩到位，
+    // 头部还不完整时按倍数增长。
+    std::size_t required = storage.size() * 2;
+    if (Buffered() >= PROTOCOL_HEADER_TOTAL)
+      required = PROTOCOL_HEADER_TOTAL + PendingPayloadSize();
+    required = std::min(required, PROTOCOL_HEADER_TOTAL + maxPayload);
+    storage.resize(std::max(required, storage.size()));
+  }
+  return {storage.data() + end, storage.size() - end};
+}
+
+void ReceiveBuffer::Commit(std::size_t bytes) {
+  end = std::min(end + bytes, storage.size());
+}
+
+ReceiveBuffer::ParseStatus ReceiveBuffer::Next(Frame &frame) {
+  if (Buffered() < PROTOCOL_HEADER_TOTAL)
+    return ParseStatus::NeedMore;
+  const uint32_t bodySize = PendingPayloadSize();
+  if (bodySize > maxPayload)
+    return ParseStatus::Oversized;
+  if (Buffered() < PROTOCOL_HEADER_TOTAL + bodySize)
+    return ParseStatus::NeedMore;
+
+  frame.protocolId = ReadWord(storage.data() + begin);
+  frame.payload = std::string_view(
+      storage.data() + begin + PROTOCOL_HEADER_TOTAL, bodySize);
+  begin += PROTOCOL_HEADER_TOTAL + bodySize;
+  return ParseStatus::Frame;
+}
+
+void ReceiveBuffer::Compact() {
+  if (begin == end) {
+    begin = end = 0;
+    // 连同大帧临时扩出的空间一起归还，下一次 Prepare 再按初始容量分配。
+    std::vector<char>().swap(storage);
+    return;
+  }
+  if (begin > 0) {
+    std::memmove(storage.data(), storage.data() + begin, end - begin);
+    end -= begin;
+    begin = 0;
+  }
+}
+
+std::size_t ReceiveBuffer::Buffered() const {
+  return end - begin;
+}
+
+std::string_view ReceiveBuffer::Unparsed() const {
+  return std::string_view(storage.data() + begin, end - begin);
+}
+
+std::size_t ReceiveBuffer::Capacity() const {
+  return storage.size();
+}
+
+uint32_t ReceiveBuffer::PendingPayloadSize() const {
+  if (Buffered() < PROTOCOL_HEADER_TOTAL)
+    return 0;
+  return ReadWord(storage.data() + begin + PROTOCOL_ID_LEN);
+}
+
+}  // namespace wimi::connection
@@ -0,0 +1,196 @@
+#include "SessionDrainer.h"
+
+#include "Configer.h"
+#include "Const.h"
+#include "GatewayServer.h"
+#include "GatewaySession.h"
+#include "Logger.h"
+#include "Redis.h"
+#include "Rendezvous.h"
+#include "SessionRegistry.h"
+#include "TcpMessageCodec.h"
+#include "state.grpc.pb.h"
+
+#include <boost/uuid/uuid_generators.hpp>
+#include <boost/uuid/uuid_io.hpp>
+#include <grpcpp/create_channel.h>
+#include <grpcpp/security/credentials.h>
+#include <algorithm>
+#include <random>
+#include <unordered_set>
+#include <utility>
+
+namespace wimi::connection {
+
+SessionDrainer::SessionDrainer(std::string gatewayId,
+                               SessionRegistry &registry,
+                               std::vector<GatewayServer *> servers,
+                               Policy policy, std::function<void()> onComplete)
+    : gatewayId(std::move(gatewayId)),
+      registry(registry),
+      servers(std::move(servers)),
+      policy(policy),
+      onComplete(std::move(onComplete)) {
+  auto config = Configer::getNode("server");
+  if (config["stateRPC"]) {
+    stateAddress = config["stateRPC"]["host"].as<std::string>() + ":" +
+                   config["stateRPC"]["port"].as<std::string>();
+  }
+}
+
+SessionDrainer::~SessionDrainer() {
+  Stop();
+}
+
+bool SessionDrainer::Start() {
+  std::lock_guard lock(mutex);
+  if (draining || stopping)
+    return false;
+  draining = true;
+  thread = std::thread([this]() { Run(); });
+  return true;
+}
+
+void SessionDrainer::Stop() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  wakeup.notify_all();
+  if (thread.joinable())
+    thread.join();
+}
+
+bool SessionDrainer::Draining() const {
+  std::lock_guard lock(mutex);
+  return draining;
+}
+
+std::size_t SessionDrainer::SelectTarget(const std::vector<Target> &targets,
+                                         int64_t uid) {
+  return SelectRendezvous(targets, static_cast<uint64_t>(uid), true,
+                          [](const Target &) { return true; });
+}
+
+std::size_t SessionDrainer::WaveSize(const Policy &policy) {
+  const double perWave = policy.sessionsPerSecond *
+                         static_cast<double>(policy.waveInterval.count()) /
+                         1000.0;
+  return std::max<std::size_t>(static_cast<std::size_t>(perWave), 1);
+}
+
+bool SessionDrainer::WaitFor(std::chrono::steady_clock::duration delay) {
+  std::unique_lock lock(mutex);
+  wakeup.wait_for(lock, delay, [this]() { return stopping; });
+  return !stopping;
+}
+
+std::vector<SessionDrainer::Target> SessionDrainer::FetchTargets() const {
+  std::vector<Target> targets;
+  if (stateAddress.empty())
+    return targets;
+  auto channel =
+      grpc::CreateChannel(stateAddress, grpc::InsecureChannelCredentials());
+  auto stub = state::StateService::NewStub(channel);
+  state::TopologyRequest request;
+  state::GatewayTopology response;
+  grpc::ClientContext context;
+  context.set_deadline(std::chrono::system_clock::now() +
+                       std::chrono::seconds(2));
+  auto status = stub->ListConnectionGateways(&context, request, &response);
+  if (!status.ok()) {
+    LOG_WARN(netLogger, "ListConnectionGateways failed: {}",
+             status.error_message());
+    return targets;
+  }
+  for (const auto &source : response.nodes()) {
+    if (source.node_id() == gatewayId || source.status() != "active" ||
+        source.host().empty() || source.port() <= 0)
+      continue;
+    targets.push_back(Target{source.node_id(), source.host(),
+                             static_cast<unsigned short>(source.port()),
+                             std::max(source.weight(), 1U),
+                             RendezvousNodeKey(source.node_id())});
+  }
+  return targets;
+}
+
+void SessionDrainer::Run() {
+  for (auto *server : servers)
+    server->StopAccepting();
+  const auto targets = FetchTargets();
+  const std::size_t waveSize = WaveSize(policy);
+  LOG_INFO(businessLogger,
+           "Connection Gateway draining {} sessions, targets: {}, wave: {}",
+           registry.Size(), targets.size(), waveSize);
+
+  std::mt19937 random(std::random_device{}());
+  std::uniform_int_distribution<long> jitter(0, policy.reconnectJitter.count());
+  boost::uuids::random_generator generator;
+  std::unordered_set<uint64_t> handled;
+  std::size_t redirected = 0;
+  std::size_t closed = 0;
+
+  // 停止 accept 前已建立、尚未完成登录的连接可能在快照之后才登记，
+  // 因此反复取快照，直到没有未处理的会话。
+  while (true) {
+    auto sessions = registry.Sessions();
+    std::erase_if(sessions, [&handled](const auto &entry) {
+      return handled.contains(entry.second->ConnectionId());
+    });
+    if (sessions.empty())
+      break;
+    for (std::size_t begin = 0; begin < sessions.size(); begin += waveSize) {
+      const auto waveStarted = std::chrono::steady_clock::now();
+      const std::size_t end = std::min(begin + waveSize, sessions.size());
+      for (std::size_t i = begin; i < end; ++i) {
+        const auto &[uid, session] = sessions[i];
+        handled.insert(session->ConnectionId());
+        const std::size_t index = SelectTarget(targets, uid);
+        // 凭证与 Gate 签发的同名同格式，按 uid 覆盖；目标 Gateway 的登录
+        // 校验无需区分来源。
+        const std::string token = boost::uuids::to_string(generator()) +
+                                  boost::uuids::to_string(generator());
+        if (index == targets.size() ||
+            !db::RedisDao::GetInstance()->setChatAuthToken(
+                uid, token, policy.tokenTtlSeconds)) {
+          session->Close();
+          ++closed;
+          continue;
+        }
+        const auto &target = targets[index];
+        TcpPacket redirect;
+        redirect.set_uid(uid);
+        redirect.set_error(ErrorCodes::Success);
+        redirect.set_gateway_id(target.id);
+        redirect.set_gateway_host(target.host);
+        redirect.set_gateway_port(target.port);
+        redirect.set_auth_token(token);
+        redirect.set_auth_token_expires_in(policy.tokenTtlSeconds);
+        redirect.set_reconnect_delay_ms(static_cast<uint32_t>(jitter(random)));
+        if (session->Redirect(redirect))
+          ++redirected;
+        else
+          ++closed;
+      }
+      if (end < sessions.size() &&
+          !WaitFor(policy.waveInterval -
+                   (std::chrono::steady_clock::now() - waveStarted)))
+        return;
+    }
+  }
+
+  const auto deadline = std::chrono::steady_clock::now() + policy.linger;
+  while (registry.Size() > 0 && std::chrono::steady_clock::now() < deadline) {
+    if (!WaitFor(std::chrono::milliseconds(50)))
+      return;
+  }
+  LOG_INFO(businessLogger,
+           "Connection Gateway drained, redirected: {}, closed: {}, "
+           "remaining: {}",
+           redirected, closed, registry.Size());
+  if (onComplete)
+    onComplete();
+}
+
+}  // namespace wimi::connection
@@ -0,0 +1,118 @@
+#include "SessionParking.h"
+
+#include "Metrics.h"
+
+#include <boost/uuid/uuid_generators.hpp>
+#include <boost/uuid/uuid_io.hpp>
+#include <utility>
+
+namespace wimi::connection {
+
+SessionParking::SessionParking(std::chrono::steady_clock::duration ttl,
+                               std::size_t maxParked)
+    : ttl(ttl), maxParked(maxParked) {}
+
+std::string SessionParking::Issue(int64_t uid, const TcpPacket &profile,
+                                  std::weak_ptr<GatewaySession> session) {
+  // random_generator 不是线程安全的，每个线程各持一个。
+  thread_local boost::uuids::random_generator generator;
+  std::string token = boost::uuids::to_string(generator()) +
+                      boost::uuids::to_string(generator());
+  Entry entry;
+  entry.state.uid = uid;
+  entry.state.profile = profile;
+  entry.state.profile.clear_resume_token();
+  entry.state.profile.clear_resumed();
+  entry.state.session = std::move(session);
+  std::lock_guard<std::mutex> lock(mutex);
+  entries.emplace(token, std::move(entry));
+  return token;
+}
+
+void SessionParking::Park(const std::string &token,
+                          std::vector<ParkedWrite> writes) {
+  const auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(mutex);
+  auto found = entries.find(token);
+  if (found == entries.end() || found->second.parked)
+    return;
+  auto &entry = found->second;
+  entry.parked = true;
+  entry.expiresAt = now + ttl;
+  entry.state.session.reset();
+  entry.state.writes = std::move(writes);
+  parkedOrder.emplace_back(entry.expiresAt, token);
+  ++parked;
+  Metrics::Increment(Metric::GatewaySessionsParked);
+  ExpireLocked(now);
+}
+
+void SessionParking::Revoke(const std::string &token) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto found = entries.find(token);
+  if (found == entries.end())
+    return;
+  if (found->second.parked)
+    --parked;
+  entries.erase(found);
+}
+
+std::optional<SessionParking::Claimed> SessionParking::Claim(
+    const std::string &token, int64_t uid) {
+  const auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(mutex);
+  ExpireLocked(now);
+  auto found = entries.find(token);
+  if (found == entries.end() || found->second.state.uid != uid) {
+    Metrics::Increment(Metric::GatewayResumeMisses);
+    return std::nullopt;
+  }
+  if (found->second.parked)
+    --parked;
+  auto claimed = std::move(found->second.state);
+  entries.erase(found);
+  Metrics::Increment(Metric::GatewaySessionsResumed);
+  return claimed;
+}
+
+void SessionParking::Restore(const std::string &token, Claimed claimed) {
+  const auto now = std::chrono::steady_clock::now();
+  Entry entry;
+  entry.state = std::move(claimed);
+  entry.state.session.reset();
+  entry.parked = true;
+  entry.expiresAt = now + ttl;
+  std::lock_guard<std::mutex> lock(mutex);
+  const auto expiresAt = entry.expiresAt;
+  if (!entries.emplace(token, std::move(entry)).second)
+    return;
+  parkedOrder.emplace_back(expiresAt, token);
+  ++parked;
+  ExpireLocked(now);
+}
+
+std::size_t SessionParking::Size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return entries.size();
+}
+
+std::size_t SessionParking::Parked() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return parked;
+}
+
+void SessionParking::ExpireLocked(std::chrono::steady_clock::time_point now) {
+  while (!parkedOrder.empty() &&
+         (parkedOrder.front().first <= now || parked > maxParked)) {
+    const auto &[expiresAt, token] = parkedOrder.front();
+    auto found = entries.find(token);
+    if (found != entries.end() && found->second.parked &&
+        found->second.expiresAt == expiresAt) {
+      entries.erase(found);
+      --parked;
+    }
+    parkedOrder.pop_front();
+  }
+}
+
+}  // namespace wimi::connection
@@ -2,101 +2,205 @@
 
 #include "GatewaySession.h"
 #include "Logger.h"
-#include "TcpMessageCodec.h"
 
+#include <bit>
+#include <charconv>
+#include <mutex>
 #include <utility>
 
 namespace wimi::connection {
+namespace {
+
+// 批量发布 lease 时每次 EVAL 携带的会话数，避免单个脚本阻塞 Redis 过久。
+constexpr std::size_t kLeaseBindBatch = 128;
+
+}  // namespace
 
 SessionRegistry::SessionRegistry(std::string gatewayId, std::string instanceId,
-                                 long leaseTtlSeconds)
+                                 long leaseTtlSeconds, std::size_t shardCount)
     : gatewayId(std::move(gatewayId)),
       instanceId(std::move(instanceId)),
-      leaseTtlSeconds(leaseTtlSeconds) {}
+      leaseTtlSeconds(leaseTtlSeconds),
+      shardCount(std::bit_ceil(std::max<std::size_t>(shardCount, 1))),
+      shards(std::make_unique<Shard[]>(this->shardCount)) {}
 
-db::SessionLease SessionRegistry::Bind(
-    int64_t uid, const std::shared_ptr<GatewaySession> &session) {
-  db::SessionLease lease;
-  lease.gatewayId = gatewayId;
-  lease.instanceId = instanceId;
-  lease.connectionId = session->ConnectionId();
-  lease.generation = db::RedisDao::GetInstance()->bindSessionLease(
-      uid, gatewayId, instanceId, lease.connectionId, leaseTtlSeconds);
-  if (lease.generation <= 0)
-    return {};
+SessionRegistry::Shard &SessionRegistry::ShardFor(int64_t uid) const {
+  // uid 由 Redis INCR 连续分配，先做乘法散列再取高位，避免相邻 uid 扎堆。
+  const uint64_t mixed = static_cast<uint64_t>(uid) * 0x9E3779B97F4A7C15ULL;
+  return shards[(mixed >> 32) & (shardCount - 1)];
+}
+
+int64_t SessionRegistry::Bind(int64_t uid,
+                              const std::shared_ptr<GatewaySession> &session) {
+  const int64_t generation = db::RedisDao::GetInstance()->bindSessionLease(
+      uid, gatewayId, instanceId, std::to_string(session->ConnectionId()),
+      leaseTtlSeconds);
+  if (generation <= 0)
+    return 0;
 
   // rebind 会话，如果旧的会话存在，目前的规则是直接关闭旧的会话（没有明确通知）
-  std::shared_ptr<GatewaySession> oldSession;
-  {
-    std::lock_guard<std::mutex> lock(mutex);
-    auto found = sessions.find(uid);
-    if (found != sessions.end())
-      oldSession = found->second.session.lock();
-    sessions[uid] = LocalSession{session, lease};
-  }
+  auto oldSession = Attach(uid, session, generation);
   if (oldSession && oldSession != session)
     oldSession->Close();
-  return lease;
+  return generation;
+}
+
+std::vector<int64_t> SessionRegistry::BindAll(
+    const std::vector<std::pair<int64_t, std::shared_ptr<GatewaySession>>>
+        &sessions) {
+  std::vector<std::pair<long, std::string>> bindings;
+  bindings.reserve(sessions.size());
+  for (const auto &[uid, session] : sessions)
+    bindings.emplace_back(uid, std::to_string(session->ConnectionId()));
+  auto generations = db::RedisDao::GetInstance()->bindSessionLeases(
+      bindings, gatewayId, instanceId, leaseTtlSeconds, kLeaseBindBatch);
+  // 同一批里同一 uid 的多次登录按顺序取得递增 generation，后者取代前者。
+  for (std::size_t i = 0; i < generations.size(); ++i) {
+    if (generations[i] <= 0)
+      continue;
+    const auto &[uid, session] = sessions[i];
+    auto oldSession = Attach(uid, session, generations[i]);
+    if (oldSession && oldSession != session)
+      oldSession->Close();
+  }
+  return generations;
+}
+
+std::shared_ptr<GatewaySession> SessionRegistry::Attach(
+    int64_t uid, const std::shared_ptr<GatewaySession> &session,
+    int64_t generation) {
+  auto &shard = ShardFor(uid);
+  std::shared_ptr<GatewaySession> oldSession;
+  std::unique_lock<std::shared_mutex> lock(shard.mutex);
+  auto found = shard.sessions.find(uid);
+  if (found != shard.sessions.end())
+    oldSession = found->second.session.lock();
+  shard.sessions[uid] =
+      LocalSession{session, session->ConnectionId(), generation};
+  return oldSession;
 }
 
-bool SessionRegistry::Refresh(int64_t uid, const db::SessionLease &lease) {
-  return db::RedisDao::GetInstance()->refreshSessionLease(uid, lease,
-                                                          leaseTtlSeconds);
+bool SessionRegistry::Detach(int64_t uid,
+                             const std::shared_ptr<GatewaySession> &session) {
+  auto &shard = ShardFor(uid);
+  std::unique_lock<std::shared_mutex> lock(shard.mutex);
+  auto found = shard.sessions.find(uid);
+  if (found == shard.sessions.end())
+    return false;
+  auto current = found->second.session.lock();
+  if (current && current != session)
+    return false;
+  shard.sessions.erase(found);
+  return true;
 }
 
 void SessionRegistry::Remove(int64_t uid,
                              const std::shared_ptr<GatewaySession> &session,
-                             const db::SessionLease &lease) {
-  {
-    std::lock_guard<std::mutex> lock(mutex);
-    auto found = sessions.find(uid);
-    if (found == sessions.end())
-      return;
-    auto current = found->second.session.lock();
-    if (current && current != session)
-      return;
-    sessions.erase(found);
-  }
-  db::RedisDao::GetInstance()->clearSessionLease(uid, lease);
+                             int64_t generation) {
+  if (!Detach(uid, session))
+    return;
+  db::RedisDao::GetInstance()->clearSessionLease(
+      uid, MakeLease(session->ConnectionId(), generation));
+}
+
+db::SessionLease SessionRegistry::MakeLease(uint64_t connectionId,
+                                            int64_t generation) const {
+  db::SessionLease lease;
+  lease.gatewayId = gatewayId;
+  lease.instanceId = instanceId;
+  lease.connectionId = std::to_string(connectionId);
+  lease.generation = generation;
+  return lease;
 }
 
 gateway::DeliveryStatus SessionRegistry::Deliver(
     const gateway::DeliveryEnvelope &delivery) {
+  auto status = gateway::DELIVERY_STATUS_QUEUED;
+  auto session = FindCurrent(delivery.recipient_uid(),
+                             delivery.expected_connection_id(),
+                             delivery.expected_connection_generation(), status);
+  if (!session)
+    return status;
+  return Send(*session,
+              GatewaySession::EncodeFrame(delivery.protocol_id(),
+                                          delivery.packet()),
+              delivery.message_id(), delivery.transport_seq());
+}
+
+void SessionRegistry::DeliverMulticast(
+    const gateway::MulticastDelivery &multicast,
+    gateway::MulticastDeliveryAck &ack) {
+  // 群推送的 2000 个接收者共享一份 TLV 帧，发送队列和重传表只增加引用计数。
+  const auto frame =
+      GatewaySession::EncodeFrame(multicast.protocol_id(), multicast.packet());
+  ack.set_delivery_id(multicast.delivery_id());
+  ack.mutable_recipients()->Reserve(multicast.targets_size());
+  for (const auto &target : multicast.targets()) {
+    auto status = gateway::DELIVERY_STATUS_QUEUED;
+    auto session = FindCurrent(target.recipient_uid(),
+                               target.expected_connection_id(),
+                               target.expected_connection_generation(), status);
+    if (session)
+      status = Send(*session, frame, multicast.message_id(),
+                    multicast.transport_seq());
+    auto *recipient = ack.add_recipients();
+    recipient->set_recipient_uid(target.recipient_uid());
+    recipient->set_status(status);
+  }
+}
+
+std::shared_ptr<GatewaySession> SessionRegistry::FindCurrent(
+    int64_t uid, std::string_view expectedConnectionId,
+    uint64_t expectedGeneration, gateway::DeliveryStatus &status) const {
+  auto &shard = ShardFor(uid);
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  auto found = shard.sessions.find(uid);
   std::shared_ptr<GatewaySession> session;
-  db::SessionLease lease;
-  {
-    std::lock_guard<std::mutex> lock(mutex);
-    auto found = sessions.find(delivery.recipient_uid());
-    if (found == sessions.end())
-      return gateway::DELIVERY_STATUS_OFFLINE;
+  if (found != shard.sessions.end())
     session = found->second.session.lock();
-    lease = found->second.lease;
+  if (!session) {
+    status = gateway::DELIVERY_STATUS_OFFLINE;
+    return nullptr;
   }
 
-  if (!session)
-    return gateway::DELIVERY_STATUS_OFFLINE;
-
   /*
     Message Core 查询在线 lease 后，把它当时看到的连接身份写入
     DeliveryEnvelope。Gateway 在真正写 socket 前，要求本地当前 session 的
     connectionId 和 generation 都完全一致；不一致就返回 STALE_ROUTE，不投递。
-    未来可以考虑投递，不然导致了一个用户的消息（如通知）无法及时收到，只因为它的连接身份变了。
+    未来可以考虑投递，不然导致了一个用户的消息（如通知）无法及时收到，
+    只因为它的连接身份变了。
     目前一般来说，对于可持久化消息是不会丢的，它存放在 Mysql 存储表中。
+    本地只保存整数 connectionId，信封里的十进制字符串就地解析后比较。
   */
-  if (lease.connectionId != delivery.expected_connection_id() ||
-      lease.generation != delivery.expected_connection_generation())
-    return gateway::DELIVERY_STATUS_STALE_ROUTE;
-  TcpPacket packet;
-  const bool hasTransportSequence = ParseTcpPacket(delivery.packet(), packet) &&
-                                    packet.has_seq() && packet.seq() > 0;
+  const char *expectedEnd =
+      expectedConnectionId.data() + expectedConnectionId.size();
+  uint64_t connectionId = 0;
+  const auto parsed =
+      std::from_chars(expectedConnectionId.data(), expectedEnd, connectionId);
+  if (parsed.ec != std::errc{} || parsed.ptr != expectedEnd ||
+      found->second.connectionId != connectionId ||
+      found->second.generation != static_cast<int64_t>(expectedGeneration)) {
+    status = gateway::DELIVERY_STATUS_STALE_ROUTE;
+    return nullptr;
+  }
+  return session;
+}
+
+gateway::DeliveryStatus SessionRegistry::Send(
+    GatewaySession &session, std::shared_ptr<const std::string> frame,
+    int64_t messageId, int64_t transportSeq) {
+  // 传输 ACK 序号由 Message 节点直接写在信封上，Gateway 不再反解推送包；
+  // 帧只编码一次，发送队列和重传表共享它。已落库的消息客户端可以补拉，
+  // 超预算时返回背压；不落库的通知超预算时直接丢弃。
+  const auto frameClass = messageId > 0 || transportSeq > 0
+                              ? GatewaySession::FrameClass::Deferrable
+                              : GatewaySession::FrameClass::Droppable;
   const bool queued =
-      hasTransportSequence
-          ? session->SendReliable(delivery.packet(), delivery.protocol_id(),
-                                  packet.seq())
-          : session->SendRaw(delivery.packet(), delivery.protocol_id());
-  if (!queued)
-    return gateway::DELIVERY_STATUS_BACKPRESSURED;
-  return gateway::DELIVERY_STATUS_QUEUED;
+      transportSeq > 0
+          ? session.SendReliable(std::move(frame), transportSeq, frameClass)
+          : session.SendFrame(std::move(frame), frameClass);
+  return queued ? gateway::DELIVERY_STATUS_QUEUED
+                : gateway::DELIVERY_STATUS_BACKPRESSURED;
 }
 
 const std::string &SessionRegistry::GatewayId() const {
@@ -107,4 +211,29 @@ const std::string &SessionRegistry::InstanceId() const {
   return instanceId;
 }
 
+std::size_t SessionRegistry::ShardCount() const {
+  return shardCount;
+}
+
+std::vector<std::pair<int64_t, std::shared_ptr<GatewaySession>>>
+SessionRegistry::Sessions() const {
+  std::vector<std::pair<int64_t, std::shared_ptr<GatewaySession>>> result;
+  for (std::size_t i = 0; i < shardCount; ++i) {
+    std::shared_lock<std::shared_mutex> lock(shards[i].mutex);
+    for (const auto &[uid, local] : shards[i].sessions)
+      if (auto session = local.session.lock())
+        result.emplace_back(uid, std::move(session));
+  }
+  return result;
+}
+
+std::size_t SessionRegistry::Size() const {
+  std::size_t total = 0;
+  for (std::size_t i = 0; i < shardCount; ++i) {
+    std::shared_lock<std::shared_mutex> lock(shards[i].mutex);
+    total += shards[i].sessions.size();
+  }
+  return total;
+}
+
 }  // namespace wimi::connection
@@ -0,0 +1,96 @@
+#include "TimingWheel.h"
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+namespace wimi::connection {
+namespace asio = boost::asio;
+
+TimingWheel::TimingWheel(asio::io_context &ioContext,
+                         std::chrono::milliseconds tick, std::size_t slotCount)
+    : ticker(ioContext),
+      tick(std::max(tick, std::chrono::milliseconds(1))),
+      slotMask(std::bit_ceil(std::max<std::size_t>(slotCount, 1)) - 1),
+      slots(slotMask + 1) {}
+
+void TimingWheel::Start() {
+  if (running.exchange(true))
+    return;
+  startedAt = std::chrono::steady_clock::now();
+  ArmTicker();
+}
+
+void TimingWheel::Stop() {
+  // 只改标志，不跨线程碰 ticker；最迟一个 tick 后停止续约。
+  running.store(false, std::memory_order_release);
+}
+
+void TimingWheel::Schedule(std::weak_ptr<Listener> listener, TimerKind kind,
+                           int64_t key, uint64_t ticket,
+                           std::chrono::milliseconds delay) {
+  const uint64_t ticks = std::max<uint64_t>(
+      (delay.count() + tick.count() - 1) / tick.count(), 1);
+  std::lock_guard<std::mutex> lock(mutex);
+  const uint64_t expiresAt = currentTick + ticks;
+  slots[expiresAt & slotMask].push_back(
+      Entry{std::move(listener), expiresAt, ticket, key, kind});
+  ++pending;
+}
+
+std::size_t TimingWheel::Tick() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++currentTick;
+    // 超过一圈的项留在原槽，expiresAt 未到就跳过，不单独维护圈数。
+    auto &slot = slots[currentTick & slotMask];
+    for (std::size_t i = 0; i < slot.size();) {
+      if (slot[i].expiresAt > currentTick) {
+        ++i;
+        continue;
+      }
+      expired.push_back(std::move(slot[i]));
+      if (i + 1 != slot.size())
+        slot[i] = std::move(slot.back());
+      slot.pop_back();
+    }
+    pending -= expired.size();
+  }
+
+  // 回调在锁外执行，接收方可以在回调里重新 Schedule。
+  std::size_t fired = 0;
+  for (auto &entry : expired) {
+    if (auto listener = entry.listener.lock()) {
+      listener->OnTimerExpired(entry.kind, entry.key, entry.ticket);
+      ++fired;
+    }
+  }
+  expired.clear();
+  return fired;
+}
+
+std::size_t TimingWheel::Pending() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return pending;
+}
+
+std::chrono::milliseconds TimingWheel::TickInterval() const {
+  return tick;
+}
+
+void TimingWheel::ArmTicker() {
+  // 按绝对时间续约，回调迟到时补齐落下的格子，时间轮不随负载漂移。
+  ticker.expires_at(startedAt + tick * (currentTick + 1));
+  ticker.async_wait([this](const boost::system::error_code &error) {
+    if (error || !running.load(std::memory_order_acquire))
+      return;
+    const auto elapsed = std::chrono::steady_clock::now() - startedAt;
+    const auto due = static_cast<uint64_t>(elapsed / tick);
+    do {
+      Tick();
+    } while (currentTick < due);
+    ArmTicker();
+  });
+}
+
+}  // namespace wimi::connection
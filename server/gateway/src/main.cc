@@ -1,20 +1,49 @@
 #include "Configer.h"
+#include "GatewayOptions.h"
 #include "GatewayServer.h"
+#include "GatewaySession.h"
+#include "Handoff.h"
+#include "LeaseRefresher.h"
 #include "Logger.h"
+#include "LoginAdmission.h"
 #include "MessageLink.h"
 #include "Mysql.h"
 #include "Redis.h"
+#include "SessionDrainer.h"
+#include "SessionParking.h"
 #include "SessionRegistry.h"
 
 #include <boost/asio.hpp>
 #include <boost/asio/co_spawn.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <memory>
 #include <thread>
 #include <vector>
 
+namespace {
+
+void PinCurrentThread(std::size_t index) {
+  const std::size_t cores =
+      std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(index % cores, &cpus);
+  const int result =
+      pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  if (result != 0)
+    LOG_WARN(wimi::businessLogger, "Gateway io thread {} pin failed: {}",
+             index, std::strerror(result));
+}
+
+}  // namespace
+
 int main(int argc, char **argv) {
   const char *configPath = std::getenv("WIMI_CONFIG");
   if (!configPath && argc > 1)
@@ -34,47 +63,195 @@ int main(int argc, char **argv) {
 
   const std::string gatewayId = config["self"]["name"].as<std::string>();
   const unsigned short port = config["self"]["port"].as<unsigned short>();
-  const std::string instanceId =
+  std::string instanceId =
       boost::uuids::to_string(boost::uuids::random_generator{}());
+  const auto options = wimi::connection::LoadGatewayOptions(config);
+
+  // 热重启：交接地址上有旧进程在等待时沿用它的实例 ID 与连接号，并继承
+  // 监听 socket；已登录会话在 Message 流就绪后再迁移。
+  wimi::connection::HandoffChannel takeover;
+  std::vector<int> inheritedListeners;
+  if (!options.handoffSocket.empty()) {
+    takeover = wimi::connection::HandoffChannel::Connect(options.handoffSocket);
+    wimi::gateway::HandoffRecord record;
+    if (takeover.Valid() && takeover.Receive(record, inheritedListeners) &&
+        record.has_hello() && record.hello().gateway_id() == gatewayId) {
+      instanceId = record.hello().instance_id();
+      wimi::connection::GatewaySession::ReserveConnectionIds(
+          record.hello().next_connection_id());
+      LOG_INFO(wimi::businessLogger,
+               "Connection Gateway taking over instance: {}, listeners: {}",
+               instanceId, inheritedListeners.size());
+    } else {
+      if (takeover.Valid())
+        LOG_WARN(wimi::businessLogger,
+                 "Connection Gateway handoff rejected, starting fresh");
+      for (const int fd : inheritedListeners)
+        ::close(fd);
+      inheritedListeners.clear();
+      takeover = wimi::connection::HandoffChannel();
+    }
+  }
 
   wimi::db::MysqlDao::GetInstance();
   wimi::db::RedisDao::GetInstance();
 
-  boost::asio::io_context ioContext;
+  // 共享模式：一个 io_context 由 ioThreads 个线程共同驱动，会话靠 strand 串行；
+  // thread-per-core：每个线程独占一个 io_context 和一个 SO_REUSEPORT acceptor。
+  const std::size_t contextCount =
+      options.threadPerCore ? options.ioThreads : 1;
+  std::vector<std::unique_ptr<boost::asio::io_context>> ioContexts;
+  ioContexts.reserve(contextCount);
+  for (std::size_t i = 0; i < contextCount; ++i)
+    ioContexts.push_back(std::make_unique<boost::asio::io_context>(
+        options.threadPerCore ? 1 : static_cast<int>(options.ioThreads)));
+  auto &ioContext = *ioContexts.front();
+
   boost::asio::thread_pool businessPool(4);
-  wimi::connection::SessionRegistry registry(gatewayId, instanceId);
-  wimi::connection::MessageLinkManager messageLinks(ioContext, businessPool,
-                                                    gatewayId, instanceId);
+  wimi::connection::SessionRegistry registry(gatewayId, instanceId,
+                                             options.leaseTtlSeconds,
+                                             options.registryShards);
+  wimi::connection::MessageLinkManager messageLinks(
+      ioContext, businessPool, gatewayId, instanceId,
+      options.messageStreamsPerNode, options.messageChannelsPerNode);
+  if (options.messageLocalTransport)
+    messageLinks.SetLocalHostId(options.messageHostId);
+  messageLinks.SetHedgePolicy(wimi::connection::HedgeScheduler::Policy{
+      options.messageHedging, options.messageHedgePercentile,
+      options.messageHedgeBudgetPercent / 100.0,
+      options.messageHedgeMinDelayMilliseconds});
   messageLinks.SetDeliveryHandler(
       [&registry](const wimi::gateway::DeliveryEnvelope &delivery) {
         return registry.Deliver(delivery);
       });
+  messageLinks.SetMulticastHandler(
+      [&registry](const wimi::gateway::MulticastDelivery &multicast,
+                  wimi::gateway::MulticastDeliveryAck &ack) {
+        registry.DeliverMulticast(multicast, ack);
+      });
   messageLinks.Start();
+  wimi::connection::LeaseRefresher leaseRefresher(
+      ioContext, businessPool, options.leaseTtlSeconds,
+      std::chrono::milliseconds(options.leaseRefreshFlushMilliseconds),
+      options.leaseRefreshBatchSize);
+  leaseRefresher.Start();
+  wimi::connection::GatewayServices services{
+      registry, messageLinks, businessPool, leaseRefresher, options, {}};
+  // 登录批次与其余业务共用 businessPool；maxInflightBatches 小于线程数，
+  // 重连风暴时仍留出线程处理 Message 控制面。
+  std::unique_ptr<wimi::connection::LoginAdmission> admission;
+  if (options.loginAdmission) {
+    admission = std::make_unique<wimi::connection::LoginAdmission>(
+        ioContext, businessPool,
+        wimi::connection::MakeStorageLoginBackend(registry),
+        wimi::connection::LoginAdmission::Policy{
+            options.loginBatchSize,
+            std::chrono::microseconds(options.loginWindowMicroseconds),
+            options.loginMaxInflightBatches, options.loginMaxQueued});
+    services.admission = admission.get();
+  }
+  std::unique_ptr<wimi::connection::SessionParking> parking;
+  if (options.sessionResume) {
+    parking = std::make_unique<wimi::connection::SessionParking>(
+        std::chrono::seconds(options.resumeTtlSeconds),
+        options.resumeMaxParked);
+    services.parking = parking.get();
+  }
 
-  wimi::connection::GatewayServer server(ioContext, port, registry,
-                                         messageLinks, businessPool);
-  boost::asio::co_spawn(ioContext, server.Run(), boost::asio::detached);
+  if (takeover.Valid() && inheritedListeners.size() != contextCount)
+    LOG_WARN(wimi::businessLogger,
+             "Connection Gateway inherited {} listeners for {} io contexts",
+             inheritedListeners.size(), contextCount);
+  std::vector<std::unique_ptr<wimi::connection::GatewayServer>> servers;
+  std::vector<wimi::connection::GatewayServer *> serverPointers;
+  servers.reserve(contextCount);
+  for (std::size_t i = 0; i < contextCount; ++i) {
+    const int listener =
+        i < inheritedListeners.size() ? inheritedListeners[i] : -1;
+    servers.push_back(std::make_unique<wimi::connection::GatewayServer>(
+        *ioContexts[i], port, services, listener));
+    serverPointers.push_back(servers.back().get());
+    boost::asio::co_spawn(*ioContexts[i], servers.back()->Run(),
+                          boost::asio::detached);
+  }
+  for (std::size_t i = contextCount; i < inheritedListeners.size(); ++i)
+    ::close(inheritedListeners[i]);
 
+  auto shutdown = [&]() {
+    messageLinks.Stop();
+    leaseRefresher.Stop();
+    for (auto &context : ioContexts)
+      context->stop();
+  };
   boost::asio::signal_set signals(ioContext, SIGINT, SIGTERM);
   signals.async_wait([&](const boost::system::error_code &error, int) {
-    if (error)
-      return;
-    messageLinks.Stop();
-    ioContext.stop();
+    if (!error)
+      shutdown();
   });
 
-  const auto workerCount =
-      std::clamp<std::size_t>(std::thread::hardware_concurrency(), 2, 8);
+  // SIGUSR1 触发计划内下线：会话分批带着重连目标关闭，排空后退出。
+  wimi::connection::SessionDrainer drainer(
+      gatewayId, registry, serverPointers,
+      wimi::connection::SessionDrainer::Policy{
+          options.drainSessionsPerSecond,
+          std::chrono::milliseconds(options.drainWaveMilliseconds),
+          std::chrono::milliseconds(options.drainReconnectJitterMilliseconds),
+          options.drainTokenTtlSeconds,
+          std::chrono::milliseconds(options.drainLingerMilliseconds)},
+      [&]() { boost::asio::post(ioContext, shutdown); });
+  boost::asio::signal_set drainSignals(ioContext, SIGUSR1);
+  drainSignals.async_wait([&](const boost::system::error_code &error, int) {
+    if (!error && drainer.Start())
+      LOG_INFO(wimi::businessLogger, "Connection Gateway drain requested");
+  });
+
+  // 交接完成后旧进程直接退出；新进程接管完毕才在同一地址上监听，等待
+  // 下一次升级。
+  std::unique_ptr<wimi::connection::HandoffServer> handoff;
+  auto listenForHandoff = [&]() {
+    handoff = std::make_unique<wimi::connection::HandoffServer>(
+        options.handoffSocket, registry, serverPointers,
+        std::chrono::milliseconds(options.handoffDrainMilliseconds),
+        [&]() { boost::asio::post(ioContext, shutdown); });
+    handoff->Start();
+  };
+  std::thread takeoverThread;
+  if (takeover.Valid()) {
+    takeoverThread = std::thread([&]() {
+      wimi::connection::AdoptHandoffSessions(takeover, messageLinks, servers);
+      takeover = wimi::connection::HandoffChannel();
+      listenForHandoff();
+    });
+  } else if (!options.handoffSocket.empty()) {
+    listenForHandoff();
+  }
+
+  const bool pinThreads = options.threadPerCore && options.pinThreads;
   std::vector<std::thread> workers;
-  workers.reserve(workerCount - 1);
-  for (std::size_t i = 1; i < workerCount; ++i)
-    workers.emplace_back([&]() { ioContext.run(); });
+  workers.reserve(options.ioThreads - 1);
+  for (std::size_t i = 1; i < options.ioThreads; ++i) {
+    auto &context = *ioContexts[i % contextCount];
+    workers.emplace_back([&context, i, pinThreads]() {
+      if (pinThreads)
+        PinCurrentThread(i);
+      context.run();
+    });
+  }
   LOG_INFO(wimi::businessLogger,
-           "Connection Gateway started, id: {}, instance: {}, port: {}",
-           gatewayId, instanceId, port);
+           "Connection Gateway started, id: {}, instance: {}, port: {}, "
+           "io threads: {}, thread-per-core: {}",
+           gatewayId, instanceId, port, options.ioThreads,
+           options.threadPerCore);
+  if (pinThreads)
+    PinCurrentThread(0);
   ioContext.run();
   for (auto &worker : workers)
     worker.join();
+  if (takeoverThread.joinable())
+    takeoverThread.join();
+  if (handoff)
+    handoff->Stop();
+  drainer.Stop();
 
   messageLinks.Stop();
   businessPool.stop();
@@ -0,0 +1,114 @@
+#include "Handoff.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using wimi::connection::HandoffChannel;
+using wimi::gateway::HandoffRecord;
+
+void Require(bool condition, const std::string &message) {
+  if (condition)
+    return;
+  std::cerr << message << '\n';
+  std::exit(EXIT_FAILURE);
+}
+
+std::pair<HandoffChannel, HandoffChannel> MakePair() {
+  int fds[2];
+  Require(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0,
+          "socketpair should succeed");
+  return {HandoffChannel(fds[0]), HandoffChannel(fds[1])};
+}
+
+void TestRecordCarriesDescriptor() {
+  auto [sender, receiver] = MakePair();
+  int pipeFds[2];
+  Require(::pipe(pipeFds) == 0, "pipe should succeed");
+
+  HandoffRecord record;
+  auto *session = record.mutable_session();
+  session->set_uid(42);
+  session->set_connection_id(7);
+  session->set_pending_input(std::string("\0\0\0\x01", 4));
+  Require(sender.Send(record, {pipeFds[1]}), "send should succeed");
+  ::close(pipeFds[1]);
+
+  HandoffRecord received;
+  std::vector<int> fds;
+  Require(receiver.Receive(received, fds), "receive should succeed");
+  Require(received.has_session() && received.session().uid() == 42 &&
+              received.session().connection_id() == 7 &&
+              received.session().pending_input().size() == 4,
+          "session state should survive the channel");
+  Require(fds.size() == 1, "exactly one descriptor should arrive");
+
+  // 收到的描述符指向同一个管道。
+  Require(::write(fds.front(), "ok", 2) == 2, "passed fd should be writable");
+  ::close(fds.front());
+  char buffer[2];
+  Require(::read(pipeFds[0], buffer, sizeof(buffer)) == 2 &&
+              std::string(buffer, 2) == "ok",
+          "data should arrive through the original pipe");
+  ::close(pipeFds[0]);
+}
+
+void TestLargeRecordsAndOrdering() {
+  auto [sender, receiver] = MakePair();
+  // 超过套接字缓冲区的记录需要分段写入，由另一线程同时读取。
+  const std::string frame(1024 * 1024, 'x');
+  std::thread writer([&sender = sender, &frame]() {
+    for (int i = 0; i < 3; ++i) {
+      HandoffRecord record;
+      auto *write = record.mutable_session()->add_reliable_writes();
+      write->set_ack_seq(i + 1);
+      write->set_frame(frame);
+      Require(sender.Send(record), "large send should succeed");
+    }
+    HandoffRecord done;
+    done.mutable_done()->set_sessions(3);
+    Require(sender.Send(done), "done should be sent");
+  });
+  for (int i = 0; i < 3; ++i) {
+    HandoffRecord record;
+    std::vector<int> fds;
+    Require(receiver.Receive(record, fds), "large receive should succeed");
+    Require(fds.empty(), "no descriptors were attached");
+    Require(record.session().reliable_writes(0).ack_seq() == i + 1 &&
+                record.session().reliable_writes(0).frame() == frame,
+            "records should arrive intact and in order");
+  }
+  HandoffRecord done;
+  std::vector<int> fds;
+  Require(receiver.Receive(done, fds) && done.has_done() &&
+              done.done().sessions() == 3,
+          "done should follow the sessions");
+  writer.join();
+}
+
+void TestClosedPeer() {
+  auto [sender, receiver] = MakePair();
+  sender = HandoffChannel();
+  HandoffRecord record;
+  std::vector<int> fds;
+  Require(!receiver.Receive(record, fds), "closed peer should fail receive");
+  Require(!HandoffChannel().Send(record), "invalid channel cannot send");
+  Require(!HandoffChannel::Connect("/nonexistent/wimi-handoff.sock").Valid(),
+          "connecting without a listener should fail");
+}
+
+}  // namespace
+
+int main() {
+  TestRecordCarriesDescriptor();
+  TestLargeRecordsAndOrdering();
+  TestClosedPeer();
+  std::cout << "handoff channel tests passed\n";
+  return EXIT_SUCCESS;
+}
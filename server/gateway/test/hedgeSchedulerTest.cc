@@ -0,0 +1,95 @@
+#include "HedgeScheduler.h"
+#include "LinkHealth.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using wimi::connection::HedgeScheduler;
+using wimi::connection::LatencyHistogram;
+
+void Require(bool condition, const std::string &message) {
+  if (condition)
+    return;
+  std::cerr << message << '\n';
+  std::exit(EXIT_FAILURE);
+}
+
+HedgeScheduler::Policy EnabledPolicy() {
+  HedgeScheduler::Policy policy;
+  policy.enabled = true;
+  policy.percentile = 0.9;
+  policy.budgetRatio = 0.05;
+  policy.minDelayMilliseconds = 10;
+  policy.minimumSamples = 20;
+  return policy;
+}
+
+void TestDelayFollowsRecentLatency() {
+  HedgeScheduler hedges;
+  LatencyHistogram histogram;
+  for (int i = 0; i < 100; ++i)
+    histogram.Record(i < 90 ? 40 : 400);
+  Require(hedges.DelayFor(histogram) == 0, "disabled policy never hedges");
+  hedges.SetPolicy(EnabledPolicy());
+  Require(hedges.DelayFor(histogram) == 50,
+          "delay should be the configured percentile bucket");
+  LatencyHistogram sparse;
+  sparse.Record(40);
+  Require(hedges.DelayFor(sparse) == 0, "too few samples should not hedge");
+  LatencyHistogram fast;
+  for (int i = 0; i < 100; ++i)
+    fast.Record(1);
+  Require(hedges.DelayFor(fast) == 10, "delay should respect the minimum");
+}
+
+void TestBudgetCapsHedgeRate() {
+  HedgeScheduler hedges;
+  hedges.SetPolicy(EnabledPolicy());
+  Require(!hedges.TryAcquire(), "no budget before any traffic");
+  int granted = 0;
+  for (int i = 0; i < 1000; ++i) {
+    hedges.Accrue();
+    granted += hedges.TryAcquire();
+  }
+  Require(granted == 50, "hedges should stay within five percent");
+  // 空闲期积攒的预算有上限。
+  for (int i = 0; i < 100000; ++i)
+    hedges.Accrue();
+  int burst = 0;
+  while (hedges.TryAcquire())
+    ++burst;
+  Require(burst == 10, "idle budget should be capped");
+}
+
+void TestDueOrderAndSettledHistory() {
+  HedgeScheduler hedges;
+  hedges.Schedule(3, 300);
+  hedges.Schedule(1, 100);
+  hedges.Schedule(2, 200);
+  Require(hedges.TakeDue(50).empty(), "nothing is due yet");
+  Require(hedges.TakeDue(200) == std::vector<uint64_t>({1, 2}),
+          "due hedges should come out in deadline order");
+  Require(hedges.TakeDue(1000) == std::vector<uint64_t>({3}),
+          "remaining hedge should come out later");
+  hedges.Settle(7);
+  Require(hedges.Settled(7) && !hedges.Settled(8),
+          "settled sequences should be remembered");
+  for (uint64_t seq = 100; seq < 10000; ++seq)
+    hedges.Settle(seq);
+  Require(!hedges.Settled(7) && hedges.Settled(9999),
+          "settled history should be bounded");
+}
+
+}  // namespace
+
+int main() {
+  TestDelayFollowsRecentLatency();
+  TestBudgetCapsHedgeRate();
+  TestDueOrderAndSettledHistory();
+  std::cout << "hedge scheduler tests passed\n";
+  return EXIT_SUCCESS;
+}
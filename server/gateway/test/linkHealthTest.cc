@@ -0,0 +1,83 @@
+#include "LinkHealth.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace {
+
+using wimi::connection::LatencyHistogram;
+using wimi::connection::LinkHealth;
+
+void Require(bool condition, const std::string &message) {
+  if (condition)
+    return;
+  std::cerr << message << '\n';
+  std::exit(EXIT_FAILURE);
+}
+
+void TestHistogramQuantiles() {
+  LatencyHistogram histogram;
+  Require(histogram.Quantile(0.5) == 0, "empty histogram has no quantile");
+  for (int i = 0; i < 98; ++i)
+    histogram.Record(3);
+  histogram.Record(150);
+  histogram.Record(9000);
+  Require(histogram.Count() == 100, "every sample should be counted");
+  Require(histogram.Quantile(0.5) == 5, "median should fall in the 5ms bucket");
+  Require(histogram.Quantile(0.99) == 200, "p99 should reach the slow sample");
+  Require(histogram.Quantile(1.0) == 10000,
+          "overflow samples should report twice the last bound");
+  Require(histogram.Quantile(0.5, 1000) == 0,
+          "too few samples should yield no quantile");
+  histogram.Decay();
+  Require(histogram.Count() == 51, "decay should halve buckets, keeping single samples");
+  Require(histogram.Format().starts_with("le_1=0 le_2=0 le_5=49"),
+          "format should list buckets in order");
+}
+
+void TestEwmaTracksLatencyAndErrors() {
+  LinkHealth health;
+  Require(health.LatencyMs() == 0 && health.ErrorRate() == 0,
+          "new link has no samples");
+  health.ObserveHeartbeat(4);
+  Require(health.HeartbeatRttMs() == 4, "first sample seeds the average");
+  for (int i = 0; i < 200; ++i)
+    health.ObserveCommand(100, i % 2 == 0);
+  Require(std::abs(health.CommandLatencyMs() - 100) < 1,
+          "command latency should converge");
+  Require(health.LatencyMs() == health.CommandLatencyMs(),
+          "latency should take the slower signal");
+  Require(health.ErrorRate() > 0.4 && health.ErrorRate() < 0.6,
+          "error rate should approach the failure ratio");
+  const double before = health.ErrorRate();
+  health.Decay();
+  Require(health.ErrorRate() < before, "decay should lower the error rate");
+}
+
+void TestCostPrefersFastHealthyLinks() {
+  LinkHealth fast;
+  LinkHealth slow;
+  LinkHealth failing;
+  for (int i = 0; i < 50; ++i) {
+    fast.ObserveCommand(5, false);
+    slow.ObserveCommand(200, false);
+    failing.ObserveCommand(5, true);
+  }
+  Require(fast.Cost(4) < slow.Cost(0),
+          "a slow link should lose even when it is idle");
+  Require(fast.Cost(0) < failing.Cost(0),
+          "failures should raise the cost");
+  Require(LinkHealth{}.Cost(0) > 0, "links without samples still cost");
+}
+
+}  // namespace
+
+int main() {
+  TestHistogramQuantiles();
+  TestEwmaTracksLatencyAndErrors();
+  TestCostPrefersFastHealthyLinks();
+  std::cout << "link health tests passed\n";
+  return EXIT_SUCCESS;
+}
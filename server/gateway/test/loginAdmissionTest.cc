@@ -0,0 +1,241 @@
+#include "LoginAdmission.h"
+
+#include <boost/asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using wimi::connection::GatewaySession;
+using wimi::connection::LoginAdmission;
+using wimi::connection::LoginBackend;
+using wimi::connection::LoginResult;
+
+void Require(bool condition, const std::string &message) {
+  if (condition)
+    return;
+  std::cerr << message << '\n';
+  std::exit(EXIT_FAILURE);
+}
+
+// 内存桩：uid 3 的凭证不匹配，uid 4 没有资料，uid 5 发布 lease 失败。
+class FakeBackend final : public LoginBackend {
+ public:
+  std::vector<bool> ValidateTokens(
+      const std::vector<std::pair<long, std::string>> &tokens) override {
+    const int running = ++active;
+    maxActive = std::max(maxActive.load(), running);
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      released.wait(lock, [this]() { return open; });
+      tokenBatches.push_back(tokens.size());
+    }
+    --active;
+    if (redisDown)
+      return {};
+    std::vector<bool> valid;
+    for (const auto &[uid, token] : tokens)
+      valid.push_back(uid != 3 && token == "token-" + std::to_string(uid));
+    return valid;
+  }
+
+  bool LoadProfiles(const std::vector<long> &uids,
+                    std::vector<wimi::db::UserInfo::Ptr> &profiles) override {
+    ++profileQueries;
+    profiles.assign(uids.size(), nullptr);
+    for (std::size_t i = 0; i < uids.size(); ++i) {
+      if (uids[i] != 4)
+        profiles[i] = std::make_shared<wimi::db::UserInfo>(
+            uids[i], "user-" + std::to_string(uids[i]), 20, "", "");
+    }
+    return true;
+  }
+
+  bool InsertProfile(const wimi::db::UserInfo::Ptr &) override {
+    ++inserts;
+    return true;
+  }
+
+  std::vector<int64_t> BindSessions(
+      const std::vector<std::pair<int64_t, std::shared_ptr<GatewaySession>>>
+          &sessions) override {
+    ++bindCalls;
+    std::vector<int64_t> generations;
+    for (const auto &[uid, session] : sessions)
+      generations.push_back(uid == 5 ? 0 : 100 + uid);
+    return generations;
+  }
+
+  void Hold() {
+    std::lock_guard<std::mutex> lock(mutex);
+    open = false;
+  }
+
+  void Release() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      open = true;
+    }
+    released.notify_all();
+  }
+
+  std::vector<std::size_t> TokenBatches() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return tokenBatches;
+  }
+
+  std::atomic<int> active{0};
+  std::atomic<int> maxActive{0};
+  std::atomic<int> profileQueries{0};
+  std::atomic<int> inserts{0};
+  std::atomic<int> bindCalls{0};
+  std::atomic<bool> redisDown{false};
+
+ private:
+  std::mutex mutex;
+  std::condition_variable released;
+  bool open{true};
+  std::vector<std::size_t> tokenBatches;
+};
+
+struct Harness {
+  explicit Harness(LoginAdmission::Policy policy) {
+    auto owned = std::make_unique<FakeBackend>();
+    backend = owned.get();
+    admission = std::make_unique<LoginAdmission>(ioContext, pool,
+                                                 std::move(owned), policy);
+    runner = std::thread([this]() { ioContext.run(); });
+  }
+
+  ~Harness() {
+    backend->Release();
+    pool.join();
+    ioContext.stop();
+    runner.join();
+  }
+
+  std::future<LoginResult> Login(int64_t uid, bool init = false) {
+    wimi::TcpPacket request;
+    request.set_uid(uid);
+    request.set_auth_token("token-" + std::to_string(uid));
+    request.set_init(init);
+    auto promise = std::make_shared<std::promise<LoginResult>>();
+    auto future = promise->get_future();
+    admission->Submit(std::move(request), nullptr,
+                      [promise](LoginResult result) {
+                        promise->set_value(std::move(result));
+                      });
+    return future;
+  }
+
+  boost::asio::io_context ioContext;
+  boost::asio::executor_work_guard<boost::asio::io_context::executor_type>
+      work{ioContext.get_executor()};
+  boost::asio::thread_pool pool{4};
+  FakeBackend *backend{nullptr};
+  std::unique_ptr<LoginAdmission> admission;
+  std::thread runner;
+};
+
+void TestConcurrentLoginsShareOneBatch() {
+  Harness harness(LoginAdmission::Policy{64, std::chrono::milliseconds(50), 2,
+                                         1000});
+  std::vector<std::future<LoginResult>> results;
+  for (int64_t uid = 1; uid <= 10; ++uid)
+    results.push_back(harness.Login(uid, uid == 6));
+
+  std::vector<LoginResult> done;
+  for (auto &result : results)
+    done.push_back(result.get());
+  Require(harness.backend->TokenBatches() == std::vector<std::size_t>{10},
+          "ten concurrent logins should share one token lookup");
+  Require(harness.backend->profileQueries == 1,
+          "profiles should load with one query");
+  Require(harness.backend->inserts == 1, "init login should insert once");
+  Require(harness.backend->bindCalls == 1, "leases should bind in one call");
+
+  Require(done[2].error == ErrorCodes::TokenInvalid,
+          "a mismatched token should be rejected");
+  Require(done[3].error == ErrorCodes::NotFound,
+          "a missing profile should be reported");
+  Require(done[4].error == ErrorCodes::DependencyUnavailable,
+          "a failed lease bind should be retryable");
+  for (const std::size_t i : {0, 1, 5, 6, 7, 8, 9}) {
+    Require(done[i].error == ErrorCodes::Success,
+            "other logins in the batch should succeed");
+    Require(done[i].generation == 101 + static_cast<int64_t>(i),
+            "each login should get its own generation");
+  }
+  Require(done[0].response.name() == "user-1",
+          "the response should carry the loaded profile");
+}
+
+void TestFullBatchSkipsWindow() {
+  Harness harness(LoginAdmission::Policy{4, std::chrono::seconds(30), 2, 100});
+  std::vector<std::future<LoginResult>> results;
+  for (int64_t uid = 1; uid <= 4; ++uid)
+    results.push_back(harness.Login(uid + 10));
+  for (auto &result : results)
+    Require(result.wait_for(std::chrono::seconds(5)) ==
+                    std::future_status::ready &&
+                result.get().error == ErrorCodes::Success,
+            "a full batch should not wait for the window");
+}
+
+void TestConcurrencyAndQueueLimits() {
+  Harness harness(LoginAdmission::Policy{1, std::chrono::microseconds(0), 1,
+                                         2});
+  harness.backend->Hold();
+  auto first = harness.Login(11);
+  while (harness.backend->active == 0)
+    std::this_thread::yield();
+  auto second = harness.Login(12);
+  auto third = harness.Login(13);
+  auto rejected = harness.Login(14);
+  Require(rejected.wait_for(std::chrono::seconds(5)) ==
+                  std::future_status::ready &&
+              rejected.get().error == ErrorCodes::ResourceExhausted,
+          "logins beyond the queue limit should be rejected");
+  Require(harness.admission->Pending() == 2 &&
+              harness.admission->Inflight() == 1,
+          "queued logins should wait behind the in-flight batch");
+
+  harness.backend->Release();
+  Require(first.get().error == ErrorCodes::Success &&
+              second.get().error == ErrorCodes::Success &&
+              third.get().error == ErrorCodes::Success,
+          "queued logins should complete after the batch finishes");
+  Require(harness.backend->maxActive == 1,
+          "no more than one batch should run at a time");
+}
+
+void TestRedisUnavailable() {
+  Harness harness(LoginAdmission::Policy{8, std::chrono::milliseconds(1), 2,
+                                         100});
+  harness.backend->redisDown = true;
+  Require(harness.Login(21).get().error ==
+              ErrorCodes::DependencyUnavailable,
+          "a token store outage should not look like an invalid token");
+  Require(harness.backend->profileQueries == 0,
+          "profiles should not load when tokens could not be checked");
+}
+
+}  // namespace
+
+int main() {
+  TestConcurrentLoginsShareOneBatch();
+  TestFullBatchSkipsWindow();
+  TestConcurrencyAndQueueLimits();
+  TestRedisUnavailable();
+  std::cout << "login admission tests passed\n";
+  return EXIT_SUCCESS;
+}
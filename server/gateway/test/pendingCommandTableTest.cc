@@ -0,0 +1,124 @@
+#include "PendingCommandTable.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using wimi::connection::PendingCommandTable;
+
+void Require(bool condition, const std::string &message) {
+  if (condition)
+    return;
+  std::cerr << message << '\n';
+  std::exit(EXIT_FAILURE);
+}
+
+PendingCommandTable::Entry MakeEntry(int64_t deadline,
+                                     const std::string &linkId = "m1") {
+  PendingCommandTable::Entry entry;
+  entry.command.set_deadline_unix_ms(deadline);
+  entry.linkId = linkId;
+  return entry;
+}
+
+void TestSequencesAreUniqueAndNonZero() {
+  PendingCommandTable table(4);
+  Require(table.ShardCount() == 4, "shard count should be kept");
+  const auto first = table.NextSequence();
+  const auto second = table.NextSequence();
+  Require(first == 1 && second == 2, "sequences start at 1 and increase");
+}
+
+void TestTakeCompletesOnce() {
+  PendingCommandTable table(8);
+  const auto requestSeq = table.NextSequence();
+  table.Insert(requestSeq, MakeEntry(1000));
+  Require(table.Size() == 1, "inserted command should be pending");
+  auto taken = table.Take(requestSeq);
+  Require(taken && taken->command.deadline_unix_ms() == 1000,
+          "take should return the pending command");
+  Require(!table.Take(requestSeq), "a command completes only once");
+  Require(table.TakeExpired(2000).empty(),
+          "completed commands must not expire later");
+}
+
+void TestExpiryFollowsDeadlines() {
+  PendingCommandTable table(2);
+  for (int64_t deadline : {300, 100, 200, 500}) {
+    auto entry = MakeEntry(deadline);
+    entry.command.set_service_id(static_cast<uint32_t>(deadline));
+    table.Insert(table.NextSequence(), std::move(entry));
+  }
+  Require(table.TakeExpired(99).empty(), "nothing is due before 100");
+  auto expired = table.TakeExpired(300);
+  std::vector<int64_t> deadlines;
+  for (const auto &entry : expired)
+    deadlines.push_back(entry.command.deadline_unix_ms());
+  std::sort(deadlines.begin(), deadlines.end());
+  Require(deadlines == std::vector<int64_t>({100, 200, 300}),
+          "all commands due by 300 should expire");
+  Require(table.Size() == 1, "later command should stay pending");
+}
+
+void TestUpdateAndLinkLookup() {
+  PendingCommandTable table(4);
+  const auto onFirst = table.NextSequence();
+  const auto onSecond = table.NextSequence();
+  table.Insert(onFirst, MakeEntry(1000, "m1"));
+  table.Insert(onSecond, MakeEntry(1000, "m2"));
+  Require(table.SequencesOnLink("m1") == std::vector<uint64_t>{onFirst},
+          "link lookup should find only its commands");
+  Require(table.Update(onFirst,
+                       [](PendingCommandTable::Entry &entry) {
+                         entry.linkId = "m2";
+                         ++entry.attempts;
+                         return true;
+                       }),
+          "update should reach a pending command");
+  Require(table.SequencesOnLink("m2").size() == 2,
+          "updated command should move to the new link");
+  Require(!table.Update(table.NextSequence(),
+                        [](PendingCommandTable::Entry &) { return true; }),
+          "update of an unknown sequence should fail");
+}
+
+void TestChurnKeepsLaterDeadlines() {
+  // 大量命令在截止前完成，堆记录会被压缩；仍在途的命令必须照常到期。
+  PendingCommandTable table(1);
+  const auto survivor = table.NextSequence();
+  table.Insert(survivor, MakeEntry(5000));
+  for (int i = 0; i < 10000; ++i) {
+    const auto requestSeq = table.NextSequence();
+    table.Insert(requestSeq, MakeEntry(4000));
+    table.Take(requestSeq);
+  }
+  Require(table.Size() == 1, "only the survivor should be pending");
+  Require(table.TakeExpired(4999).empty(), "survivor is not due yet");
+  Require(table.TakeExpired(5000).size() == 1, "survivor should expire");
+}
+
+void TestTakeAllDrainsEveryShard() {
+  PendingCommandTable table(16);
+  for (int i = 0; i < 100; ++i)
+    table.Insert(table.NextSequence(), MakeEntry(1000));
+  Require(table.TakeAll().size() == 100, "take all should drain every shard");
+  Require(table.Size() == 0 && table.TakeExpired(2000).empty(),
+          "drained table should be empty");
+}
+
+}  // namespace
+
+int main() {
+  TestSequencesAreUniqueAndNonZero();
+  TestTakeCompletesOnce();
+  TestExpiryFollowsDeadlines();
+  TestUpdateAndLinkLookup();
+  TestChurnKeepsLaterDeadlines();
+  TestTakeAllDrainsEveryShard();
+  std::cout << "pending command table tests passed\n";
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+#include "ReceiveBuffer.h"
+
+#include <arpa/inet.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+
+using wimi::connection::ReceiveBuffer;
+
+void Require(bool condition, const std::string &message) {
+  if (condition)
+    return;
+  std::cerr << message << '\n';
+  std::exit(EXIT_FAILURE);
+}
+
+std::string EncodeFrame(uint32_t protocolId, const std::string &payload) {
+  std::string frame(PROTOCOL_HEADER_TOTAL, '\0');
+  const uint32_t wireId = htonl(protocolId);
+  const uint32_t wireSize = htonl(static_cast<uint32_t>(payload.size()));
+  std::memcpy(frame.data(), &wireId, sizeof(wireId));
+  std::memcpy(frame.data() + sizeof(wireId), &wireSize, sizeof(wireSize));
+  return frame + payload;
+}
+
+// 模拟 read_some：每次最多写入 chunk 字节。
+void Feed(ReceiveBuffer &buffer, const std::string &bytes, std::size_t &offset,
+          std::size_t chunk) {
+  auto space = buffer.Prepare();
+  const auto count = std::min({chunk, space.size(), bytes.size() - offset});
+  std::memcpy(space.data(), bytes.data() + offset, count);
+  buffer.Commit(count);
+  offset += count;
+}
+
+}  // namespace
+
+int main() {
+  {
+    ReceiveBuffer buffer(64);
+    const std::string burst = EncodeFrame(1, "ack-1") + EncodeFrame(2, "") +
+                              EncodeFrame(3, "ping");
+    std::size_t offset = 0;
+    Feed(buffer, burst, offset, burst.size());
+    ReceiveBuffer::Frame frame;
+    Require(buffer.Next(frame) == ReceiveBuffer::ParseStatus::Frame &&
+                frame.protocolId == 1 && frame.payload == "ack-1",
+            "first frame of a burst was not parsed");
+    Require(buffer.Next(frame) == ReceiveBuffer::ParseStatus::Frame &&
+                frame.protocolId == 2 && frame.payload.empty(),
+            "empty frame of a burst was not parsed");
+    Require(buffer.Next(frame) == ReceiveBuffer::ParseStatus::Frame &&
+                frame.protocolId == 3 && frame.payload == "ping",
+            "last frame of a burst was not parsed");
+    Require(buffer.Next(frame) == ReceiveBuffer::ParseStatus::NeedMore,
+            "drained buffer reported another frame");
+  }
+
+  {
+    ReceiveBuffer buffer(16);
+    const std::string large(1000, 'x');
+    const std::string bytes = EncodeFrame(7, large) + EncodeFrame(8, "tail");
+    std::size_t offset = 0;
+    ReceiveBuffer::Frame frame;
+    int parsed = 0;
+    while (offset < bytes.size()) {
+      Feed(buffer, bytes, offset, 5);
+      while (buffer.Next(frame) == ReceiveBuffer::ParseStatus::Frame) {
+        ++parsed;
+        if (parsed == 1)
+          Require(frame.protocolId == 7 && frame.payload == large,
+                  "split large frame was corrupted");
+        else
+          Require(frame.protocolId == 8 && frame.payload == "tail",
+                  "frame after a large frame was corrupted");
+      }
+      buffer.Compact();
+    }
+    Require(parsed == 2, "split frames were not all parsed");
+    Require(buffer.Buffered() == 0 && buffer.Capacity() == 0,
+            "drained buffer did not release its storage");
+    Require(buffer.Prepare().size() == 16,
+            "buffer did not reallocate its initial capacity");
+  }
+
+  {
+    ReceiveBuffer buffer(64, 32);
+    const std::string bytes = EncodeFrame(9, std::string(33, 'y'));
+    std::size_t offset = 0;
+    Feed(buffer, bytes, offset, bytes.size());
+    ReceiveBuffer::Frame frame;
+    Require(buffer.Next(frame) == ReceiveBuffer::ParseStatus::Oversized &&
+                buffer.PendingPayloadSize() == 33,
+            "oversized frame was accepted");
+  }
+  return EXIT_SUCCESS;
+}
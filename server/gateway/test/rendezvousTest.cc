@@ -0,0 +1,99 @@
+#include "Rendezvous.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using wimi::connection::RendezvousNodeKey;
+using wimi::connection::SelectRendezvous;
+
+constexpr uint64_t kConversations = 200000;
+
+struct Candidate {
+  uint64_t key{0};
+  uint32_t weight{1};
+};
+
+void Require(bool condition, const std::string &message) {
+  if (condition)
+    return;
+  std::cerr << message << '\n';
+  std::exit(EXIT_FAILURE);
+}
+
+std::vector<Candidate> MakeCandidates(const std::vector<uint32_t> &weights) {
+  std::vector<Candidate> candidates;
+  for (std::size_t i = 0; i < weights.size(); ++i)
+    candidates.push_back(
+        Candidate{RendezvousNodeKey("message-" + std::to_string(i + 1)),
+                  weights[i]});
+  return candidates;
+}
+
+const auto kAll = [](const Candidate &) { return true; };
+
+void TestEqualWeightsSpreadEvenly() {
+  const auto candidates = MakeCandidates({1, 1, 1, 1});
+  std::vector<uint64_t> counts(candidates.size());
+  for (uint64_t conversation = 1; conversation <= kConversations;
+       ++conversation)
+    ++counts[SelectRendezvous(candidates, conversation, false, kAll)];
+  for (const auto count : counts)
+    Require(count > kConversations / 4 * 9 / 10 &&
+                count < kConversations / 4 * 11 / 10,
+            "equal weights should spread conversations evenly");
+}
+
+void TestWeightsAreProportional() {
+  const auto candidates = MakeCandidates({1, 3});
+  uint64_t heavy = 0;
+  for (uint64_t conversation = 1; conversation <= kConversations;
+       ++conversation)
+    heavy += SelectRendezvous(candidates, conversation, true, kAll) == 1;
+  Require(heavy > kConversations * 72 / 100 &&
+              heavy < kConversations * 78 / 100,
+          "a weight-3 node should take about three quarters");
+}
+
+void TestRemovalOnlyMovesItsConversations() {
+  const auto candidates = MakeCandidates({1, 2, 1, 4, 1, 1, 3, 1});
+  constexpr std::size_t kRemoved = 3;
+  const auto withoutRemoved = [](const Candidate &candidate) {
+    return candidate.key != RendezvousNodeKey("message-4");
+  };
+  for (uint64_t conversation = 1; conversation <= kConversations / 10;
+       ++conversation) {
+    const auto before = SelectRendezvous(candidates, conversation, true, kAll);
+    const auto after =
+        SelectRendezvous(candidates, conversation, true, withoutRemoved);
+    Require(after != kRemoved, "excluded node must not be selected");
+    Require(before == kRemoved || before == after,
+            "conversations on surviving nodes must not move");
+  }
+}
+
+void TestNoEligibleCandidate() {
+  const auto candidates = MakeCandidates({1, 1});
+  Require(SelectRendezvous(candidates, 7, false,
+                           [](const Candidate &) { return false; }) ==
+              candidates.size(),
+          "no eligible node should return size()");
+  const std::vector<Candidate> empty;
+  Require(SelectRendezvous(empty, 7, true, kAll) == 0,
+          "empty candidates should return size()");
+}
+
+}  // namespace
+
+int main() {
+  TestEqualWeightsSpreadEvenly();
+  TestWeightsAreProportional();
+  TestRemovalOnlyMovesItsConversations();
+  TestNoEligibleCandidate();
+  std::cout << "rendezvous tests passed\n";
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+#include "Rendezvous.h"
+#include "SessionDrainer.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using wimi::connection::RendezvousNodeKey;
+using wimi::connection::SessionDrainer;
+
+constexpr int64_t kUsers = 100000;
+
+void Require(bool condition, const std::string &message) {
+  if (condition)
+    return;
+  std::cerr << message << '\n';
+  std::exit(EXIT_FAILURE);
+}
+
+SessionDrainer::Target MakeTarget(const std::string &id, uint32_t weight) {
+  return SessionDrainer::Target{id, "127.0.0.1", 8090, weight,
+                                RendezvousNodeKey(id)};
+}
+
+void TestTargetsSpreadByWeight() {
+  const std::vector<SessionDrainer::Target> targets{
+      MakeTarget("gateway-2", 1), MakeTarget("gateway-3", 1),
+      MakeTarget("gateway-4", 2)};
+  std::vector<int64_t> counts(targets.size());
+  for (int64_t uid = 1; uid <= kUsers; ++uid) {
+    const auto index = SessionDrainer::SelectTarget(targets, uid);
+    Require(index < targets.size(), "every uid should get a target");
+    ++counts[index];
+  }
+  Require(counts[2] > kUsers * 45 / 100 && counts[2] < kUsers * 55 / 100,
+          "a weight-2 gateway should take about half of the sessions");
+  Require(counts[0] > kUsers * 20 / 100 && counts[1] > kUsers * 20 / 100,
+          "weight-1 gateways should share the rest");
+}
+
+void TestTargetIsStable() {
+  std::vector<SessionDrainer::Target> targets{MakeTarget("gateway-2", 1),
+                                              MakeTarget("gateway-3", 1)};
+  std::vector<std::string> before;
+  for (int64_t uid = 1; uid <= 1000; ++uid)
+    before.push_back(targets[SessionDrainer::SelectTarget(targets, uid)].id);
+
+  // 拓扑顺序变化不影响选点；新增节点只带走一部分 uid。
+  targets = {MakeTarget("gateway-3", 1), MakeTarget("gateway-2", 1),
+             MakeTarget("gateway-4", 1)};
+  int moved = 0;
+  for (int64_t uid = 1; uid <= 1000; ++uid) {
+    const auto &id = targets[SessionDrainer::SelectTarget(targets, uid)].id;
+    if (id != before[uid - 1]) {
+      Require(id == "gateway-4", "uids should only move to the new gateway");
+      ++moved;
+    }
+  }
+  Require(moved > 250 && moved < 420,
+          "about a third of the uids should move to the new gateway");
+}
+
+void TestNoTargets() {
+  const std::vector<SessionDrainer::Target> targets;
+  Require(SessionDrainer::SelectTarget(targets, 42) == 0,
+          "no target should be reported as targets.size()");
+}
+
+void TestWaveSize() {
+  SessionDrainer::Policy policy;
+  policy.sessionsPerSecond = 500;
+  policy.waveInterval = std::chrono::milliseconds(200);
+  Require(SessionDrainer::WaveSize(policy) == 100,
+          "500 sessions/s in 200ms waves should close 100 per wave");
+  policy.sessionsPerSecond = 1;
+  policy.waveInterval = std::chrono::milliseconds(10);
+  Require(SessionDrainer::WaveSize(policy) == 1,
+          "every wave should close at least one session");
+}
+
+}  // namespace
+
+int main() {
+  TestTargetsSpreadByWeight();
+  TestTargetIsStable();
+  TestNoTargets();
+  TestWaveSize();
+  std::cout << "session drainer tests passed\n";
+  return EXIT_SUCCESS;
+}
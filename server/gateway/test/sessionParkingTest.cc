@@ -0,0 +1,130 @@
+#include "SessionParking.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using wimi::connection::ParkedWrite;
+using wimi::connection::SessionParking;
+
+void Require(bool condition, const std::string &message) {
+  if (condition)
+    return;
+  std::cerr << message << '\n';
+  std::exit(EXIT_FAILURE);
+}
+
+wimi::TcpPacket Profile(int64_t uid) {
+  wimi::TcpPacket profile;
+  profile.set_uid(uid);
+  profile.set_name("user-" + std::to_string(uid));
+  profile.set_error(ErrorCodes::Success);
+  return profile;
+}
+
+std::vector<ParkedWrite> Writes(std::initializer_list<int64_t> seqs) {
+  std::vector<ParkedWrite> writes;
+  for (const int64_t seq : seqs)
+    writes.push_back(ParkedWrite{
+        seq, std::make_shared<const std::string>("frame-" +
+                                                 std::to_string(seq))});
+  return writes;
+}
+
+void TestParkedSessionResumesOnce() {
+  SessionParking parking(std::chrono::seconds(60), 16);
+  const auto token = parking.Issue(7, Profile(7), {});
+  Require(token.size() == 72, "tokens should be two uuids");
+  parking.Park(token, Writes({3, 4}));
+  Require(parking.Parked() == 1, "a lost session should be parked");
+
+  Require(!parking.Claim(token, 8), "another uid should not claim the token");
+  auto claimed = parking.Claim(token, 7);
+  Require(claimed.has_value(), "the owner should resume within the ttl");
+  Require(claimed->profile.name() == "user-7",
+          "the profile should come from the original login");
+  Require(claimed->writes.size() == 2 && claimed->writes[0].ackSeq == 3 &&
+              *claimed->writes[1].frame == "frame-4",
+          "pending reliable writes should be handed over");
+  Require(!parking.Claim(token, 7), "a token should resume only once");
+  Require(parking.Size() == 0 && parking.Parked() == 0,
+          "a claimed session should leave the parking");
+}
+
+void TestLiveSessionCanBeClaimed() {
+  SessionParking parking(std::chrono::seconds(60), 16);
+  const auto token = parking.Issue(9, Profile(9), {});
+  auto claimed = parking.Claim(token, 9);
+  Require(claimed.has_value() && claimed->writes.empty(),
+          "a reconnect that beats the disconnect should still resume");
+  parking.Park(token, Writes({1}));
+  Require(parking.Parked() == 0,
+          "the old connection should not park after being claimed");
+}
+
+void TestRevokedSessionCannotResume() {
+  SessionParking parking(std::chrono::seconds(60), 16);
+  const auto token = parking.Issue(11, Profile(11), {});
+  parking.Revoke(token);
+  parking.Park(token, Writes({1}));
+  Require(!parking.Claim(token, 11),
+          "a session closed by the gateway should not resume");
+}
+
+void TestRestoredClaimCanResumeAgain() {
+  SessionParking parking(std::chrono::seconds(60), 16);
+  const auto token = parking.Issue(13, Profile(13), {});
+  parking.Park(token, Writes({5, 6}));
+  auto claimed = parking.Claim(token, 13);
+  Require(claimed.has_value(), "the owner should claim the parked session");
+  parking.Restore(token, std::move(*claimed));
+  Require(parking.Parked() == 1,
+          "a failed resume should put the session back into the parking");
+
+  auto retried = parking.Claim(token, 13);
+  Require(retried.has_value(), "the same token should resume after a restore");
+  Require(retried->profile.name() == "user-13" &&
+              retried->writes.size() == 2 && retried->writes[1].ackSeq == 6,
+          "the restored profile and pending writes should be kept");
+  Require(parking.Size() == 0 && parking.Parked() == 0,
+          "a claimed session should leave the parking");
+}
+
+void TestExpiryAndCapacity() {
+  SessionParking expiring(std::chrono::milliseconds(20), 16);
+  const auto stale = expiring.Issue(1, Profile(1), {});
+  expiring.Park(stale, Writes({1}));
+  std::this_thread::sleep_for(std::chrono::milliseconds(40));
+  Require(!expiring.Claim(stale, 1), "parked sessions should expire");
+  Require(expiring.Size() == 0, "expired sessions should be released");
+
+  SessionParking bounded(std::chrono::seconds(60), 2);
+  std::vector<std::string> tokens;
+  for (int64_t uid = 1; uid <= 3; ++uid) {
+    tokens.push_back(bounded.Issue(uid, Profile(uid), {}));
+    bounded.Park(tokens.back(), Writes({uid}));
+  }
+  Require(bounded.Parked() == 2, "parking should stay within maxParked");
+  Require(!bounded.Claim(tokens[0], 1),
+          "the oldest parked session should be evicted first");
+  Require(bounded.Claim(tokens[2], 3).has_value(),
+          "recently parked sessions should survive eviction");
+}
+
+}  // namespace
+
+int main() {
+  TestParkedSessionResumesOnce();
+  TestLiveSessionCanBeClaimed();
+  TestRevokedSessionCannotResume();
+  TestRestoredClaimCanResumeAgain();
+  TestExpiryAndCapacity();
+  std::cout << "session parking tests passed\n";
+  return EXIT_SUCCESS;
+}
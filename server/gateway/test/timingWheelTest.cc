@@ -0,0 +1,143 @@
+#include "TimingWheel.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+using wimi::connection::TimingWheel;
+using std::chrono::milliseconds;
+
+void Require(bool condition, const std::string &message) {
+  if (condition)
+    return;
+  std::cerr << message << '\n';
+  std::exit(EXIT_FAILURE);
+}
+
+struct Fired {
+  TimingWheel::TimerKind kind;
+  int64_t key;
+  uint64_t ticket;
+};
+
+class RecordingListener : public TimingWheel::Listener {
+ public:
+  void OnTimerExpired(TimingWheel::TimerKind kind, int64_t key,
+                      uint64_t ticket) override {
+    fired.push_back(Fired{kind, key, ticket});
+  }
+
+  std::vector<Fired> fired;
+};
+
+// 不启动内部定时器，手动 Tick 推进，结果与时钟无关。
+std::size_t TickTimes(TimingWheel &wheel, std::size_t count) {
+  std::size_t fired = 0;
+  for (std::size_t i = 0; i < count; ++i)
+    fired += wheel.Tick();
+  return fired;
+}
+
+void TestDelayRoundsUpToTick() {
+  boost::asio::io_context ioContext;
+  TimingWheel wheel(ioContext, milliseconds(100), 16);
+  auto listener = std::make_shared<RecordingListener>();
+
+  wheel.Schedule(listener, TimingWheel::TimerKind::TransportRetry, 7, 1,
+                 milliseconds(250));
+  Require(wheel.Pending() == 1, "scheduled entry should be pending");
+  Require(TickTimes(wheel, 2) == 0, "250ms must not fire after two ticks");
+  Require(TickTimes(wheel, 1) == 1, "250ms should fire on the third tick");
+  Require(listener->fired.size() == 1 && listener->fired[0].key == 7 &&
+              listener->fired[0].ticket == 1 &&
+              listener->fired[0].kind ==
+                  TimingWheel::TimerKind::TransportRetry,
+          "fired entry should carry kind, key and ticket");
+  Require(wheel.Pending() == 0, "fired entry should leave the wheel");
+}
+
+void TestLongDelayWrapsAroundSlots() {
+  boost::asio::io_context ioContext;
+  TimingWheel wheel(ioContext, milliseconds(10), 16);
+  auto listener = std::make_shared<RecordingListener>();
+
+  // 16 个槽、每槽 10ms，一圈 160ms；500ms 需要绕三圈多。
+  wheel.Schedule(listener, TimingWheel::TimerKind::IdleRead, 0, 3,
+                 milliseconds(500));
+  wheel.Schedule(listener, TimingWheel::TimerKind::IdleRead, 0, 4,
+                 milliseconds(20));
+  Require(TickTimes(wheel, 2) == 1, "short entry should fire first");
+  Require(TickTimes(wheel, 47) == 0, "long entry must survive earlier laps");
+  Require(TickTimes(wheel, 1) == 1, "long entry should fire on tick 50");
+  Require(listener->fired.back().ticket == 3,
+          "long entry should keep its ticket");
+}
+
+void TestExpiredListenerIsSkipped() {
+  boost::asio::io_context ioContext;
+  TimingWheel wheel(ioContext, milliseconds(10), 16);
+  auto listener = std::make_shared<RecordingListener>();
+  wheel.Schedule(listener, TimingWheel::TimerKind::TransportRetry, 1, 1,
+                 milliseconds(10));
+  listener.reset();
+  Require(TickTimes(wheel, 1) == 0, "destroyed listener must not be called");
+  Require(wheel.Pending() == 0, "entry of destroyed listener is discarded");
+}
+
+// 重传到期后在回调里重新登记，是 GatewaySession 的典型用法。
+class RearmingListener : public TimingWheel::Listener {
+ public:
+  explicit RearmingListener(TimingWheel &wheel) : wheel(wheel) {}
+
+  void OnTimerExpired(TimingWheel::TimerKind kind, int64_t key,
+                      uint64_t ticket) override {
+    ++attempts;
+    if (attempts < 3)
+      wheel.Schedule(self, kind, key, ticket + 1, milliseconds(20));
+  }
+
+  TimingWheel &wheel;
+  std::weak_ptr<RearmingListener> self;
+  unsigned int attempts{0};
+};
+
+void TestRescheduleFromCallback() {
+  boost::asio::io_context ioContext;
+  TimingWheel wheel(ioContext, milliseconds(10), 16);
+  auto listener = std::make_shared<RearmingListener>(wheel);
+  listener->self = listener;
+  wheel.Schedule(listener, TimingWheel::TimerKind::TransportRetry, 9, 1,
+                 milliseconds(20));
+  Require(TickTimes(wheel, 6) == 3, "three attempts should fire in 60ms");
+  Require(listener->attempts == 3, "listener should stop after 3 attempts");
+  Require(TickTimes(wheel, 16) == 0, "no entry should remain after last try");
+}
+
+void TestTickerDrivesWheel() {
+  boost::asio::io_context ioContext;
+  TimingWheel wheel(ioContext, milliseconds(5), 16);
+  auto listener = std::make_shared<RecordingListener>();
+  wheel.Schedule(listener, TimingWheel::TimerKind::IdleRead, 0, 1,
+                 milliseconds(10));
+  wheel.Start();
+  ioContext.run_for(milliseconds(200));
+  wheel.Stop();
+  Require(listener->fired.size() == 1, "ticker should advance the wheel");
+}
+
+}  // namespace
+
+int main() {
+  TestDelayRoundsUpToTick();
+  TestLongDelayWrapsAroundSlots();
+  TestExpiredListenerIsSkipped();
+  TestRescheduleFromCallback();
+  TestTickerDrivesWheel();
+  std::cout << "timing wheel tests passed\n";
+  return EXIT_SUCCESS;
+}
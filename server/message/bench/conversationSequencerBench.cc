@@ -0,0 +1,117 @@
+#include "AcceptBatcher.h"
+#include "ConversationSequencer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 单个热点会话的写入吞吐对比。旧路径在整个事务期间持有 conversations
+// 行锁；新路径先在内存里分配序号，只在提交前推进 latestSeq 时短暂加锁。
+// 行锁用互斥量代替，事务里的往返用 sleep 模拟，差异只来自锁的持有范围。
+// 攒批路径经 GroupAcceptBatcher 把并发写入合成一个事务，每个提交者
+// 阻塞等自己的结果。另测 OwnerConversationSequencer 在同一会话上的纯
+// 分配开销。
+// 用法：conversationSequencerBench [threads] [transactionMicroseconds]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+constexpr int64_t kConversationId = 9001002;
+constexpr auto kRun = std::chrono::milliseconds(500);
+
+template <typename Accept>
+double AcceptsPerSecond(int threads, Accept accept) {
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> accepted{0};
+  std::vector<std::thread> workers;
+  const auto started = Clock::now();
+  for (int i = 0; i < threads; ++i) {
+    workers.emplace_back([&] {
+      uint64_t local = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        accept();
+        ++local;
+      }
+      accepted.fetch_add(local, std::memory_order_relaxed);
+    });
+  }
+  std::this_thread::sleep_for(kRun);
+  stop.store(true, std::memory_order_relaxed);
+  for (auto &worker : workers)
+    worker.join();
+  const double seconds =
+      std::chrono::duration<double>(Clock::now() - started).count();
+  return static_cast<double>(accepted.load()) / seconds;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const int threads = argc > 1 ? std::atoi(argv[1]) : 16;
+  const auto transaction =
+      std::chrono::microseconds(argc > 2 ? std::atoi(argv[2]) : 500);
+  // 读好友关系、查重、插入消息各一次往返，最后的 UPDATE 约占其中四分之一。
+  const auto finalUpdate = transaction / 4;
+
+  std::mutex rowLock;
+  int64_t latestSeq = 0;
+  const double rowLocked = AcceptsPerSecond(threads, [&] {
+    std::lock_guard<std::mutex> lock(rowLock);
+    std::this_thread::sleep_for(transaction);
+    ++latestSeq;
+  });
+
+  wimi::db::OwnerConversationSequencer sequencer;
+  latestSeq = 0;
+  const double sequenced = AcceptsPerSecond(threads, [&] {
+    const auto range = sequencer.Allocate(kConversationId, 1, 0, 0);
+    std::this_thread::sleep_for(transaction - finalUpdate);
+    std::lock_guard<std::mutex> lock(rowLock);
+    std::this_thread::sleep_for(finalUpdate);
+    latestSeq = std::max(latestSeq, range.first);
+  });
+
+  latestSeq = 0;
+  wimi::GroupAcceptBatcher batcher(
+      wimi::GroupAcceptBatcher::Policy{64, std::chrono::microseconds(200)},
+      [&](int64_t, const std::vector<wimi::db::GroupTextCommand> &commands) {
+        const auto range = sequencer.Allocate(
+            kConversationId, static_cast<int64_t>(commands.size()), 0, 0);
+        std::this_thread::sleep_for(transaction - finalUpdate);
+        std::lock_guard<std::mutex> lock(rowLock);
+        std::this_thread::sleep_for(finalUpdate);
+        latestSeq = std::max(latestSeq, range.first + range.count - 1);
+        return std::vector<wimi::db::GroupMessageAcceptResult>(
+            commands.size());
+      });
+  const double batched = AcceptsPerSecond(threads, [&] {
+    std::promise<void> accepted;
+    auto done = accepted.get_future();
+    batcher.Submit(kConversationId, wimi::db::GroupTextCommand{},
+                   [&](wimi::db::GroupMessageAcceptResult) {
+                     accepted.set_value();
+                   });
+    done.wait();
+  });
+
+  wimi::db::OwnerConversationSequencer allocator;
+  const double allocations = AcceptsPerSecond(threads, [&] {
+    if (!allocator.Allocate(kConversationId, 1, 0, 0).Valid())
+      std::cerr << "unexpected invalid range\n";
+  });
+
+  std::cout << "threads=" << threads
+            << " transaction_us=" << transaction.count()
+            << " row_lock_accepts_per_s=" << rowLocked
+            << " sequencer_accepts_per_s=" << sequenced
+            << " batched_accepts_per_s=" << batched
+            << " owner_allocations_per_s=" << allocations << '\n';
+  return EXIT_SUCCESS;
+}
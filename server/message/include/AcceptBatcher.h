@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Mysql.h"
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace wimi {
+
+// 群文本写入攒批：同一个群的并发 accept 合成一批，一个事务内分配一段
+// 连续序号并用一条多行 INSERT 落库，热点群上多个事务排队等同一行锁的
+// 时间变成一批的吞吐。提交者只入批即返回，不占住工作线程：攒满
+// batchSize 时由最后入批的提交者在本线程上写入；否则由批的定时器在
+// window 到期后把写入交给 Dispatch。关批之后到达的命令开启下一批。
+// batchSize <= 1 或 window 为 0 时逐条写入。
+class GroupAcceptBatcher {
+ public:
+  struct Policy {
+    std::size_t batchSize{64};
+    std::chrono::microseconds window{500};
+  };
+  // 结果与 commands 同序。
+  using Accept = std::function<std::vector<db::GroupMessageAcceptResult>(
+      int64_t groupId, const std::vector<db::GroupTextCommand> &commands)>;
+  // 在执行这一批写入的线程上调用。
+  using Completion = std::function<void(db::GroupMessageAcceptResult)>;
+  // 把到期的批交给工作线程写入；返回 false 时在定时器线程上直接写入。
+  using Dispatch = std::function<bool(std::function<void()>)>;
+
+  GroupAcceptBatcher(Policy policy, Accept accept, Dispatch dispatch);
+  // 未到期的批在析构线程上写完后返回。
+  ~GroupAcceptBatcher();
+
+  void Submit(int64_t groupId, db::GroupTextCommand command, Completion done);
+
+ private:
+  struct Batch {
+    std::vector<db::GroupTextCommand> commands;
+    std::vector<Completion> completions;
+  };
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    std::unordered_map<int64_t, std::shared_ptr<Batch>> open;
+  };
+  static constexpr std::size_t kShards = 64;
+
+  Shard &ShardFor(int64_t groupId);
+  // 窗口到期：批仍未被攒满摘下时由这里关批。
+  void Expire(int64_t groupId, const std::shared_ptr<Batch> &batch);
+  void Flush(int64_t groupId, Batch &batch);
+
+  Policy policy;
+  Accept accept;
+  Dispatch dispatch;
+  std::array<Shard, kShards> shards;
+  std::atomic<bool> stopping{false};
+  // 所有批的窗口定时器共用一个线程，到期只做关批与转交，不执行写入。
+  boost::asio::io_context timers;
+  std::optional<
+      boost::asio::executor_work_guard<boost::asio::io_context::executor_type>>
+      timersWork;
+  std::thread timerThread;
+};
+
+}  // namespace wimi
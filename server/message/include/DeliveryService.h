@@ -13,8 +13,10 @@ class GatewayStreamService;
 class DeliveryService {
  public:
   void SetGatewayStreamService(rpc::GatewayStreamService *service);
+  // transportSeq 与 packet.seq 一致，Gateway 据此做传输 ACK 重传而无需反解包。
   bool SendGateway(int64_t uid, const std::string &packet, uint32_t protocolId,
-                   int64_t deliveryId = 0, int64_t messageId = 0,
+                   int64_t transportSeq, int64_t deliveryId = 0,
+                   int64_t messageId = 0,
                    int64_t conversationId = 0,
                    int64_t conversationSeq = 0) const;
   void Acknowledge(int64_t uid, int64_t seq) const;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "GatewayStreamTable.h"
+#include "MulticastAckTracker.h"
 #include "gateway_message.grpc.pb.h"
 
 #include <grpcpp/support/server_callback.h>
@@ -8,6 +10,7 @@
 #include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace wimi::db {
 struct SessionLease;
@@ -27,32 +30,56 @@ class GatewayStreamService final
                           gateway::MessageToGatewayFrame> *
   Connect(grpc::CallbackServerContext *context) override;
 
+  // 同一 Gateway 实例可以并行注册多条流，streamIndex 相同的重连流替换
+  // 旧流；新 instance 或热重启后的新进程（processEpoch 不同）注册时取代
+  // 旧一代的全部流，旧流在断开前仍能回复已收到的命令。streamCount 为
+  // Gateway 声明的流总数，投递按它选流。
   void Register(const std::string &gatewayId, const std::string &instanceId,
-                GatewayStreamReactor *reactor);
+                uint64_t processEpoch, GatewayStreamReactor *reactor,
+                uint32_t protocolVersion, uint32_t streamIndex,
+                uint32_t streamCount);
   void Unregister(const std::string &gatewayId, const std::string &instanceId,
-                  GatewayStreamReactor *reactor);
+                  uint64_t processEpoch, GatewayStreamReactor *reactor);
   bool Deliver(const db::SessionLease &lease,
                gateway::DeliveryEnvelope envelope);
   bool DeliverToUser(int64_t recipientUid, gateway::DeliveryEnvelope envelope);
-  bool Reply(const std::string &gatewayId, const std::string &instanceId,
-             GatewayStreamReactor *reactor,
+  // 群消息扇出：一次 MGET 取回所有接收者的 lease，按 Gateway 分组后每个
+  // v3 流只发一条 MulticastDelivery；旧版本流和路由已变化的接收者退回
+  // 逐人 DeliveryEnvelope。返回已入队的接收者数。
+  std::size_t DeliverToUsers(const std::vector<int64_t> &recipientUids,
+                             const gateway::DeliveryEnvelope &prototype);
+  // 按 MulticastDeliveryAck 逐个接收者记录投递结果；路由已过期的接收者
+  // 在后台线程按逐人路径重投一次。
+  void ResolveMulticast(const std::string &gatewayId,
+                        const gateway::MulticastDeliveryAck &ack);
+  // 命令从哪条流进来，结果和撤回查询就回到哪条流。
+  struct CommandOrigin {
+    std::string gatewayId;
+    std::string instanceId;
+    uint64_t processEpoch{0};
+    GatewayStreamReactor *reactor{nullptr};
+  };
+  bool Reply(const CommandOrigin &origin,
              gateway::MessageToGatewayFrame frame);
+  // worker 执行命令前调用：Gateway 已撤回该命令（对冲落败）时返回 true。
+  bool TakeCancelled(const CommandOrigin &origin, uint64_t requestSeq);
   void DrainAll(const std::string &reason);
   const std::string &MessageNodeId() const;
   bool RequirePeerIdentity() const;
   bool Draining() const;
 
  private:
-  struct RegisteredStream {
-    std::string instanceId;
-    GatewayStreamReactor *reactor{nullptr};
-  };
+  using StreamTable = GatewayStreamTable<GatewayStreamReactor>;
 
   std::string messageNodeId;
   bool requirePeerIdentity{false};
   std::atomic<bool> draining{false};
   std::mutex streamsMutex;
-  std::unordered_map<std::string, RegisteredStream> streams;
+  // 投递按会话（无会话时按接收者）选流，同一会话的投递保持有序。
+  StreamTable streams;
+  // 锁序：可以在持有 streamsMutex 时获取，反之不行。
+  std::mutex multicastMutex;
+  MulticastAckTracker multicastAcks;
 };
 
 }  // namespace wimi::rpc
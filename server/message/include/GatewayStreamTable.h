@@ -0,0 +1,180 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace wimi::rpc {
+
+// 各 Gateway 实例注册到本节点的流。reactor 只作为不透明指针保存，调用方
+// 负责加锁与 reactor 的生命周期。
+//
+// 一个 Gateway 的流按 (instanceId, processEpoch) 归属一代。新一代注册
+// 后投递只走新一代；被取代的流（旧实例、热重启前的旧进程、同槽位的
+// 旧连接）不再参与选流，但在各自注销前仍可回复已收到的命令，旧进程
+// 交接期间在途命令照常完成。
+template <typename Reactor>
+class GatewayStreamTable {
+ public:
+  struct Stream {
+    Reactor *reactor{nullptr};
+    uint32_t protocolVersion{1};
+    uint32_t streamIndex{0};
+  };
+  struct Streams {
+    std::string instanceId;
+    uint64_t processEpoch{0};
+    // Gateway 声明的并行流总数；旧版本为 0，退回按已注册流数取模。
+    uint32_t streamCount{0};
+    // 按 streamIndex 升序。
+    std::vector<Stream> streams;
+  };
+
+  // streamIndex 相同的重连流替换旧流；新一代注册时取代旧一代的全部流。
+  // 返回这一代当前的流数。
+  std::size_t Register(const std::string &gatewayId,
+                       const std::string &instanceId, uint64_t processEpoch,
+                       Stream stream, uint32_t streamCount) {
+    auto &registered = gateways[gatewayId];
+    if (registered.instanceId != instanceId ||
+        registered.processEpoch != processEpoch) {
+      for (const auto &previous : registered.streams)
+        Retire(gatewayId, registered, previous);
+      registered.instanceId = instanceId;
+      registered.processEpoch = processEpoch;
+      registered.streams.clear();
+    }
+    registered.streamCount = streamCount;
+    auto slot = std::lower_bound(
+        registered.streams.begin(), registered.streams.end(),
+        stream.streamIndex, [](const Stream &current, uint32_t index) {
+          return current.streamIndex < index;
+        });
+    if (slot != registered.streams.end() &&
+        slot->streamIndex == stream.streamIndex) {
+      if (slot->reactor != stream.reactor)
+        Retire(gatewayId, registered, *slot);
+      *slot = stream;
+    } else {
+      registered.streams.insert(slot, stream);
+    }
+    retired.erase(stream.reactor);
+    return registered.streams.size();
+  }
+
+  // 返回是否确实移除了该流；一代的最后一条流移除后整项删除。
+  bool Unregister(const std::string &gatewayId, const std::string &instanceId,
+                  uint64_t processEpoch, const Reactor *reactor) {
+    bool erased = false;
+    auto previous = retired.find(reactor);
+    if (previous != retired.end() &&
+        previous->second.Matches(gatewayId, instanceId, processEpoch)) {
+      retired.erase(previous);
+      erased = true;
+    }
+    auto found = gateways.find(gatewayId);
+    if (found == gateways.end() || found->second.instanceId != instanceId ||
+        found->second.processEpoch != processEpoch)
+      return erased;
+    erased |=
+        std::erase_if(found->second.streams, [reactor](const Stream &stream) {
+          return stream.reactor == reactor;
+        }) > 0;
+    if (found->second.streams.empty())
+      gateways.erase(found);
+    return erased;
+  }
+
+  // gatewayId 当前实例为 instanceId 时返回它的流，否则返回 nullptr。
+  const Streams *Find(const std::string &gatewayId,
+                      const std::string &instanceId) const {
+    auto found = gateways.find(gatewayId);
+    if (found == gateways.end() || found->second.instanceId != instanceId)
+      return nullptr;
+    return &found->second;
+  }
+
+  const Streams *Find(const std::string &gatewayId) const {
+    auto found = gateways.find(gatewayId);
+    return found == gateways.end() ? nullptr : &found->second;
+  }
+
+  // reactor 仍是这一代注册过且未注销的流时返回 true，包括已被取代的流；
+  // 命令结果与撤回只在这种情况下交给 reactor。
+  bool Contains(const std::string &gatewayId, const std::string &instanceId,
+                uint64_t processEpoch, const Reactor *reactor) const {
+    auto previous = retired.find(reactor);
+    if (previous != retired.end())
+      return previous->second.Matches(gatewayId, instanceId, processEpoch);
+    auto found = gateways.find(gatewayId);
+    return found != gateways.end() &&
+           found->second.instanceId == instanceId &&
+           found->second.processEpoch == processEpoch &&
+           std::any_of(found->second.streams.begin(),
+                       found->second.streams.end(),
+                       [reactor](const Stream &stream) {
+                         return stream.reactor == reactor;
+                       });
+  }
+
+  // 按 Gateway 声明的流总数取模定槽位，同一会话始终落在同一条流上；
+  // 某条流断开时只有原本落在它上面的 key 改走其余流，其他流上的会话
+  // 不受影响。streams 不能为空。
+  static const Stream &Pick(const Streams &registered, int64_t key) {
+    const auto &streams = registered.streams;
+    const uint64_t hash = static_cast<uint64_t>(key);
+    if (registered.streamCount == 0)
+      return streams[hash % streams.size()];
+    const auto index = static_cast<uint32_t>(hash % registered.streamCount);
+    auto slot = std::lower_bound(
+        streams.begin(), streams.end(), index,
+        [](const Stream &current, uint32_t wanted) {
+          return current.streamIndex < wanted;
+        });
+    if (slot != streams.end() && slot->streamIndex == index)
+      return *slot;
+    return streams[hash % streams.size()];
+  }
+
+  // 遍历所有未注销的流，包括已被取代的流。
+  template <typename Visit>
+  void ForEach(Visit &&visit) const {
+    for (const auto &[_, registered] : gateways) {
+      for (const auto &stream : registered.streams)
+        visit(stream);
+    }
+    for (const auto &[_, previous] : retired)
+      visit(previous.stream);
+  }
+
+  std::size_t Retired() const { return retired.size(); }
+
+ private:
+  struct RetiredStream {
+    std::string gatewayId;
+    std::string instanceId;
+    uint64_t processEpoch{0};
+    Stream stream;
+
+    bool Matches(const std::string &gateway, const std::string &instance,
+                 uint64_t epoch) const {
+      return gatewayId == gateway && instanceId == instance &&
+             processEpoch == epoch;
+    }
+  };
+
+  void Retire(const std::string &gatewayId, const Streams &registered,
+              const Stream &stream) {
+    retired.insert_or_assign(
+        stream.reactor, RetiredStream{gatewayId, registered.instanceId,
+                                      registered.processEpoch, stream});
+  }
+
+  std::unordered_map<std::string, Streams> gateways;
+  std::unordered_map<const Reactor *, RetiredStream> retired;
+};
+
+}  // namespace wimi::rpc
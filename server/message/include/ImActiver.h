@@ -16,6 +16,7 @@
 #include <atomic>
 #include <csignal>
 #include <cstddef>
+#include <filesystem>
 #include <thread>
 namespace wimi {
 class ImServiceRunner : public Singleton<ImServiceRunner> {
@@ -65,10 +66,34 @@ class ImServiceRunner : public Singleton<ImServiceRunner> {
       builder.AddChannelArgument(GRPC_ARG_ALLOW_REUSEPORT, 0);
       builder.AddListeningPort(address,
                                BuildServerCredentials(transportSecurity));
+      // 同机 Gateway 走 Unix 域套接字，省掉 TCP 回环协议栈；服务与凭据
+      // 与 TCP 端口完全相同，帧语义不变。
+      std::string localSocket;
+      if (config["self"]["localSocket"]) {
+        localSocket = config["self"]["localSocket"].as<std::string>();
+        // 只清理上次运行遗留的套接字文件；路径被其他文件占用时放弃本机
+        // 监听，Gateway 退回 TCP。
+        std::error_code statusError;
+        const auto status =
+            std::filesystem::symlink_status(localSocket, statusError);
+        if (std::filesystem::exists(status) &&
+            !std::filesystem::is_socket(status)) {
+          LOG_ERROR(wimi::businessLogger,
+                    "local socket path {} exists and is not a socket",
+                    localSocket);
+          localSocket.clear();
+        } else {
+          std::error_code removeError;
+          std::filesystem::remove(localSocket, removeError);
+          builder.AddListeningPort("unix:" + localSocket,
+                                   BuildServerCredentials(transportSecurity));
+        }
+      }
       builder.RegisterService(&gatewayStreamService);
       rpcServer = builder.BuildAndStart();
-      LOG_INFO(wimi::businessLogger, "IM RPC服务启动成功, 监听端口: {}",
-               rpcPort);
+      LOG_INFO(wimi::businessLogger,
+               "IM RPC服务启动成功, 监听端口: {}, 本机套接字: {}", rpcPort,
+               localSocket.empty() ? "-" : localSocket);
 
       rpcRunThread = std::thread([&]() { rpcServer->Wait(); });
 
@@ -1,7 +1,11 @@
 #pragma once
 
+#include "AcceptBatcher.h"
+#include "ConversationSequencer.h"
 #include "TcpMessageCodec.h"
 
+#include <functional>
+#include <memory>
 #include <vector>
 
 namespace wimi {
@@ -24,10 +28,14 @@ class MessageService {
     bool shouldDeliver{false};
   };
 
+  using GroupTextCompletion = std::function<void(AcceptedGroupText)>;
+
   explicit MessageService(DeliveryService &deliveryService);
 
   AcceptedText AcceptText(TcpPacket request);
-  AcceptedGroupText AcceptGroupText(TcpPacket request);
+  // 同一个群的并发写入经 GroupAcceptBatcher 合批落库；done 可能在攒批的
+  // leader 线程上调用，本线程返回时结果未必已经产生。
+  void AcceptGroupText(TcpPacket request, GroupTextCompletion done);
 
   TcpPacket Ack(uint32_t msgID, TcpPacket &request);
   TcpPacket SendText(uint32_t msgID, TcpPacket &request);
@@ -38,6 +46,8 @@ class MessageService {
 
  private:
   DeliveryService &deliveryService;
+  std::unique_ptr<db::ConversationSequencer> sequencer;
+  std::unique_ptr<GroupAcceptBatcher> groupBatcher;
 };
 
 }  // namespace wimi
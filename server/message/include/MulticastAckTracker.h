@@ -0,0 +1,115 @@
+#pragma once
+
+#include "gateway_message.pb.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace wimi::rpc {
+
+// 已发出、等待 Gateway 聚合 ACK 的多播投递。调用方负责加锁。
+//
+// MulticastDeliveryAck 的 recipients 与发出时的 targets 同序，按位置对回
+// 每个接收者，uid 对不上的条目不采信。只保留最近 capacity 次登记，更早
+// 的记录被淘汰，之后才到的 ACK 按未匹配处理。
+class MulticastAckTracker {
+ public:
+  struct Outcome {
+    // delivery_id 已登记且来自发往的 Gateway。
+    bool found{false};
+    std::size_t queued{0};
+    std::size_t offline{0};
+    std::size_t backpressured{0};
+    std::size_t unmatched{0};
+    // 路由已过期的接收者，由调用方按逐人路径重投一次。
+    std::vector<int64_t> staleRecipients;
+    std::shared_ptr<const gateway::DeliveryEnvelope> prototype;
+  };
+
+  explicit MulticastAckTracker(std::size_t capacity) : capacity(capacity) {}
+
+  void Track(const gateway::MulticastDelivery &multicast,
+             const std::string &gatewayId,
+             std::shared_ptr<const gateway::DeliveryEnvelope> prototype) {
+    Pending pending{gatewayId, {}, std::move(prototype)};
+    pending.recipients.reserve(multicast.targets_size());
+    for (const auto &target : multicast.targets())
+      pending.recipients.push_back(target.recipient_uid());
+    if (!pendings.insert_or_assign(multicast.delivery_id(), std::move(pending))
+             .second)
+      return;
+    order.push_back(multicast.delivery_id());
+    while (order.size() > capacity) {
+      pendings.erase(order.front());
+      order.pop_front();
+    }
+  }
+
+  // 入队失败的多播不会有 ACK。
+  void Forget(const std::string &deliveryId) { pendings.erase(deliveryId); }
+
+  Outcome Resolve(const gateway::MulticastDeliveryAck &ack,
+                  const std::string &gatewayId) {
+    Outcome outcome;
+    auto found = pendings.find(ack.delivery_id());
+    if (found == pendings.end() || found->second.gatewayId != gatewayId) {
+      outcome.unmatched = static_cast<std::size_t>(ack.recipients_size());
+      return outcome;
+    }
+    auto pending = std::move(found->second);
+    pendings.erase(found);
+    outcome.found = true;
+    outcome.prototype = std::move(pending.prototype);
+    for (int i = 0; i < ack.recipients_size(); ++i) {
+      const auto &recipient = ack.recipients(i);
+      const auto index = static_cast<std::size_t>(i);
+      if (index >= pending.recipients.size() ||
+          pending.recipients[index] != recipient.recipient_uid()) {
+        ++outcome.unmatched;
+        continue;
+      }
+      switch (recipient.status()) {
+        case gateway::DELIVERY_STATUS_QUEUED:
+          ++outcome.queued;
+          break;
+        case gateway::DELIVERY_STATUS_OFFLINE:
+          ++outcome.offline;
+          break;
+        case gateway::DELIVERY_STATUS_BACKPRESSURED:
+          ++outcome.backpressured;
+          break;
+        case gateway::DELIVERY_STATUS_STALE_ROUTE:
+          outcome.staleRecipients.push_back(recipient.recipient_uid());
+          break;
+        default:
+          ++outcome.unmatched;
+          break;
+      }
+    }
+    return outcome;
+  }
+
+  std::size_t Outstanding() const { return pendings.size(); }
+
+ private:
+  struct Pending {
+    std::string gatewayId;
+    // 与 MulticastDelivery.targets 同序。
+    std::vector<int64_t> recipients;
+    // 逐人重投时复用的推送原型。
+    std::shared_ptr<const gateway::DeliveryEnvelope> prototype;
+  };
+
+  std::size_t capacity;
+  std::unordered_map<std::string, Pending> pendings;
+  // 登记顺序，长度不超过 capacity；已解决的 id 留到轮到淘汰时再出队。
+  std::deque<std::string> order;
+};
+
+}  // namespace wimi::rpc
@@ -0,0 +1,106 @@
+#include "AcceptBatcher.h"
+
+#include "Metrics.h"
+
+#include <boost/asio/steady_timer.hpp>
+#include <utility>
+
+namespace wimi {
+
+GroupAcceptBatcher::GroupAcceptBatcher(Policy policy, Accept accept,
+                                       Dispatch dispatch)
+    : policy(policy),
+      accept(std::move(accept)),
+      dispatch(std::move(dispatch)),
+      timersWork(boost::asio::make_work_guard(timers)),
+      timerThread([this]() { timers.run(); }) {}
+
+GroupAcceptBatcher::~GroupAcceptBatcher() {
+  // 此后到期的批在定时器线程上直接写入，不再转交给可能已停止的线程池；
+  // 未到期的批不等窗口，在这里写完，剩下的定时器随 stop 丢弃。
+  stopping.store(true, std::memory_order_release);
+  for (auto &shard : shards) {
+    std::unordered_map<int64_t, std::shared_ptr<Batch>> open;
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      open.swap(shard.open);
+    }
+    for (auto &[groupId, batch] : open)
+      Flush(groupId, *batch);
+  }
+  timersWork.reset();
+  timers.stop();
+  if (timerThread.joinable())
+    timerThread.join();
+}
+
+void GroupAcceptBatcher::Submit(int64_t groupId, db::GroupTextCommand command,
+                                Completion done) {
+  if (policy.batchSize <= 1 || policy.window.count() <= 0) {
+    Batch batch;
+    batch.commands.push_back(std::move(command));
+    batch.completions.push_back(std::move(done));
+    Flush(groupId, batch);
+    return;
+  }
+
+  auto &shard = ShardFor(groupId);
+  std::unique_lock<std::mutex> lock(shard.mutex);
+  auto open = shard.open.find(groupId);
+  if (open != shard.open.end()) {
+    auto batch = open->second;
+    batch->commands.push_back(std::move(command));
+    batch->completions.push_back(std::move(done));
+    if (batch->commands.size() < policy.batchSize)
+      return;
+    // 攒满由最后入批的提交者关批并写入；定时器到期时发现批已摘下即返回。
+    shard.open.erase(open);
+    lock.unlock();
+    Flush(groupId, *batch);
+    return;
+  }
+
+  auto batch = std::make_shared<Batch>();
+  batch->commands.push_back(std::move(command));
+  batch->completions.push_back(std::move(done));
+  shard.open.emplace(groupId, batch);
+  lock.unlock();
+
+  auto timer = std::make_shared<boost::asio::steady_timer>(timers);
+  timer->expires_after(policy.window);
+  timer->async_wait(
+      [this, groupId, batch, timer](const boost::system::error_code &) {
+        Expire(groupId, batch);
+      });
+}
+
+GroupAcceptBatcher::Shard &GroupAcceptBatcher::ShardFor(int64_t groupId) {
+  return shards[static_cast<uint64_t>(groupId) % kShards];
+}
+
+void GroupAcceptBatcher::Expire(int64_t groupId,
+                                const std::shared_ptr<Batch> &batch) {
+  {
+    auto &shard = ShardFor(groupId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.open.find(groupId);
+    if (found == shard.open.end() || found->second != batch)
+      return;
+    shard.open.erase(found);
+  }
+  if (!stopping.load(std::memory_order_acquire) && dispatch &&
+      dispatch([this, groupId, batch]() { Flush(groupId, *batch); }))
+    return;
+  Flush(groupId, *batch);
+}
+
+void GroupAcceptBatcher::Flush(int64_t groupId, Batch &batch) {
+  Metrics::Increment(Metric::MessageAcceptBatches);
+  Metrics::Increment(Metric::MessageAcceptsBatched, batch.commands.size());
+  auto results = accept(groupId, batch.commands);
+  results.resize(batch.commands.size());
+  for (std::size_t i = 0; i < batch.completions.size(); ++i)
+    batch.completions[i](std::move(results[i]));
+}
+
+}  // namespace wimi
@@ -14,8 +14,9 @@ void DeliveryService::SetGatewayStreamService(
 }
 
 bool DeliveryService::SendGateway(int64_t uid, const std::string &packet,
-                                  uint32_t protocolId, int64_t deliveryId,
-                                  int64_t messageId, int64_t conversationId,
+                                  uint32_t protocolId, int64_t transportSeq,
+                                  int64_t deliveryId, int64_t messageId,
+                                  int64_t conversationId,
                                   int64_t conversationSeq) const {
   auto *service = gatewayStreamService.load(std::memory_order_acquire);
   if (!service)
@@ -32,6 +33,7 @@ bool DeliveryService::SendGateway(int64_t uid, const std::string &packet,
   delivery.set_conversation_id(conversationId);
   delivery.set_conversation_seq(conversationSeq);
   delivery.set_packet(packet);
+  delivery.set_transport_seq(transportSeq);
   return service->DeliverToUser(uid, std::move(delivery));
 }
 
@@ -49,7 +49,7 @@ TcpPacket FriendService::NotifyAddFriend(unsigned int msgID,
   senderRsp.clear_skip_storage();
   senderRsp.set_seq(db::RedisDao::GetInstance()->generateMsgId());
   if (deliveryService.SendGateway(to, SerializeTcpPacket(senderRsp),
-                                  ID_NOTIFY_ADD_FRIEND_REQ)) {
+                                  ID_NOTIFY_ADD_FRIEND_REQ, senderRsp.seq())) {
     rsp.set_error(ErrorCodes::Success);
     return rsp;
   }
@@ -93,7 +93,7 @@ TcpPacket FriendService::ReplyAddFriend(unsigned int msgID,
   senderRsp.set_reply_message(replyMessage);
   senderRsp.set_seq(db::RedisDao::GetInstance()->generateMsgId());
   if (deliveryService.SendGateway(to, SerializeTcpPacket(senderRsp),
-                                  ID_REPLY_ADD_FRIEND_REQ)) {
+                                  ID_REPLY_ADD_FRIEND_REQ, senderRsp.seq())) {
     rsp.set_error(ErrorCodes::Success);
     return rsp;
   }
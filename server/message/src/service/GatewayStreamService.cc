@@ -1,22 +1,41 @@
 #include "GatewayStreamService.h"
 
 #include "Const.h"
+#include "GatewayFrameBatch.h"
 #include "Logger.h"
+#include "Metrics.h"
 #include "Redis.h"
 #include "RequestContext.h"
 #include "Service.h"
+#include "StreamCredit.h"
 #include "TcpMessageCodec.h"
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <deque>
 #include <memory>
+#include <unordered_set>
 #include <utility>
 
 namespace wimi::rpc {
 namespace {
 
 constexpr std::size_t kMaxStreamQueue = 4096;
+// 单条 MulticastDelivery 的目标数上限；超大群按块拆分，单帧远小于 gRPC
+// 接收上限。
+constexpr std::size_t kMaxMulticastTargets = 1024;
+// 等待聚合 ACK 的多播登记上限；正常情况下 ACK 在一个往返内回来。
+constexpr std::size_t kMaxTrackedMulticasts = 8192;
+
+gateway::DeliveryEnvelope RecipientEnvelope(
+    const gateway::DeliveryEnvelope &prototype, int64_t recipientUid) {
+  gateway::DeliveryEnvelope delivery = prototype;
+  delivery.set_delivery_id(prototype.delivery_id() + ":" +
+                           std::to_string(recipientUid));
+  delivery.set_recipient_uid(recipientUid);
+  return delivery;
+}
 
 int64_t NowUnixMilliseconds() {
   return std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -36,23 +55,36 @@ class GatewayStreamReactor final
     StartRead(&readFrame);
   }
 
+  // v5 起投递与多播受 Gateway 授予的信用约束：信用耗尽时在本流按序
+  // 停放，不再继续写入 gRPC 流；每个命令结果为 Gateway 归还一份命令信用。
   bool Enqueue(gateway::MessageToGatewayFrame frame) {
+    bool queued = false;
     bool startWrite = false;
     {
       std::lock_guard<std::mutex> lock(writeMutex);
-      if (finishing || writeQueue.size() >= kMaxStreamQueue)
+      if (finishing)
         return false;
-      writeQueue.push_back(std::move(frame));
-      if (!writeInFlight) {
+      // 即使结果因队列满被丢弃，Gateway 侧的命令也会以超时完成，
+      // 信用照常归还，避免窗口永久缩小。
+      const uint32_t returned =
+          frame.has_command_result() && creditFlowControl
+              ? commandReturn.Consume()
+              : 0;
+      queued = Admit(frame);
+      if (returned > 0) {
+        gateway::MessageToGatewayFrame grant;
+        grant.mutable_credit_grant()->set_credits(returned);
+        writeQueue.push_back(std::move(grant));
+      }
+      if (!writeInFlight && !writeQueue.empty()) {
         writeInFlight = true;
-        writeFrame = std::move(writeQueue.front());
-        writeQueue.pop_front();
+        writeFrames = TakeNextStreamFrame(writeQueue, writeFrame, batching);
         startWrite = true;
       }
     }
     if (startWrite)
       StartWrite(&writeFrame);
-    return true;
+    return queued;
   }
 
   void OnReadDone(bool ok) override {
@@ -64,13 +96,24 @@ class GatewayStreamReactor final
     if (readFrame.has_register_gateway()) {
       HandleRegister(readFrame.register_gateway());
     } else if (readFrame.has_command()) {
-      HandleCommand(readFrame.command());
+      HandleCommand(std::move(*readFrame.mutable_command()));
+    } else if (readFrame.has_command_batch()) {
+      auto *commands = readFrame.mutable_command_batch()->mutable_commands();
+      for (auto &command : *commands)
+        HandleCommand(std::move(command));
     } else if (readFrame.has_heartbeat()) {
       gateway::MessageToGatewayFrame response;
       auto *heartbeat = response.mutable_heartbeat_ack();
       heartbeat->set_sent_at_unix_ms(readFrame.heartbeat().sent_at_unix_ms());
       heartbeat->set_sequence(readFrame.heartbeat().sequence());
       Enqueue(std::move(response));
+    } else if (readFrame.has_credit_grant()) {
+      GrantDeliveryCredits(readFrame.credit_grant().credits());
+    } else if (readFrame.has_command_cancel()) {
+      Cancel(readFrame.command_cancel().request_seq());
+    } else if (readFrame.has_multicast_delivery_ack()) {
+      if (registered)
+        service.ResolveMulticast(gatewayId, readFrame.multicast_delivery_ack());
     }
 
     readFrame.Clear();
@@ -82,12 +125,14 @@ class GatewayStreamReactor final
       FinishOnce();
       return;
     }
+    Metrics::Increment(Metric::GatewayStreamWrites);
+    Metrics::Increment(Metric::GatewayStreamFramesWritten, writeFrames);
+    // 上一次写在途期间积压的结果与投递在这里合并成一个批量帧。
     bool startWrite = false;
     {
       std::lock_guard<std::mutex> lock(writeMutex);
       if (!writeQueue.empty()) {
-        writeFrame = std::move(writeQueue.front());
-        writeQueue.pop_front();
+        writeFrames = TakeNextStreamFrame(writeQueue, writeFrame, batching);
         startWrite = true;
       } else {
         writeInFlight = false;
@@ -97,22 +142,101 @@ class GatewayStreamReactor final
       StartWrite(&writeFrame);
   }
 
+  bool TakeCancelled(uint64_t requestSeq) {
+    std::lock_guard<std::mutex> lock(cancelMutex);
+    return cancelled.erase(requestSeq) > 0;
+  }
+
   void OnDone() override {
-    service.Unregister(gatewayId, instanceId, this);
+    service.Unregister(gatewayId, instanceId, processEpoch, this);
+    std::size_t dropped = 0;
+    {
+      std::lock_guard<std::mutex> lock(writeMutex);
+      dropped = deliveryCredits.Close();
+    }
+    // 消息已持久化，被丢弃的停放投递由客户端重连后拉取补齐。
+    if (dropped > 0)
+      LOG_WARN(netLogger,
+               "Gateway stream closed with deliveries parked for credit, "
+               "gateway: {}, instance: {}, dropped: {}",
+               gatewayId, instanceId, dropped);
     delete this;
   }
 
  private:
+  // 调用方持有写锁。
+  bool Admit(gateway::MessageToGatewayFrame &frame) {
+    if (frame.has_delivery() || frame.has_multicast_delivery()) {
+      using Admission = decltype(deliveryCredits)::Admission;
+      const auto admission = deliveryCredits.Admit(frame);
+      if (admission == Admission::Rejected)
+        return false;
+      if (admission == Admission::Parked)
+        return true;
+    }
+    if (writeQueue.size() >= kMaxStreamQueue)
+      return false;
+    writeQueue.push_back(std::move(frame));
+    return true;
+  }
+
+  // 撤回帧可能晚于命令执行到达，留下的序号不会再被取走；超过流队列
+  // 容量时整体清空，集合大小有界。
+  void Cancel(uint64_t requestSeq) {
+    std::lock_guard<std::mutex> lock(cancelMutex);
+    if (cancelled.size() >= kMaxStreamQueue)
+      cancelled.clear();
+    cancelled.insert(requestSeq);
+  }
+
+  void GrantDeliveryCredits(uint32_t credits) {
+    bool startWrite = false;
+    {
+      std::lock_guard<std::mutex> lock(writeMutex);
+      if (finishing)
+        return;
+      deliveryCredits.Grant(
+          credits, [this](gateway::MessageToGatewayFrame frame) {
+            writeQueue.push_back(std::move(frame));
+          });
+      if (!writeInFlight && !writeQueue.empty()) {
+        writeInFlight = true;
+        writeFrames = TakeNextStreamFrame(writeQueue, writeFrame, batching);
+        startWrite = true;
+      }
+    }
+    if (startWrite)
+      StartWrite(&writeFrame);
+  }
+
   void HandleRegister(const gateway::RegisterGateway &request) {
     gatewayId = request.gateway_id();
     instanceId = request.instance_id();
     streamEpoch = request.stream_epoch();
+    // 旧版本 Gateway 不带进程标识，为 0。
+    processEpoch = request.process_epoch();
+    // Gateway 声明自己支持的最高版本，取双方较小者；v1 Gateway 不会收到
+    // 批量帧。
+    const uint32_t protocolVersion =
+        std::min(request.protocol_version(), kGatewayStreamProtocolVersion);
     const bool valid =
-        request.protocol_version() == 1 && !gatewayId.empty() &&
+        protocolVersion >= 1 && !gatewayId.empty() &&
         !instanceId.empty() && !service.Draining() &&
         (!service.RequirePeerIdentity() || authenticatedPeer == gatewayId);
     if (valid) {
-      service.Register(gatewayId, instanceId, this);
+      {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        batching = protocolVersion >= kGatewayStreamBatchProtocolVersion;
+        // v5：Gateway 在 capacity 中授予初始投递信用；本端授予的命令
+        // 信用随注册结果返回。
+        creditFlowControl =
+            protocolVersion >= kGatewayStreamCreditProtocolVersion;
+        if (creditFlowControl && request.capacity() > 0)
+          deliveryCredits.Enable(request.capacity());
+      }
+      service.Register(gatewayId, instanceId, processEpoch, this,
+                       protocolVersion, request.stream_index(),
+                       request.stream_count());
       registered = true;
     }
 
@@ -121,6 +245,10 @@ class GatewayStreamReactor final
     result->set_accepted(valid);
     result->set_message_node_id(service.MessageNodeId());
     result->set_stream_epoch(streamEpoch);
+    if (valid)
+      result->set_protocol_version(protocolVersion);
+    if (valid && protocolVersion >= kGatewayStreamCreditProtocolVersion)
+      result->set_capacity(kMaxStreamQueue);
     if (!valid)
       result->set_reason(
           "unsupported protocol or gateway identity does not match mTLS peer");
@@ -129,11 +257,14 @@ class GatewayStreamReactor final
 
   void HandleCommand(gateway::CommandEnvelope command) {
     const std::string requestId = command.request_id();
+    const uint64_t requestSeq = command.request_seq();
     const uint32_t serviceId = command.service_id();
-    if (!registered || requestId.empty()) {
+    // v4 Gateway 用 request_seq 配对结果，旧 Gateway 只带 request_id。
+    if (!registered || (requestSeq == 0 && requestId.empty())) {
       gateway::MessageToGatewayFrame responseFrame;
       auto *response = responseFrame.mutable_command_result();
       response->set_request_id(requestId);
+      response->set_request_seq(requestSeq);
       response->set_response_service_id(
           __getServiceResponseId(ServiceID(serviceId)));
       response->set_error(ErrorCodes::AuthenticationRequired);
@@ -148,6 +279,7 @@ class GatewayStreamReactor final
       gateway::MessageToGatewayFrame responseFrame;
       auto *response = responseFrame.mutable_command_result();
       response->set_request_id(requestId);
+      response->set_request_seq(requestSeq);
       response->set_response_service_id(
           __getServiceResponseId(ServiceID(serviceId)));
       response->set_error(ErrorCodes::DeadlineExceeded);
@@ -161,12 +293,11 @@ class GatewayStreamReactor final
     // 通过后，不在 gRPC reactor 回调线程里直接跑业务，
     // 而是投递到 message 的后台线程池。
     // gRPC 流线程只负责收发和轻量分发，真正消息服务逻辑在线程池里跑。
-    const std::string originGatewayId = gatewayId;
-    const std::string originInstanceId = instanceId;
-    auto *originReactor = this;
+    GatewayStreamService::CommandOrigin origin{gatewayId, instanceId,
+                                               processEpoch, this};
     auto *streamService = &service;
     auto accepted = Service::GetInstance()->PostBackgroundTask(
-        [streamService, originGatewayId, originInstanceId, originReactor,
+        [streamService, origin = std::move(origin),
          command = std::move(command)]() mutable {
           const auto remaining = std::chrono::milliseconds(
               command.deadline_unix_ms() - NowUnixMilliseconds());
@@ -181,6 +312,7 @@ class GatewayStreamReactor final
           gateway::MessageToGatewayFrame responseFrame;
           auto *response = responseFrame.mutable_command_result();
           response->set_request_id(command.request_id());
+          response->set_request_seq(command.request_seq());
           response->set_response_service_id(
               __getServiceResponseId(ServiceID(command.service_id())));
 
@@ -191,8 +323,19 @@ class GatewayStreamReactor final
             response->set_error(ErrorCodes::DeadlineExceeded);
             response->set_retryable(true);
             response->set_packet(SerializeTcpPacket(error));
-            streamService->Reply(originGatewayId, originInstanceId,
-                                 originReactor, std::move(responseFrame));
+            streamService->Reply(origin, std::move(responseFrame));
+            return;
+          }
+
+          // 对冲落败的副本不再执行；结果照常返回，命令信用随之归还。
+          if (command.request_seq() != 0 &&
+              streamService->TakeCancelled(origin, command.request_seq())) {
+            auto error = MakeErrorPacket(ErrorCodes::RequestCancelled,
+                                         "command cancelled by gateway");
+            response->set_error(ErrorCodes::RequestCancelled);
+            response->set_retryable(false);
+            response->set_packet(SerializeTcpPacket(error));
+            streamService->Reply(origin, std::move(responseFrame));
             return;
           }
 
@@ -202,8 +345,8 @@ class GatewayStreamReactor final
           // 用户重新登录后，旧连接 generation 不匹配，Message 端会拒绝。
           auto actorLease =
               db::RedisDao::GetInstance()->getSessionLease(command.actor_uid());
-          if (actorLease.empty() || actorLease.gatewayId != originGatewayId ||
-              actorLease.instanceId != originInstanceId ||
+          if (actorLease.empty() || actorLease.gatewayId != origin.gatewayId ||
+              actorLease.instanceId != origin.instanceId ||
               actorLease.connectionId != command.connection_id() ||
               actorLease.generation != command.connection_generation()) {
             auto error =
@@ -212,8 +355,7 @@ class GatewayStreamReactor final
             response->set_error(ErrorCodes::AuthenticationRequired);
             response->set_retryable(false);
             response->set_packet(SerializeTcpPacket(error));
-            streamService->Reply(originGatewayId, originInstanceId,
-                                 originReactor, std::move(responseFrame));
+            streamService->Reply(origin, std::move(responseFrame));
             return;
           }
 
@@ -224,8 +366,7 @@ class GatewayStreamReactor final
             response->set_error(ErrorCodes::JsonParser);
             response->set_retryable(false);
             response->set_packet(SerializeTcpPacket(error));
-            streamService->Reply(originGatewayId, originInstanceId,
-                                 originReactor, std::move(responseFrame));
+            streamService->Reply(origin, std::move(responseFrame));
             return;
           }
           packet.set_uid(command.actor_uid());
@@ -236,8 +377,7 @@ class GatewayStreamReactor final
             response->set_error(TcpPacketError(acceptedText.response));
             response->set_retryable(acceptedText.response.retryable());
             response->set_packet(SerializeTcpPacket(acceptedText.response));
-            streamService->Reply(originGatewayId, originInstanceId,
-                                 originReactor, std::move(responseFrame));
+            streamService->Reply(origin, std::move(responseFrame));
 
             if (acceptedText.shouldDeliver) {
               gateway::DeliveryEnvelope delivery;
@@ -252,6 +392,7 @@ class GatewayStreamReactor final
               delivery.set_conversation_seq(
                   acceptedText.response.conversation_seq());
               delivery.set_packet(SerializeTcpPacket(acceptedText.delivery));
+              delivery.set_transport_seq(acceptedText.delivery.seq());
               streamService->DeliverToUser(acceptedText.recipientUid,
                                            std::move(delivery));
             }
@@ -259,32 +400,38 @@ class GatewayStreamReactor final
           }
 
           if (command.service_id() == ID_GROUP_TEXT_SEND_REQ) {
-            auto acceptedText =
-                Service::GetInstance()->Messages().AcceptGroupText(
-                    std::move(packet));
-            response->set_error(TcpPacketError(acceptedText.response));
-            response->set_retryable(acceptedText.response.retryable());
-            response->set_packet(SerializeTcpPacket(acceptedText.response));
-            streamService->Reply(originGatewayId, originInstanceId,
-                                 originReactor, std::move(responseFrame));
-
-            if (acceptedText.shouldDeliver) {
-              for (const int64_t recipientUid : acceptedText.recipientUids) {
-                gateway::DeliveryEnvelope delivery;
-                delivery.set_delivery_id(
-                    std::to_string(acceptedText.response.message_id()) + ":" +
-                    std::to_string(recipientUid));
-                delivery.set_recipient_uid(recipientUid);
-                delivery.set_protocol_id(ID_GROUP_TEXT_SEND_REQ);
-                delivery.set_message_id(acceptedText.response.message_id());
-                delivery.set_conversation_id(
-                    acceptedText.response.conversation_id());
-                delivery.set_conversation_seq(
-                    acceptedText.response.conversation_seq());
-                delivery.set_packet(SerializeTcpPacket(acceptedText.delivery));
-                streamService->DeliverToUser(recipientUid, std::move(delivery));
-              }
-            }
+            // 结果在执行这一批写入的线程上回来，本工作线程先行返回。
+            Service::GetInstance()->Messages().AcceptGroupText(
+                std::move(packet),
+                [streamService, origin,
+                 responseFrame = std::move(responseFrame)](
+                    MessageService::AcceptedGroupText acceptedText) mutable {
+                  auto *response = responseFrame.mutable_command_result();
+                  response->set_error(TcpPacketError(acceptedText.response));
+                  response->set_retryable(acceptedText.response.retryable());
+                  response->set_packet(
+                      SerializeTcpPacket(acceptedText.response));
+                  streamService->Reply(origin, std::move(responseFrame));
+
+                  // 推送包只序列化一次，按目标 Gateway 聚合后多播。
+                  if (acceptedText.shouldDeliver) {
+                    gateway::DeliveryEnvelope delivery;
+                    delivery.set_delivery_id(
+                        std::to_string(acceptedText.response.message_id()));
+                    delivery.set_protocol_id(ID_GROUP_TEXT_SEND_REQ);
+                    delivery.set_message_id(
+                        acceptedText.response.message_id());
+                    delivery.set_conversation_id(
+                        acceptedText.response.conversation_id());
+                    delivery.set_conversation_seq(
+                        acceptedText.response.conversation_seq());
+                    delivery.set_packet(
+                        SerializeTcpPacket(acceptedText.delivery));
+                    delivery.set_transport_seq(acceptedText.delivery.seq());
+                    streamService->DeliverToUsers(acceptedText.recipientUids,
+                                                  delivery);
+                  }
+                });
             return;
           }
 
@@ -293,14 +440,14 @@ class GatewayStreamReactor final
           response->set_error(TcpPacketError(packetResponse));
           response->set_retryable(isRetryableError(response->error()));
           response->set_packet(SerializeTcpPacket(packetResponse));
-          streamService->Reply(originGatewayId, originInstanceId, originReactor,
-                               std::move(responseFrame));
+          streamService->Reply(origin, std::move(responseFrame));
         });
 
     if (!accepted) {
       gateway::MessageToGatewayFrame responseFrame;
       auto *response = responseFrame.mutable_command_result();
       response->set_request_id(requestId);
+      response->set_request_seq(requestSeq);
       response->set_response_service_id(
           __getServiceResponseId(ServiceID(serviceId)));
       response->set_error(ErrorCodes::ResourceExhausted);
@@ -322,19 +469,31 @@ class GatewayStreamReactor final
   std::string instanceId;
   std::string authenticatedPeer;
   uint64_t streamEpoch{0};
+  uint64_t processEpoch{0};
   gateway::GatewayToMessageFrame readFrame;
   gateway::MessageToGatewayFrame writeFrame;
   std::mutex writeMutex;
   std::deque<gateway::MessageToGatewayFrame> writeQueue;
+  std::size_t writeFrames{0};
   bool writeInFlight{false};
+  // 注册时协商出 v2 后才合并结果与投递。
+  bool batching{false};
+  // 以下三项在写锁内使用。
+  bool creditFlowControl{false};
+  StreamCreditWindow<gateway::MessageToGatewayFrame> deliveryCredits{
+      kMaxStreamQueue, Metric::GatewayStreamDeliveryCredits};
+  StreamCreditReturn commandReturn{kMaxStreamQueue};
   std::atomic<bool> finishing{false};
   bool registered{false};
+  std::mutex cancelMutex;
+  std::unordered_set<uint64_t> cancelled;
 };
 
 GatewayStreamService::GatewayStreamService(std::string messageNodeId,
                                            bool requirePeerIdentity)
     : messageNodeId(std::move(messageNodeId)),
-      requirePeerIdentity(requirePeerIdentity) {}
+      requirePeerIdentity(requirePeerIdentity),
+      multicastAcks(kMaxTrackedMulticasts) {}
 
 grpc::ServerBidiReactor<gateway::GatewayToMessageFrame,
                         gateway::MessageToGatewayFrame> *
@@ -350,35 +509,51 @@ GatewayStreamService::Connect(grpc::CallbackServerContext *context) {
 
 void GatewayStreamService::Register(const std::string &gatewayId,
                                     const std::string &instanceId,
-                                    GatewayStreamReactor *reactor) {
+                                    uint64_t processEpoch,
+                                    GatewayStreamReactor *reactor,
+                                    uint32_t protocolVersion,
+                                    uint32_t streamIndex,
+                                    uint32_t streamCount) {
   std::lock_guard<std::mutex> lock(streamsMutex);
-  streams[gatewayId] = RegisteredStream{instanceId, reactor};
-  LOG_INFO(netLogger, "Gateway stream registered, gateway: {}, instance: {}",
-           gatewayId, instanceId);
+  const auto registered = streams.Register(
+      gatewayId, instanceId, processEpoch,
+      StreamTable::Stream{reactor, protocolVersion, streamIndex}, streamCount);
+  LOG_INFO(netLogger,
+           "Gateway stream registered, gateway: {}, instance: {}, "
+           "stream_index: {}, stream_count: {}, streams: {}, "
+           "protocol_version: {}",
+           gatewayId, instanceId, streamIndex, streamCount, registered,
+           protocolVersion);
 }
 
 void GatewayStreamService::Unregister(const std::string &gatewayId,
                                       const std::string &instanceId,
+                                      uint64_t processEpoch,
                                       GatewayStreamReactor *reactor) {
   std::lock_guard<std::mutex> lock(streamsMutex);
-  auto found = streams.find(gatewayId);
-  if (found == streams.end() || found->second.instanceId != instanceId ||
-      found->second.reactor != reactor)
+  if (!streams.Unregister(gatewayId, instanceId, processEpoch, reactor))
     return;
-  streams.erase(found);
-  LOG_INFO(netLogger, "Gateway stream unregistered, gateway: {}, instance: {}",
-           gatewayId, instanceId);
+  const auto *remaining = streams.Find(gatewayId, instanceId);
+  LOG_INFO(netLogger,
+           "Gateway stream unregistered, gateway: {}, instance: {}, "
+           "remaining_streams: {}",
+           gatewayId, instanceId,
+           remaining == nullptr ? 0 : remaining->streams.size());
 }
 
 bool GatewayStreamService::Deliver(const db::SessionLease &lease,
                                    gateway::DeliveryEnvelope envelope) {
   std::lock_guard<std::mutex> lock(streamsMutex);
-  auto found = streams.find(lease.gatewayId);
-  if (found == streams.end() || found->second.instanceId != lease.instanceId)
+  const auto *registered = streams.Find(lease.gatewayId, lease.instanceId);
+  if (registered == nullptr)
     return false;
+  const int64_t key = envelope.conversation_id() != 0
+                          ? envelope.conversation_id()
+                          : envelope.recipient_uid();
   gateway::MessageToGatewayFrame frame;
   *frame.mutable_delivery() = std::move(envelope);
-  return found->second.reactor->Enqueue(std::move(frame));
+  return StreamTable::Pick(*registered, key).reactor->Enqueue(
+      std::move(frame));
 }
 
 bool GatewayStreamService::DeliverToUser(int64_t recipientUid,
@@ -403,28 +578,182 @@ bool GatewayStreamService::DeliverToUser(int64_t recipientUid,
   return Deliver(refreshed, std::move(envelope));
 }
 
-bool GatewayStreamService::Reply(const std::string &gatewayId,
-                                 const std::string &instanceId,
-                                 GatewayStreamReactor *reactor,
+std::size_t GatewayStreamService::DeliverToUsers(
+    const std::vector<int64_t> &recipientUids,
+    const gateway::DeliveryEnvelope &prototype) {
+  const auto perRecipient = [&prototype](int64_t recipientUid) {
+    return RecipientEnvelope(prototype, recipientUid);
+  };
+  const std::vector<long> uids(recipientUids.begin(), recipientUids.end());
+  const auto leases = db::RedisDao::GetInstance()->getSessionLeases(uids);
+
+  std::size_t queued = 0;
+  std::vector<int64_t> fallback;
+  // 多播 ACK 回报路由过期时按原型逐人重投，多个多播帧共用一份。
+  std::shared_ptr<const gateway::DeliveryEnvelope> shared;
+  if (leases.size() != recipientUids.size()) {
+    // MGET 失败时按逐人路径重试，单人查询各自再判定在线状态。
+    fallback = recipientUids;
+  } else {
+    std::unordered_map<std::string, std::vector<std::size_t>> byGateway;
+    for (std::size_t i = 0; i < leases.size(); ++i) {
+      if (!leases[i].empty())
+        byGateway[leases[i].gatewayId].push_back(i);
+    }
+
+    std::lock_guard<std::mutex> lock(streamsMutex);
+    for (auto &[gatewayId, indexes] : byGateway) {
+      const auto *registered = streams.Find(gatewayId);
+      if (registered == nullptr) {
+        for (const auto index : indexes)
+          fallback.push_back(recipientUids[index]);
+        continue;
+      }
+      // 同一 gatewayId 下 instance 已变化的 lease 说明接收者正在迁移，
+      // 交给逐人路径重新读取 lease。
+      std::vector<std::size_t> current;
+      current.reserve(indexes.size());
+      for (const auto index : indexes) {
+        if (leases[index].instanceId == registered->instanceId)
+          current.push_back(index);
+        else
+          fallback.push_back(recipientUids[index]);
+      }
+      // 同一会话的推送固定走一条流，与单聊投递的选流规则一致。
+      const auto &stream = StreamTable::Pick(
+          *registered, prototype.conversation_id() != 0
+                           ? prototype.conversation_id()
+                           : recipientUids[indexes.front()]);
+      auto *reactor = stream.reactor;
+
+      if (stream.protocolVersion < kGatewayStreamMulticastProtocolVersion) {
+        for (const auto index : current) {
+          gateway::MessageToGatewayFrame frame;
+          *frame.mutable_delivery() = perRecipient(recipientUids[index]);
+          auto *delivery = frame.mutable_delivery();
+          delivery->set_expected_connection_id(leases[index].connectionId);
+          delivery->set_expected_connection_generation(
+              leases[index].generation);
+          if (reactor->Enqueue(std::move(frame)))
+            ++queued;
+        }
+        continue;
+      }
+
+      for (std::size_t first = 0; first < current.size();
+           first += kMaxMulticastTargets) {
+        const std::size_t last =
+            std::min(first + kMaxMulticastTargets, current.size());
+        gateway::MessageToGatewayFrame frame;
+        auto *multicast = frame.mutable_multicast_delivery();
+        multicast->set_delivery_id(prototype.delivery_id() + ":" + gatewayId +
+                                   ":" + std::to_string(first));
+        multicast->set_protocol_id(prototype.protocol_id());
+        multicast->set_message_id(prototype.message_id());
+        multicast->set_conversation_id(prototype.conversation_id());
+        multicast->set_conversation_seq(prototype.conversation_seq());
+        multicast->set_packet(prototype.packet());
+        multicast->set_transport_seq(prototype.transport_seq());
+        multicast->mutable_targets()->Reserve(static_cast<int>(last - first));
+        for (std::size_t i = first; i < last; ++i) {
+          const auto &lease = leases[current[i]];
+          auto *target = multicast->add_targets();
+          target->set_recipient_uid(recipientUids[current[i]]);
+          target->set_expected_connection_id(lease.connectionId);
+          target->set_expected_connection_generation(lease.generation);
+        }
+        if (!shared)
+          shared = std::make_shared<const gateway::DeliveryEnvelope>(prototype);
+        const std::string deliveryId = multicast->delivery_id();
+        {
+          std::lock_guard<std::mutex> trackLock(multicastMutex);
+          multicastAcks.Track(*multicast, gatewayId, shared);
+        }
+        if (reactor->Enqueue(std::move(frame))) {
+          queued += last - first;
+        } else {
+          std::lock_guard<std::mutex> trackLock(multicastMutex);
+          multicastAcks.Forget(deliveryId);
+        }
+      }
+    }
+  }
+
+  for (const int64_t recipientUid : fallback) {
+    if (DeliverToUser(recipientUid, perRecipient(recipientUid)))
+      ++queued;
+  }
+  return queued;
+}
+
+void GatewayStreamService::ResolveMulticast(
+    const std::string &gatewayId, const gateway::MulticastDeliveryAck &ack) {
+  MulticastAckTracker::Outcome outcome;
+  {
+    std::lock_guard<std::mutex> lock(multicastMutex);
+    outcome = multicastAcks.Resolve(ack, gatewayId);
+  }
+  Metrics::Increment(Metric::MessageMulticastRecipientsQueued, outcome.queued);
+  Metrics::Increment(Metric::MessageMulticastRecipientsOffline,
+                     outcome.offline);
+  Metrics::Increment(Metric::MessageMulticastRecipientsBackpressured,
+                     outcome.backpressured);
+  Metrics::Increment(Metric::MessageMulticastRecipientsStaleRoute,
+                     outcome.staleRecipients.size());
+  Metrics::Increment(Metric::MessageMulticastAcksUnmatched, outcome.unmatched);
+  if (!outcome.found) {
+    LOG_DEBUG(netLogger,
+              "Multicast ack not tracked, gateway: {}, delivery: {}",
+              gatewayId, ack.delivery_id());
+    return;
+  }
+  if (outcome.staleRecipients.empty())
+    return;
+
+  // 发出后接收者的连接变了：重新读取 lease 逐人重投一次，结果不再跟踪。
+  // 查 Redis 不能占用 reactor 回调线程。
+  auto accepted = wimi::Service::GetInstance()->PostBackgroundTask(
+      [this, prototype = std::move(outcome.prototype),
+       stale = std::move(outcome.staleRecipients)]() {
+        for (const int64_t recipientUid : stale)
+          DeliverToUser(recipientUid,
+                        RecipientEnvelope(*prototype, recipientUid));
+      });
+  if (!accepted)
+    LOG_WARN(netLogger,
+             "Multicast stale route retry rejected, gateway: {}, delivery: {}",
+             gatewayId, ack.delivery_id());
+}
+
+bool GatewayStreamService::Reply(const CommandOrigin &origin,
                                  gateway::MessageToGatewayFrame frame) {
   std::lock_guard<std::mutex> lock(streamsMutex);
-  auto found = streams.find(gatewayId);
-  if (found == streams.end() || found->second.instanceId != instanceId ||
-      found->second.reactor != reactor)
+  if (!streams.Contains(origin.gatewayId, origin.instanceId,
+                        origin.processEpoch, origin.reactor))
     return false;
-  return reactor->Enqueue(std::move(frame));
+  return origin.reactor->Enqueue(std::move(frame));
+}
+
+bool GatewayStreamService::TakeCancelled(const CommandOrigin &origin,
+                                         uint64_t requestSeq) {
+  // 持有 streamsMutex 期间 reactor 不会被注销和释放。
+  std::lock_guard<std::mutex> lock(streamsMutex);
+  if (!streams.Contains(origin.gatewayId, origin.instanceId,
+                        origin.processEpoch, origin.reactor))
+    return false;
+  return origin.reactor->TakeCancelled(requestSeq);
 }
 
 void GatewayStreamService::DrainAll(const std::string &reason) {
   draining.store(true, std::memory_order_release);
   std::lock_guard<std::mutex> lock(streamsMutex);
-  for (const auto &[_, stream] : streams) {
+  streams.ForEach([&](const StreamTable::Stream &stream) {
     gateway::MessageToGatewayFrame frame;
     auto *notice = frame.mutable_drain_notice();
     notice->set_message_node_id(messageNodeId);
     notice->set_reason(reason);
     stream.reactor->Enqueue(std::move(frame));
-  }
+  });
 }
 
 const std::string &GatewayStreamService::MessageNodeId() const {
@@ -66,7 +66,8 @@ int GroupService::NotifyMemberJoin(int64_t uid, int64_t gid,
     notifyRequest.set_error(ErrorCodes::Success);
     if (deliveryService.SendGateway(manager->uid,
                                     SerializeTcpPacket(notifyRequest),
-                                    ID_GROUP_NOTIFY_JOIN_REQ, serverSeq))
+                                    ID_GROUP_NOTIFY_JOIN_REQ, serverSeq,
+                                    serverSeq))
       continue;
 
     LOG_DEBUG(businessLogger,
@@ -163,7 +164,8 @@ int GroupService::NotifyMemberReply(int64_t gid, int64_t managerUid,
     notifyRequest.set_seq(serverSeq);
     if (deliveryService.SendGateway(member->uid,
                                     SerializeTcpPacket(notifyRequest),
-                                    ID_GROUP_REPLY_JOIN_REQ, serverSeq))
+                                    ID_GROUP_REPLY_JOIN_REQ, serverSeq,
+                                    serverSeq))
       continue;
 
     LOG_DEBUG(businessLogger,
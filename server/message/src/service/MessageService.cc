@@ -1,5 +1,6 @@
 #include "MessageService.h"
 
+#include "Configer.h"
 #include "Const.h"
 #include "DbGlobal.h"
 #include "DeliveryService.h"
@@ -7,13 +8,67 @@
 #include "Mysql.h"
 #include "Redis.h"
 #include "RequestContext.h"
+#include "Service.h"
 
+#include <algorithm>
+#include <chrono>
+#include <exception>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace wimi {
 
+namespace {
+
+// server.sequencer.mode：redis（默认）或 owner，见 conf/README.md。
+std::string SequencerMode() {
+  try {
+    auto sequencer = Configer::getNode("server")["sequencer"];
+    if (sequencer && sequencer["mode"])
+      return sequencer["mode"].as<std::string>();
+  } catch (const std::exception &error) {
+    LOG_ERROR(businessLogger, "invalid sequencer config: {}", error.what());
+  }
+  return "redis";
+}
+
+// server.acceptBatch：enabled 为 false 时群文本逐条落库。
+GroupAcceptBatcher::Policy AcceptBatchPolicy() {
+  GroupAcceptBatcher::Policy policy;
+  try {
+    auto batch = Configer::getNode("server")["acceptBatch"];
+    if (!batch)
+      return policy;
+    if (batch["batchSize"])
+      policy.batchSize = std::max(batch["batchSize"].as<int>(), 1);
+    if (batch["windowMicroseconds"])
+      policy.window = std::chrono::microseconds(
+          std::max(batch["windowMicroseconds"].as<int>(), 0));
+    if (batch["enabled"] && !batch["enabled"].as<bool>())
+      policy.batchSize = 1;
+  } catch (const std::exception &error) {
+    LOG_ERROR(businessLogger, "invalid acceptBatch config: {}", error.what());
+  }
+  return policy;
+}
+
+}  // namespace
+
 MessageService::MessageService(DeliveryService &deliveryService)
-    : deliveryService(deliveryService) {}
+    : deliveryService(deliveryService),
+      sequencer(db::MakeConversationSequencer(SequencerMode())) {
+  groupBatcher = std::make_unique<GroupAcceptBatcher>(
+      AcceptBatchPolicy(),
+      [this](int64_t groupId,
+             const std::vector<db::GroupTextCommand> &commands) {
+        return db::MysqlDao::GetInstance()->acceptGroupTextBatch(
+            *sequencer, groupId, commands);
+      },
+      [](std::function<void()> flush) {
+        return Service::GetInstance()->PostBackgroundTask(std::move(flush));
+      });
+}
 
 MessageService::AcceptedText MessageService::AcceptText(TcpPacket request) {
   AcceptedText result;
@@ -39,7 +94,7 @@ MessageService::AcceptedText MessageService::AcceptText(TcpPacket request) {
 
   const std::string sendDateTime = getCurrentDateTime();
   auto accepted = db::MysqlDao::GetInstance()->acceptDirectText(
-      from, to, clientMessageId, data, sendDateTime);
+      *sequencer, from, to, clientMessageId, data, sendDateTime);
   result.response.set_error(accepted.error);
   result.response.set_retryable(isRetryableError(accepted.error));
   if (accepted.error != ErrorCodes::Success) {
@@ -76,8 +131,8 @@ MessageService::AcceptedText MessageService::AcceptText(TcpPacket request) {
   return result;
 }
 
-MessageService::AcceptedGroupText MessageService::AcceptGroupText(
-    TcpPacket request) {
+void MessageService::AcceptGroupText(TcpPacket request,
+                                     GroupTextCompletion done) {
   AcceptedGroupText result;
   const int64_t clientSeq = request.seq();
   const int64_t sender = request.uid();
@@ -100,46 +155,58 @@ MessageService::AcceptedGroupText MessageService::AcceptGroupText(
     result.response.set_message(
         "actor, gid, data and client_message_id are required");
     result.response.set_retryable(false);
-    return result;
-  }
-
-  const std::string sendDateTime = getCurrentDateTime();
-  auto accepted = db::MysqlDao::GetInstance()->acceptGroupText(
-      sender, groupId, clientMessageId, content, sendDateTime);
-  result.response.set_error(accepted.error);
-  result.response.set_retryable(isRetryableError(accepted.error));
-  if (accepted.error != ErrorCodes::Success) {
-    if (!accepted.diagnostic.empty())
-      LOG_ERROR(dbLogger, "group message accept failed: {}",
-                accepted.diagnostic);
-    result.response.set_message(accepted.diagnostic.empty()
-                                    ? "persistent group message accept failed"
-                                    : accepted.diagnostic);
-    return result;
+    done(std::move(result));
+    return;
   }
 
-  result.response.set_status("accepted");
-  result.response.set_message_id(accepted.messageId);
-  result.response.set_conversation_id(accepted.conversationId);
-  result.response.set_conversation_seq(accepted.conversationSeq);
-  result.response.set_session_key(accepted.conversationId);
-  result.response.set_message_state(protocol::MESSAGE_STATE_ACCEPTED);
-  result.response.set_retryable(false);
-
-  request.set_from(sender);
-  request.set_gid(groupId);
-  request.set_seq(accepted.messageId);
-  request.set_message_id(accepted.messageId);
-  request.set_client_message_id(clientMessageId);
-  request.set_conversation_id(accepted.conversationId);
-  request.set_conversation_seq(accepted.conversationSeq);
-  request.set_session_key(accepted.conversationId);
-  request.set_message_state(protocol::MESSAGE_STATE_ACCEPTED);
-  request.set_send_date_time(sendDateTime);
-  result.delivery = std::move(request);
-  result.recipientUids = std::move(accepted.recipientUids);
-  result.shouldDeliver = !accepted.duplicate;
-  return result;
+  db::GroupTextCommand command;
+  command.senderId = sender;
+  command.clientMessageId = clientMessageId;
+  command.content = content;
+  command.sendDateTime = getCurrentDateTime();
+  const std::string sendDateTime = command.sendDateTime;
+  groupBatcher->Submit(
+      groupId, std::move(command),
+      [result = std::move(result), request = std::move(request), sender,
+       groupId, clientMessageId, sendDateTime,
+       done = std::move(done)](db::GroupMessageAcceptResult accepted) mutable {
+        result.response.set_error(accepted.error);
+        result.response.set_retryable(isRetryableError(accepted.error));
+        if (accepted.error != ErrorCodes::Success) {
+          if (!accepted.diagnostic.empty())
+            LOG_ERROR(dbLogger, "group message accept failed: {}",
+                      accepted.diagnostic);
+          result.response.set_message(
+              accepted.diagnostic.empty()
+                  ? "persistent group message accept failed"
+                  : accepted.diagnostic);
+          done(std::move(result));
+          return;
+        }
+
+        result.response.set_status("accepted");
+        result.response.set_message_id(accepted.messageId);
+        result.response.set_conversation_id(accepted.conversationId);
+        result.response.set_conversation_seq(accepted.conversationSeq);
+        result.response.set_session_key(accepted.conversationId);
+        result.response.set_message_state(protocol::MESSAGE_STATE_ACCEPTED);
+        result.response.set_retryable(false);
+
+        request.set_from(sender);
+        request.set_gid(groupId);
+        request.set_seq(accepted.messageId);
+        request.set_message_id(accepted.messageId);
+        request.set_client_message_id(clientMessageId);
+        request.set_conversation_id(accepted.conversationId);
+        request.set_conversation_seq(accepted.conversationSeq);
+        request.set_session_key(accepted.conversationId);
+        request.set_message_state(protocol::MESSAGE_STATE_ACCEPTED);
+        request.set_send_date_time(sendDateTime);
+        result.delivery = std::move(request);
+        result.recipientUids = std::move(accepted.recipientUids);
+        result.shouldDeliver = !accepted.duplicate;
+        done(std::move(result));
+      });
 }
 
 TcpPacket MessageService::Ack(uint32_t msgID, TcpPacket &request) {
@@ -0,0 +1,214 @@
+#include "AcceptBatcher.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using wimi::GroupAcceptBatcher;
+using wimi::db::GroupMessageAcceptResult;
+using wimi::db::GroupTextCommand;
+
+void Require(bool condition, const std::string &message) {
+  if (condition)
+    return;
+  std::cerr << message << '\n';
+  std::exit(EXIT_FAILURE);
+}
+
+GroupTextCommand Command(long senderId) {
+  GroupTextCommand command;
+  command.senderId = senderId;
+  command.clientMessageId = std::to_string(senderId);
+  return command;
+}
+
+// 假的 accept：记录每一批，按 senderId 回填 messageId；rows 非 0 时只
+// 返回前 rows 条结果。
+struct FakeStore {
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::vector<std::vector<long>> batches;
+  std::vector<std::thread::id> flushThreads;
+  std::vector<GroupMessageAcceptResult> completed;
+  std::size_t rows{0};
+
+  GroupAcceptBatcher::Accept Accept() {
+    return [this](int64_t groupId,
+                  const std::vector<GroupTextCommand> &commands) {
+      std::vector<GroupMessageAcceptResult> results;
+      std::vector<long> senders;
+      for (const auto &command : commands) {
+        senders.push_back(command.senderId);
+        if (rows != 0 && results.size() == rows)
+          continue;
+        GroupMessageAcceptResult result;
+        result.error = 0;
+        result.groupId = groupId;
+        result.messageId = command.senderId;
+        results.push_back(result);
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      batches.push_back(std::move(senders));
+      flushThreads.push_back(std::this_thread::get_id());
+      return results;
+    };
+  }
+
+  GroupAcceptBatcher::Completion Completion() {
+    return [this](GroupMessageAcceptResult result) {
+      std::lock_guard<std::mutex> lock(mutex);
+      completed.push_back(std::move(result));
+      changed.notify_all();
+    };
+  }
+
+  bool WaitCompleted(std::size_t count) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return changed.wait_for(lock, std::chrono::seconds(5),
+                            [&] { return completed.size() >= count; });
+  }
+};
+
+// 按调用次数计数，交给独立线程执行，模拟工作线程池。
+struct FakeWorkers {
+  std::mutex mutex;
+  std::vector<std::thread> threads;
+  std::size_t dispatched{0};
+  bool accepting{true};
+
+  GroupAcceptBatcher::Dispatch Dispatch() {
+    return [this](std::function<void()> task) {
+      std::lock_guard<std::mutex> lock(mutex);
+      ++dispatched;
+      if (!accepting)
+        return false;
+      threads.emplace_back(std::move(task));
+      return true;
+    };
+  }
+
+  ~FakeWorkers() {
+    for (auto &thread : threads)
+      thread.join();
+  }
+};
+
+void TestFullBatchIsWrittenByLastJoiner() {
+  FakeStore store;
+  FakeWorkers workers;
+  {
+    GroupAcceptBatcher batcher({3, std::chrono::seconds(10)}, store.Accept(),
+                               workers.Dispatch());
+    for (long sender = 1; sender <= 3; ++sender)
+      batcher.Submit(7, Command(sender), store.Completion());
+    // 第三条攒满后在提交线程上同步写入，无需等待窗口。
+    Require(store.completed.size() == 3,
+            "a full batch should be written by the last joiner");
+    Require(store.flushThreads.front() == std::this_thread::get_id(),
+            "the filling submit should write the batch itself");
+  }
+  Require(store.batches.size() == 1 &&
+              store.batches.front() == std::vector<long>{1, 2, 3},
+          "all commands should be written in one batch in order");
+  for (std::size_t i = 0; i < store.completed.size(); ++i)
+    Require(store.completed[i].messageId == static_cast<int64_t>(i + 1),
+            "completions should follow submit order");
+  Require(workers.dispatched == 0,
+          "the expired timer of a full batch should not dispatch it again");
+}
+
+void TestWindowClosesBatchOnWorker() {
+  FakeStore store;
+  FakeWorkers workers;
+  GroupAcceptBatcher batcher({64, std::chrono::milliseconds(20)},
+                             store.Accept(), workers.Dispatch());
+  const auto started = std::chrono::steady_clock::now();
+  batcher.Submit(7, Command(1), store.Completion());
+  batcher.Submit(7, Command(2), store.Completion());
+  batcher.Submit(8, Command(3), store.Completion());
+  Require(std::chrono::steady_clock::now() - started <
+              std::chrono::milliseconds(20),
+          "submits should return without waiting for the window");
+  Require(store.WaitCompleted(3), "the window should close open batches");
+  std::lock_guard<std::mutex> lock(store.mutex);
+  Require(store.batches.size() == 2, "each group should close its own batch");
+  for (const auto &thread : store.flushThreads)
+    Require(thread != std::this_thread::get_id(),
+            "expired batches should be written on a worker");
+  Require(workers.dispatched == 2, "each expired batch is dispatched once");
+}
+
+void TestRejectedDispatchWritesOnTimer() {
+  FakeStore store;
+  FakeWorkers workers;
+  workers.accepting = false;
+  GroupAcceptBatcher batcher({64, std::chrono::milliseconds(1)},
+                             store.Accept(), workers.Dispatch());
+  batcher.Submit(7, Command(1), store.Completion());
+  Require(store.WaitCompleted(1),
+          "a batch should still be written when the workers reject it");
+}
+
+void TestShortResultsArePadded() {
+  FakeStore store;
+  store.rows = 1;
+  FakeWorkers workers;
+  GroupAcceptBatcher batcher({2, std::chrono::seconds(10)}, store.Accept(),
+                             workers.Dispatch());
+  batcher.Submit(7, Command(1), store.Completion());
+  batcher.Submit(7, Command(2), store.Completion());
+  Require(store.completed.size() == 2,
+          "every command should complete even if results are missing");
+  Require(store.completed[0].error == 0 && store.completed[0].messageId == 1,
+          "returned results should be delivered");
+  Require(store.completed[1].error != 0,
+          "a missing result should complete as a failure");
+}
+
+void TestDisabledBatchingWritesEachCommand() {
+  FakeStore store;
+  FakeWorkers workers;
+  GroupAcceptBatcher batcher({1, std::chrono::seconds(10)}, store.Accept(),
+                             workers.Dispatch());
+  batcher.Submit(7, Command(1), store.Completion());
+  batcher.Submit(7, Command(2), store.Completion());
+  Require(store.batches.size() == 2 && store.completed.size() == 2,
+          "batchSize 1 should write every command on its own");
+}
+
+void TestDestructorWritesOpenBatches() {
+  FakeStore store;
+  FakeWorkers workers;
+  {
+    GroupAcceptBatcher batcher({64, std::chrono::milliseconds(50)},
+                               store.Accept(), workers.Dispatch());
+    batcher.Submit(7, Command(1), store.Completion());
+  }
+  Require(store.completed.size() == 1,
+          "open batches should be written before the batcher goes away");
+  Require(workers.dispatched == 0,
+          "batches expiring during shutdown should not be dispatched");
+}
+
+}  // namespace
+
+int main() {
+  TestFullBatchIsWrittenByLastJoiner();
+  TestWindowClosesBatchOnWorker();
+  TestRejectedDispatchWritesOnTimer();
+  TestShortResultsArePadded();
+  TestDisabledBatchingWritesEachCommand();
+  TestDestructorWritesOpenBatches();
+  std::cout << "accept batcher tests passed\n";
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+#include "GatewayStreamTable.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace {
+
+struct Reactor {
+  int id{0};
+};
+
+using Table = wimi::rpc::GatewayStreamTable<Reactor>;
+
+void Require(bool condition, const std::string &message) {
+  if (condition)
+    return;
+  std::cerr << message << '\n';
+  std::exit(EXIT_FAILURE);
+}
+
+int Picked(const Table &table, int64_t key) {
+  const auto *registered = table.Find("gateway-1", "instance-1");
+  Require(registered != nullptr, "the instance should be registered");
+  return Table::Pick(*registered, key).reactor->id;
+}
+
+void TestKeysStayOnTheirSlot() {
+  Reactor reactors[4]{{0}, {1}, {2}, {3}};
+  Table table;
+  for (uint32_t i = 0; i < 4; ++i)
+    table.Register("gateway-1", "instance-1", 1,
+                   Table::Stream{&reactors[i], 6, i}, 4);
+  for (int64_t key = 0; key < 64; ++key)
+    Require(Picked(table, key) == key % 4,
+            "keys should map to stream_index = key % stream_count");
+
+  // 流 1 断开：落在其余流上的 key 不动，只有原本属于流 1 的 key 改道。
+  Require(table.Unregister("gateway-1", "instance-1", 1, &reactors[1]),
+          "a registered stream should be removed");
+  for (int64_t key = 0; key < 64; ++key) {
+    const int picked = Picked(table, key);
+    if (key % 4 != 1)
+      Require(picked == key % 4, "surviving streams should keep their keys");
+    else
+      Require(picked != 1, "keys of the missing slot should fall back");
+  }
+
+  // 流 1 重连后收回原来的 key。
+  table.Register("gateway-1", "instance-1", 1,
+                 Table::Stream{&reactors[1], 6, 1}, 4);
+  for (int64_t key = 0; key < 64; ++key)
+    Require(Picked(table, key) == key % 4,
+            "a reconnected stream should take its slot back");
+}
+
+void TestLegacyGatewayWithoutStreamCount() {
+  Reactor reactors[2]{{0}, {1}};
+  Table table;
+  table.Register("gateway-1", "instance-1", 0,
+                 Table::Stream{&reactors[0], 4, 0}, 0);
+  table.Register("gateway-1", "instance-1", 0,
+                 Table::Stream{&reactors[1], 4, 1}, 0);
+  for (int64_t key = 0; key < 8; ++key)
+    Require(Picked(table, key) == key % 2,
+            "without stream_count keys should spread over registered streams");
+}
+
+void TestNewInstanceReplacesStreams() {
+  Reactor previous{0};
+  Reactor current{1};
+  Table table;
+  table.Register("gateway-1", "instance-0", 1, Table::Stream{&previous, 6, 0},
+                 1);
+  table.Register("gateway-1", "instance-1", 1, Table::Stream{&current, 6, 0},
+                 1);
+  Require(table.Find("gateway-1", "instance-0") == nullptr,
+          "the previous instance should no longer receive deliveries");
+  Require(Picked(table, 7) == 1, "deliveries should use the new instance");
+}
+
+void TestRestartedProcessKeepsOldStreamsForReplies() {
+  // 热重启：新进程沿用 instanceId，只有 processEpoch 不同。
+  Reactor old{0};
+  Reactor fresh{1};
+  Table table;
+  table.Register("gateway-1", "instance-1", 11, Table::Stream{&old, 6, 0}, 1);
+  table.Register("gateway-1", "instance-1", 22, Table::Stream{&fresh, 6, 0},
+                 1);
+  Require(Picked(table, 7) == 1, "deliveries should use the new process");
+  Require(table.Contains("gateway-1", "instance-1", 11, &old),
+          "commands read from the old process should still be answerable");
+  Require(!table.Contains("gateway-1", "instance-1", 22, &old),
+          "the old stream should not be reachable under the new epoch");
+  Require(table.Contains("gateway-1", "instance-1", 22, &fresh),
+          "the new process should be answerable");
+  Require(table.Retired() == 1, "the replaced stream should stay retired");
+
+  // 旧进程的流关闭后即不可再回复，新进程不受影响。
+  Require(table.Unregister("gateway-1", "instance-1", 11, &old),
+          "the retired stream should be removed on close");
+  Require(!table.Contains("gateway-1", "instance-1", 11, &old),
+          "a closed stream should no longer be answerable");
+  Require(table.Retired() == 0, "no retired stream should remain");
+  Require(Picked(table, 7) == 1, "the new process should keep its streams");
+}
+
+}  // namespace
+
+int main() {
+  TestKeysStayOnTheirSlot();
+  TestLegacyGatewayWithoutStreamCount();
+  TestNewInstanceReplacesStreams();
+  TestRestartedProcessKeepsOldStreamsForReplies();
+  std::cout << "gateway stream table tests passed\n";
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+#include "MulticastAckTracker.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using wimi::rpc::MulticastAckTracker;
+namespace gateway = wimi::gateway;
+
+void Require(bool condition, const std::string &message) {
+  if (condition)
+    return;
+  std::cerr << message << '\n';
+  std::exit(EXIT_FAILURE);
+}
+
+gateway::MulticastDelivery Multicast(const std::string &deliveryId,
+                                     const std::vector<int64_t> &uids) {
+  gateway::MulticastDelivery multicast;
+  multicast.set_delivery_id(deliveryId);
+  for (const int64_t uid : uids)
+    multicast.add_targets()->set_recipient_uid(uid);
+  return multicast;
+}
+
+gateway::MulticastDeliveryAck Ack(
+    const std::string &deliveryId,
+    const std::vector<std::pair<int64_t, gateway::DeliveryStatus>> &statuses) {
+  gateway::MulticastDeliveryAck ack;
+  ack.set_delivery_id(deliveryId);
+  for (const auto &[uid, status] : statuses) {
+    auto *recipient = ack.add_recipients();
+    recipient->set_recipient_uid(uid);
+    recipient->set_status(status);
+  }
+  return ack;
+}
+
+std::shared_ptr<const gateway::DeliveryEnvelope> Prototype() {
+  auto prototype = std::make_shared<gateway::DeliveryEnvelope>();
+  prototype->set_delivery_id("message-1");
+  return prototype;
+}
+
+void TestStatusesMapBackToRecipients() {
+  MulticastAckTracker tracker(16);
+  tracker.Track(Multicast("m:gw-1:0", {11, 12, 13, 14}), "gw-1", Prototype());
+
+  const auto outcome = tracker.Resolve(
+      Ack("m:gw-1:0", {{11, gateway::DELIVERY_STATUS_QUEUED},
+                       {12, gateway::DELIVERY_STATUS_OFFLINE},
+                       {13, gateway::DELIVERY_STATUS_STALE_ROUTE},
+                       {14, gateway::DELIVERY_STATUS_BACKPRESSURED}}),
+      "gw-1");
+  Require(outcome.found, "a tracked multicast should be resolved");
+  Require(outcome.queued == 1 && outcome.offline == 1 &&
+              outcome.backpressured == 1 && outcome.unmatched == 0,
+          "each recipient status should be counted once");
+  Require(outcome.staleRecipients == std::vector<int64_t>{13},
+          "stale recipients should be returned for a retry");
+  Require(outcome.prototype && outcome.prototype->delivery_id() == "message-1",
+          "the retry should reuse the tracked prototype");
+  Require(tracker.Outstanding() == 0, "a resolved multicast is forgotten");
+
+  const auto duplicate = tracker.Resolve(
+      Ack("m:gw-1:0", {{11, gateway::DELIVERY_STATUS_QUEUED}}), "gw-1");
+  Require(!duplicate.found && duplicate.unmatched == 1,
+          "a duplicate ack should not be counted twice");
+}
+
+void TestMismatchedAcksAreNotTrusted() {
+  MulticastAckTracker tracker(16);
+  tracker.Track(Multicast("m:gw-1:0", {11, 12}), "gw-1", Prototype());
+
+  const auto foreign = tracker.Resolve(
+      Ack("m:gw-1:0", {{11, gateway::DELIVERY_STATUS_QUEUED}}), "gw-2");
+  Require(!foreign.found, "an ack from another gateway should be ignored");
+  Require(tracker.Outstanding() == 1, "the ignored ack keeps the record");
+
+  const auto outcome = tracker.Resolve(
+      Ack("m:gw-1:0", {{12, gateway::DELIVERY_STATUS_QUEUED},
+                       {12, gateway::DELIVERY_STATUS_STALE_ROUTE},
+                       {99, gateway::DELIVERY_STATUS_QUEUED}}),
+      "gw-1");
+  Require(outcome.found, "the multicast should be resolved");
+  Require(outcome.queued == 0 && outcome.unmatched == 2,
+          "recipients out of target order should not be trusted");
+  Require(outcome.staleRecipients == std::vector<int64_t>{12},
+          "the recipient in its own position should still be used");
+}
+
+void TestOldestRecordsAreEvicted() {
+  MulticastAckTracker tracker(2);
+  tracker.Track(Multicast("a", {1}), "gw-1", Prototype());
+  tracker.Track(Multicast("b", {2}), "gw-1", Prototype());
+  Require(tracker.Resolve(Ack("a", {{1, gateway::DELIVERY_STATUS_QUEUED}}),
+                          "gw-1")
+              .found,
+          "a record within capacity should be resolved");
+  tracker.Track(Multicast("c", {3}), "gw-1", Prototype());
+  tracker.Track(Multicast("d", {4}), "gw-1", Prototype());
+  Require(tracker.Outstanding() == 2, "only capacity records should be kept");
+  Require(!tracker.Resolve(Ack("b", {{2, gateway::DELIVERY_STATUS_QUEUED}}),
+                           "gw-1")
+               .found,
+          "the oldest record should be evicted");
+
+  tracker.Forget("d");
+  Require(!tracker.Resolve(Ack("d", {{4, gateway::DELIVERY_STATUS_QUEUED}}),
+                           "gw-1")
+               .found,
+          "a forgotten multicast should not be resolved");
+}
+
+}  // namespace
+
+int main() {
+  TestStatusesMapBackToRecipients();
+  TestMismatchedAcksAreNotTrusted();
+  TestOldestRecordsAreEvicted();
+  std::cout << "multicast ack tracker tests passed\n";
+  return EXIT_SUCCESS;
+}
@@ -47,6 +47,13 @@ class Defer {
 #define PROTOCOL_SEND_MSS (10 * 1024 * 1024)  // 10MB
 #define PROTOCOL_QUEUE_MAX_SIZE (10240)
 
+// 大帧分片：协议 ID 最高位表示该帧是某个大帧的一片，次高位表示最后一片，
+// 接收方按序拼接后还原为去掉标志位的原协议 ID。只对登录时声明了
+// PROTOCOL_FEATURE_FRAGMENTATION 的客户端启用。
+#define PROTOCOL_FRAGMENT_FLAG 0x80000000u
+#define PROTOCOL_FRAGMENT_END_FLAG 0x40000000u
+#define PROTOCOL_FEATURE_FRAGMENTATION 0x1u
+
 #include <string>
 #include <unordered_map>
 
@@ -81,7 +88,8 @@ enum ErrorCodes {
   DeadlineExceeded,
   ResourceExhausted,
   DependencyUnavailable,
-  IdempotencyConflict
+  IdempotencyConflict,
+  RequestCancelled
 };
 
 enum ServiceID {
@@ -156,6 +164,10 @@ enum ServiceID {
   ID_GROUP_TEXT_SEND_REQ,  // 发送群组消息
   ID_GROUP_TEXT_SEND_RSP,
 
+  /* 接入 */
+  ID_GATEWAY_REDIRECT_REQ,  // Gateway 下线前推送重连目标，客户端无需应答
+  ID_GATEWAY_REDIRECT_RSP,
+
 };
 
 static std::unordered_map<int, std::string> errorCodesMap = {
@@ -258,7 +270,9 @@ static std::unordered_map<int, std::string> serviceIDMap = {
     {ID_GROUP_QUIT_REQ, "ID_GROUP_QUIT_REQ"},
     {ID_GROUP_QUIT_RSP, "ID_GROUP_QUIT_RSP"},
     {ID_GROUP_TEXT_SEND_REQ, "ID_GROUP_TEXT_SEND_REQ"},
-    {ID_GROUP_TEXT_SEND_RSP, "ID_GROUP_TEXT_SEND_RSP"}};
+    {ID_GROUP_TEXT_SEND_RSP, "ID_GROUP_TEXT_SEND_RSP"},
+    {ID_GATEWAY_REDIRECT_REQ, "ID_GATEWAY_REDIRECT_REQ"},
+    {ID_GATEWAY_REDIRECT_RSP, "ID_GATEWAY_REDIRECT_RSP"}};
 
 inline std::string getServiceIdString(int id) {
   if (serviceIDMap.find(id) != serviceIDMap.end()) {
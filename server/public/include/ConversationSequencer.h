@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace wimi::db {
+
+// 一段连续的会话序号 [first, first + count)；epoch 是分配时计数器的代次，
+// 随消息一起提交，MySQL 拒绝比 conversations.seqEpoch 旧的代次。
+struct SequenceRange {
+  int64_t first{0};
+  int64_t count{0};
+  int64_t epoch{0};
+
+  bool Valid() const { return first > 0 && count > 0 && epoch > 0; }
+};
+
+// 会话序号分配器。序号在写事务之外分配，conversations 行锁只在提交前的
+// 最后一条 UPDATE 上持有；唯一性仍由 uk_messages_conversation_seq 保证。
+// floor/floorEpoch 是事务里一致性读到的 latestSeq 与 seqEpoch：计数器
+// 缺失、落后或已被其他持有者换代时，从这里重新起步并把代次加一。
+class ConversationSequencer {
+ public:
+  virtual ~ConversationSequencer() = default;
+  // 失败时返回无效区间，调用方按依赖不可用处理。
+  virtual SequenceRange Allocate(int64_t conversationId, int64_t count,
+                                 int64_t floor, int64_t floorEpoch) = 0;
+  // 写入撞上序号冲突或代次已被取代：丢弃计数，下次分配重新起步。
+  virtual void Reset(int64_t conversationId) = 0;
+};
+
+// 所有 Message 节点共用 Redis 上的原子计数器，会话可以落在任意节点。
+class RedisConversationSequencer final : public ConversationSequencer {
+ public:
+  explicit RedisConversationSequencer(long ttlSeconds = 24 * 3600);
+
+  SequenceRange Allocate(int64_t conversationId, int64_t count, int64_t floor,
+                         int64_t floorEpoch) override;
+  void Reset(int64_t conversationId) override;
+
+ private:
+  long ttlSeconds;
+};
+
+// 会话按 rendezvous 粘在同一 Message 节点上时，由这个节点在内存里分配，
+// 不经过任何网络往返。会话迁到别的节点后，新持有者以更高的代次起步，
+// 旧节点残留的分配在提交时被拒绝；迁回时发现库里的代次更高，同样换代
+// 重新起步。每个分片最多缓存 maxConversationsPerShard 个会话，超出时
+// 随意淘汰一个，被淘汰的会话下次分配时换代。
+class OwnerConversationSequencer final : public ConversationSequencer {
+ public:
+  explicit OwnerConversationSequencer(
+      std::size_t maxConversationsPerShard = 16384);
+
+  SequenceRange Allocate(int64_t conversationId, int64_t count, int64_t floor,
+                         int64_t floorEpoch) override;
+  void Reset(int64_t conversationId) override;
+
+ private:
+  struct Counter {
+    int64_t epoch{0};
+    int64_t last{0};
+  };
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    std::unordered_map<int64_t, Counter> counters;
+  };
+  static constexpr std::size_t kShards = 64;
+
+  Shard &ShardFor(int64_t conversationId);
+
+  std::size_t maxConversationsPerShard;
+  std::array<Shard, kShards> shards;
+};
+
+// mode 为 "owner" 时使用节点内存计数器，其余取值使用 Redis。
+std::unique_ptr<ConversationSequencer> MakeConversationSequencer(
+    const std::string &mode);
+
+}  // namespace wimi::db
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "gateway_message.pb.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+namespace wimi {
+
+// Gateway-Message 流协议版本。v1 每帧一条；v2 起写端可发送批量帧；
+// v3 起群消息按 Gateway 聚合为多播投递；v4 起命令与结果按整数
+// request_seq 配对；v5 起命令与投递受信用流控（见 StreamCredit.h）；
+// v6 起 Gateway 可撤回对冲落败的命令。
+// 双方按注册时 min(Gateway 声明版本, Message 最高版本) 协商。
+constexpr uint32_t kGatewayStreamProtocolVersion = 6;
+constexpr uint32_t kGatewayStreamBatchProtocolVersion = 2;
+constexpr uint32_t kGatewayStreamMulticastProtocolVersion = 3;
+constexpr uint32_t kGatewayStreamRequestSeqProtocolVersion = 4;
+constexpr uint32_t kGatewayStreamCreditProtocolVersion = 5;
+constexpr uint32_t kGatewayStreamCancelProtocolVersion = 6;
+// 单个批量帧的条数与字节上限，远低于 gRPC 默认 4MiB 接收上限。
+constexpr std::size_t kGatewayStreamBatchMaxFrames = 256;
+constexpr std::size_t kGatewayStreamBatchMaxBytes = 1024 * 1024;
+
+namespace detail {
+
+// 从 queue 中按原顺序取出所有 matches 的帧交给 append，其余帧保持相对
+// 顺序留在队列；达到条数或字节上限后停止合并，保证同类帧不乱序。
+// firstBytes 是已放进批次的首帧大小。返回合并的帧数。
+template <typename Frame, typename Matches, typename Append>
+std::size_t CoalesceQueued(std::deque<Frame> &queue, std::size_t firstBytes,
+                           Matches matches, Append append) {
+  std::size_t frames = 1;
+  std::size_t bytes = firstBytes;
+  bool taking = true;
+  auto keep = queue.begin();
+  for (auto current = queue.begin(); current != queue.end(); ++current) {
+    if (taking && matches(*current)) {
+      const std::size_t frameBytes = current->ByteSizeLong();
+      if (frames < kGatewayStreamBatchMaxFrames &&
+          bytes + frameBytes <= kGatewayStreamBatchMaxBytes) {
+        append(*current);
+        ++frames;
+        bytes += frameBytes;
+        continue;
+      }
+      taking = false;
+    }
+    if (keep != current)
+      *keep = std::move(*current);
+    ++keep;
+  }
+  queue.erase(keep, queue.end());
+  return frames - 1;
+}
+
+template <typename Frame, typename Matches>
+bool HasQueued(const std::deque<Frame> &queue, Matches matches) {
+  return std::any_of(queue.begin(), queue.end(), matches);
+}
+
+}  // namespace detail
+
+// 取出下一次 StartWrite 的帧，调用方持有写锁。batching 时若队列里还有
+// 与队首同类的命令或 ACK，就合并成批量帧；注册、心跳等控制帧原样发送。
+// 返回这次写携带的逻辑帧数。
+inline std::size_t TakeNextStreamFrame(
+    std::deque<gateway::GatewayToMessageFrame> &queue,
+    gateway::GatewayToMessageFrame &out, bool batching) {
+  using Frame = gateway::GatewayToMessageFrame;
+  out = std::move(queue.front());
+  queue.pop_front();
+  if (!batching)
+    return 1;
+
+  const auto isCommand = [](const Frame &frame) { return frame.has_command(); };
+  if (out.has_command() && detail::HasQueued(queue, isCommand)) {
+    Frame batch;
+    auto *commands = batch.mutable_command_batch()->mutable_commands();
+    const std::size_t firstBytes = out.ByteSizeLong();
+    commands->Add(std::move(*out.mutable_command()));
+    const auto merged = detail::CoalesceQueued(
+        queue, firstBytes, isCommand, [commands](Frame &frame) {
+          commands->Add(std::move(*frame.mutable_command()));
+        });
+    out = std::move(batch);
+    return merged + 1;
+  }
+
+  const auto isAck = [](const Frame &frame) {
+    return frame.has_delivery_ack();
+  };
+  if (out.has_delivery_ack() && detail::HasQueued(queue, isAck)) {
+    Frame batch;
+    auto *acks = batch.mutable_delivery_ack_batch();
+    acks->set_gateway_id(out.delivery_ack().gateway_id());
+    acks->set_instance_id(out.delivery_ack().instance_id());
+    const auto append = [acks](gateway::DeliveryAck &&ack) {
+      ack.clear_gateway_id();
+      ack.clear_instance_id();
+      acks->mutable_acks()->Add(std::move(ack));
+    };
+    const std::size_t firstBytes = out.ByteSizeLong();
+    append(std::move(*out.mutable_delivery_ack()));
+    const auto merged = detail::CoalesceQueued(
+        queue, firstBytes, isAck, [&append](Frame &frame) {
+          append(std::move(*frame.mutable_delivery_ack()));
+        });
+    out = std::move(batch);
+    return merged + 1;
+  }
+  return 1;
+}
+
+inline std::size_t TakeNextStreamFrame(
+    std::deque<gateway::MessageToGatewayFrame> &queue,
+    gateway::MessageToGatewayFrame &out, bool batching) {
+  using Frame = gateway::MessageToGatewayFrame;
+  out = std::move(queue.front());
+  queue.pop_front();
+  if (!batching)
+    return 1;
+
+  const auto isResult = [](const Frame &frame) {
+    return frame.has_command_result();
+  };
+  if (out.has_command_result() && detail::HasQueued(queue, isResult)) {
+    Frame batch;
+    auto *results = batch.mutable_command_result_batch()->mutable_results();
+    const std::size_t firstBytes = out.ByteSizeLong();
+    results->Add(std::move(*out.mutable_command_result()));
+    const auto merged = detail::CoalesceQueued(
+        queue, firstBytes, isResult, [results](Frame &frame) {
+          results->Add(std::move(*frame.mutable_command_result()));
+        });
+    out = std::move(batch);
+    return merged + 1;
+  }
+
+  const auto isDelivery = [](const Frame &frame) {
+    return frame.has_delivery();
+  };
+  if (out.has_delivery() && detail::HasQueued(queue, isDelivery)) {
+    Frame batch;
+    auto *deliveries = batch.mutable_delivery_batch()->mutable_deliveries();
+    const std::size_t firstBytes = out.ByteSizeLong();
+    deliveries->Add(std::move(*out.mutable_delivery()));
+    const auto merged = detail::CoalesceQueued(
+        queue, firstBytes, isDelivery, [deliveries](Frame &frame) {
+          deliveries->Add(std::move(*frame.mutable_delivery()));
+        });
+    out = std::move(batch);
+    return merged + 1;
+  }
+  return 1;
+}
+
+}  // namespace wimi
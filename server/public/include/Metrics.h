@@ -21,14 +21,61 @@ enum class Metric : std::size_t {
   RpcDeadlineExceeded,
   IdempotencyAccepted,
   IdempotencyReplayed,
+  GatewaySocketWrites,
+  GatewayFramesWritten,
+  GatewayLeaseRefreshBatches,
+  GatewayLeasesRefreshed,
+  GatewayLeasesFenced,
+  GatewayQueuedFrames,
+  GatewayQueuedBytes,
+  GatewayPushesDropped,
+  GatewayPushesBackpressured,
+  GatewaySlowConsumerDisconnects,
+  GatewayStreamWrites,
+  GatewayStreamFramesWritten,
+  GatewayMulticastDeliveries,
+  GatewayMulticastRecipients,
+  GatewayStreamCommandCredits,
+  GatewayStreamDeliveryCredits,
+  GatewayStreamQueuedForCredit,
+  GatewayStreamCreditStalls,
+  GatewayStreamCreditRejected,
+  GatewayHedgesSent,
+  GatewayHedgesWon,
+  GatewayHedgesOverBudget,
+  GatewayLoginsQueued,
+  GatewayLoginsAdmitted,
+  GatewayLoginsRejected,
+  GatewayLoginBatches,
+  GatewayLoginQueueMicroseconds,
+  GatewaySessionsParked,
+  GatewaySessionsResumed,
+  GatewayResumeMisses,
+  MessageAcceptBatches,
+  MessageAcceptsBatched,
+  MessageMulticastRecipientsQueued,
+  MessageMulticastRecipientsOffline,
+  MessageMulticastRecipientsBackpressured,
+  MessageMulticastRecipientsStaleRoute,
+  MessageMulticastAcksUnmatched,
   Count,
 };
 
 // 当前只提供进程内原子计数骨架；后续接 Prometheus/OpenTelemetry 时，
 // 业务代码继续使用这些稳定的指标名，不直接依赖具体采集 SDK。
+// 名称含 queued 或以 credits 结尾的是可增可减的 gauge，其余为单调计数。
+// gateway_stream_* 统计 Gateway-Message 双向流，两端各自计数，帧数/写次数
+// 即平均批量；*_credits 是对端授予、本端尚未用掉的信用之和。
+// gateway_login_queue_microseconds 是登录在准入队列中等待的累计时长，
+// 除以 gateway_logins_admitted 即平均排队时间。
+// gateway_sessions_resumed 与 gateway_resume_misses 之比即会话恢复命中率。
+// message_accepts_batched 除以 message_accept_batches 即群文本平均批量。
+// message_multicast_recipients_* 是 Gateway 多播 ACK 回报的逐人结果，
+// stale_route 的接收者会按逐人路径重投一次。
 class Metrics {
  public:
   static void Increment(Metric metric, uint64_t value = 1);
+  static void Decrement(Metric metric, uint64_t value = 1);
   static uint64_t Get(Metric metric);
   static std::string_view Name(Metric metric);
 
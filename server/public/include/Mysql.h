@@ -8,23 +8,30 @@
 #include <ctime>
 #include <exception>
 #include <functional>
+#include <iomanip>
 #include <mysql-cppconn/mysqlx/devapi/common.h>
 #include <mysql-cppconn/mysqlx/devapi/result.h>
 #include <mysql-cppconn/mysqlx/xdevapi.h>
 
 #include <atomic>
 #include <cstddef>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <sstream>
 #include <spdlog/spdlog.h>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "Configer.h"
 #include "Const.h"
+#include "ConversationSequencer.h"
 #include "DbGlobal.h"
 #include "Logger.h"
 #include "Metrics.h"
@@ -46,6 +53,13 @@ struct GroupMessageAcceptResult : MessageAcceptResult {
   std::vector<int64_t> recipientUids;
 };
 
+struct GroupTextCommand {
+  long senderId{0};
+  std::string clientMessageId;
+  std::string content;
+  std::string sendDateTime;
+};
+
 struct ConversationMessageRecord {
   int64_t messageId{0};
   int64_t senderId{0};
@@ -398,6 +412,40 @@ class MysqlDao : public Singleton<MysqlDao>,
         });
   }
 
+  // 登录准入批量加载资料：一次 WHERE uid IN (...)，结果与 uids 同序，查不到
+  // 的位置为 nullptr。查询失败返回 false。
+  bool getUserInfos(const std::vector<long> &uids,
+                    std::vector<UserInfo::Ptr> &infos) {
+    infos.assign(uids.size(), nullptr);
+    if (uids.empty())
+      return true;
+    return executeTemplate([&](std::unique_ptr<mysqlx::Session> &session) {
+      std::string query =
+          "SELECT uid, name, age, sex, headImageURL FROM userInfo WHERE uid "
+          "IN (?";
+      for (std::size_t i = 1; i < uids.size(); ++i)
+        query += ", ?";
+      query += ")";
+      auto statement = session->sql(query);
+      for (const long uid : uids)
+        statement.bind(uid);
+      auto result = statement.execute();
+      std::unordered_map<long, UserInfo::Ptr> found;
+      for (auto row = result.fetchOne(); row; row = result.fetchOne()) {
+        const long uid = static_cast<long>(row[0].get<uint64_t>());
+        found[uid] = std::make_shared<UserInfo>(
+            uid, row[1].get<std::string>(), row[2].get<int>(),
+            row[3].get<std::string>(), row[4].get<std::string>());
+      }
+      for (std::size_t i = 0; i < uids.size(); ++i) {
+        auto match = found.find(uids[i]);
+        if (match != found.end())
+          infos[i] = match->second;
+      }
+      return true;
+    });
+  }
+
   bool hasUserInfo(long uid) {
     return executeTemplate(
         [&](std::unique_ptr<mysqlx::Session> &session) -> bool {
@@ -607,238 +655,122 @@ class MysqlDao : public Singleton<MysqlDao>,
     });
   }
 
-  MessageAcceptResult acceptDirectText(long senderId, long receiverId,
+  // 会话序号由 sequencer 在事务外分配，事务里对 conversations 只做一致性
+  // 读，提交前最后一步才锁行推进 latestSeq，行锁不再覆盖整个事务。序号
+  // 冲突、代次被取代或同一 clientMessageId 并发提交时整体重来一次。
+  static constexpr int kAcceptAttempts = 2;
+
+  MessageAcceptResult acceptDirectText(ConversationSequencer &sequencer,
+                                       long senderId, long receiverId,
                                        const std::string &clientMessageId,
                                        const std::string &content,
                                        const std::string &sendDateTime) {
-    return executeTemplate([&](std::unique_ptr<mysqlx::Session> &session)
-                               -> MessageAcceptResult {
-      MessageAcceptResult accepted;
-      session->startTransaction();
-      try {
-        auto friendResult =
-            session
-                ->sql(
-                    R"(SELECT sessionId FROM friends WHERE uidA = ? AND uidB = ?)")
-                .bind(senderId)
-                .bind(receiverId)
-                .execute();
-        auto friendRow = friendResult.fetchOne();
-        if (!friendRow) {
-          session->rollback();
-          accepted.error = ErrorCodes::UserNotFriend;
-          return accepted;
-        }
-
-        accepted.conversationId = friendRow[0].get<int64_t>();
-        session
-            ->sql(
-                R"(INSERT INTO conversations (conversationId, type, businessId, latestSeq, createTime) VALUES (?, 1, ?, 0, ?) ON DUPLICATE KEY UPDATE conversationId = VALUES(conversationId))")
-            .bind(accepted.conversationId)
-            .bind(accepted.conversationId)
-            .bind(sendDateTime)
-            .execute();
-        session
-            ->sql(
-                R"(INSERT IGNORE INTO conversationMembers (conversationId, uid, joinedSeq) VALUES (?, ?, 1), (?, ?, 1))")
-            .bind(accepted.conversationId)
-            .bind(senderId)
-            .bind(accepted.conversationId)
-            .bind(receiverId)
-            .execute();
-
-        auto sequenceResult =
-            session
-                ->sql(
-                    R"(SELECT latestSeq FROM conversations WHERE conversationId = ? FOR UPDATE)")
-                .bind(accepted.conversationId)
-                .execute();
-        auto sequenceRow = sequenceResult.fetchOne();
-        if (!sequenceRow) {
-          session->rollback();
-          accepted.error = ErrorCodes::MysqlFailed;
-          accepted.diagnostic = "conversation row missing after insert";
-          return accepted;
-        }
-
-        auto duplicateResult =
-            session
-                ->sql(
-                    R"(SELECT messageId, conversationId, conversationSeq, receiverId, type, content FROM messages WHERE senderId = ? AND clientMessageId = ?)")
-                .bind(senderId)
-                .bind(clientMessageId)
-                .execute();
-        auto duplicateRow = duplicateResult.fetchOne();
-        if (duplicateRow) {
-          const bool sameCommand =
-              duplicateRow[1].get<int64_t>() == accepted.conversationId &&
-              duplicateRow[3].get<int64_t>() == receiverId &&
-              duplicateRow[4].get<int>() == Message::Type::TEXT &&
-              duplicateRow[5].get<std::string>() == content;
-          if (!sameCommand) {
+    MessageAcceptResult accepted;
+    for (int attempt = 0; attempt < kAcceptAttempts; ++attempt) {
+      bool retry = false;
+      accepted = executeTemplate([&](std::unique_ptr<mysqlx::Session> &session)
+                                     -> MessageAcceptResult {
+        MessageAcceptResult accepted;
+        session->startTransaction();
+        try {
+          auto friendResult =
+              session
+                  ->sql(
+                      R"(SELECT sessionId FROM friends WHERE uidA = ? AND uidB = ?)")
+                  .bind(senderId)
+                  .bind(receiverId)
+                  .execute();
+          auto friendRow = friendResult.fetchOne();
+          if (!friendRow) {
             session->rollback();
-            accepted.error = ErrorCodes::IdempotencyConflict;
+            accepted.error = ErrorCodes::UserNotFriend;
             return accepted;
           }
-          accepted.messageId = duplicateRow[0].get<int64_t>();
-          accepted.conversationSeq = duplicateRow[2].get<int64_t>();
-          accepted.duplicate = true;
-          accepted.error = ErrorCodes::Success;
-          session->commit();
-          return accepted;
-        }
 
-        accepted.conversationSeq = sequenceRow[0].get<int64_t>() + 1;
-        session
-            ->sql(
-                R"(UPDATE conversations SET latestSeq = ? WHERE conversationId = ?)")
-            .bind(accepted.conversationSeq)
-            .bind(accepted.conversationId)
-            .execute();
-
-        const std::string canonicalCommand =
-            std::to_string(accepted.conversationId) + ":" +
-            std::to_string(static_cast<int>(Message::Type::TEXT)) + ":" +
-            content;
-        const std::string commandHash =
-            std::to_string(std::hash<std::string>{}(canonicalCommand));
-        auto insertResult =
+          accepted.conversationId = friendRow[0].get<int64_t>();
+          auto sequenceResult =
+              session
+                  ->sql(
+                      R"(SELECT latestSeq, seqEpoch FROM conversations WHERE conversationId = ?)")
+                  .bind(accepted.conversationId)
+                  .execute();
+          auto sequenceRow = sequenceResult.fetchOne();
+          int64_t floor = 0;
+          int64_t floorEpoch = 0;
+          if (sequenceRow) {
+            floor = sequenceRow[0].get<int64_t>();
+            floorEpoch = sequenceRow[1].get<int64_t>();
+          } else {
             session
                 ->sql(
-                    R"(INSERT INTO messages (senderId, receiverId, conversationId, conversationSeq, clientMessageId, commandHash, sessionKey, type, content, status, sendDateTime, readDateTime) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ''))")
-                .bind(senderId)
-                .bind(receiverId)
+                    R"(INSERT IGNORE INTO conversations (conversationId, type, businessId, latestSeq, seqEpoch, createTime) VALUES (?, 1, ?, 0, 0, ?))")
+                .bind(accepted.conversationId)
                 .bind(accepted.conversationId)
-                .bind(accepted.conversationSeq)
-                .bind(clientMessageId)
-                .bind(commandHash)
-                .bind(std::to_string(accepted.conversationId))
-                .bind(static_cast<int>(Message::Type::TEXT))
-                .bind(content)
-                .bind(static_cast<int>(Message::Status::WAIT))
                 .bind(sendDateTime)
                 .execute();
-        accepted.messageId =
-            static_cast<int64_t>(insertResult.getAutoIncrementValue());
-        session->commit();
-        accepted.error = ErrorCodes::Success;
-        return accepted;
-      } catch (const std::exception &error) {
-        try {
-          session->rollback();
-        } catch (...) {
-        }
-        accepted.error = ErrorCodes::MysqlFailed;
-        accepted.diagnostic = error.what();
-        return accepted;
-      }
-    });
-  }
-
-  GroupMessageAcceptResult acceptGroupText(long senderId, long groupId,
-                                           const std::string &clientMessageId,
-                                           const std::string &content,
-                                           const std::string &sendDateTime) {
-    return executeTemplate([&](std::unique_ptr<mysqlx::Session> &session)
-                               -> GroupMessageAcceptResult {
-      GroupMessageAcceptResult accepted;
-      accepted.groupId = groupId;
-      session->startTransaction();
-      try {
-        auto groupResult =
             session
                 ->sql(
-                    R"(SELECT gi.sessionKey, gm.speech FROM groupInfo gi INNER JOIN groupMembers gm ON gm.gid = gi.gid WHERE gi.gid = ? AND gm.uid = ?)")
-                .bind(groupId)
+                    R"(INSERT IGNORE INTO conversationMembers (conversationId, uid, joinedSeq) VALUES (?, ?, 1), (?, ?, 1))")
+                .bind(accepted.conversationId)
                 .bind(senderId)
-                .execute();
-        auto groupRow = groupResult.fetchOne();
-        if (!groupRow) {
-          session->rollback();
-          accepted.error = ErrorCodes::MessageOwnershipInvalid;
-          return accepted;
-        }
-        if (groupRow[1].get<int>() != 0) {
-          session->rollback();
-          accepted.error = ErrorCodes::GroupNotifyFailed;
-          return accepted;
-        }
-
-        accepted.conversationId = groupRow[0].get<int64_t>();
-        session
-            ->sql(
-                R"(INSERT INTO conversations (conversationId, type, businessId, latestSeq, createTime) VALUES (?, 2, ?, 0, ?) ON DUPLICATE KEY UPDATE conversationId = VALUES(conversationId))")
-            .bind(accepted.conversationId)
-            .bind(groupId)
-            .bind(sendDateTime)
-            .execute();
-        session
-            ->sql(
-                R"(INSERT IGNORE INTO conversationMembers (conversationId, uid, joinedSeq) SELECT ?, gm.uid, c.latestSeq + 1 FROM groupMembers gm INNER JOIN conversations c ON c.conversationId = ? WHERE gm.gid = ?)")
-            .bind(accepted.conversationId)
-            .bind(accepted.conversationId)
-            .bind(groupId)
-            .execute();
-
-        auto sequenceResult =
-            session
-                ->sql(
-                    R"(SELECT latestSeq FROM conversations WHERE conversationId = ? FOR UPDATE)")
                 .bind(accepted.conversationId)
+                .bind(receiverId)
                 .execute();
-        auto sequenceRow = sequenceResult.fetchOne();
-        if (!sequenceRow) {
-          session->rollback();
-          accepted.error = ErrorCodes::MysqlFailed;
-          accepted.diagnostic = "group conversation row missing after insert";
-          return accepted;
-        }
+          }
 
-        auto duplicateResult =
-            session
-                ->sql(
-                    R"(SELECT messageId, conversationId, conversationSeq, receiverId, type, content FROM messages WHERE senderId = ? AND clientMessageId = ?)")
-                .bind(senderId)
-                .bind(clientMessageId)
-                .execute();
-        auto duplicateRow = duplicateResult.fetchOne();
-        if (duplicateRow) {
-          const bool sameCommand =
-              duplicateRow[1].get<int64_t>() == accepted.conversationId &&
-              duplicateRow[3].get<int64_t>() == groupId &&
-              duplicateRow[4].get<int>() == Message::Type::TEXT &&
-              duplicateRow[5].get<std::string>() == content;
-          if (!sameCommand) {
+          auto duplicateResult =
+              session
+                  ->sql(
+                      R"(SELECT messageId, conversationId, conversationSeq, receiverId, type, content FROM messages WHERE senderId = ? AND clientMessageId = ?)")
+                  .bind(senderId)
+                  .bind(clientMessageId)
+                  .execute();
+          auto duplicateRow = duplicateResult.fetchOne();
+          if (duplicateRow) {
+            const bool sameCommand =
+                duplicateRow[1].get<int64_t>() == accepted.conversationId &&
+                duplicateRow[3].get<int64_t>() == receiverId &&
+                duplicateRow[4].get<int>() == Message::Type::TEXT &&
+                duplicateRow[5].get<std::string>() == content;
+            if (!sameCommand) {
+              session->rollback();
+              accepted.error = ErrorCodes::IdempotencyConflict;
+              return accepted;
+            }
+            accepted.messageId = duplicateRow[0].get<int64_t>();
+            accepted.conversationSeq = duplicateRow[2].get<int64_t>();
+            accepted.duplicate = true;
+            accepted.error = ErrorCodes::Success;
+            session->commit();
+            return accepted;
+          }
+
+          const auto range =
+              sequencer.Allocate(accepted.conversationId, 1, floor, floorEpoch);
+          if (!range.Valid()) {
             session->rollback();
-            accepted.error = ErrorCodes::IdempotencyConflict;
+            accepted.error = ErrorCodes::DependencyUnavailable;
+            accepted.diagnostic = "conversation sequencer unavailable";
             return accepted;
           }
-          accepted.messageId = duplicateRow[0].get<int64_t>();
-          accepted.conversationSeq = duplicateRow[2].get<int64_t>();
-          accepted.duplicate = true;
-        } else {
-          accepted.conversationSeq = sequenceRow[0].get<int64_t>() + 1;
-          session
-              ->sql(
-                  R"(UPDATE conversations SET latestSeq = ? WHERE conversationId = ?)")
-              .bind(accepted.conversationSeq)
-              .bind(accepted.conversationId)
-              .execute();
+          accepted.conversationSeq = range.first;
+
           const std::string canonicalCommand =
               std::to_string(accepted.conversationId) + ":" +
               std::to_string(static_cast<int>(Message::Type::TEXT)) + ":" +
               content;
+          const std::string commandHash =
+              std::to_string(std::hash<std::string>{}(canonicalCommand));
           auto insertResult =
               session
                   ->sql(
                       R"(INSERT INTO messages (senderId, receiverId, conversationId, conversationSeq, clientMessageId, commandHash, sessionKey, type, content, status, sendDateTime, readDateTime) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ''))")
                   .bind(senderId)
-                  .bind(groupId)
+                  .bind(receiverId)
                   .bind(accepted.conversationId)
                   .bind(accepted.conversationSeq)
                   .bind(clientMessageId)
-                  .bind(std::to_string(
-                      std::hash<std::string>{}(canonicalCommand)))
+                  .bind(commandHash)
                   .bind(std::to_string(accepted.conversationId))
                   .bind(static_cast<int>(Message::Type::TEXT))
                   .bind(content)
@@ -847,30 +779,354 @@ class MysqlDao : public Singleton<MysqlDao>,
                   .execute();
           accepted.messageId =
               static_cast<int64_t>(insertResult.getAutoIncrementValue());
+          if (!advanceConversationSeq(session, accepted.conversationId,
+                                      range)) {
+            session->rollback();
+            sequencer.Reset(accepted.conversationId);
+            retry = true;
+            return accepted;
+          }
+          session->commit();
+          accepted.error = ErrorCodes::Success;
+          return accepted;
+        } catch (const std::exception &error) {
+          try {
+            session->rollback();
+          } catch (...) {
+          }
+          retry = isAcceptRace(error, sequencer, accepted.conversationId);
+          accepted.error = ErrorCodes::MysqlFailed;
+          accepted.diagnostic = error.what();
+          return accepted;
         }
+      });
+      if (!retry)
+        return accepted;
+    }
+    accepted.error = ErrorCodes::DependencyUnavailable;
+    accepted.diagnostic = "conversation sequence contention";
+    return accepted;
+  }
+
+  // 同一群的一批文本在一个事务里落库：一次读取群成员与发送者身份、一次
+  // 查重、一次分配连续序号、一条多行 INSERT。结果与 commands 同序；发送者
+  // 身份、禁言与幂等冲突逐条判定，只有失败的那条返回错误。事务因某一行
+  // 数据出错时整批回滚后逐条重写，不让一条坏命令拖垮同批；连接、锁等待
+  // 等与数据无关的失败整批返回可重试错误。
+  std::vector<GroupMessageAcceptResult>
+  acceptGroupTextBatch(ConversationSequencer &sequencer, long groupId,
+                       const std::vector<GroupTextCommand> &commands) {
+    std::vector<GroupMessageAcceptResult> accepted;
+    for (int attempt = 0; attempt < kAcceptAttempts; ++attempt) {
+      bool retry = false;
+      bool isolate = false;
+      accepted = executeTemplate([&](std::unique_ptr<mysqlx::Session> &session)
+                                     -> std::vector<GroupMessageAcceptResult> {
+        std::vector<GroupMessageAcceptResult> accepted(commands.size());
+        for (auto &result : accepted)
+          result.groupId = groupId;
+        int64_t conversationId = 0;
+        session->startTransaction();
+        try {
+          // 一次一致性读取回群成员、禁言状态，以及入群后还没有会话成员
+          // 记录的人；只有存在这样的人时才写 conversationMembers。
+          auto members =
+              session
+                  ->sql(
+                      R"(SELECT gi.sessionKey, gm.uid, gm.speech, cm.uid IS NULL FROM groupInfo gi INNER JOIN groupMembers gm ON gm.gid = gi.gid LEFT JOIN conversationMembers cm ON cm.conversationId = gi.sessionKey AND cm.uid = gm.uid WHERE gi.gid = ?)")
+                  .bind(groupId)
+                  .execute();
+          std::unordered_map<int64_t, int> speech;
+          std::vector<int64_t> memberUids;
+          std::vector<int64_t> joining;
+          for (const auto &row : members.fetchAll()) {
+            conversationId = row[0].get<int64_t>();
+            const int64_t uid = row[1].get<int64_t>();
+            speech[uid] = row[2].get<int>();
+            memberUids.push_back(uid);
+            if (row[3].get<int>() != 0)
+              joining.push_back(uid);
+          }
+
+          std::vector<std::size_t> pending;
+          for (std::size_t i = 0; i < commands.size(); ++i) {
+            auto found = speech.find(commands[i].senderId);
+            if (found == speech.end()) {
+              accepted[i].error = ErrorCodes::MessageOwnershipInvalid;
+            } else if (found->second != 0) {
+              accepted[i].error = ErrorCodes::GroupNotifyFailed;
+            } else {
+              accepted[i].conversationId = conversationId;
+              pending.push_back(i);
+            }
+          }
+          if (pending.empty()) {
+            session->rollback();
+            return accepted;
+          }
 
-        auto members =
+          auto sequenceResult =
+              session
+                  ->sql(
+                      R"(SELECT latestSeq, seqEpoch FROM conversations WHERE conversationId = ?)")
+                  .bind(conversationId)
+                  .execute();
+          auto sequenceRow = sequenceResult.fetchOne();
+          int64_t floor = 0;
+          int64_t floorEpoch = 0;
+          if (sequenceRow) {
+            floor = sequenceRow[0].get<int64_t>();
+            floorEpoch = sequenceRow[1].get<int64_t>();
+          } else {
             session
                 ->sql(
-                    R"(SELECT uid FROM groupMembers WHERE gid = ? AND uid <> ?)")
+                    R"(INSERT IGNORE INTO conversations (conversationId, type, businessId, latestSeq, seqEpoch, createTime) VALUES (?, 2, ?, 0, 0, ?))")
+                .bind(conversationId)
                 .bind(groupId)
-                .bind(senderId)
+                .bind(commands[pending.front()].sendDateTime)
                 .execute();
-        for (const auto &row : members.fetchAll())
-          accepted.recipientUids.push_back(row[0].get<int64_t>());
-        session->commit();
-        accepted.error = ErrorCodes::Success;
-        return accepted;
-      } catch (const std::exception &error) {
-        try {
-          session->rollback();
-        } catch (...) {
+          }
+          if (!joining.empty()) {
+            std::string query =
+                "INSERT IGNORE INTO conversationMembers (conversationId, uid, "
+                "joinedSeq) VALUES (?, ?, ?)";
+            for (std::size_t i = 1; i < joining.size(); ++i)
+              query += ", (?, ?, ?)";
+            auto statement = session->sql(query);
+            for (const int64_t uid : joining)
+              statement.bind(conversationId).bind(uid).bind(floor + 1);
+            statement.execute();
+          }
+
+          // 库里已有的 (senderId, clientMessageId) 按原结果返回或判冲突；
+          // 批内重复的以第一条为准，后面的视为它的重放。
+          std::string query =
+              "SELECT senderId, clientMessageId, messageId, conversationId, "
+              "conversationSeq, receiverId, type, content FROM messages WHERE "
+              "(senderId, clientMessageId) IN ((?, ?)";
+          for (std::size_t i = 1; i < pending.size(); ++i)
+            query += ", (?, ?)";
+          query += ")";
+          auto duplicateStatement = session->sql(query);
+          for (const std::size_t i : pending)
+            duplicateStatement.bind(commands[i].senderId)
+                .bind(commands[i].clientMessageId);
+          std::map<std::pair<int64_t, std::string>, mysqlx::Row> stored;
+          for (auto &row : duplicateStatement.execute().fetchAll())
+            stored.emplace(std::make_pair(row[0].get<int64_t>(),
+                                          row[1].get<std::string>()),
+                           row);
+          std::map<std::pair<int64_t, std::string>, std::size_t> firstInBatch;
+          std::vector<std::size_t> fresh;
+          std::vector<std::pair<std::size_t, std::size_t>> replays;
+          for (const std::size_t i : pending) {
+            const auto &command = commands[i];
+            auto key = std::make_pair(static_cast<int64_t>(command.senderId),
+                                      command.clientMessageId);
+            auto row = stored.find(key);
+            if (row != stored.end()) {
+              const bool sameCommand =
+                  row->second[3].get<int64_t>() == conversationId &&
+                  row->second[5].get<int64_t>() == groupId &&
+                  row->second[6].get<int>() == Message::Type::TEXT &&
+                  row->second[7].get<std::string>() == command.content;
+              if (!sameCommand) {
+                accepted[i].error = ErrorCodes::IdempotencyConflict;
+                continue;
+              }
+              accepted[i].messageId = row->second[2].get<int64_t>();
+              accepted[i].conversationSeq = row->second[4].get<int64_t>();
+              accepted[i].duplicate = true;
+              accepted[i].error = ErrorCodes::Success;
+              continue;
+            }
+            auto first = firstInBatch.emplace(std::move(key), i);
+            if (first.second) {
+              fresh.push_back(i);
+            } else if (commands[first.first->second].content !=
+                       command.content) {
+              accepted[i].error = ErrorCodes::IdempotencyConflict;
+            } else {
+              replays.emplace_back(i, first.first->second);
+            }
+          }
+          if (fresh.empty()) {
+            session->commit();
+            return accepted;
+          }
+
+          const auto range = sequencer.Allocate(
+              conversationId, static_cast<int64_t>(fresh.size()), floor,
+              floorEpoch);
+          if (!range.Valid()) {
+            session->rollback();
+            for (const std::size_t i : pending) {
+              accepted[i] = GroupMessageAcceptResult{};
+              accepted[i].groupId = groupId;
+              accepted[i].error = ErrorCodes::DependencyUnavailable;
+              accepted[i].diagnostic = "conversation sequencer unavailable";
+            }
+            return accepted;
+          }
+
+          query =
+              "INSERT INTO messages (senderId, receiverId, conversationId, "
+              "conversationSeq, clientMessageId, commandHash, sessionKey, "
+              "type, content, status, sendDateTime, readDateTime) VALUES "
+              "(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, '')";
+          for (std::size_t i = 1; i < fresh.size(); ++i)
+            query += ", (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, '')";
+          auto insertStatement = session->sql(query);
+          for (std::size_t k = 0; k < fresh.size(); ++k) {
+            const auto &command = commands[fresh[k]];
+            accepted[fresh[k]].conversationSeq =
+                range.first + static_cast<int64_t>(k);
+            const std::string canonicalCommand =
+                std::to_string(conversationId) + ":" +
+                std::to_string(static_cast<int>(Message::Type::TEXT)) + ":" +
+                command.content;
+            insertStatement.bind(command.senderId)
+                .bind(groupId)
+                .bind(conversationId)
+                .bind(accepted[fresh[k]].conversationSeq)
+                .bind(command.clientMessageId)
+                .bind(std::to_string(
+                    std::hash<std::string>{}(canonicalCommand)))
+                .bind(std::to_string(conversationId))
+                .bind(static_cast<int>(Message::Type::TEXT))
+                .bind(command.content)
+                .bind(static_cast<int>(Message::Status::WAIT))
+                .bind(command.sendDateTime);
+          }
+          insertStatement.execute();
+
+          // 多行插入的自增 id 在 innodb_autoinc_lock_mode = 2 下不保证连续，
+          // 按本批的序号区间回读。
+          auto inserted =
+              session
+                  ->sql(
+                      R"(SELECT conversationSeq, messageId FROM messages WHERE conversationId = ? AND conversationSeq BETWEEN ? AND ?)")
+                  .bind(conversationId)
+                  .bind(range.first)
+                  .bind(range.first + range.count - 1)
+                  .execute();
+          for (const auto &row : inserted.fetchAll()) {
+            const auto k =
+                static_cast<std::size_t>(row[0].get<int64_t>() - range.first);
+            accepted[fresh[k]].messageId = row[1].get<int64_t>();
+            accepted[fresh[k]].error = ErrorCodes::Success;
+          }
+          if (!advanceConversationSeq(session, conversationId, range)) {
+            session->rollback();
+            sequencer.Reset(conversationId);
+            retry = true;
+            return accepted;
+          }
+          session->commit();
+          for (const auto &[replay, first] : replays) {
+            accepted[replay].messageId = accepted[first].messageId;
+            accepted[replay].conversationSeq = accepted[first].conversationSeq;
+            accepted[replay].duplicate = true;
+            accepted[replay].error = ErrorCodes::Success;
+          }
+          for (const std::size_t i : pending) {
+            if (accepted[i].error != ErrorCodes::Success)
+              continue;
+            for (const int64_t uid : memberUids) {
+              if (uid != commands[i].senderId)
+                accepted[i].recipientUids.push_back(uid);
+            }
+          }
+          return accepted;
+        } catch (const std::exception &error) {
+          try {
+            session->rollback();
+          } catch (...) {
+          }
+          retry = isAcceptRace(error, sequencer, conversationId);
+          isolate = !retry && commands.size() > 1 && isRowError(error);
+          for (auto &result : accepted) {
+            result = GroupMessageAcceptResult{};
+            result.groupId = groupId;
+            result.error = ErrorCodes::MysqlFailed;
+            result.diagnostic = error.what();
+          }
+          return accepted;
         }
-        accepted.error = ErrorCodes::MysqlFailed;
-        accepted.diagnostic = error.what();
+      });
+      if (retry)
+        continue;
+      if (isolate) {
+        for (std::size_t i = 0; i < commands.size(); ++i)
+          accepted[i] = std::move(
+              acceptGroupTextBatch(sequencer, groupId, {commands[i]}).front());
         return accepted;
       }
-    });
+      // executeTemplate 拿不到连接时返回空表。
+      if (accepted.size() != commands.size()) {
+        accepted.assign(commands.size(), GroupMessageAcceptResult{});
+        for (auto &result : accepted)
+          result.groupId = groupId;
+      }
+      return accepted;
+    }
+    accepted.assign(commands.size(), GroupMessageAcceptResult{});
+    for (auto &result : accepted) {
+      result.groupId = groupId;
+      result.error = ErrorCodes::DependencyUnavailable;
+      result.diagnostic = "conversation sequence contention";
+    }
+    return accepted;
+  }
+
+  // 提交前最后一步：锁住会话行校验代次并推进 latestSeq。库里的代次已经
+  // 比本次分配新时返回 false，说明计数器已被接管，本次序号作废。
+  static bool advanceConversationSeq(std::unique_ptr<mysqlx::Session> &session,
+                                     int64_t conversationId,
+                                     const SequenceRange &range) {
+    auto current =
+        session
+            ->sql(
+                R"(SELECT seqEpoch FROM conversations WHERE conversationId = ? FOR UPDATE)")
+            .bind(conversationId)
+            .execute();
+    auto row = current.fetchOne();
+    if (!row || row[0].get<int64_t>() > range.epoch)
+      return false;
+    session
+        ->sql(
+            R"(UPDATE conversations SET latestSeq = GREATEST(latestSeq, ?), seqEpoch = ? WHERE conversationId = ?)")
+        .bind(range.first + range.count - 1)
+        .bind(range.epoch)
+        .bind(conversationId)
+        .execute();
+    return true;
+  }
+
+  // 插入撞上唯一键：序号冲突说明计数器落后于库，清掉后重来；同一
+  // clientMessageId 并发提交时重来一次即可读到已提交的那条。
+  static bool isAcceptRace(const std::exception &error,
+                           ConversationSequencer &sequencer,
+                           int64_t conversationId) {
+    const std::string_view what = error.what();
+    if (what.find("uk_messages_conversation_seq") != std::string_view::npos) {
+      sequencer.Reset(conversationId);
+      return true;
+    }
+    return what.find("uk_messages_sender_client") != std::string_view::npos;
+  }
+
+  // 只与某一行数据有关的错误：超长、编码非法、越界、空值与约束冲突。
+  static bool isRowError(const std::exception &error) {
+    const std::string_view what = error.what();
+    constexpr std::string_view kRowErrors[] = {
+        "Data too long",   "Data truncated",   "Incorrect string value",
+        "Out of range",    "cannot be null",   "Duplicate entry",
+        "foreign key constraint fails"};
+    return std::any_of(std::begin(kRowErrors), std::end(kRowErrors),
+                       [what](std::string_view marker) {
+                         return what.find(marker) != std::string_view::npos;
+                       });
   }
 
   ConversationSyncResult syncConversation(long uid, long conversationId,
@@ -908,17 +1164,26 @@ class MysqlDao : public Singleton<MysqlDao>,
               .bind(leftSeq)
               .bind(boundedCount + 1)
               .execute();
+      // 序号在事务外分配，中止的写入会留下永久空洞，较小序号也可能晚于
+      // 较大序号提交。遇到空洞时，只有空洞后的消息已超过宽限期才跨过去，
+      // 否则停在空洞前，等那条消息提交后的推送再来拉取。
+      int64_t expectedSeq = effectiveAfter + 1;
       for (const auto &row : result.fetchAll()) {
         if (sync.messages.size() >= static_cast<std::size_t>(boundedCount)) {
           sync.hasMore = true;
           break;
         }
+        const int64_t conversationSeq = row[4].get<int64_t>();
+        if (conversationSeq != expectedSeq &&
+            !isSettled(row[9].get<std::string>()))
+          break;
+        expectedSeq = conversationSeq + 1;
         ConversationMessageRecord message;
         message.messageId = row[0].get<int64_t>();
         message.senderId = row[1].get<int64_t>();
         message.receiverId = row[2].get<int64_t>();
         message.conversationId = row[3].get<int64_t>();
-        message.conversationSeq = row[4].get<int64_t>();
+        message.conversationSeq = conversationSeq;
         message.clientMessageId = row[5].get<std::string>();
         message.type = row[6].get<int>();
         message.content = row[7].get<std::string>();
@@ -935,6 +1200,21 @@ class MysqlDao : public Singleton<MysqlDao>,
     });
   }
 
+  // 空洞宽限期：sendDateTime 早于这个时长的消息之前若仍有空洞，视为
+  // 中止写入留下的，不再等待。
+  static constexpr int kSeqHoleGraceSeconds = 10;
+
+  static bool isSettled(const std::string &sendDateTime) {
+    std::tm sent{};
+    std::istringstream input(sendDateTime);
+    input >> std::get_time(&sent, "%Y-%m-%d %H:%M:%S");
+    if (input.fail())
+      return true;
+    sent.tm_isdst = -1;
+    const std::time_t sentAt = std::mktime(&sent);
+    return std::difftime(std::time(nullptr), sentAt) >= kSeqHoleGraceSeconds;
+  }
+
   int updateUserInfoName(long uid, const std::string &name) {
     return executeTemplate(
         [&](std::unique_ptr<mysqlx::Session> &session) -> int {
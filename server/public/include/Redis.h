@@ -5,6 +5,7 @@
 #include <memory>
 #include <sw/redis++/redis.h>
 
+#include <algorithm>
 #include <atomic>
 
 #include "Configer.h"
@@ -14,12 +15,15 @@
 #include "Metrics.h"
 #include "RequestContext.h"
 #include <condition_variable>
+#include <iterator>
 #include <jsoncpp/json/json.h>
 #include <mutex>
 #include <string>
 #include <queue>
 #include <spdlog/spdlog.h>
 #include <thread>
+#include <utility>
+#include <vector>
 
 namespace wimi::db {
 
@@ -314,6 +318,62 @@ return generation
     });
   }
 
+  // 登录准入批量发布 lease：每 batchSize 个会话一次 EVAL，多批放进同一条
+  // pipeline。bindings 为 (uid, connectionId)，返回与输入同序的 generation；
+  // Redis 不可用时返回空表。
+  std::vector<int64_t> bindSessionLeases(
+      const std::vector<std::pair<long, std::string>> &bindings,
+      const std::string &gatewayId, const std::string &instanceId,
+      long ttlSeconds, std::size_t batchSize) {
+    if (bindings.empty() || gatewayId.empty() || instanceId.empty() ||
+        ttlSeconds <= 0)
+      return {};
+    batchSize = std::max<std::size_t>(batchSize, 1);
+    return executeTemplate([&](std::unique_ptr<sw::redis::Redis> &redis) {
+      static const std::string script = R"(
+local generations = {}
+for i = 1, #KEYS / 2 do
+  local generation = redis.call('INCR', KEYS[i * 2 - 1])
+  local value = cjson.encode({gatewayId=ARGV[1], instanceId=ARGV[2], connectionId=ARGV[i + 3], generation=generation})
+  redis.call('SETEX', KEYS[i * 2], ARGV[3], value)
+  generations[i] = generation
+end
+return generations
+)";
+      const std::string ttl = std::to_string(ttlSeconds);
+      const std::size_t batches = (bindings.size() + batchSize - 1) / batchSize;
+      auto pipeline = redis->pipeline(false);
+      for (std::size_t batch = 0; batch < batches; ++batch) {
+        const std::size_t first = batch * batchSize;
+        const std::size_t last = std::min(first + batchSize, bindings.size());
+        std::vector<std::string> keys;
+        std::vector<std::string> args{gatewayId, instanceId, ttl};
+        keys.reserve((last - first) * 2);
+        args.reserve(last - first + 3);
+        for (std::size_t i = first; i < last; ++i) {
+          const auto &[uid, connectionId] = bindings[i];
+          keys.push_back(PrefixSessionGeneration + std::to_string(uid));
+          keys.push_back(PrefixSessionLease + std::to_string(uid));
+          args.push_back(connectionId);
+        }
+        pipeline.eval(script, keys.begin(), keys.end(), args.begin(),
+                      args.end());
+      }
+
+      auto replies = pipeline.exec();
+      std::vector<int64_t> generations;
+      generations.reserve(bindings.size());
+      for (std::size_t batch = 0; batch < batches; ++batch) {
+        for (const auto generation :
+             replies.get<std::vector<long long>>(batch))
+          generations.push_back(generation);
+      }
+      if (generations.size() != bindings.size())
+        return std::vector<int64_t>{};
+      return generations;
+    });
+  }
+
   SessionLease getSessionLease(long uid) {
     if (uid <= 0)
       return {};
@@ -321,16 +381,29 @@ return generation
       auto source = redis->get(PrefixSessionLease + std::to_string(uid));
       if (!source)
         return SessionLease{};
-      Json::Value value;
-      Json::Reader reader;
-      if (!reader.parse(*source, value))
-        return SessionLease{};
-      SessionLease lease;
-      lease.gatewayId = value["gatewayId"].asString();
-      lease.instanceId = value["instanceId"].asString();
-      lease.connectionId = value["connectionId"].asString();
-      lease.generation = value["generation"].asInt64();
-      return lease;
+      return parseSessionLease(*source);
+    });
+  }
+
+  // 群投递按接收者批量查询在线 lease：一次 MGET 往返，结果与 uids 同序，
+  // 不在线的位置为空 lease。Redis 不可用时返回空表。
+  std::vector<SessionLease> getSessionLeases(const std::vector<long> &uids) {
+    if (uids.empty())
+      return {};
+    return executeTemplate([&](std::unique_ptr<sw::redis::Redis> &redis) {
+      std::vector<std::string> keys;
+      keys.reserve(uids.size());
+      for (const long uid : uids)
+        keys.push_back(PrefixSessionLease + std::to_string(uid));
+      std::vector<sw::redis::OptionalString> sources;
+      sources.reserve(uids.size());
+      redis->mget(keys.begin(), keys.end(), std::back_inserter(sources));
+      std::vector<SessionLease> leases(uids.size());
+      for (std::size_t i = 0; i < sources.size() && i < leases.size(); ++i) {
+        if (uids[i] > 0 && sources[i])
+          leases[i] = parseSessionLease(*sources[i]);
+      }
+      return leases;
     });
   }
 
@@ -355,6 +428,68 @@ return redis.call('EXPIRE', KEYS[1], ARGV[5])
     });
   }
 
+  // 批量续约：每 batchSize 个 lease 一次 EVAL，多批放进同一条 pipeline，
+  // 一个往返完成。返回与输入同序的 CAS 结果；Redis 不可用时返回空表，
+  // 调用方应视为"本轮未知"而不是被取代。
+  std::vector<bool> refreshSessionLeases(
+      const std::vector<std::pair<long, SessionLease>> &leases,
+      long ttlSeconds, std::size_t batchSize) {
+    if (leases.empty() || ttlSeconds <= 0)
+      return {};
+    batchSize = std::max<std::size_t>(batchSize, 1);
+    return executeTemplate([&](std::unique_ptr<sw::redis::Redis> &redis) {
+      static const std::string script = R"(
+local refreshed = {}
+for i, key in ipairs(KEYS) do
+  local base = (i - 1) * 4 + 1
+  local result = 0
+  local value = redis.call('GET', key)
+  if value then
+    local lease = cjson.decode(value)
+    if lease.gatewayId == ARGV[base + 1] and lease.instanceId == ARGV[base + 2] and lease.connectionId == ARGV[base + 3] and tostring(lease.generation) == ARGV[base + 4] then
+      result = redis.call('EXPIRE', key, ARGV[1])
+    end
+  end
+  refreshed[i] = result
+end
+return refreshed
+)";
+      const std::string ttl = std::to_string(ttlSeconds);
+      const std::size_t batches = (leases.size() + batchSize - 1) / batchSize;
+      auto pipeline = redis->pipeline(false);
+      for (std::size_t batch = 0; batch < batches; ++batch) {
+        const std::size_t first = batch * batchSize;
+        const std::size_t last = std::min(first + batchSize, leases.size());
+        std::vector<std::string> keys;
+        std::vector<std::string> args;
+        keys.reserve(last - first);
+        args.reserve((last - first) * 4 + 1);
+        args.push_back(ttl);
+        for (std::size_t i = first; i < last; ++i) {
+          const auto &[uid, lease] = leases[i];
+          keys.push_back(PrefixSessionLease + std::to_string(uid));
+          args.push_back(lease.gatewayId);
+          args.push_back(lease.instanceId);
+          args.push_back(lease.connectionId);
+          args.push_back(std::to_string(lease.generation));
+        }
+        pipeline.eval(script, keys.begin(), keys.end(), args.begin(),
+                      args.end());
+      }
+
+      auto replies = pipeline.exec();
+      std::vector<bool> refreshed;
+      refreshed.reserve(leases.size());
+      for (std::size_t batch = 0; batch < batches; ++batch) {
+        for (const auto result : replies.get<std::vector<long long>>(batch))
+          refreshed.push_back(result == 1);
+      }
+      if (refreshed.size() != leases.size())
+        return std::vector<bool>{};
+      return refreshed;
+    });
+  }
+
   bool clearSessionLease(long uid, const SessionLease &lease) {
     if (uid <= 0 || lease.empty())
       return false;
@@ -396,6 +531,30 @@ return 1
     });
   }
 
+  // 批量登录校验：一次 MGET 取回全部凭证，结果与 tokens 同序。Redis 不可用
+  // 时返回空表，调用方应视为依赖不可用而不是凭证无效。
+  std::vector<bool> validateChatAuthTokens(
+      const std::vector<std::pair<long, std::string>> &tokens) {
+    if (tokens.empty())
+      return {};
+    return executeTemplate([&](std::unique_ptr<sw::redis::Redis> &redis) {
+      std::vector<std::string> keys;
+      keys.reserve(tokens.size());
+      for (const auto &[uid, token] : tokens)
+        keys.push_back(PrefixChatAuthToken + std::to_string(uid));
+      std::vector<sw::redis::OptionalString> stored;
+      stored.reserve(tokens.size());
+      redis->mget(keys.begin(), keys.end(), std::back_inserter(stored));
+      if (stored.size() != tokens.size())
+        return std::vector<bool>{};
+      std::vector<bool> valid(tokens.size());
+      for (std::size_t i = 0; i < tokens.size(); ++i)
+        valid[i] = tokens[i].first > 0 && !tokens[i].second.empty() &&
+                   stored[i] && *stored[i] == tokens[i].second;
+      return valid;
+    });
+  }
+
   const std::string __prefixUid = "im:userId";
   int64_t generateUserId() {
     return generateId(__prefixUid);
@@ -425,6 +584,56 @@ return 1
         });
   }
 
+  // 会话序号计数器：hash 中 seq 为已分配的最大序号，epoch 为计数器代次。
+  // 计数器缺失（过期或 Redis 丢数据）或落后于库里已提交的代次时，从库里
+  // 的 latestSeq/seqEpoch 重新起步并换代，旧代次分配出的序号在提交时被
+  // MySQL 拒绝。返回 {epoch, 首个序号}；Redis 不可用时返回空表。
+  const std::string PrefixConversationSeq = "im:conversationSeq:";
+  std::vector<int64_t> allocateConversationSeqs(long conversationId,
+                                                int64_t count, int64_t floor,
+                                                int64_t floorEpoch,
+                                                long ttlSeconds) {
+    if (conversationId <= 0 || count <= 0 || floor < 0 || floorEpoch < 0 ||
+        ttlSeconds <= 0)
+      return {};
+    return executeTemplate([&](std::unique_ptr<sw::redis::Redis> &redis) {
+      static const std::string script = R"(
+local epoch = tonumber(redis.call('HGET', KEYS[1], 'epoch') or '0')
+local seq = tonumber(redis.call('HGET', KEYS[1], 'seq') or '-1')
+local floor = tonumber(ARGV[1])
+local floorEpoch = tonumber(ARGV[2])
+if seq < 0 or epoch < floorEpoch then
+  epoch = floorEpoch + 1
+  seq = floor
+end
+if seq < floor then seq = floor end
+local last = seq + tonumber(ARGV[3])
+redis.call('HSET', KEYS[1], 'epoch', epoch, 'seq', last)
+redis.call('EXPIRE', KEYS[1], ARGV[4])
+return {epoch, seq + 1}
+)";
+      std::vector<long long> reply;
+      redis->eval(script,
+                  {PrefixConversationSeq + std::to_string(conversationId)},
+                  {std::to_string(floor), std::to_string(floorEpoch),
+                   std::to_string(count), std::to_string(ttlSeconds)},
+                  std::back_inserter(reply));
+      if (reply.size() != 2)
+        return std::vector<int64_t>{};
+      return std::vector<int64_t>{reply[0], reply[1]};
+    });
+  }
+
+  // 写入撞上序号冲突或被新代次拒绝：删掉计数器，下次分配重新起步。
+  bool resetConversationSeq(long conversationId) {
+    if (conversationId <= 0)
+      return false;
+    return executeTemplate([&](std::unique_ptr<sw::redis::Redis> &redis) {
+      redis->del(PrefixConversationSeq + std::to_string(conversationId));
+      return true;
+    });
+  }
+
   const std::string __prefixUserMsgId = "im:userMsgId";
   bool setUserMsgId(long userId, int64_t msgId, short expired) {
     return executeTemplate([&](std::unique_ptr<sw::redis::Redis> &redis) {
@@ -607,6 +816,19 @@ return 1
         });
   }
 
+  static SessionLease parseSessionLease(const std::string &source) {
+    Json::Value value;
+    Json::Reader reader;
+    if (!reader.parse(source, value))
+      return {};
+    SessionLease lease;
+    lease.gatewayId = value["gatewayId"].asString();
+    lease.instanceId = value["instanceId"].asString();
+    lease.connectionId = value["connectionId"].asString();
+    lease.generation = value["generation"].asInt64();
+    return lease;
+  }
+
  private:
   RedisPool::Ptr redisPool;
   uint16_t machineId;  // 集群中每个节点的唯一ID (0-1023)
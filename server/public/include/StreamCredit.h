@@ -0,0 +1,131 @@
+#pragma once
+
+#include "Metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+namespace wimi {
+
+// Gateway-Message 流的信用流控（v5）发送端。对端在注册时授予初始信用，
+// 每个计费帧（命令、投递）消耗一个；信用耗尽后计费帧在本端按序停放，
+// 收到 CreditGrant 再放行，停放数超过上限才拒绝。未 Enable 时不限流，
+// 兼容旧版本对端。调用方持有流的写锁。
+template <typename Frame>
+class StreamCreditWindow {
+ public:
+  enum class Admission { Send, Parked, Rejected };
+
+  StreamCreditWindow(std::size_t maxParked, Metric creditsGauge)
+      : maxParked(maxParked), creditsGauge(creditsGauge) {}
+
+  StreamCreditWindow(const StreamCreditWindow &) = delete;
+  StreamCreditWindow &operator=(const StreamCreditWindow &) = delete;
+
+  ~StreamCreditWindow() {
+    Close();
+  }
+
+  void Enable(uint32_t initialCredits) {
+    if (enabled)
+      return;
+    enabled = true;
+    credits = initialCredits;
+    Metrics::Increment(creditsGauge, credits);
+  }
+
+  bool Enabled() const {
+    return enabled;
+  }
+
+  // Send：已扣信用，调用方立即写入；Parked：frame 已移入停放队列；
+  // Rejected：停放队列已满，frame 原样保留。
+  Admission Admit(Frame &frame) {
+    if (!enabled)
+      return Admission::Send;
+    // 已有停放帧时新帧也要排在后面，保证计费帧之间的顺序。
+    if (credits > 0 && parked.empty()) {
+      --credits;
+      Metrics::Decrement(creditsGauge);
+      return Admission::Send;
+    }
+    if (parked.size() >= maxParked) {
+      Metrics::Increment(Metric::GatewayStreamCreditRejected);
+      return Admission::Rejected;
+    }
+    parked.push_back(std::move(frame));
+    Metrics::Increment(Metric::GatewayStreamQueuedForCredit);
+    Metrics::Increment(Metric::GatewayStreamCreditStalls);
+    return Admission::Parked;
+  }
+
+  // 追加信用，并把可以放行的停放帧按序交给 send。返回放行帧数。
+  template <typename Send>
+  std::size_t Grant(uint32_t granted, Send send) {
+    if (!enabled || granted == 0)
+      return 0;
+    credits += granted;
+    Metrics::Increment(creditsGauge, granted);
+    std::size_t released = 0;
+    while (credits > 0 && !parked.empty()) {
+      --credits;
+      send(std::move(parked.front()));
+      parked.pop_front();
+      ++released;
+    }
+    Metrics::Decrement(creditsGauge, released);
+    Metrics::Decrement(Metric::GatewayStreamQueuedForCredit, released);
+    return released;
+  }
+
+  // 流关闭：丢弃停放帧并撤回 gauge 中本流的份额。返回丢弃的帧数。
+  std::size_t Close() {
+    const std::size_t dropped = parked.size();
+    Metrics::Decrement(creditsGauge, credits);
+    Metrics::Decrement(Metric::GatewayStreamQueuedForCredit, dropped);
+    credits = 0;
+    parked.clear();
+    enabled = false;
+    return dropped;
+  }
+
+  uint64_t Available() const {
+    return credits;
+  }
+
+  std::size_t Parked() const {
+    return parked.size();
+  }
+
+ private:
+  const std::size_t maxParked;
+  const Metric creditsGauge;
+  bool enabled{false};
+  uint64_t credits{0};
+  std::deque<Frame> parked;
+};
+
+// 信用流控接收端：每处理完一个计费帧记一次，累计达到容量的四分之一时
+// 返回应回送的授信数，其余时候返回 0。未回送的信用始终少于容量，发送端
+// 不会因为尾部零头而停住。可在多个线程上并发调用。
+class StreamCreditReturn {
+ public:
+  explicit StreamCreditReturn(uint32_t capacity)
+      : batch(std::max<uint32_t>(capacity / 4, 1)) {}
+
+  uint32_t Consume(uint32_t count = 1) {
+    if (pending.fetch_add(count, std::memory_order_acq_rel) + count < batch)
+      return 0;
+    return pending.exchange(0, std::memory_order_acq_rel);
+  }
+
+ private:
+  const uint32_t batch;
+  std::atomic<uint32_t> pending{0};
+};
+
+}  // namespace wimi
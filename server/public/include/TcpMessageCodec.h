@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 #include "Const.h"
 #include "tcp_message.pb.h"
@@ -13,6 +14,10 @@ inline bool ParseTcpPacket(const std::string &data, TcpPacket &packet) {
   return packet.ParseFromString(data);
 }
 
+inline bool ParseTcpPacket(std::string_view data, TcpPacket &packet) {
+  return packet.ParseFromArray(data.data(), static_cast<int>(data.size()));
+}
+
 inline std::string SerializeTcpPacket(const TcpPacket &packet) {
   std::string data;
   packet.SerializeToString(&data);
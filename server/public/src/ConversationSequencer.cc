@@ -0,0 +1,75 @@
+#include "ConversationSequencer.h"
+
+#include "Redis.h"
+
+#include <algorithm>
+
+namespace wimi::db {
+
+RedisConversationSequencer::RedisConversationSequencer(long ttlSeconds)
+    : ttlSeconds(std::max<long>(ttlSeconds, 1)) {}
+
+SequenceRange RedisConversationSequencer::Allocate(int64_t conversationId,
+                                                   int64_t count,
+                                                   int64_t floor,
+                                                   int64_t floorEpoch) {
+  const auto reply = RedisDao::GetInstance()->allocateConversationSeqs(
+      conversationId, count, floor, floorEpoch, ttlSeconds);
+  if (reply.size() != 2)
+    return {};
+  return SequenceRange{reply[1], count, reply[0]};
+}
+
+void RedisConversationSequencer::Reset(int64_t conversationId) {
+  RedisDao::GetInstance()->resetConversationSeq(conversationId);
+}
+
+OwnerConversationSequencer::OwnerConversationSequencer(
+    std::size_t maxConversationsPerShard)
+    : maxConversationsPerShard(
+          std::max<std::size_t>(maxConversationsPerShard, 1)) {}
+
+SequenceRange OwnerConversationSequencer::Allocate(int64_t conversationId,
+                                                   int64_t count,
+                                                   int64_t floor,
+                                                   int64_t floorEpoch) {
+  if (conversationId <= 0 || count <= 0 || floor < 0 || floorEpoch < 0)
+    return {};
+  auto &shard = ShardFor(conversationId);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto found = shard.counters.find(conversationId);
+  if (found == shard.counters.end()) {
+    if (shard.counters.size() >= maxConversationsPerShard)
+      shard.counters.erase(shard.counters.begin());
+    found = shard.counters.emplace(conversationId, Counter{}).first;
+  }
+  auto &counter = found->second;
+  if (counter.epoch == 0 || counter.epoch < floorEpoch) {
+    counter.epoch = floorEpoch + 1;
+    counter.last = floor;
+  }
+  counter.last = std::max(counter.last, floor);
+  const int64_t first = counter.last + 1;
+  counter.last += count;
+  return SequenceRange{first, count, counter.epoch};
+}
+
+void OwnerConversationSequencer::Reset(int64_t conversationId) {
+  auto &shard = ShardFor(conversationId);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.counters.erase(conversationId);
+}
+
+OwnerConversationSequencer::Shard &OwnerConversationSequencer::ShardFor(
+    int64_t conversationId) {
+  return shards[static_cast<uint64_t>(conversationId) % kShards];
+}
+
+std::unique_ptr<ConversationSequencer> MakeConversationSequencer(
+    const std::string &mode) {
+  if (mode == "owner")
+    return std::make_unique<OwnerConversationSequencer>();
+  return std::make_unique<RedisConversationSequencer>();
+}
+
+}  // namespace wimi::db
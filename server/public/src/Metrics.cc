@@ -12,6 +12,11 @@ void Metrics::Increment(Metric metric, uint64_t value) {
       value, std::memory_order_relaxed);
 }
 
+void Metrics::Decrement(Metric metric, uint64_t value) {
+  Counters()[static_cast<std::size_t>(metric)].fetch_sub(
+      value, std::memory_order_relaxed);
+}
+
 uint64_t Metrics::Get(Metric metric) {
   return Counters()[static_cast<std::size_t>(metric)].load(
       std::memory_order_relaxed);
@@ -31,7 +36,44 @@ std::string_view Metrics::Name(Metric metric) {
                "rpc_acquire_timeout",
                "rpc_deadline_exceeded",
                "idempotency_accepted",
-               "idempotency_replayed"};
+               "idempotency_replayed",
+               "gateway_socket_writes",
+               "gateway_frames_written",
+               "gateway_lease_refresh_batches",
+               "gateway_leases_refreshed",
+               "gateway_leases_fenced",
+               "gateway_queued_frames",
+               "gateway_queued_bytes",
+               "gateway_pushes_dropped",
+               "gateway_pushes_backpressured",
+               "gateway_slow_consumer_disconnects",
+               "gateway_stream_writes",
+               "gateway_stream_frames_written",
+               "gateway_multicast_deliveries",
+               "gateway_multicast_recipients",
+               "gateway_stream_command_credits",
+               "gateway_stream_delivery_credits",
+               "gateway_stream_queued_for_credit",
+               "gateway_stream_credit_stalls",
+               "gateway_stream_credit_rejected",
+               "gateway_hedges_sent",
+               "gateway_hedges_won",
+               "gateway_hedges_over_budget",
+               "gateway_logins_queued",
+               "gateway_logins_admitted",
+               "gateway_logins_rejected",
+               "gateway_login_batches",
+               "gateway_login_queue_microseconds",
+               "gateway_sessions_parked",
+               "gateway_sessions_resumed",
+               "gateway_resume_misses",
+               "message_accept_batches",
+               "message_accepts_batched",
+               "message_multicast_recipients_queued",
+               "message_multicast_recipients_offline",
+               "message_multicast_recipients_backpressured",
+               "message_multicast_recipients_stale_route",
+               "message_multicast_acks_unmatched"};
   return names[static_cast<std::size_t>(metric)];
 }
 
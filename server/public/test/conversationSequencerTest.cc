@@ -0,0 +1,86 @@
+#include "ConversationSequencer.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace {
+
+using wimi::db::OwnerConversationSequencer;
+using wimi::db::SequenceRange;
+
+void Require(bool condition, const std::string &message) {
+  if (condition)
+    return;
+  std::cerr << message << '\n';
+  std::exit(EXIT_FAILURE);
+}
+
+bool Is(const SequenceRange &range, int64_t first, int64_t count,
+        int64_t epoch) {
+  return range.first == first && range.count == count && range.epoch == epoch;
+}
+
+void TestNewCounterStartsAboveFloorEpoch() {
+  OwnerConversationSequencer sequencer;
+  Require(Is(sequencer.Allocate(7, 3, 10, 4), 11, 3, 5),
+          "a new counter should start after floor with floorEpoch + 1");
+  Require(Is(sequencer.Allocate(7, 2, 10, 5), 14, 2, 5),
+          "a current counter should keep allocating in its own epoch");
+}
+
+void TestCounterBehindFloorIsRebased() {
+  OwnerConversationSequencer sequencer;
+  Require(Is(sequencer.Allocate(7, 5, 0, 0), 1, 5, 1), "first allocation");
+  // 同代次但库里已推进到更大的序号：从 floor 之后继续，代次不变。
+  Require(Is(sequencer.Allocate(7, 1, 9, 1), 10, 1, 1),
+          "a counter behind floor should skip to floor");
+  // 其他持有者已换代：从 floor 重新起步并再换一代。
+  Require(Is(sequencer.Allocate(7, 1, 20, 3), 21, 1, 4),
+          "a counter behind floorEpoch should restart from floor");
+}
+
+void TestResetDropsCounter() {
+  OwnerConversationSequencer sequencer;
+  Require(Is(sequencer.Allocate(7, 5, 0, 0), 1, 5, 1), "first allocation");
+  sequencer.Reset(7);
+  Require(Is(sequencer.Allocate(7, 1, 0, 1), 1, 1, 2),
+          "a reset counter should restart above the committed epoch");
+}
+
+void TestEvictedCounterRestartsInNewEpoch() {
+  // 一个分片只留一个会话；7 与 71 落在同一分片。
+  OwnerConversationSequencer sequencer(1);
+  Require(Is(sequencer.Allocate(7, 5, 0, 0), 1, 5, 1), "first allocation");
+  Require(Is(sequencer.Allocate(71, 1, 0, 0), 1, 1, 1),
+          "another conversation in the shard should get its own counter");
+  Require(Is(sequencer.Allocate(7, 1, 0, 1), 1, 1, 2),
+          "an evicted counter should restart in a new epoch");
+  Require(Is(sequencer.Allocate(8, 1, 0, 0), 1, 1, 1),
+          "other shards should not be evicted");
+  Require(Is(sequencer.Allocate(7, 1, 1, 2), 2, 1, 2),
+          "a conversation in another shard should not evict this one");
+}
+
+void TestInvalidArgumentsAreRejected() {
+  OwnerConversationSequencer sequencer;
+  Require(!sequencer.Allocate(0, 1, 0, 0).Valid(),
+          "a missing conversation should be rejected");
+  Require(!sequencer.Allocate(7, 0, 0, 0).Valid(),
+          "an empty allocation should be rejected");
+  Require(!sequencer.Allocate(7, 1, -1, 0).Valid(),
+          "a negative floor should be rejected");
+}
+
+}  // namespace
+
+int main() {
+  TestNewCounterStartsAboveFloorEpoch();
+  TestCounterBehindFloorIsRebased();
+  TestResetDropsCounter();
+  TestEvictedCounterRestartsInNewEpoch();
+  TestInvalidArgumentsAreRejected();
+  std::cout << "conversation sequencer tests passed\n";
+  return EXIT_SUCCESS;
+}
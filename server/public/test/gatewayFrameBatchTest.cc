@@ -0,0 +1,128 @@
+#include "GatewayFrameBatch.h"
+
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <string>
+
+namespace {
+
+using wimi::gateway::GatewayToMessageFrame;
+using wimi::gateway::MessageToGatewayFrame;
+
+void Require(bool condition, const std::string &message) {
+  if (condition)
+    return;
+  std::cerr << message << '\n';
+  std::exit(EXIT_FAILURE);
+}
+
+GatewayToMessageFrame Command(const std::string &requestId) {
+  GatewayToMessageFrame frame;
+  frame.mutable_command()->set_request_id(requestId);
+  return frame;
+}
+
+GatewayToMessageFrame Ack(const std::string &deliveryId) {
+  GatewayToMessageFrame frame;
+  auto *ack = frame.mutable_delivery_ack();
+  ack->set_delivery_id(deliveryId);
+  ack->set_gateway_id("gateway-1");
+  ack->set_instance_id("instance-1");
+  return frame;
+}
+
+GatewayToMessageFrame Heartbeat(uint64_t sequence) {
+  GatewayToMessageFrame frame;
+  frame.mutable_heartbeat()->set_sequence(sequence);
+  return frame;
+}
+
+void TestCommandsCoalesceAroundControlFrames() {
+  std::deque<GatewayToMessageFrame> queue{Command("r1"), Heartbeat(1),
+                                          Command("r2"), Ack("d1"),
+                                          Command("r3")};
+  GatewayToMessageFrame out;
+  Require(wimi::TakeNextStreamFrame(queue, out, true) == 3,
+          "queued commands should share one write");
+  Require(out.has_command_batch() && out.command_batch().commands_size() == 3 &&
+              out.command_batch().commands(0).request_id() == "r1" &&
+              out.command_batch().commands(2).request_id() == "r3",
+          "command batch should keep queue order");
+  Require(queue.size() == 2 && queue[0].has_heartbeat() &&
+              queue[1].has_delivery_ack(),
+          "other frames should stay queued in order");
+}
+
+void TestAcksHoistGatewayIdentity() {
+  std::deque<GatewayToMessageFrame> queue{Ack("d1"), Ack("d2")};
+  GatewayToMessageFrame out;
+  Require(wimi::TakeNextStreamFrame(queue, out, true) == 2 && queue.empty(),
+          "queued acks should share one write");
+  const auto &batch = out.delivery_ack_batch();
+  Require(batch.gateway_id() == "gateway-1" &&
+              batch.instance_id() == "instance-1" && batch.acks_size() == 2 &&
+              batch.acks(1).delivery_id() == "d2" &&
+              batch.acks(0).gateway_id().empty(),
+          "ack batch should carry the identity once");
+}
+
+void TestSingleFrameAndV1StayUnbatched() {
+  std::deque<GatewayToMessageFrame> queue{Command("r1"), Heartbeat(1)};
+  GatewayToMessageFrame out;
+  Require(wimi::TakeNextStreamFrame(queue, out, true) == 1 &&
+              out.has_command() && queue.size() == 1,
+          "a lone command should be sent as a v1 frame");
+
+  queue = {Command("r1"), Command("r2")};
+  Require(wimi::TakeNextStreamFrame(queue, out, false) == 1 &&
+              out.has_command() && queue.size() == 1,
+          "v1 streams must not batch");
+}
+
+void TestBatchRespectsFrameLimit() {
+  std::deque<MessageToGatewayFrame> queue;
+  for (std::size_t i = 0; i < wimi::kGatewayStreamBatchMaxFrames + 10; ++i) {
+    MessageToGatewayFrame frame;
+    frame.mutable_delivery()->set_delivery_id(std::to_string(i));
+    queue.push_back(std::move(frame));
+  }
+  MessageToGatewayFrame out;
+  Require(wimi::TakeNextStreamFrame(queue, out, true) ==
+              wimi::kGatewayStreamBatchMaxFrames,
+          "delivery batch should stop at the frame limit");
+  Require(queue.size() == 10 && queue.front().delivery().delivery_id() ==
+                                    std::to_string(
+                                        wimi::kGatewayStreamBatchMaxFrames),
+          "deliveries past the limit should stay queued in order");
+}
+
+void TestBatchRespectsByteLimit() {
+  std::deque<MessageToGatewayFrame> queue;
+  const std::string packet(wimi::kGatewayStreamBatchMaxBytes / 3, 'x');
+  for (int i = 0; i < 4; ++i) {
+    MessageToGatewayFrame frame;
+    frame.mutable_command_result()->set_request_id(std::to_string(i));
+    frame.mutable_command_result()->set_packet(packet);
+    queue.push_back(std::move(frame));
+  }
+  MessageToGatewayFrame out;
+  Require(wimi::TakeNextStreamFrame(queue, out, true) == 2 &&
+              out.command_result_batch().results_size() == 2,
+          "result batch should stop before the byte limit");
+  Require(queue.size() == 2 && queue.front().command_result().request_id() ==
+                                   "2",
+          "results past the byte limit should stay queued in order");
+}
+
+}  // namespace
+
+int main() {
+  TestCommandsCoalesceAroundControlFrames();
+  TestAcksHoistGatewayIdentity();
+  TestSingleFrameAndV1StayUnbatched();
+  TestBatchRespectsFrameLimit();
+  TestBatchRespectsByteLimit();
+  std::cout << "gateway frame batch tests passed\n";
+  return EXIT_SUCCESS;
+}
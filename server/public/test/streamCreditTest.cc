@@ -0,0 +1,112 @@
+#include "StreamCredit.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using wimi::Metric;
+using wimi::Metrics;
+using wimi::StreamCreditReturn;
+using Window = wimi::StreamCreditWindow<int>;
+using Admission = Window::Admission;
+
+void Require(bool condition, const std::string &message) {
+  if (condition)
+    return;
+  std::cerr << message << '\n';
+  std::exit(EXIT_FAILURE);
+}
+
+void TestDisabledWindowDoesNotLimit() {
+  Window window(1, Metric::GatewayStreamCommandCredits);
+  for (int i = 0; i < 100; ++i) {
+    int frame = i;
+    Require(window.Admit(frame) == Admission::Send,
+            "window without negotiated credit should not limit old peers");
+  }
+}
+
+void TestCreditsParkAndReleaseInOrder() {
+  const auto before = Metrics::Get(Metric::GatewayStreamCommandCredits);
+  Window window(8, Metric::GatewayStreamCommandCredits);
+  window.Enable(2);
+  Require(Metrics::Get(Metric::GatewayStreamCommandCredits) == before + 2,
+          "enabled credits should be exported");
+  for (int i = 0; i < 2; ++i) {
+    int frame = i;
+    Require(window.Admit(frame) == Admission::Send, "credit should be spent");
+  }
+  for (int i = 2; i < 5; ++i) {
+    int frame = i;
+    Require(window.Admit(frame) == Admission::Parked,
+            "frames beyond credit should park");
+  }
+  Require(window.Parked() == 3 && window.Available() == 0,
+          "three frames should wait for credit");
+
+  std::vector<int> released;
+  const auto send = [&released](int frame) { released.push_back(frame); };
+  Require(window.Grant(2, send) == 2, "grant should release two frames");
+  Require(released == std::vector<int>({2, 3}),
+          "parked frames should leave in order");
+  // 仍有停放帧时，新帧不能越过它们直接使用信用。
+  window.Grant(0, send);
+  int late = 5;
+  Require(window.Admit(late) == Admission::Parked,
+          "new frames should queue behind parked ones");
+  window.Grant(4, send);
+  Require(released == std::vector<int>({2, 3, 4, 5}),
+          "later grant should release the rest in order");
+  Require(window.Available() == 2 &&
+              Metrics::Get(Metric::GatewayStreamCommandCredits) == before + 2,
+          "unused credit should remain available");
+  window.Close();
+  Require(Metrics::Get(Metric::GatewayStreamCommandCredits) == before,
+          "closing should withdraw the exported credit");
+}
+
+void TestFullParkingRejects() {
+  const auto rejected = Metrics::Get(Metric::GatewayStreamCreditRejected);
+  const auto queued = Metrics::Get(Metric::GatewayStreamQueuedForCredit);
+  Window window(2, Metric::GatewayStreamDeliveryCredits);
+  window.Enable(0);
+  int first = 1;
+  int second = 2;
+  int third = 3;
+  Require(window.Admit(first) == Admission::Parked &&
+              window.Admit(second) == Admission::Parked,
+          "frames should park until the limit");
+  Require(window.Admit(third) == Admission::Rejected && third == 3,
+          "a rejected frame should stay with the caller");
+  Require(Metrics::Get(Metric::GatewayStreamCreditRejected) == rejected + 1,
+          "rejections should be counted");
+  Require(Metrics::Get(Metric::GatewayStreamQueuedForCredit) == queued + 2,
+          "parked frames should be exported");
+  Require(window.Close() == 2, "closing should drop parked frames");
+  Require(Metrics::Get(Metric::GatewayStreamQueuedForCredit) == queued,
+          "dropped frames should leave the queued gauge");
+}
+
+void TestReturnBatchesCredits() {
+  StreamCreditReturn credits(16);
+  Require(credits.Consume() == 0 && credits.Consume(2) == 0,
+          "credit below a quarter of capacity should be held back");
+  Require(credits.Consume() == 4, "a quarter of capacity should be returned");
+  Require(credits.Consume(9) == 9, "large batches should return at once");
+  StreamCreditReturn tiny(1);
+  Require(tiny.Consume() == 1, "tiny windows should return every credit");
+}
+
+}  // namespace
+
+int main() {
+  TestDisabledWindowDoesNotLimit();
+  TestCreditsParkAndReleaseInOrder();
+  TestFullParkingRejects();
+  TestReturnBatchesCredits();
+  std::cout << "stream credit tests passed\n";
+  return EXIT_SUCCESS;
+}
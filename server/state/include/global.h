@@ -11,6 +11,9 @@ struct ServiceNodeInfo {
   unsigned short port{0};
   std::string status{"active"};
   unsigned int weight{1};
+  // 仅 Message 节点：同机部署时的 Unix 域套接字与主机标识。
+  std::string localSocket;
+  std::string hostId;
 
   bool active() const {
     return status == "active" && !host.empty() && port != 0;
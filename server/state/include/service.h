@@ -9,6 +9,7 @@
 namespace wimi::rpc {
 using state::ConnectUser;
 using state::ConnectUserRsp;
+using state::GatewayTopology;
 using state::MessageTopology;
 using state::StateService;
 using state::TestNetwork;
@@ -25,6 +26,10 @@ class StateServiceImpl final : public StateService::Service {
                                 const TopologyRequest *request,
                                 MessageTopology *response) override;
 
+  grpc::Status ListConnectionGateways(grpc::ServerContext *context,
+                                      const TopologyRequest *request,
+                                      GatewayTopology *response) override;
+
   grpc::Status GetImServer(grpc::ServerContext *context,
                            const ConnectUser *request,
                            ConnectUserRsp *response) override;
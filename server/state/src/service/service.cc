@@ -37,6 +37,10 @@ std::vector<ServiceNodeInfo> LoadNodes(const YAML::Node &server,
     node.status = source["status"] ? source["status"].as<std::string>()
                                    : std::string{"active"};
     node.weight = source["weight"] ? source["weight"].as<unsigned int>() : 1;
+    if (source["localSocket"])
+      node.localSocket = source["localSocket"].as<std::string>();
+    if (source["hostId"])
+      node.hostId = source["hostId"].as<std::string>();
     nodes.push_back(std::move(node));
   }
   return nodes;
@@ -125,9 +129,27 @@ grpc::Status StateServiceImpl::ListMessageNodes(grpc::ServerContext *,
     target->set_port(node.port);
     target->set_status(node.status);
     target->set_weight(node.weight);
+    target->set_local_socket(node.localSocket);
+    target->set_host_id(node.hostId);
   }
   return grpc::Status::OK;
 }
+
+grpc::Status StateServiceImpl::ListConnectionGateways(
+    grpc::ServerContext *, const TopologyRequest *, GatewayTopology *response) {
+  for (const auto &node : gatewayNodes) {
+    if (!node.active())
+      continue;
+    auto *target = response->add_nodes();
+    target->set_node_id(node.id);
+    target->set_host(node.host);
+    target->set_port(node.port);
+    target->set_status(node.status);
+    target->set_weight(node.weight);
+  }
+  return grpc::Status::OK;
+}
+
 grpc::Status StateServiceImpl::GetImServer(grpc::ServerContext *context,
                                            const ConnectUser *request,
                                            ConnectUserRsp *response) {